@@ -46,7 +46,8 @@ public class ColumnSchema {
     GROUP_VARINT(EncodingType.GROUP_VARINT),
     RLE(EncodingType.RLE),
     DICT_ENCODING(EncodingType.DICT_ENCODING),
-    BIT_SHUFFLE(EncodingType.BIT_SHUFFLE);
+    BIT_SHUFFLE(EncodingType.BIT_SHUFFLE),
+    FRAME_OF_REFERENCE(EncodingType.FRAME_OF_REFERENCE);
 
     final EncodingType internalPbType;
 
@@ -0,0 +1,124 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Micro benchmark comparing the encoded size and decode speed of the
+// integer block encodings on timestamp- and counter-like data.
+//
+
+#include <glog/logging.h>
+#include <gflags/gflags.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/bshuf_block.h"
+#include "kudu/cfile/cfile_writer.h"
+#include "kudu/cfile/for_block.h"
+#include "kudu/cfile/gvint_block.h"
+#include "kudu/cfile/plain_block.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/stopwatch.h"
+
+DEFINE_int32(int_encodings_num_values, 64 * 1024,
+             "Number of values to encode in each block");
+DEFINE_int32(int_encodings_num_iters, 1000,
+             "Number of times to decode each block");
+
+namespace kudu {
+namespace cfile {
+
+using std::vector;
+
+// Encode 'vals' into a single block, then decode the whole block
+// FLAGS_int_encodings_num_iters times, 1024 rows at a time as a scan would.
+template<DataType Type, class BuilderType, class DecoderType>
+void EncodeAndDecode(const std::string& name,
+                     const vector<typename TypeTraits<Type>::cpp_type>& vals) {
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  const size_t kBatchSize = 1024;
+
+  WriterOptions opts;
+  opts.storage_attributes.cfile_block_size = vals.size() * sizeof(CppType) * 2;
+  BuilderType builder(&opts);
+  builder.Add(reinterpret_cast<const uint8_t*>(&vals[0]), vals.size());
+  Slice encoded = builder.Finish(0);
+  LOG(INFO) << strings::Substitute("$0: $1 bytes for $2 values ($3 bits/value)",
+                                   name, encoded.size(), vals.size(),
+                                   encoded.size() * 8.0 / vals.size());
+
+  Arena arena(1024, 1024 * 1024);
+  vector<CppType> decoded(kBatchSize);
+  ColumnBlock dst(GetTypeInfo(Type), NULL, &decoded[0], kBatchSize, &arena);
+  LOG_TIMING(INFO, strings::Substitute("decoding $0", name)) {
+    for (int i = 0; i < FLAGS_int_encodings_num_iters; i++) {
+      DecoderType decoder(encoded);
+      CHECK_OK(decoder.ParseHeader());
+      while (decoder.HasNext()) {
+        size_t n = kBatchSize;
+        ColumnDataView view(&dst);
+        CHECK_OK(decoder.CopyNextValues(&n, &view));
+      }
+    }
+  }
+}
+
+// Microsecond timestamps a few hundred micros apart.
+void Timestamps() {
+  vector<int64_t> vals;
+  int64_t ts = 1440000000000000L;
+  for (int i = 0; i < FLAGS_int_encodings_num_values; i++) {
+    ts += random() % 500;
+    vals.push_back(ts);
+  }
+  EncodeAndDecode<INT64, PlainBlockBuilder<INT64>, PlainBlockDecoder<INT64> >(
+      "timestamps PLAIN_ENCODING", vals);
+  EncodeAndDecode<INT64, BShufBlockBuilder<INT64>, BShufBlockDecoder<INT64> >(
+      "timestamps BIT_SHUFFLE", vals);
+  EncodeAndDecode<INT64, ForBlockBuilder<INT64>, ForBlockDecoder<INT64> >(
+      "timestamps FRAME_OF_REFERENCE", vals);
+}
+
+// Small, unsorted counter values.
+void Counters() {
+  vector<uint32_t> vals;
+  for (int i = 0; i < FLAGS_int_encodings_num_values; i++) {
+    vals.push_back(random() % 5000);
+  }
+  EncodeAndDecode<UINT32, PlainBlockBuilder<UINT32>, PlainBlockDecoder<UINT32> >(
+      "counters PLAIN_ENCODING", vals);
+  EncodeAndDecode<UINT32, GVIntBlockBuilder, GVIntBlockDecoder>(
+      "counters GROUP_VARINT", vals);
+  EncodeAndDecode<UINT32, BShufBlockBuilder<UINT32>, BShufBlockDecoder<UINT32> >(
+      "counters BIT_SHUFFLE", vals);
+  EncodeAndDecode<UINT32, ForBlockBuilder<UINT32>, ForBlockDecoder<UINT32> >(
+      "counters FRAME_OF_REFERENCE", vals);
+}
+
+} // namespace cfile
+} // namespace kudu
+
+int main(int argc, char **argv) {
+  FLAGS_logtostderr = 1;
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+
+  kudu::cfile::Timestamps();
+  kudu::cfile::Counters();
+
+  return 0;
+}
@@ -22,8 +22,10 @@
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/cfile/bshuf_block.h"
 #include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/coding-inl.h"
 #include "kudu/util/group_varint-inl.h"
@@ -257,6 +259,46 @@ Status BinaryDictBlockDecoder::CopyNextDecodeStrings(size_t* n, ColumnDataView*
   return Status::OK();
 }
 
+Status BinaryDictBlockDecoder::CopyNextMatchingValues(size_t* n,
+                                                      const uint8_t* matching_codewords,
+                                                      SelectionVector* sel,
+                                                      ColumnDataView* dst) {
+  DCHECK(parsed_);
+  DCHECK_EQ(mode_, kCodeWordMode);
+  CHECK_EQ(dst->type_info()->physical_type(), BINARY);
+  DCHECK_LE(*n, dst->nrows());
+  DCHECK_EQ(dst->stride(), sizeof(Slice));
+
+  Arena* out_arena = dst->arena();
+  Slice* out = reinterpret_cast<Slice*>(dst->data());
+
+  codeword_buf_.resize((*n)*sizeof(uint32_t));
+  BShufBlockDecoder<UINT32>* d_bptr = down_cast<BShufBlockDecoder<UINT32>*>(data_decoder_.get());
+  RETURN_NOT_OK(d_bptr->CopyNextValuesToArray(n, codeword_buf_.data()));
+  const uint32_t* codewords = reinterpret_cast<const uint32_t*>(codeword_buf_.data());
+
+  // Each row costs a bit test against the dictionary's match bitmap; only
+  // the strings of the surviving rows are copied into the arena.
+  uint8_t* sel_bitmap = sel->mutable_bitmap();
+  size_t row_idx = dst->first_row_index();
+  DCHECK_LE(row_idx + *n, sel->nrows());
+  for (size_t i = 0; i < *n; i++, row_idx++) {
+    if (!BitmapTest(sel_bitmap, row_idx)) {
+      out[i] = Slice();
+      continue;
+    }
+    uint32_t codeword = codewords[i];
+    DCHECK_LT(codeword, dict_decoder_->Count());
+    if (!BitmapTest(matching_codewords, codeword)) {
+      BitmapClear(sel_bitmap, row_idx);
+      out[i] = Slice();
+      continue;
+    }
+    CHECK(out_arena->RelocateSlice(dict_decoder_->string_at_index(codeword), &out[i]));
+  }
+  return Status::OK();
+}
+
 Status BinaryDictBlockDecoder::CopyNextValues(size_t* n, ColumnDataView* dst) {
   if (mode_ == kCodeWordMode) {
     return CopyNextDecodeStrings(n, dst);
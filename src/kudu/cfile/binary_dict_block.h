@@ -49,6 +49,7 @@
 
 namespace kudu {
 class Arena;
+class SelectionVector;
 namespace cfile {
 
 struct WriterOptions;
@@ -139,6 +140,23 @@ class BinaryDictBlockDecoder : public BlockDecoder {
     return data_decoder_->GetFirstRowId();
   }
 
+  // Return true if the block stores codewords into the cfile's dictionary,
+  // rather than falling back to plain-encoded strings.
+  bool is_codeword_mode() const {
+    return mode_ == kCodeWordMode;
+  }
+
+  // Like CopyNextValues(), but only copies the strings of the rows which
+  // are selected in 'sel' and whose codeword is set in 'matching_codewords'.
+  // The bits in 'sel' of the rows whose codeword is not set are cleared,
+  // and the cells of all rows which aren't copied are set to empty slices.
+  // The values correspond to the rows of 'sel' starting at
+  // dst->first_row_index().
+  //
+  // Only valid in codeword mode.
+  Status CopyNextMatchingValues(size_t* n, const uint8_t* matching_codewords,
+                                SelectionVector* sel, ColumnDataView* dst);
+
   static const size_t kMinHeaderSize = sizeof(uint32_t) * 1;
 
  private:
@@ -154,7 +172,8 @@ class BinaryDictBlockDecoder : public BlockDecoder {
 
   DictEncodingMode mode_;
 
-  // buffer to hold the codewords, needed by CopyNextDecodeStrings()
+  // buffer to hold the codewords, needed by CopyNextDecodeStrings() and
+  // CopyNextMatchingValues()
   faststring codeword_buf_;
 
 };
@@ -106,6 +106,10 @@ class BinaryPlainBlockDecoder : public BlockDecoder {
     return ordinal_pos_base_;
   }
 
+  virtual size_t memory_footprint() const OVERRIDE {
+    return kudu_malloc_usable_size(this) + offsets_.capacity() * sizeof(uint32_t);
+  }
+
   Slice string_at_index(size_t idx) const {
     const uint32_t offset = offsets_[idx];
     uint32_t len = offsets_[idx + 1] - offset;
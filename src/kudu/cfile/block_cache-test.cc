@@ -54,6 +54,32 @@ TEST(TestBlockCache, TestBasics) {
 
 }
 
+// Tests that churning through data blocks doesn't evict index blocks, which
+// are cached separately.
+TEST(TestBlockCache, TestIndexBlocksNotEvictedByDataBlocks) {
+  const size_t kBlockSize = 4096;
+  BlockCache data_cache(1024 * 1024);
+  IndexBlockCache index_cache(1024 * 1024);
+  BlockCache::FileId id(1234);
+
+  {
+    BlockCacheHandle handle;
+    uint8_t* data = index_cache.Allocate(kBlockSize);
+    ASSERT_TRUE(index_cache.Insert(id, 0, Slice(data, kBlockSize), &handle));
+  }
+
+  // Insert many times the data cache's capacity worth of blocks.
+  for (int i = 1; i <= 1024; i++) {
+    BlockCacheHandle handle;
+    uint8_t* data = data_cache.Allocate(kBlockSize);
+    ASSERT_TRUE(data_cache.Insert(id, i * kBlockSize, Slice(data, kBlockSize), &handle));
+  }
+
+  BlockCacheHandle handle;
+  ASSERT_FALSE(data_cache.Lookup(id, kBlockSize, Cache::EXPECT_IN_CACHE, &handle));
+  ASSERT_TRUE(index_cache.Lookup(id, 0, Cache::EXPECT_IN_CACHE, &handle));
+}
+
 
 } // namespace cfile
 } // namespace kudu
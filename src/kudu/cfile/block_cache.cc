@@ -12,11 +12,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <gflags/gflags.h>
 
 #include "kudu/cfile/block_cache.h"
 #include "kudu/gutil/port.h"
 #include "kudu/util/cache.h"
+#include "kudu/util/cache_metrics.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/slice.h"
@@ -27,11 +29,56 @@ TAG_FLAG(block_cache_capacity_mb, stable);
 
 DEFINE_string(block_cache_type, "DRAM",
               "Which type of block cache to use for caching data. "
-              "Valid choices are 'DRAM' or 'NVM'. DRAM, the default, "
-              "caches data in regular memory. 'NVM' caches data "
-              "in a memory-mapped file using the NVML library.");
+              "Valid choices are 'DRAM', 'SLRU', 'CLOCK' or 'NVM'. DRAM, the default, "
+              "caches data in regular memory with an LRU eviction policy. "
+              "'SLRU' also caches data in regular memory, but only protects "
+              "blocks from eviction once they have been hit at least once "
+              "after being cached, so that large scans don't evict frequently "
+              "used blocks. 'CLOCK' caches data in regular memory with an "
+              "approximation of LRU which doesn't serialize concurrent "
+              "lookups, for servers with many cores. 'NVM' caches data in "
+              "a memory-mapped file using the NVML library.");
 TAG_FLAG(block_cache_type, experimental);
 
+DEFINE_int64(block_cache_index_capacity_mb, 64,
+             "Capacity in MB of the cache for CFile index and bloom filter blocks. "
+             "These are cached apart from data blocks, so that scans can't evict "
+             "them and slow down key lookups on insert. The capacity is taken out "
+             "of --block_cache_capacity_mb, up to half of it, so the two caches "
+             "together never use more than --block_cache_capacity_mb. If 0, they "
+             "are cached in the block cache along with data blocks.");
+TAG_FLAG(block_cache_index_capacity_mb, advanced);
+TAG_FLAG(block_cache_index_capacity_mb, experimental);
+
+METRIC_DEFINE_counter(server, index_block_cache_inserts,
+                      "Index Block Cache Inserts", kudu::MetricUnit::kBlocks,
+                      "Number of index and bloom filter blocks inserted in the "
+                      "index block cache");
+METRIC_DEFINE_counter(server, index_block_cache_lookups,
+                      "Index Block Cache Lookups", kudu::MetricUnit::kBlocks,
+                      "Number of index and bloom filter blocks looked up from the "
+                      "index block cache");
+METRIC_DEFINE_counter(server, index_block_cache_evictions,
+                      "Index Block Cache Evictions", kudu::MetricUnit::kBlocks,
+                      "Number of blocks evicted from the index block cache");
+METRIC_DEFINE_counter(server, index_block_cache_misses,
+                      "Index Block Cache Misses", kudu::MetricUnit::kBlocks,
+                      "Number of index block cache lookups that didn't yield a block");
+METRIC_DEFINE_counter(server, index_block_cache_misses_caching,
+                      "Index Block Cache Misses (Caching)", kudu::MetricUnit::kBlocks,
+                      "Number of index block cache lookups that were expecting a block "
+                      "that didn't yield one");
+METRIC_DEFINE_counter(server, index_block_cache_hits,
+                      "Index Block Cache Hits", kudu::MetricUnit::kBlocks,
+                      "Number of index block cache lookups that found a block");
+METRIC_DEFINE_counter(server, index_block_cache_hits_caching,
+                      "Index Block Cache Hits (Caching)", kudu::MetricUnit::kBlocks,
+                      "Number of index block cache lookups that were expecting a block "
+                      "that found one");
+METRIC_DEFINE_gauge_uint64(server, index_block_cache_usage, "Index Block Cache Memory Usage",
+                           kudu::MetricUnit::kBytes,
+                           "Memory consumed by the index block cache");
+
 namespace kudu {
 
 class MetricEntity;
@@ -70,6 +117,27 @@ class Deleter : public CacheDeleter {
   DISALLOW_COPY_AND_ASSIGN(Deleter);
 };
 
+// Metrics for the cache of HIGH_PRIORITY blocks.
+struct IndexBlockCacheMetrics : public CacheMetrics {
+  explicit IndexBlockCacheMetrics(const scoped_refptr<MetricEntity>& entity) {
+    inserts = METRIC_index_block_cache_inserts.Instantiate(entity);
+    lookups = METRIC_index_block_cache_lookups.Instantiate(entity);
+    evictions = METRIC_index_block_cache_evictions.Instantiate(entity);
+    cache_hits = METRIC_index_block_cache_hits.Instantiate(entity);
+    cache_hits_caching = METRIC_index_block_cache_hits_caching.Instantiate(entity);
+    cache_misses = METRIC_index_block_cache_misses.Instantiate(entity);
+    cache_misses_caching = METRIC_index_block_cache_misses_caching.Instantiate(entity);
+    cache_usage = METRIC_index_block_cache_usage.Instantiate(entity, 0);
+  }
+};
+
+// The capacity of the cache for HIGH_PRIORITY blocks, in bytes. It is
+// carved out of the block cache's capacity.
+int64_t IndexBlockCacheCapacity() {
+  return std::min(FLAGS_block_cache_index_capacity_mb, FLAGS_block_cache_capacity_mb / 2) *
+      1024 * 1024;
+}
+
 Cache* CreateCache(int64_t capacity) {
   CacheType t;
   ToUpperCase(FLAGS_block_cache_type, &FLAGS_block_cache_type);
@@ -77,9 +145,13 @@ Cache* CreateCache(int64_t capacity) {
     t = NVM_CACHE;
   } else if (FLAGS_block_cache_type == "DRAM") {
     t = DRAM_CACHE;
+  } else if (FLAGS_block_cache_type == "SLRU") {
+    t = DRAM_SLRU_CACHE;
+  } else if (FLAGS_block_cache_type == "CLOCK") {
+    t = DRAM_CLOCK_CACHE;
   } else {
     LOG(FATAL) << "Unknown block cache type: '" << FLAGS_block_cache_type
-               << "' (expected 'DRAM' or 'NVM')";
+               << "' (expected 'DRAM', 'SLRU', 'CLOCK' or 'NVM')";
   }
   return NewLRUCache(t, capacity, "block_cache");
 }
@@ -87,15 +159,30 @@ Cache* CreateCache(int64_t capacity) {
 } // anonymous namespace
 
 BlockCache::BlockCache()
-  : cache_(CreateCache(FLAGS_block_cache_capacity_mb * 1024 * 1024)) {
+  : cache_(CreateCache(FLAGS_block_cache_capacity_mb * 1024 * 1024 - IndexBlockCacheCapacity())),
+    priority_(NORMAL_PRIORITY) {
   deleter_.reset(new Deleter(cache_.get()));
 }
 
 BlockCache::BlockCache(size_t capacity)
-  : cache_(CreateCache(capacity)) {
+  : cache_(CreateCache(capacity)),
+    priority_(NORMAL_PRIORITY) {
+  deleter_.reset(new Deleter(cache_.get()));
+}
+
+BlockCache::BlockCache(Cache* cache, Priority priority)
+  : cache_(cache),
+    priority_(priority) {
   deleter_.reset(new Deleter(cache_.get()));
 }
 
+BlockCache* BlockCache::GetSingleton(Priority priority) {
+  if (priority == HIGH_PRIORITY && IndexBlockCacheCapacity() > 0) {
+    return Singleton<IndexBlockCache>::get();
+  }
+  return GetSingleton();
+}
+
 uint8_t* BlockCache::Allocate(size_t size) {
   return cache_->Allocate(size);
 }
@@ -134,7 +221,22 @@ bool BlockCache::Insert(FileId file_id, uint64_t offset, const Slice &block_data
 }
 
 void BlockCache::StartInstrumentation(const scoped_refptr<MetricEntity>& metric_entity) {
-  cache_->SetMetrics(metric_entity);
+  gscoped_ptr<CacheMetrics> metrics;
+  if (priority_ == HIGH_PRIORITY) {
+    metrics.reset(new IndexBlockCacheMetrics(metric_entity));
+  } else {
+    metrics.reset(new CacheMetrics(metric_entity));
+  }
+  cache_->SetMetrics(metrics.Pass());
+}
+
+IndexBlockCache::IndexBlockCache()
+  : BlockCache(NewLRUCache(DRAM_CACHE, IndexBlockCacheCapacity(), "index_block_cache"),
+               HIGH_PRIORITY) {
+}
+
+IndexBlockCache::IndexBlockCache(size_t capacity)
+  : BlockCache(NewLRUCache(DRAM_CACHE, capacity, "index_block_cache"), HIGH_PRIORITY) {
 }
 
 } // namespace cfile
@@ -42,10 +42,25 @@ class BlockCache {
   // which is just a portion of a CFile.
   typedef BlockId FileId;
 
+  // The priority with which a block is cached.
+  enum Priority {
+    // Data blocks, which are cached in the main block cache.
+    NORMAL_PRIORITY,
+
+    // Index and bloom filter blocks. Unless --block_cache_index_capacity_mb
+    // is 0, these are cached apart from data blocks, in a cache whose budget
+    // is taken out of the block cache's, so that scans can't evict the blocks
+    // needed to look up keys.
+    HIGH_PRIORITY
+  };
+
   static BlockCache *GetSingleton() {
     return Singleton<BlockCache>::get();
   }
 
+  // Return the cache in which blocks of the given priority are cached.
+  static BlockCache *GetSingleton(Priority priority);
+
   explicit BlockCache(size_t capacity);
 
   // Lookup the given block in the cache.
@@ -91,6 +106,10 @@ class BlockCache {
   // Free a pointer previously allocated using Allocate().
   void Free(uint8_t *p);
 
+ protected:
+  // Create a cache for blocks of the given priority.
+  BlockCache(Cache* cache, Priority priority);
+
  private:
   friend class Singleton<BlockCache>;
   BlockCache();
@@ -101,6 +120,23 @@ class BlockCache {
   // (the Cache needs to use the Deleter during destruction)
   gscoped_ptr<CacheDeleter> deleter_;
   gscoped_ptr<Cache> cache_;
+
+  // The priority of the blocks in this cache, which determines the metrics
+  // it records.
+  const Priority priority_;
+};
+
+// The cache for HIGH_PRIORITY blocks, when it's enabled. It is always held
+// in DRAM, regardless of --block_cache_type.
+class IndexBlockCache : public BlockCache {
+ public:
+  explicit IndexBlockCache(size_t capacity);
+
+ private:
+  friend class Singleton<IndexBlockCache>;
+  IndexBlockCache();
+
+  DISALLOW_COPY_AND_ASSIGN(IndexBlockCache);
 };
 
 // Scoped reference to a block from the block cache.
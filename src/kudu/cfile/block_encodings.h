@@ -23,6 +23,7 @@
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/malloc.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
@@ -146,6 +147,13 @@ class BlockDecoder {
   // header which is shared by all data blocks.
   virtual rowid_t GetFirstRowId() const = 0;
 
+  // Return the memory usage of the decoder, including the object itself but
+  // not the block data it decodes. Decoders which build up state in
+  // ParseHeader() should add it in.
+  virtual size_t memory_footprint() const {
+    return kudu_malloc_usable_size(this);
+  }
+
   virtual ~BlockDecoder() {}
  private:
   DISALLOW_COPY_AND_ASSIGN(BlockDecoder);
@@ -255,7 +255,8 @@ Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
   }
 
   BlockHandle dblk_data;
-  RETURN_NOT_OK(reader_->ReadBlock(bblk_ptr, CFileReader::CACHE_BLOCK, &dblk_data));
+  RETURN_NOT_OK(reader_->ReadBlock(bblk_ptr, CFileReader::CACHE_BLOCK, &dblk_data,
+                                   BlockCache::HIGH_PRIORITY));
 
   // Parse the header in the block.
   BloomBlockHeaderPB hdr;
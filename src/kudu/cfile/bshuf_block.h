@@ -299,6 +299,10 @@ class BShufBlockDecoder : public BlockDecoder {
     return ordinal_pos_base_;
   }
 
+  virtual size_t memory_footprint() const OVERRIDE {
+    return kudu_malloc_usable_size(this) + decoded_.capacity();
+  }
+
   size_t Count() const OVERRIDE {
     return num_elems_;
   }
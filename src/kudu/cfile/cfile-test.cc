@@ -18,15 +18,21 @@
 #include <list>
 
 #include <boost/assign/list_of.hpp>
+#include <boost/foreach.hpp>
 #include "kudu/cfile/cfile-test-base.h"
 #include "kudu/cfile/cfile_reader.h"
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/cfile/cfile.pb.h"
+#include "kudu/cfile/decoded_block_cache.h"
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
+#include "kudu/cfile/zone_map.h"
 #include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/scan_predicate.h"
 #include "kudu/fs/fs-test-util.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/test_macros.h"
@@ -34,10 +40,13 @@
 
 DECLARE_string(nvm_cache_path);
 DECLARE_string(block_cache_type);
+DECLARE_int64(block_cache_index_capacity_mb);
 DECLARE_string(cfile_do_on_finish);
+DECLARE_int32(cfile_readahead_bytes);
 DECLARE_bool(nvm_cache_simulate_allocation_failure);
 
 METRIC_DECLARE_counter(block_cache_hits_caching);
+METRIC_DECLARE_counter(index_block_cache_hits_caching);
 
 METRIC_DECLARE_entity(server);
 
@@ -273,8 +282,8 @@ class TestCFile : public CFileTestBase {
 };
 
 // Subclass of TestCFile which is parameterized on the block cache type.
-// Tests that use TEST_P(TestCFileBothCacheTypes, ...) will run twice --
-// once for each cache type (DRAM, NVM).
+// Tests that use TEST_P(TestCFileBothCacheTypes, ...) will run once for
+// each cache type (DRAM, NVM, SLRU, CLOCK).
 class TestCFileBothCacheTypes : public TestCFile,
                                 public ::testing::WithParamInterface<CacheType> {
  public:
@@ -293,16 +302,27 @@ class TestCFileBothCacheTypes : public TestCFile,
       case NVM_CACHE:
         FLAGS_block_cache_type = "NVM";
         break;
+      case DRAM_SLRU_CACHE:
+        FLAGS_block_cache_type = "SLRU";
+        break;
+      case DRAM_CLOCK_CACHE:
+        FLAGS_block_cache_type = "CLOCK";
+        break;
     }
     CFileTestBase::SetUp();
   }
 
   void TearDown() OVERRIDE {
+    // Cached decoded blocks refer to entries in the block cache, so they
+    // have to go first.
+    Singleton<DecodedBlockCache>::UnsafeReset();
     Singleton<BlockCache>::UnsafeReset();
+    Singleton<IndexBlockCache>::UnsafeReset();
   }
 };
 INSTANTIATE_TEST_CASE_P(CacheTypes, TestCFileBothCacheTypes,
-                        ::testing::Values(DRAM_CACHE, NVM_CACHE));
+                        ::testing::Values(DRAM_CACHE, NVM_CACHE, DRAM_SLRU_CACHE,
+                                          DRAM_CLOCK_CACHE));
 
 template<DataType type>
 void CopyOne(CFileIterator *it,
@@ -611,6 +631,236 @@ TEST_P(TestCFileBothCacheTypes, TestMetadata) {
   }
 }
 
+TEST_P(TestCFileBothCacheTypes, TestZoneMaps) {
+  const int kNumItems = 10000;
+  BlockId block_id;
+
+  // Write a nullable file whose values increase with the row index, with
+  // every tenth value null.
+  {
+    gscoped_ptr<WritableBlock> sink;
+    ASSERT_OK(fs_manager_->CreateNewBlock(&sink));
+    block_id = sink->id();
+    WriterOptions opts;
+    opts.write_posidx = true;
+    opts.write_zone_maps = true;
+    opts.storage_attributes.cfile_block_size = 1024;
+    CFileWriter w(opts, GetTypeInfo(INT32), true, sink.Pass());
+    ASSERT_OK(w.Start());
+
+    int32_t vals[kNumItems];
+    uint8_t null_bitmap[BitmapSize(kNumItems)];
+    for (int i = 0; i < kNumItems; i++) {
+      vals[i] = i;
+      BitmapChange(null_bitmap, i, i % 10 != 0);
+    }
+    ASSERT_OK(w.AppendNullableEntries(null_bitmap, vals, kNumItems));
+    ASSERT_OK(w.Finish());
+  }
+
+  gscoped_ptr<ReadableBlock> source;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &source));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(source.Pass(), ReaderOptions(), &reader));
+  ASSERT_TRUE(reader->has_zone_maps());
+
+  const TypeInfo* type = GetTypeInfo(INT32);
+  const ZoneMapPB& file_zone_map = reader->file_zone_map();
+  ASSERT_TRUE(file_zone_map.has_values());
+  ASSERT_TRUE(file_zone_map.has_nulls());
+
+  int32_t lower = kNumItems;
+  ASSERT_FALSE(ZoneMapMayMatch(type, file_zone_map, ValueRange(type, &lower, NULL)));
+  lower = kNumItems - 1;
+  ASSERT_TRUE(ZoneMapMayMatch(type, file_zone_map, ValueRange(type, &lower, NULL)));
+
+  // The per-block zone maps should cover every row exactly once, and each
+  // should only match the values within its block.
+  const DataBlockZoneMapsPB* block_zone_maps;
+  ASSERT_OK(reader->GetBlockZoneMaps(&block_zone_maps));
+  ASSERT_GT(block_zone_maps->blocks_size(), 1);
+  int64_t next_ordinal = 0;
+  BOOST_FOREACH(const DataBlockZoneMapPB& block, block_zone_maps->blocks()) {
+    ASSERT_EQ(next_ordinal, block.first_ordinal());
+    next_ordinal += block.num_values();
+
+    int32_t first = block.first_ordinal();
+    int32_t last = block.first_ordinal() + block.num_values() - 1;
+    int32_t last_non_null = (last % 10 == 0) ? last - 1 : last;
+    ASSERT_TRUE(ZoneMapMayMatch(type, block.zone_map(),
+                                ValueRange(type, &last_non_null, &last_non_null)));
+    int32_t after = last + 1;
+    ASSERT_FALSE(ZoneMapMayMatch(type, block.zone_map(), ValueRange(type, &after, NULL)));
+    if (first > 0) {
+      int32_t before = first - 1;
+      ASSERT_FALSE(ZoneMapMayMatch(type, block.zone_map(), ValueRange(type, NULL, &before)));
+    }
+  }
+  ASSERT_EQ(kNumItems, next_ordinal);
+}
+
+// Write a nullable, dictionary-encoded file of the given strings, with
+// every tenth value null.
+static void WriteNullableDictStrings(FsManager* fs_manager, const vector<string>& strs,
+                                     BlockId* block_id) {
+  gscoped_ptr<WritableBlock> sink;
+  ASSERT_OK(fs_manager->CreateNewBlock(&sink));
+  *block_id = sink->id();
+  WriterOptions opts;
+  opts.write_posidx = true;
+  opts.storage_attributes.cfile_block_size = 1024;
+  opts.storage_attributes.encoding = DICT_ENCODING;
+  CFileWriter w(opts, GetTypeInfo(STRING), true, sink.Pass());
+  ASSERT_OK(w.Start());
+
+  vector<Slice> vals(strs.size());
+  uint8_t null_bitmap[BitmapSize(strs.size())];
+  for (int i = 0; i < strs.size(); i++) {
+    vals[i] = Slice(strs[i]);
+    BitmapChange(null_bitmap, i, i % 10 != 0);
+  }
+  ASSERT_OK(w.AppendNullableEntries(null_bitmap, &vals[0], strs.size()));
+  ASSERT_OK(w.Finish());
+}
+
+TEST_P(TestCFileBothCacheTypes, TestEvaluatePredicateOnDictionary) {
+  const int kNumItems = 10000;
+  BlockId block_id;
+
+  // Seven distinct values fit in the dictionary, so every block is
+  // codeword-encoded.
+  vector<string> strs(kNumItems);
+  for (int i = 0; i < kNumItems; i++) {
+    strs[i] = StringPrintf("val%d", i % 7);
+  }
+  NO_FATALS(WriteNullableDictStrings(fs_manager_.get(), strs, &block_id));
+
+  gscoped_ptr<ReadableBlock> source;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &source));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(source.Pass(), ReaderOptions(), &reader));
+
+  ColumnSchema col("s", STRING, true);
+  Slice val2("val2"), val3("val3"), val4("val4"), val5("val5");
+  vector<const void*> in_list = boost::assign::list_of<const void*>(&val2)(&val5);
+  ColumnRangePredicate pred = ColumnRangePredicate::InList(col, in_list);
+
+  gscoped_ptr<CFileIterator> iter;
+  ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+  ASSERT_OK(iter->SeekToOrdinal(0));
+
+  const int kBatchSize = 100;
+  ScopedColumnBlock<STRING> cb(kBatchSize);
+  SelectionVector sel(kBatchSize);
+  int row = 0;
+  int num_matched = 0;
+  while (iter->HasNext()) {
+    // Halfway through, replace the predicate with another one at the same
+    // address. The dictionary's cached matches must not be reused for it.
+    bool second_half = row >= kNumItems / 2;
+    if (row == kNumItems / 2) {
+      pred = ColumnRangePredicate(col, &val3, &val4);
+    }
+
+    size_t n = kBatchSize;
+    ASSERT_OK(iter->PrepareBatch(&n));
+    ASSERT_EQ(kBatchSize, n);
+
+    // Rows unselected on the way in must stay unselected.
+    sel.SetAllTrue();
+    for (int i = 0; i < n; i += 3) {
+      sel.SetRowUnselected(i);
+    }
+    bool evaluated;
+    ASSERT_OK(iter->ScanSelectedAndEvaluate(pred, &cb, &sel, &evaluated));
+    ASSERT_TRUE(evaluated);
+
+    for (int i = 0; i < n; i++) {
+      int idx = row + i;
+      int v = idx % 7;
+      bool matches = second_half ? (v == 3 || v == 4) : (v == 2 || v == 5);
+      bool expected = i % 3 != 0 && idx % 10 != 0 && matches;
+      ASSERT_EQ(expected, sel.IsRowSelected(i)) << "row " << idx;
+      if (expected) {
+        ASSERT_EQ(StringPrintf("val%d", v), cb[i].ToString());
+        num_matched++;
+      }
+    }
+    ASSERT_OK(iter->FinishBatch());
+    cb.arena()->Reset();
+    row += n;
+  }
+  ASSERT_EQ(kNumItems, row);
+  ASSERT_GT(num_matched, 0);
+}
+
+// Tests evaluating a predicate against the blocks of a dictionary-encoded
+// file which fell back to plain encoding once the dictionary filled up.
+TEST_P(TestCFileBothCacheTypes, TestEvaluatePredicateOnPlainFallbackBlocks) {
+  const int kNumItems = 10000;
+  BlockId block_id;
+
+  // Every value is distinct, so the dictionary fills up after the first few
+  // blocks.
+  vector<string> strs(kNumItems);
+  for (int i = 0; i < kNumItems; i++) {
+    strs[i] = StringPrintf("val%d-%05d", i % 7, i);
+  }
+  NO_FATALS(WriteNullableDictStrings(fs_manager_.get(), strs, &block_id));
+
+  gscoped_ptr<ReadableBlock> source;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &source));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(source.Pass(), ReaderOptions(), &reader));
+
+  // Matches "val2-*" through "val3-*".
+  ColumnSchema col("s", STRING, true);
+  Slice lower("val2"), upper("val3~");
+  ColumnRangePredicate pred(col, &lower, &upper);
+
+  gscoped_ptr<CFileIterator> iter;
+  ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+  ASSERT_OK(iter->SeekToOrdinal(0));
+
+  const int kBatchSize = 100;
+  ScopedColumnBlock<STRING> cb(kBatchSize);
+  SelectionVector sel(kBatchSize);
+  int row = 0;
+  int num_matched = 0;
+  while (iter->HasNext()) {
+    size_t n = kBatchSize;
+    ASSERT_OK(iter->PrepareBatch(&n));
+    ASSERT_EQ(kBatchSize, n);
+
+    // Unselect runs of rows of various lengths.
+    sel.SetAllTrue();
+    for (int i = 0; i < n; i++) {
+      if (i % 11 < 4) {
+        sel.SetRowUnselected(i);
+      }
+    }
+    bool evaluated;
+    ASSERT_OK(iter->ScanSelectedAndEvaluate(pred, &cb, &sel, &evaluated));
+    ASSERT_TRUE(evaluated);
+
+    for (int i = 0; i < n; i++) {
+      int idx = row + i;
+      int v = idx % 7;
+      bool expected = i % 11 >= 4 && idx % 10 != 0 && (v == 2 || v == 3);
+      ASSERT_EQ(expected, sel.IsRowSelected(i)) << "row " << idx;
+      if (expected) {
+        ASSERT_EQ(strs[idx], cb[i].ToString());
+        num_matched++;
+      }
+    }
+    ASSERT_OK(iter->FinishBatch());
+    cb.arena()->Reset();
+    row += n;
+  }
+  ASSERT_EQ(kNumItems, row);
+  ASSERT_GT(num_matched, 0);
+}
+
 TEST_P(TestCFileBothCacheTypes, TestDefaultColumnIter) {
   const int kNumItems = 64;
   uint8_t null_bitmap[BitmapSize(kNumItems)];
@@ -668,6 +918,46 @@ TEST_P(TestCFileBothCacheTypes, TestNullInts) {
   TestNullTypes(&generator, GROUP_VARINT, LZ4);
 }
 
+TEST_P(TestCFileBothCacheTypes, TestNullForInts) {
+  Int32DataGenerator<true> generator;
+  TestNullTypes(&generator, FRAME_OF_REFERENCE, NO_COMPRESSION);
+  TestNullTypes(&generator, FRAME_OF_REFERENCE, LZ4);
+
+  // The generator starts each run of 256 rows with 64 NULLs. The last rows
+  // of a 10000 row file are NULL, so seeking to them seeks the decoder to
+  // the end of the last block, and a file with fewer than 64 rows has a data
+  // block without any values at all.
+  const int kNumRowsToSeek[] = { 10000, 50 };
+  BOOST_FOREACH(int num_rows, kNumRowsToSeek) {
+    SCOPED_TRACE(num_rows);
+    BlockId block_id;
+    generator.Reset();
+    WriteTestFile(&generator, FRAME_OF_REFERENCE, NO_COMPRESSION, num_rows,
+                  SMALL_BLOCKSIZE, &block_id);
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(block.Pass(), ReaderOptions(), &reader));
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+
+    const rowid_t kFirstNullAtEnd = num_rows - 10;
+    ASSERT_OK(iter->SeekToOrdinal(kFirstNullAtEnd));
+    ScopedColumnBlock<INT32> cb(10);
+    size_t n = cb.nrows();
+    ASSERT_OK(iter->CopyNextValues(&n, &cb));
+    ASSERT_EQ(10, n);
+    for (size_t i = 0; i < n; i++) {
+      ASSERT_TRUE(cb.is_null(i));
+    }
+    ASSERT_FALSE(iter->HasNext());
+
+    ASSERT_OK(iter->SeekToFirst());
+    ASSERT_OK(iter->SeekToOrdinal(num_rows - 1));
+    ASSERT_EQ(num_rows - 1, iter->GetCurrentOrdinal());
+  }
+}
+
 TEST_P(TestCFileBothCacheTypes, TestNullFloats) {
   FPDataGenerator<FLOAT, true> generator;
   TestNullTypes(&generator, PLAIN_ENCODING, NO_COMPRESSION);
@@ -765,6 +1055,24 @@ TEST_P(TestCFileBothCacheTypes, TestLazyInit) {
   ASSERT_EQ(bytes_read_after_init, bytes_read);
 }
 
+// Read the first index block and then the first data block of the given
+// file through a new reader.
+static void ReadFirstBlocks(FsManager* fs_manager, const BlockId& block_id) {
+  gscoped_ptr<ReadableBlock> source;
+  ASSERT_OK(fs_manager->OpenBlock(block_id, &source));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(source.Pass(), ReaderOptions(), &reader));
+
+  gscoped_ptr<IndexTreeIterator> iter;
+  iter.reset(IndexTreeIterator::Create(reader.get(), reader->posidx_root()));
+  ASSERT_OK(iter->SeekToFirst());
+
+  BlockHandle bh;
+  ASSERT_OK(reader->ReadBlock(iter->GetCurrentBlockPointer(),
+                              CFileReader::CACHE_BLOCK,
+                              &bh));
+}
+
 // Tests that the block cache keys used by CFileReaders are stable. That is,
 // different reader instances operating on the same block should use the same
 // block cache keys.
@@ -772,8 +1080,8 @@ TEST_P(TestCFileBothCacheTypes, TestCacheKeysAreStable) {
   // Set up block cache instrumentation.
   MetricRegistry registry;
   scoped_refptr<MetricEntity> entity(METRIC_ENTITY_server.Instantiate(&registry, "test_entity"));
-  BlockCache* cache = BlockCache::GetSingleton();
-  cache->StartInstrumentation(entity);
+  BlockCache::GetSingleton()->StartInstrumentation(entity);
+  BlockCache::GetSingleton(BlockCache::HIGH_PRIORITY)->StartInstrumentation(entity);
 
   // Create a small test file.
   BlockId block_id;
@@ -786,28 +1094,261 @@ TEST_P(TestCFileBothCacheTypes, TestCacheKeysAreStable) {
 
   // Open and read from it twice, checking the block cache statistics.
   for (int i = 0; i < 2; i++) {
-    gscoped_ptr<ReadableBlock> source;
-    ASSERT_OK(fs_manager_->OpenBlock(block_id, &source));
-    gscoped_ptr<CFileReader> reader;
-    ASSERT_OK(CFileReader::Open(source.Pass(), ReaderOptions(), &reader));
-
-    gscoped_ptr<IndexTreeIterator> iter;
-    iter.reset(IndexTreeIterator::Create(reader.get(), reader->posidx_root()));
-    ASSERT_OK(iter->SeekToFirst());
-
-    BlockHandle bh;
-    ASSERT_OK(reader->ReadBlock(iter->GetCurrentBlockPointer(),
-                                CFileReader::CACHE_BLOCK,
-                                &bh));
+    NO_FATALS(ReadFirstBlocks(fs_manager_.get(), block_id));
 
     // The first time through, we miss in the seek and in the ReadBlock().
     // But the second time through, both are hits, because we've got the same
-    // cache keys as before.
+    // cache keys as before. The index block is cached in the index block
+    // cache, and the data block in the block cache.
+    ASSERT_EQ(i, down_cast<Counter*>(
+        entity->FindOrNull(METRIC_index_block_cache_hits_caching).get())->value());
+    ASSERT_EQ(i, down_cast<Counter*>(
+        entity->FindOrNull(METRIC_block_cache_hits_caching).get())->value());
+  }
+}
+
+// Tests that index blocks are cached along with data blocks when the index
+// block cache is disabled.
+TEST_P(TestCFileBothCacheTypes, TestIndexBlockCacheDisabled) {
+  FLAGS_block_cache_index_capacity_mb = 0;
+  ASSERT_EQ(BlockCache::GetSingleton(),
+            BlockCache::GetSingleton(BlockCache::HIGH_PRIORITY));
+
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity(METRIC_ENTITY_server.Instantiate(&registry, "test_entity"));
+  BlockCache::GetSingleton()->StartInstrumentation(entity);
+
+  BlockId block_id;
+  {
+    StringDataGenerator<false> generator("hello %04d");
+    WriteTestFile(&generator, PREFIX_ENCODING, NO_COMPRESSION, 1000,
+                  SMALL_BLOCKSIZE | WRITE_VALIDX, &block_id);
+  }
+  for (int i = 0; i < 2; i++) {
+    NO_FATALS(ReadFirstBlocks(fs_manager_.get(), block_id));
     ASSERT_EQ(i * 2, down_cast<Counter*>(
         entity->FindOrNull(METRIC_block_cache_hits_caching).get())->value());
   }
 }
 
+// Tests that scans which reuse decoders from the decoded block cache read
+// the same data as scans which decode the blocks themselves.
+TEST_P(TestCFileBothCacheTypes, TestDecodedBlockCache) {
+  FLAGS_decoded_block_cache_capacity_mb = 64;
+
+  TestReadWriteFixedSizeTypes<UInt32DataGenerator<false> >(PLAIN_ENCODING);
+  TestReadWriteFixedSizeTypes<Int32DataGenerator<false> >(FRAME_OF_REFERENCE);
+  TestReadWriteStrings(PREFIX_ENCODING);
+  UInt32DataGenerator<true> generator;
+  TestNullTypes(&generator, BIT_SHUFFLE, LZ4);
+
+  // An iterator hands its blocks to the cache when it's done with them, and
+  // a reader which finds a block there takes it out.
+  BlockId block_id;
+  {
+    UInt32DataGenerator<false> generator;
+    WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, 1000,
+                  SMALL_BLOCKSIZE, &block_id);
+  }
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(block.Pass(), ReaderOptions(), &reader));
+  gscoped_ptr<IndexTreeIterator> idx_iter(
+      IndexTreeIterator::Create(reader.get(), reader->posidx_root()));
+  ASSERT_OK(idx_iter->SeekToFirst());
+  uint64_t offset = idx_iter->GetCurrentBlockPointer().offset();
+
+  DecodedBlockCache* cache = DecodedBlockCache::GetSingleton();
+  gscoped_ptr<DecodedBlock> decoded;
+  ASSERT_FALSE(cache->Take(block_id, offset, &decoded));
+  {
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToFirst());
+    ASSERT_EQ(1, iter->io_statistics().data_blocks_read_from_disk);
+    ASSERT_EQ(0, iter->io_statistics().data_blocks_from_decoded_cache);
+  }
+
+  // A cache hit isn't accounted as a block read from disk.
+  {
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToFirst());
+    ASSERT_EQ(0, iter->io_statistics().data_blocks_read_from_disk);
+    ASSERT_EQ(0, iter->io_statistics().bytes_read_from_disk);
+    ASSERT_EQ(0, iter->io_statistics().cells_read_from_disk);
+    ASSERT_EQ(1, iter->io_statistics().data_blocks_from_decoded_cache);
+  }
+  ASSERT_TRUE(cache->Take(block_id, offset, &decoded));
+  ASSERT_EQ(0, decoded->decoder->GetFirstRowId());
+  ASSERT_GT(decoded->num_rows_in_block, 0);
+  ASSERT_FALSE(cache->Take(block_id, offset, &decoded));
+
+  // Iterators which don't cache blocks leave the cache alone.
+  {
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::DONT_CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToFirst());
+  }
+  ASSERT_FALSE(cache->Take(block_id, offset, &decoded));
+}
+
+// Tests that sequential scans read ahead of the blocks they're reading, and
+// that short reads after a seek don't.
+TEST_P(TestCFileBothCacheTypes, TestReadAhead) {
+  FLAGS_cfile_readahead_bytes = 16 * 1024;
+  const int kNumRows = 100000;
+
+  BlockId block_id;
+  {
+    UInt32DataGenerator<false> generator;
+    WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumRows,
+                  SMALL_BLOCKSIZE, &block_id);
+  }
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  size_t bytes_read = 0;
+  size_t bytes_read_ahead = 0;
+  gscoped_ptr<ReadableBlock> count_block(
+      new CountingReadableBlock(block.Pass(), &bytes_read, &bytes_read_ahead));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(count_block.Pass(), ReaderOptions(), &reader));
+  gscoped_ptr<CFileIterator> iter;
+  ASSERT_OK(reader->NewIterator(&iter, CFileReader::DONT_CACHE_BLOCK));
+
+  ASSERT_OK(iter->SeekToOrdinal(kNumRows / 2));
+  ScopedColumnBlock<UINT32> cb(10);
+  size_t n = cb.nrows();
+  ASSERT_OK(iter->CopyNextValues(&n, &cb));
+  ASSERT_EQ(0, bytes_read_ahead);
+
+  // Each range is only hinted at once, and never past the end of the file.
+  ASSERT_OK(iter->SeekToFirst());
+  int count = 0;
+  TimeReadFileForDataType<UINT32, uint64_t>(iter, count);
+  ASSERT_EQ(kNumRows, count);
+  ASSERT_GT(bytes_read_ahead, 0);
+  ASSERT_LE(bytes_read_ahead, reader->file_size());
+
+  // Read-ahead can be disabled.
+  FLAGS_cfile_readahead_bytes = 0;
+  bytes_read_ahead = 0;
+  ASSERT_OK(iter->SeekToFirst());
+  count = 0;
+  TimeReadFileForDataType<UINT32, uint64_t>(iter, count);
+  ASSERT_EQ(kNumRows, count);
+  ASSERT_EQ(0, bytes_read_ahead);
+}
+
+// Tests seeking several iterators with the reads of their data blocks
+// issued together, as when materializing the columns of a row.
+TEST_P(TestCFileBothCacheTypes, TestBatchedSeekToOrdinal) {
+  const int kNumFiles = 3;
+  const int kNumRows = 10000;
+
+  vector<CFileReader*> readers;
+  ElementDeleter reader_deleter(&readers);
+  vector<CFileIterator*> iters;
+  ElementDeleter iter_deleter(&iters);
+  for (int i = 0; i < kNumFiles; i++) {
+    BlockId block_id;
+    UInt32DataGenerator<false> generator;
+    WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumRows,
+                  SMALL_BLOCKSIZE, &block_id);
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(block.Pass(), ReaderOptions(), &reader));
+    CFileIterator* iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::DONT_CACHE_BLOCK));
+    readers.push_back(reader.release());
+    iters.push_back(iter);
+  }
+
+  UInt32DataGenerator<false> expected;
+  const rowid_t kOrdinals[] = { 0, 1234, kNumRows - 1 };
+  BOOST_FOREACH(rowid_t ord_idx, kOrdinals) {
+    vector<fs::BlockReadRequest*> reads;
+    BOOST_FOREACH(CFileIterator* iter, iters) {
+      ASSERT_OK(iter->PrepareSeekToOrdinal(ord_idx, &reads));
+    }
+    ASSERT_EQ(kNumFiles, reads.size());
+
+    vector<fs::BlockReadRequest> batch;
+    BOOST_FOREACH(const fs::BlockReadRequest* req, reads) {
+      batch.push_back(*req);
+    }
+    ASSERT_OK(fs_manager_->ReadBatch(&batch));
+    for (int i = 0; i < reads.size(); i++) {
+      reads[i]->read.result = batch[i].read.result;
+    }
+
+    BOOST_FOREACH(CFileIterator* iter, iters) {
+      ASSERT_OK(iter->FinishSeekToOrdinal());
+      ASSERT_EQ(ord_idx, iter->GetCurrentOrdinal());
+      ScopedColumnBlock<UINT32> cb(1);
+      size_t n = 1;
+      ASSERT_OK(iter->CopyNextValues(&n, &cb));
+      ASSERT_EQ(1, n);
+      ASSERT_EQ(expected.BuildTestValue(0, ord_idx), cb[0]);
+    }
+  }
+
+  // Seeking past the end of the file fails once the seek is finished.
+  vector<fs::BlockReadRequest*> reads;
+  ASSERT_OK(iters[0]->PrepareSeekToOrdinal(kNumRows, &reads));
+  BOOST_FOREACH(fs::BlockReadRequest* req, reads) {
+    ASSERT_OK(req->block->Read(req->read.offset, req->read.length,
+                               &req->read.result, req->read.scratch));
+  }
+  ASSERT_TRUE(iters[0]->FinishSeekToOrdinal().IsNotFound());
+}
+
+// Tests scanning batches which span several data blocks, whose reads are
+// coalesced, both from the start of the file and after a positional seek.
+TEST_P(TestCFileBothCacheTypes, TestScanBatchesAcrossBlocks) {
+  const int kNumRows = 10000;
+  BlockId block_id;
+  {
+    UInt32DataGenerator<false> generator;
+    WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumRows,
+                  SMALL_BLOCKSIZE, &block_id);
+  }
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(block.Pass(), ReaderOptions(), &reader));
+  gscoped_ptr<CFileIterator> iter;
+  ASSERT_OK(reader->NewIterator(&iter, CFileReader::DONT_CACHE_BLOCK));
+
+  UInt32DataGenerator<false> expected;
+  const size_t kBatchSizes[] = { 7, 255, 256, 700, 1500 };
+  const rowid_t kStartOrdinals[] = { 0, 1, 300, 4321 };
+  BOOST_FOREACH(size_t batch_size, kBatchSizes) {
+    BOOST_FOREACH(rowid_t start, kStartOrdinals) {
+      SCOPED_TRACE(StringPrintf("batch size %zu, starting at %u", batch_size, start));
+      if (start == 0) {
+        ASSERT_OK(iter->SeekToFirst());
+      } else {
+        ASSERT_OK(iter->SeekToOrdinal(start));
+      }
+      ScopedColumnBlock<UINT32> cb(batch_size);
+      rowid_t row = start;
+      while (iter->HasNext()) {
+        size_t n = batch_size;
+        ASSERT_OK(iter->CopyNextValues(&n, &cb));
+        ASSERT_GT(n, 0);
+        for (size_t i = 0; i < n; i++) {
+          ASSERT_EQ(expected.BuildTestValue(0, row + i), cb[i]) << "at row " << (row + i);
+        }
+        row += n;
+      }
+      ASSERT_EQ(kNumRows, row);
+    }
+  }
+}
+
 // Inject failures in nvm allocation and ensure that we can still read a file.
 TEST_P(TestCFileBothCacheTypes, TestNvmAllocationFailure) {
   if (GetParam() != NVM_CACHE) return;
@@ -15,6 +15,7 @@
 #include "kudu/cfile/cfile_reader.h"
 
 #include <boost/foreach.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include <glog/logging.h>
 
 #include <algorithm>
@@ -24,18 +25,25 @@
 #include "kudu/cfile/block_pointer.h"
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/cfile/cfile_writer.h" // for kMagicString
+#include "kudu/cfile/decoded_block_cache.h"
 #include "kudu/cfile/gvint_block.h"
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
+#include "kudu/cfile/binary_dict_block.h"
 #include "kudu/cfile/binary_plain_block.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/scan_predicate.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/object_pool.h"
+#include "kudu/util/pb_util.h"
 #include "kudu/util/rle-encoding.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
@@ -44,7 +52,15 @@ DEFINE_bool(cfile_lazy_open, true,
             "Allow lazily opening of cfiles");
 TAG_FLAG(cfile_lazy_open, hidden);
 
+DEFINE_int32(cfile_readahead_bytes, 1024 * 1024,
+             "Number of bytes past the current data block to read ahead when "
+             "scanning a cfile sequentially. 0 disables read-ahead.");
+TAG_FLAG(cfile_readahead_bytes, advanced);
+TAG_FLAG(cfile_readahead_bytes, experimental);
+
+using boost::ptr_vector;
 using kudu::fs::ReadableBlock;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -56,6 +72,11 @@ static const size_t kMaxHeaderFooterPBSize = 64*1024;
 
 static const size_t kBlockSizeLimit = 16 * 1024 * 1024; // 16MB
 
+// Number of data blocks an iterator must read in a row after a seek before
+// it starts reading ahead, so that short scans don't pull in data they
+// won't use.
+static const int kReadAheadMinSequentialBlocks = 2;
+
 static Status ParseMagicAndLength(const Slice &data,
                                   uint32_t *parsed_len) {
   if (data.size() != kMagicAndLengthSize) {
@@ -148,6 +169,31 @@ Status CFileReader::Init() {
   return init_once_.Init(&CFileReader::InitOnce, this);
 }
 
+Status CFileReader::ReadBlockZoneMapsOnce() {
+  DCHECK(has_zone_maps());
+  BlockPointer bp(footer().zone_maps_block_ptr());
+  BlockHandle handle;
+  RETURN_NOT_OK_PREPEND(ReadBlock(bp, CACHE_BLOCK, &handle),
+                        "Couldn't read zone maps block");
+
+  gscoped_ptr<DataBlockZoneMapsPB> zone_maps(new DataBlockZoneMapsPB());
+  RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(zone_maps.get(),
+                                                handle.data().data(),
+                                                handle.data().size()),
+                        "Couldn't parse zone maps block");
+  block_zone_maps_.reset(zone_maps.release());
+
+  // The zone maps are retained for the lifetime of the reader.
+  mem_consumption_.Reset(memory_footprint());
+  return Status::OK();
+}
+
+Status CFileReader::GetBlockZoneMaps(const DataBlockZoneMapsPB** zone_maps) {
+  RETURN_NOT_OK(zone_maps_once_.Init(&CFileReader::ReadBlockZoneMapsOnce, this));
+  *zone_maps = block_zone_maps_.get();
+  return Status::OK();
+}
+
 Status CFileReader::ReadAndParseHeader() {
   TRACE_EVENT1("io", "CFileReader::ReadAndParseHeader",
                "cfile", ToString());
@@ -211,8 +257,6 @@ Status CFileReader::ReadAndParseFooter() {
   return Status::OK();
 }
 
-namespace {
-
 // ScratchMemory owns a memory buffer which could either be allocated on-heap
 // or allocated by a Cache instance. In the case of the default DRAM-based cache,
 // these two are equivalent, but we still make a distinction between "cache-managed"
@@ -223,7 +267,7 @@ namespace {
 // or the cache. In its destructor, the memory is freed, either via 'delete[]', if
 // it's heap memory, or via Cache::Free(), if it came from the cache. Alternatively,
 // the memory can be released using 'release()'.
-class ScratchMemory {
+class CFileReader::ScratchMemory {
  public:
   ScratchMemory() : cache_(NULL), ptr_(NULL), size_(-1) {}
   ~ScratchMemory() {
@@ -298,21 +342,41 @@ class ScratchMemory {
   int size_;
   DISALLOW_COPY_AND_ASSIGN(ScratchMemory);
 };
-} // anonymous namespace
+
+bool CFileReader::LookupBlock(BlockCache *cache, const BlockPointer &ptr,
+                              CacheControl cache_control, BlockHandle *ret) const {
+  BlockCacheHandle bc_handle;
+  Cache::CacheBehavior cache_behavior = cache_control == CACHE_BLOCK ?
+      Cache::EXPECT_IN_CACHE : Cache::NO_EXPECT_IN_CACHE;
+  if (cache->Lookup(block_->id(), ptr.offset(), cache_behavior, &bc_handle)) {
+    *ret = BlockHandle::WithDataFromCache(&bc_handle);
+    return true;
+  }
+  return false;
+}
+
+void CFileReader::AllocateReadScratch(BlockCache *cache, const BlockPointer &ptr,
+                                      CacheControl cache_control,
+                                      ScratchMemory *scratch) const {
+  // If we are reading uncompressed data and plan to cache the result,
+  // then we should allocate our scratch memory directly from the cache.
+  // This avoids an extra memory copy in the case of an NVM cache.
+  if (block_uncompressor_ == NULL && cache_control == CACHE_BLOCK) {
+    scratch->TryAllocateFromCache(cache, ptr.size());
+  } else {
+    scratch->AllocateFromHeap(ptr.size());
+  }
+}
 
 Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_control,
-                              BlockHandle *ret) const {
+                              BlockHandle *ret, BlockCache::Priority priority) const {
   DCHECK(init_once_.initted());
   CHECK(ptr.offset() > 0 &&
         ptr.offset() + ptr.size() < file_size_) <<
     "bad offset " << ptr.ToString() << " in file of size "
                   << file_size_;
-  BlockCacheHandle bc_handle;
-  Cache::CacheBehavior cache_behavior = cache_control == CACHE_BLOCK ?
-      Cache::EXPECT_IN_CACHE : Cache::NO_EXPECT_IN_CACHE;
-  BlockCache* cache = BlockCache::GetSingleton();
-  if (cache->Lookup(block_->id(), ptr.offset(), cache_behavior, &bc_handle)) {
-    *ret = BlockHandle::WithDataFromCache(&bc_handle);
+  BlockCache* cache = BlockCache::GetSingleton(priority);
+  if (LookupBlock(cache, ptr, cache_control, ret)) {
     // Cache hit
     return Status::OK();
   }
@@ -324,19 +388,96 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
   TRACE_EVENT1("io", "CFileReader::ReadBlock(cache miss)",
                "cfile", ToString());
   Slice block;
-
-  // If we are reading uncompressed data and plan to cache the result,
-  // then we should allocate our scratch memory directly from the cache.
-  // This avoids an extra memory copy in the case of an NVM cache.
   ScratchMemory scratch;
-  if (block_uncompressor_ == NULL && cache_control == CACHE_BLOCK) {
-    scratch.TryAllocateFromCache(cache, ptr.size());
-  } else {
-    scratch.AllocateFromHeap(ptr.size());
+  AllocateReadScratch(cache, ptr, cache_control, &scratch);
+  RETURN_NOT_OK(block_->Read(ptr.offset(), ptr.size(), &block, scratch.get()));
+  return FinishReadBlock(cache, ptr, cache_control, block, &scratch, ret);
+}
+
+Status CFileReader::ReadBlocks(const vector<BlockPointer> &ptrs, CacheControl cache_control,
+                               const vector<BlockHandle *> &ret) const {
+  DCHECK(init_once_.initted());
+  DCHECK_EQ(ptrs.size(), ret.size());
+  BlockCache* cache = BlockCache::GetSingleton(BlockCache::NORMAL_PRIORITY);
+
+  // Indexes into 'ptrs' of the blocks which missed the cache.
+  vector<int> misses;
+  for (int i = 0; i < ptrs.size(); i++) {
+    const BlockPointer &ptr = ptrs[i];
+    CHECK(ptr.offset() > 0 &&
+          ptr.offset() + ptr.size() < file_size_) <<
+      "bad offset " << ptr.ToString() << " in file of size "
+                    << file_size_;
+    if (!LookupBlock(cache, ptr, cache_control, ret[i])) {
+      misses.push_back(i);
+    }
+  }
+  if (misses.empty()) {
+    return Status::OK();
+  }
+  if (misses.size() == 1) {
+    int i = misses[0];
+    return ReadBlock(ptrs[i], cache_control, ret[i]);
   }
 
-  RETURN_NOT_OK(block_->Read(ptr.offset(), ptr.size(), &block, scratch.get()));
+  TRACE_EVENT2("io", "CFileReader::ReadBlocks(cache miss)",
+               "cfile", ToString(),
+               "num_blocks", misses.size());
+  ptr_vector<ScratchMemory> scratches;
+  vector<ReadRequest> requests;
+  requests.reserve(misses.size());
+  BOOST_FOREACH(int i, misses) {
+    ScratchMemory* scratch = new ScratchMemory();
+    scratches.push_back(scratch);
+    AllocateReadScratch(cache, ptrs[i], cache_control, scratch);
+    requests.push_back(ReadRequest(ptrs[i].offset(), ptrs[i].size(), scratch->get()));
+  }
+  RETURN_NOT_OK(block_->ReadBatch(&requests));
+  for (int j = 0; j < misses.size(); j++) {
+    int i = misses[j];
+    RETURN_NOT_OK(FinishReadBlock(cache, ptrs[i], cache_control, requests[j].result,
+                                  &scratches[j], ret[i]));
+  }
+  return Status::OK();
+}
+
+CFileReader::PendingBlockRead::PendingBlockRead()
+  : cache_control_(CACHE_BLOCK) {
+}
+
+CFileReader::PendingBlockRead::~PendingBlockRead() {
+}
 
+bool CFileReader::PrepareBlockRead(const BlockPointer &ptr, CacheControl cache_control,
+                                   BlockHandle *ret, PendingBlockRead *read) const {
+  DCHECK(init_once_.initted());
+  CHECK(ptr.offset() > 0 &&
+        ptr.offset() + ptr.size() < file_size_) <<
+    "bad offset " << ptr.ToString() << " in file of size "
+                  << file_size_;
+  BlockCache* cache = BlockCache::GetSingleton(BlockCache::NORMAL_PRIORITY);
+  if (LookupBlock(cache, ptr, cache_control, ret)) {
+    return true;
+  }
+
+  read->ptr_ = ptr;
+  read->cache_control_ = cache_control;
+  read->scratch_.reset(new ScratchMemory());
+  AllocateReadScratch(cache, ptr, cache_control, read->scratch_.get());
+  read->request_ = fs::BlockReadRequest(block_.get(), ptr.offset(), ptr.size(),
+                                        read->scratch_->get());
+  return false;
+}
+
+Status CFileReader::FinishBlockRead(PendingBlockRead *read, BlockHandle *ret) const {
+  BlockCache* cache = BlockCache::GetSingleton(BlockCache::NORMAL_PRIORITY);
+  return FinishReadBlock(cache, read->ptr_, read->cache_control_, read->request_.read.result,
+                         read->scratch_.get(), ret);
+}
+
+Status CFileReader::FinishReadBlock(BlockCache *cache, const BlockPointer &ptr,
+                                    CacheControl cache_control, Slice block,
+                                    ScratchMemory *scratch, BlockHandle *ret) const {
   if (block.size() != ptr.size()) {
     return Status::IOError("Could not read full block length");
   }
@@ -373,47 +514,56 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
     // Now that we've decompressed, we don't need to keep holding onto the original
     // scratch buffer. Instead, we have to start holding onto our decompression
     // output buffer.
-    scratch.Swap(&decompressed_scratch);
+    scratch->Swap(&decompressed_scratch);
 
     // Set the result block to our decompressed data.
-    block = Slice(scratch.get(), uncompressed_size);
+    block = Slice(scratch->get(), uncompressed_size);
   } else {
     // Some of the File implementations from LevelDB attempt to be tricky
     // and just return a Slice into an mmapped region (or in-memory region).
     // But, this is hard to program against in terms of cache management, etc,
     // so we memcpy into our scratch buffer if necessary.
-    block.relocate(scratch.get());
+    block.relocate(scratch->get());
   }
 
   // It's possible that one of the TryAllocateFromCache() calls above
   // failed, in which case we don't insert it into the cache regardless
   // of what the user requested.
-  if (cache_control == CACHE_BLOCK && scratch.IsFromCache()) {
+  if (cache_control == CACHE_BLOCK && scratch->IsFromCache()) {
+    BlockCacheHandle bc_handle;
     if (cache->Insert(block_->id(), ptr.offset(), block, &bc_handle)) {
       *ret = BlockHandle::WithDataFromCache(&bc_handle);
     } else {
       // If we failed to insert in the cache, but we'd already read into
       // cache-managed memory, we need to ensure that we end up with a
       // heap-allocated block in the BlockHandle.
-      scratch.EnsureOnHeap();
-      block = Slice(scratch.get(), block.size());
+      scratch->EnsureOnHeap();
+      block = Slice(scratch->get(), block.size());
       *ret = BlockHandle::WithOwnedData(block);
     }
   } else {
     // If we never intended to cache the block, then the scratch space
     // should not be owned by the cache.
-    DCHECK_EQ(block.data(), scratch.get());
-    DCHECK(!scratch.IsFromCache());
+    DCHECK_EQ(block.data(), scratch->get());
+    DCHECK(!scratch->IsFromCache());
     *ret = BlockHandle::WithOwnedData(block);
   }
 
   // The cache or the BlockHandle now has ownership over the memory, so release
   // the scoped pointer.
-  ignore_result(scratch.release());
+  ignore_result(scratch->release());
 
   return Status::OK();
 }
 
+Status CFileReader::ReadAhead(uint64_t offset, size_t length) const {
+  if (offset >= file_size_) {
+    return Status::OK();
+  }
+  length = std::min<uint64_t>(length, file_size_ - offset);
+  return block_->ReadAhead(offset, length);
+}
+
 Status CFileReader::CountRows(rowid_t *count) const {
   *count = footer().num_values();
   return Status::OK();
@@ -457,6 +607,10 @@ size_t CFileReader::memory_footprint() const {
   if (block_uncompressor_) {
     size += kudu_malloc_usable_size(block_uncompressor_.get());
   }
+  size += zone_maps_once_.memory_footprint_excluding_this();
+  if (block_zone_maps_) {
+    size += block_zone_maps_->SpaceUsed();
+  }
   return size;
 }
 
@@ -511,14 +665,35 @@ CFileIterator::CFileIterator(CFileReader* reader,
     seeked_(NULL),
     prepared_(false),
     cache_control_(cache_control),
+    cache_decoded_blocks_(false),
+    sequential_blocks_read_(0),
+    readahead_end_(0),
+    pending_seek_block_(NULL),
+    pending_seek_idx_(0),
+    pending_seek_needs_read_(false),
     last_prepare_idx_(-1),
-    last_prepare_count_(-1) {
+    last_prepare_count_(-1),
+    dict_pred_id_(-1) {
 }
 
 CFileIterator::~CFileIterator() {
+  BOOST_FOREACH(PreparedBlock *pb, prepared_blocks_) {
+    ReturnDecodedBlock(pb);
+  }
 }
 
 Status CFileIterator::SeekToOrdinal(rowid_t ord_idx) {
+  vector<fs::BlockReadRequest *> reads;
+  RETURN_NOT_OK(PrepareSeekToOrdinal(ord_idx, &reads));
+  BOOST_FOREACH(fs::BlockReadRequest *req, reads) {
+    RETURN_NOT_OK(req->block->Read(req->read.offset, req->read.length,
+                                   &req->read.result, req->read.scratch));
+  }
+  return FinishSeekToOrdinal();
+}
+
+Status CFileIterator::PrepareSeekToOrdinal(rowid_t ord_idx,
+                                           vector<fs::BlockReadRequest *> *reads) {
   RETURN_NOT_OK(PrepareForNewSeek());
   if (PREDICT_FALSE(posidx_iter_ == NULL)) {
     return Status::NotSupported("no positional index in file");
@@ -529,9 +704,33 @@ Status CFileIterator::SeekToOrdinal(rowid_t ord_idx) {
   RETURN_NOT_OK(posidx_iter_->SeekAtOrBefore(Slice(tmp_buf_)));
 
   // TODO: fast seek within block (without reseeking index)
-  pblock_pool_scoped_ptr b = prepared_block_pool_.make_scoped_ptr(
-    prepared_block_pool_.Construct());
-  RETURN_NOT_OK(ReadCurrentDataBlock(*posidx_iter_, b.get()));
+  PreparedBlock *b = prepared_block_pool_.Construct();
+  pending_seek_block_ = b;
+  pending_seek_idx_ = ord_idx;
+  b->dblk_ptr_ = posidx_iter_->GetCurrentBlockPointer();
+  if (!TakeDecodedBlock(b) &&
+      !reader_->PrepareBlockRead(b->dblk_ptr_, cache_control_, &b->dblk_data_,
+                                 &pending_seek_read_)) {
+    pending_seek_needs_read_ = true;
+    reads->push_back(pending_seek_read_.request());
+  }
+  return Status::OK();
+}
+
+Status CFileIterator::FinishSeekToOrdinal() {
+  CHECK(pending_seek_block_ != NULL) << "no seek prepared";
+  pblock_pool_scoped_ptr b = prepared_block_pool_.make_scoped_ptr(pending_seek_block_);
+  pending_seek_block_ = NULL;
+  rowid_t ord_idx = pending_seek_idx_;
+
+  if (pending_seek_needs_read_) {
+    pending_seek_needs_read_ = false;
+    RETURN_NOT_OK(reader_->FinishBlockRead(&pending_seek_read_, &b->dblk_data_));
+  }
+  if (!b->dblk_) {
+    RETURN_NOT_OK(DecodeDataBlock(b.get()));
+  }
+  FinishDataBlock(b.get());
 
   // If the data block doesn't actually contain the data
   // we're looking for, then we're probably in the last
@@ -704,11 +903,24 @@ Status CFileIterator::PrepareForNewSeek() {
     RETURN_NOT_OK_PREPEND(dict_decoder_->ParseHeader(), "Couldn't parse dictionary block header");
   }
 
+  cache_decoded_blocks_ = cache_control_ == CFileReader::CACHE_BLOCK &&
+      DecodedBlockCache::IsEnabled() &&
+      !reader_->footer().has_dict_block_ptr();
+
+  sequential_blocks_read_ = 0;
+  readahead_end_ = 0;
+
   seeked_ = NULL;
   BOOST_FOREACH(PreparedBlock *pb, prepared_blocks_) {
+    ReturnDecodedBlock(pb);
     prepared_block_pool_.Destroy(pb);
   }
   prepared_blocks_.clear();
+  if (pending_seek_block_ != NULL) {
+    prepared_block_pool_.Destroy(pending_seek_block_);
+    pending_seek_block_ = NULL;
+  }
+  pending_seek_needs_read_ = false;
 
   return Status::OK();
 }
@@ -741,17 +953,41 @@ Status DecodeNullInfo(Slice *data_block, uint32_t *num_rows_in_block, Slice *nul
   return Status::OK();
 }
 
-Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
-                                           PreparedBlock *prep_block) {
-  prep_block->dblk_ptr_ = idx_iter.GetCurrentBlockPointer();
-  RETURN_NOT_OK(reader_->ReadBlock(prep_block->dblk_ptr_, cache_control_, &prep_block->dblk_data_));
+void CFileIterator::ReturnDecodedBlock(PreparedBlock *pb) {
+  if (!cache_decoded_blocks_ || !pb->dblk_) {
+    return;
+  }
+  gscoped_ptr<DecodedBlock> decoded(new DecodedBlock());
+  decoded->data = pb->dblk_data_.Pass();
+  decoded->decoder.reset(pb->dblk_.release());
+  decoded->null_bitmap = pb->rle_bitmap;
+  decoded->num_rows_in_block = pb->num_rows_in_block_;
+  DecodedBlockCache::GetSingleton()->Put(reader_->block_id(), pb->dblk_ptr_.offset(),
+                                         decoded.Pass());
+}
+
+bool CFileIterator::TakeDecodedBlock(PreparedBlock *prep_block) {
+  gscoped_ptr<DecodedBlock> decoded;
+  if (!cache_decoded_blocks_ ||
+      !DecodedBlockCache::GetSingleton()->Take(reader_->block_id(),
+                                               prep_block->dblk_ptr_.offset(),
+                                               &decoded)) {
+    return false;
+  }
+  prep_block->dblk_data_ = decoded->data.Pass();
+  prep_block->dblk_.reset(decoded->decoder.release());
+  prep_block->dblk_->SeekToPositionInBlock(0);
+  prep_block->rle_bitmap = decoded->null_bitmap;
+  prep_block->num_rows_in_block_ = decoded->num_rows_in_block;
+  io_stats_.data_blocks_from_decoded_cache++;
+  return true;
+}
 
+Status CFileIterator::DecodeDataBlock(PreparedBlock *prep_block) {
   uint32_t num_rows_in_block = 0;
   Slice data_block = prep_block->dblk_data_.data();
   if (reader_->is_nullable()) {
     RETURN_NOT_OK(DecodeNullInfo(&data_block, &num_rows_in_block, &(prep_block->rle_bitmap)));
-    prep_block->rle_decoder_ = RleDecoder<bool>(prep_block->rle_bitmap.data(),
-                                                prep_block->rle_bitmap.size(), 1);
   }
 
   BlockDecoder *bd;
@@ -765,17 +1001,41 @@ Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
   if (!reader_->is_nullable()) {
     num_rows_in_block = bd->Count();
   }
+  prep_block->num_rows_in_block_ = num_rows_in_block;
 
+  // Only blocks which were actually read are accounted as read from disk;
+  // decoded block cache hits are counted in TakeDecodedBlock().
   io_stats_.cells_read_from_disk += num_rows_in_block;
   io_stats_.data_blocks_read_from_disk++;
   io_stats_.bytes_read_from_disk += data_block.size();
+  return Status::OK();
+}
+
+void CFileIterator::FinishDataBlock(PreparedBlock *prep_block) {
+  if (reader_->is_nullable()) {
+    prep_block->rle_decoder_ = RleDecoder<bool>(prep_block->rle_bitmap.data(),
+                                                prep_block->rle_bitmap.size(), 1);
+  }
 
   prep_block->idx_in_block_ = 0;
-  prep_block->num_rows_in_block_ = num_rows_in_block;
   prep_block->needs_rewind_ = false;
   prep_block->rewind_idx_ = 0;
 
   DVLOG(2) << "Read dblk " << prep_block->ToString();
+}
+
+Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
+                                           PreparedBlock *prep_block) {
+  // 'prep_block' may still hold the block it was previously read into.
+  ReturnDecodedBlock(prep_block);
+
+  prep_block->dblk_ptr_ = idx_iter.GetCurrentBlockPointer();
+  if (!TakeDecodedBlock(prep_block)) {
+    RETURN_NOT_OK(reader_->ReadBlock(prep_block->dblk_ptr_, cache_control_,
+                                     &prep_block->dblk_data_));
+    RETURN_NOT_OK(DecodeDataBlock(prep_block));
+  }
+  FinishDataBlock(prep_block);
   return Status::OK();
 }
 
@@ -783,10 +1043,107 @@ Status CFileIterator::QueueCurrentDataBlock(const IndexTreeIterator &idx_iter) {
   pblock_pool_scoped_ptr b = prepared_block_pool_.make_scoped_ptr(
     prepared_block_pool_.Construct());
   RETURN_NOT_OK(ReadCurrentDataBlock(idx_iter, b.get()));
+  MaybeReadAhead(b->dblk_ptr_);
   prepared_blocks_.push_back(b.release());
   return Status::OK();
 }
 
+void CFileIterator::MaybeReadAhead(const BlockPointer &ptr) {
+  if (FLAGS_cfile_readahead_bytes <= 0 ||
+      ++sequential_blocks_read_ < kReadAheadMinSequentialBlocks) {
+    return;
+  }
+
+  // Keep the window ahead of the scan, but only extend it once the scan
+  // has consumed half of it, so that each hint covers a decent-sized range.
+  uint64_t window_size = FLAGS_cfile_readahead_bytes;
+  uint64_t block_end = ptr.offset() + ptr.size();
+  uint64_t window_end = block_end + window_size;
+  uint64_t start = std::max(block_end, readahead_end_);
+  if (start >= window_end || window_end - start < window_size / 2) {
+    return;
+  }
+  WARN_NOT_OK(reader_->ReadAhead(start, window_end - start),
+              Substitute("Could not read ahead in $0", reader_->ToString()));
+  readahead_end_ = window_end;
+}
+
+Status CFileIterator::QueueDataBlocks(rowid_t end_idx) {
+  if (seeked_ != posidx_iter_.get()) {
+    // The value index doesn't say which rows a block holds, so read the
+    // blocks one at a time until they cover the range.
+    while (prepared_blocks_.back()->last_row_idx() < end_idx) {
+      Status s = seeked_->Next();
+      if (PREDICT_FALSE(s.IsNotFound())) {
+        VLOG(1) << "Reached EOF";
+        break;
+      } else if (!s.ok()) {
+        return s;
+      }
+      RETURN_NOT_OK(QueueCurrentDataBlock(*seeked_));
+    }
+    return Status::OK();
+  }
+
+  if (prepared_blocks_.back()->last_row_idx() >= end_idx) {
+    return Status::OK();
+  }
+
+  // Collect all of the blocks covering the rest of the range so that they
+  // can be read together. The positional index is keyed by each block's
+  // first row, so we only know the range is covered once we've stepped
+  // onto a block starting at or after 'end_idx'; that block is read along
+  // with the rest, and kept around by FinishBatch() for the next batch.
+  tmp_buf_.clear();
+  KeyEncoderTraits<UINT32, faststring>::Encode(end_idx, &tmp_buf_);
+  vector<BlockPointer> ptrs;
+  while (true) {
+    Status s = seeked_->Next();
+    if (PREDICT_FALSE(s.IsNotFound())) {
+      VLOG(1) << "Reached EOF";
+      break;
+    }
+    RETURN_NOT_OK(s);
+    ptrs.push_back(seeked_->GetCurrentBlockPointer());
+    if (seeked_->GetCurrentKey().compare(Slice(tmp_buf_)) >= 0) {
+      break;
+    }
+  }
+
+  vector<PreparedBlock *> blocks;
+  vector<BlockPointer> miss_ptrs;
+  vector<BlockHandle *> miss_handles;
+  vector<PreparedBlock *> misses;
+  BOOST_FOREACH(const BlockPointer &ptr, ptrs) {
+    PreparedBlock *b = prepared_block_pool_.Construct();
+    blocks.push_back(b);
+    b->dblk_ptr_ = ptr;
+    if (!TakeDecodedBlock(b)) {
+      miss_ptrs.push_back(ptr);
+      miss_handles.push_back(&b->dblk_data_);
+      misses.push_back(b);
+    }
+  }
+
+  Status s = reader_->ReadBlocks(miss_ptrs, cache_control_, miss_handles);
+  for (int i = 0; s.ok() && i < misses.size(); i++) {
+    s = DecodeDataBlock(misses[i]);
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    BOOST_FOREACH(PreparedBlock *b, blocks) {
+      prepared_block_pool_.Destroy(b);
+    }
+    return s;
+  }
+
+  BOOST_FOREACH(PreparedBlock *b, blocks) {
+    FinishDataBlock(b);
+    MaybeReadAhead(b->dblk_ptr_);
+    prepared_blocks_.push_back(b);
+  }
+  return Status::OK();
+}
+
 bool CFileIterator::HasNext() const {
   CHECK(seeked_) << "not seeked";
   CHECK(!prepared_) << "Cannot call HasNext() mid-batch";
@@ -805,16 +1162,7 @@ Status CFileIterator::PrepareBatch(size_t *n) {
 
   // Read blocks until all blocks covering the requested range are in the
   // prepared_blocks_ queue.
-  while (prepared_blocks_.back()->last_row_idx() < end_idx) {
-    Status s = seeked_->Next();
-    if (PREDICT_FALSE(s.IsNotFound())) {
-      VLOG(1) << "Reached EOF";
-      break;
-    } else if (!s.ok()) {
-      return s;
-    }
-    RETURN_NOT_OK(QueueCurrentDataBlock(*seeked_));
-  }
+  RETURN_NOT_OK(QueueDataBlocks(end_idx));
 
   // Seek the first block in the queue such that the first value to be read
   // corresponds to start_idx
@@ -852,25 +1200,19 @@ Status CFileIterator::FinishBatch() {
   DVLOG(1) << "Finishing batch " << last_prepare_idx_ << "-"
            << (last_prepare_idx_ + last_prepare_count_ - 1);
 
-  // Release all blocks except for the last one, which may still contain
-  // relevent data for the next batch.
-  for (int i = 0; i < prepared_blocks_.size() - 1; i++) {
-    PreparedBlock *b = prepared_blocks_[i];
+  // Release the blocks which were fully consumed. The rest may still contain
+  // relevant data for the next batch: usually that's just the last block, but
+  // coalesced reads may have queued more than one block past the batch.
+  rowid_t next_idx = last_prepare_idx_ + last_prepare_count_;
+  int num_released = 0;
+  while (num_released < prepared_blocks_.size() &&
+         prepared_blocks_[num_released]->last_row_idx() < next_idx) {
+    PreparedBlock *b = prepared_blocks_[num_released];
+    ReturnDecodedBlock(b);
     prepared_block_pool_.Destroy(b);
+    num_released++;
   }
-
-  PreparedBlock *back = prepared_blocks_.back();
-  DVLOG(1) << "checking last block " << back->ToString() << " vs "
-           << last_prepare_idx_ << " + " << last_prepare_count_
-           << " (" << (last_prepare_idx_ + last_prepare_count_) << ")";
-  if (back->last_row_idx() < last_prepare_idx_ + last_prepare_count_) {
-    // Last block is irrelevant
-    prepared_block_pool_.Destroy(back);
-    prepared_blocks_.clear();
-  } else {
-    prepared_blocks_[0] = back;
-    prepared_blocks_.resize(1);
-  }
+  prepared_blocks_.erase(prepared_blocks_.begin(), prepared_blocks_.begin() + num_released);
 
   #ifndef NDEBUG
   if (VLOG_IS_ON(1)) {
@@ -893,10 +1235,70 @@ Status CFileIterator::Scan(ColumnBlock *dst) {
 
   // Use a column data view to been able to advance it as we read into it.
   ColumnDataView remaining_dst(dst);
+  DCHECK_LE(last_prepare_count_, dst->nrows());
+
+  RewindPreparedBlocks();
+  size_t pb_idx = 0;
+  return CopyPreparedRows(last_prepare_count_, &pb_idx, &remaining_dst);
+}
+
+Status CFileIterator::ScanSelected(ColumnBlock *dst, const SelectionVector& sel) {
+  CHECK(seeked_) << "not seeked";
+  DCHECK_LE(last_prepare_count_, sel.nrows());
+
+  size_t n = last_prepare_count_;
+  if (n == 0 || BitMapIsAllSet(sel.bitmap(), 0, n)) {
+    return Scan(dst);
+  }
+
+  ColumnDataView remaining_dst(dst);
+  DCHECK_LE(last_prepare_count_, dst->nrows());
+
+  RewindPreparedBlocks();
+  size_t pb_idx = 0;
+
+  // Skipping a run of rows costs a seek within the data block, so short gaps
+  // between selected rows are cheaper to decode than to skip.
+  const size_t kMinRowsToSkip = 16;
+
+  const uint8_t* bitmap = sel.bitmap();
+  size_t row = 0;
+  while (row < n) {
+    size_t next_selected;
+    if (!BitmapFindFirstSet(bitmap, row, n, &next_selected)) {
+      next_selected = n;
+    }
+    if (next_selected == n || next_selected - row >= kMinRowsToSkip) {
+      SkipPreparedRows(next_selected - row, &pb_idx, &remaining_dst);
+      row = next_selected;
+      continue;
+    }
 
-  uint32_t rem = last_prepare_count_;
-  DCHECK_LE(rem, dst->nrows());
+    // Decode up to the next gap which is worth skipping.
+    size_t end = next_selected;
+    while (end < n) {
+      size_t gap_start;
+      if (!BitmapFindFirstZero(bitmap, end, n, &gap_start)) {
+        end = n;
+        break;
+      }
+      size_t gap_end;
+      if (!BitmapFindFirstSet(bitmap, gap_start, n, &gap_end)) {
+        gap_end = n;
+      }
+      if (gap_end == n || gap_end - gap_start >= kMinRowsToSkip) {
+        end = gap_start;
+        break;
+      }
+      end = gap_end;
+    }
+    RETURN_NOT_OK(CopyPreparedRows(end - row, &pb_idx, &remaining_dst));
+    row = end;
+  }
+  return Status::OK();
+}
 
+void CFileIterator::RewindPreparedBlocks() {
   BOOST_FOREACH(PreparedBlock *pb, prepared_blocks_) {
     if (pb->needs_rewind_) {
       // Seek back to the saved position.
@@ -905,10 +1307,105 @@ Status CFileIterator::Scan(ColumnBlock *dst) {
       // that might be more efficient (allowing the decoder to save internal state
       // instead of having to reconstruct it)
     }
+  }
+}
 
-    if (reader_->is_nullable()) {
-      DCHECK(dst->is_nullable());
+Status CFileIterator::ScanSelectedAndEvaluate(const ColumnRangePredicate& pred,
+                                              ColumnBlock *dst, SelectionVector *sel,
+                                              bool *evaluated) {
+  CHECK(seeked_) << "not seeked";
+  if (dict_decoder_ == NULL ||
+      (pred.predicate_type() != ColumnRangePredicate::RANGE &&
+       pred.predicate_type() != ColumnRangePredicate::IN_LIST)) {
+    *evaluated = false;
+    return ScanSelected(dst, *sel);
+  }
+  DCHECK_LE(last_prepare_count_, sel->nrows());
+  DCHECK_LE(last_prepare_count_, dst->nrows());
+
+  EvaluatePredicateOnDictionary(pred);
+
+  ColumnDataView remaining_dst(dst);
+  RewindPreparedBlocks();
+  size_t pb_idx = 0;
+  RETURN_NOT_OK(CopyPreparedRows(last_prepare_count_, &pb_idx, &remaining_dst, &pred, sel));
+  *evaluated = true;
+  return Status::OK();
+}
 
+void CFileIterator::EvaluatePredicateOnDictionary(const ColumnRangePredicate& pred) {
+  if (dict_pred_id_ == pred.id()) {
+    return;
+  }
+  size_t num_codewords = dict_decoder_->Count();
+  dict_matches_.resize(BitmapSize(num_codewords));
+  BitmapChangeBits(dict_matches_.data(), 0, num_codewords, false);
+  for (size_t i = 0; i < num_codewords; i++) {
+    Slice entry = dict_decoder_->string_at_index(i);
+    if (pred.MatchesCell(&entry)) {
+      BitmapSet(dict_matches_.data(), i);
+    }
+  }
+  dict_pred_id_ = pred.id();
+}
+
+Status CFileIterator::CopyNextValuesAndEvaluate(PreparedBlock *pb, size_t *n,
+                                                ColumnDataView *dst,
+                                                const ColumnRangePredicate *pred,
+                                                SelectionVector *sel) {
+  if (pred == NULL) {
+    return pb->dblk_->CopyNextValues(n, dst);
+  }
+
+  BinaryDictBlockDecoder* dict_dblk = down_cast<BinaryDictBlockDecoder*>(pb->dblk_.get());
+  if (dict_dblk->is_codeword_mode()) {
+    return dict_dblk->CopyNextMatchingValues(n, dict_matches_.data(), sel, dst);
+  }
+
+  // The block fell back to plain encoding, so its strings have to be
+  // evaluated one at a time. Only the runs of selected rows are copied; the
+  // decoder is seeked past the others.
+  size_t first_pos = dict_dblk->GetCurrentIndex();
+  *n = std::min(*n, dict_dblk->Count() - first_pos);
+  size_t first_row = dst->first_row_index();
+  BitmapIterator sel_iter(sel->bitmap() + first_row / 8, first_row % 8 + *n);
+  sel_iter.SeekTo(first_row % 8);
+  Slice* cells = reinterpret_cast<Slice*>(dst->data());
+  size_t i = 0;
+  bool selected;
+  size_t run;
+  while ((run = sel_iter.Next(&selected)) > 0) {
+    if (!selected) {
+      std::fill(cells + i, cells + i + run, Slice());
+      dict_dblk->SeekToPositionInBlock(first_pos + i + run);
+    } else {
+      ColumnDataView run_dst(*dst);
+      run_dst.Advance(i);
+      size_t copied = run;
+      RETURN_NOT_OK(dict_dblk->CopyNextValues(&copied, &run_dst));
+      DCHECK_EQ(run, copied);
+      for (size_t j = i; j < i + run; j++) {
+        if (!pred->MatchesCell(&cells[j])) {
+          BitmapClear(sel->mutable_bitmap(), first_row + j);
+        }
+      }
+    }
+    i += run;
+  }
+  return Status::OK();
+}
+
+Status CFileIterator::CopyPreparedRows(uint32_t num_rows, size_t *pb_idx,
+                                       ColumnDataView *dst,
+                                       const ColumnRangePredicate *pred,
+                                       SelectionVector *sel) {
+  uint32_t rem = num_rows;
+
+  while (rem > 0) {
+    DCHECK_LT(*pb_idx, prepared_blocks_.size());
+    PreparedBlock *pb = prepared_blocks_[*pb_idx];
+
+    if (reader_->is_nullable()) {
       size_t nrows = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
 
       // Fill column bitmap
@@ -926,40 +1423,44 @@ Status CFileIterator::Scan(ColumnBlock *dst) {
         size_t this_batch = nblock;
         if (not_null) {
           // TODO: Maybe copy all and shift later?
-          RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
+          RETURN_NOT_OK(CopyNextValuesAndEvaluate(pb, &this_batch, dst, pred, sel));
           DCHECK_EQ(nblock, this_batch);
           pb->needs_rewind_ = true;
         } else {
+          if (pred != NULL) {
+            // NULL cells never match a RANGE or IN_LIST predicate.
+            BitmapChangeBits(sel->mutable_bitmap(), dst->first_row_index(), nblock, false);
+          }
 #ifndef NDEBUG
-          kudu::OverwriteWithPattern(reinterpret_cast<char *>(remaining_dst.data()),
-                                     remaining_dst.stride() * nblock,
+          kudu::OverwriteWithPattern(reinterpret_cast<char *>(dst->data()),
+                                     dst->stride() * nblock,
                                      "NULLNULLNULLNULLNULL");
 #endif
         }
 
         // Set the ColumnBlock bitmap
-        remaining_dst.SetNullBits(this_batch, not_null);
+        dst->SetNullBits(this_batch, not_null);
 
         rem -= this_batch;
         count -= this_batch;
         pb->idx_in_block_ += this_batch;
-        remaining_dst.Advance(this_batch);
+        dst->Advance(this_batch);
       }
     } else {
       // Fetch as many as we can from the current datablock.
       size_t this_batch = rem;
-      RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
+      RETURN_NOT_OK(CopyNextValuesAndEvaluate(pb, &this_batch, dst, pred, sel));
       pb->needs_rewind_ = true;
       DCHECK_LE(this_batch, rem);
 
       // If the column is nullable, set all bits to true
       if (dst->is_nullable()) {
-        remaining_dst.SetNullBits(this_batch, true);
+        dst->SetNullBits(this_batch, true);
       }
 
       rem -= this_batch;
       pb->idx_in_block_ += this_batch;
-      remaining_dst.Advance(this_batch);
+      dst->Advance(this_batch);
     }
 
     // If we didn't fetch as many as requested, then it should
@@ -967,15 +1468,43 @@ Status CFileIterator::Scan(ColumnBlock *dst) {
     if (rem > 0) {
       DCHECK_EQ(pb->dblk_->Count(), pb->dblk_->GetCurrentIndex()) <<
         "dblk stopped yielding values before it was empty.";
-    } else {
-      break;
+      (*pb_idx)++;
+    } else if (pb->idx_in_block_ == pb->num_rows_in_block_) {
+      (*pb_idx)++;
     }
   }
-
-  DCHECK_EQ(rem, 0) << "Should have fetched exactly the number of prepared rows";
   return Status::OK();
 }
 
+void CFileIterator::SkipPreparedRows(uint32_t nrows, size_t *pb_idx, ColumnDataView *dst) {
+  // Leave the skipped cells in a well-defined state: zeroed cells are valid
+  // values of every type (e.g. empty Slices).
+  memset(dst->data(), 0, dst->stride() * nrows);
+  if (dst->is_nullable()) {
+    dst->SetNullBits(nrows, false);
+  }
+  dst->Advance(nrows);
+  io_stats_.cells_skipped += nrows;
+
+  uint32_t rem = nrows;
+  while (rem > 0) {
+    DCHECK_LT(*pb_idx, prepared_blocks_.size());
+    PreparedBlock *pb = prepared_blocks_[*pb_idx];
+    uint32_t avail = pb->num_rows_in_block_ - pb->idx_in_block_;
+    if (rem < avail) {
+      SeekToPositionInBlock(pb, pb->idx_in_block_ + rem);
+      pb->needs_rewind_ = true;
+      return;
+    }
+    // The rest of the block is skipped. There's no need to seek its decoder,
+    // since nothing further is read from the block until it is rewound.
+    pb->idx_in_block_ = pb->num_rows_in_block_;
+    pb->needs_rewind_ = true;
+    rem -= avail;
+    (*pb_idx)++;
+  }
+}
+
 Status CFileIterator::CopyNextValues(size_t *n, ColumnBlock *cb) {
   RETURN_NOT_OK(PrepareBatch(n));
   RETURN_NOT_OK(Scan(cb));
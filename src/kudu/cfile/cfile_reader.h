@@ -23,6 +23,7 @@
 #include "kudu/cfile/block_cache.h"
 #include "kudu/cfile/block_encodings.h"
 #include "kudu/cfile/block_handle.h"
+#include "kudu/cfile/block_pointer.h"
 #include "kudu/cfile/block_compression.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/index_btree.h"
@@ -41,6 +42,10 @@
 #include "kudu/common/key_encoder.h"
 
 namespace kudu {
+
+class ColumnRangePredicate;
+class SelectionVector;
+
 namespace cfile {
 
 class BlockCache;
@@ -92,8 +97,61 @@ class CFileReader {
 
   // TODO: make this private? should only be used
   // by the iterator and index tree readers, I think.
+  //
+  // If the block is cached, 'priority' determines which cache it goes in.
   Status ReadBlock(const BlockPointer &ptr, CacheControl cache_control,
-                   BlockHandle *ret) const;
+                   BlockHandle *ret,
+                   BlockCache::Priority priority = BlockCache::NORMAL_PRIORITY) const;
+
+  // Like ReadBlock(), but for several blocks at once. The reads of any
+  // blocks which aren't cached are issued together. On success, the block
+  // at ptrs[i] is returned in *ret[i].
+  Status ReadBlocks(const vector<BlockPointer> &ptrs, CacheControl cache_control,
+                    const vector<BlockHandle *> &ret) const;
+
+  // Hint that the 'length' bytes of the file starting at 'offset' will be
+  // read soon, so that they can be fetched in the background. The range is
+  // clipped to the end of the file.
+  Status ReadAhead(uint64_t offset, size_t length) const;
+
+  // Memory which a block is read into. Defined in cfile_reader.cc.
+  class ScratchMemory;
+
+  // The read of a block which missed the cache, set up by PrepareBlockRead()
+  // so that the caller can issue it along with the reads of other blocks,
+  // possibly of other files, through fs::BlockManager::ReadBatch().
+  class PendingBlockRead {
+   public:
+    PendingBlockRead();
+    ~PendingBlockRead();
+
+    // The read to issue. Its result must be set before the read is passed
+    // to FinishBlockRead().
+    fs::BlockReadRequest* request() { return &request_; }
+
+   private:
+    friend class CFileReader;
+
+    BlockPointer ptr_;
+    CacheControl cache_control_;
+    gscoped_ptr<ScratchMemory> scratch_;
+    fs::BlockReadRequest request_;
+
+    DISALLOW_COPY_AND_ASSIGN(PendingBlockRead);
+  };
+
+  // Like ReadBlock(), except that if the block isn't cached, the read of it
+  // is set up in 'read' for the caller to issue, rather than issued.
+  //
+  // Returns true if the block was cached, in which case it's returned in
+  // 'ret'. Otherwise returns false, and the caller must issue the read and
+  // then pass it to FinishBlockRead().
+  bool PrepareBlockRead(const BlockPointer &ptr, CacheControl cache_control,
+                        BlockHandle *ret, PendingBlockRead *read) const;
+
+  // Decompress and cache the block read by 'read' like ReadBlock(), and
+  // return it in 'ret'.
+  Status FinishBlockRead(PendingBlockRead *read, BlockHandle *ret) const;
 
   // Return the number of rows in this cfile.
   // This is assumed to be reasonably fast (i.e does not scan
@@ -158,6 +216,26 @@ class CFileReader {
     return BlockPointer(footer().validx_info().root_block());
   }
 
+  // Return true if this file was written with zone maps.
+  bool has_zone_maps() const {
+    return footer().has_zone_map() && footer().has_zone_maps_block_ptr();
+  }
+
+  // Return the min/max statistics for the whole file.
+  const ZoneMapPB& file_zone_map() const {
+    DCHECK(has_zone_maps());
+    return footer().zone_map();
+  }
+
+  // Return the min/max statistics for each data block in the file.
+  // The zone maps are read from disk on the first call, and remain valid
+  // for the lifetime of this reader.
+  //
+  // REQUIRES: has_zone_maps()
+  Status GetBlockZoneMaps(const DataBlockZoneMapsPB** zone_maps);
+
+  const BlockId& block_id() const { return block_->id(); }
+
   std::string ToString() const { return block_->id().ToString(); }
 
  private:
@@ -174,6 +252,23 @@ class CFileReader {
   Status ReadAndParseHeader();
   Status ReadAndParseFooter();
 
+  // Callback used in 'zone_maps_once_' to read the block zone maps.
+  Status ReadBlockZoneMapsOnce();
+
+  // Look up the block at 'ptr' in 'cache', returning it in 'ret' if found.
+  bool LookupBlock(BlockCache *cache, const BlockPointer &ptr, CacheControl cache_control,
+                   BlockHandle *ret) const;
+
+  // Allocate the memory to read the block at 'ptr' into.
+  void AllocateReadScratch(BlockCache *cache, const BlockPointer &ptr,
+                           CacheControl cache_control, ScratchMemory *scratch) const;
+
+  // Decompress the block at 'ptr', whose on-disk data 'block' was read
+  // into 'scratch', and insert it into 'cache' if requested.
+  Status FinishReadBlock(BlockCache *cache, const BlockPointer &ptr,
+                         CacheControl cache_control, Slice block,
+                         ScratchMemory *scratch, BlockHandle *ret) const;
+
   // Returns the memory usage of the object including the object itself.
   size_t memory_footprint() const;
 
@@ -193,6 +288,9 @@ class CFileReader {
 
   KuduOnceDynamic init_once_;
 
+  gscoped_ptr<DataBlockZoneMapsPB> block_zone_maps_;
+  KuduOnceDynamic zone_maps_once_;
+
   ScopedTrackedConsumption mem_consumption_;
 };
 
@@ -242,6 +340,29 @@ class ColumnIterator {
   // calls to Scan() will re-read the same values.
   virtual Status Scan(ColumnBlock *dst) = 0;
 
+  // Like Scan(), but only the cells of rows selected in 'sel' are guaranteed
+  // to be materialized. The contents of unselected cells are unspecified
+  // (though safe to read). 'sel' covers the rows of the prepared batch.
+  //
+  // The default implementation materializes every cell.
+  virtual Status ScanSelected(ColumnBlock *dst, const SelectionVector& sel) {
+    return Scan(dst);
+  }
+
+  // Like ScanSelected(), but the iterator may also evaluate 'pred' against
+  // the column while scanning it. If it does, the bits in 'sel' of the rows
+  // which don't match are cleared, the cells of those rows are unspecified,
+  // and '*evaluated' is set to true. Otherwise '*evaluated' is set to false
+  // and 'sel' is left unchanged.
+  //
+  // The default implementation never evaluates the predicate.
+  virtual Status ScanSelectedAndEvaluate(const ColumnRangePredicate& pred,
+                                         ColumnBlock *dst, SelectionVector *sel,
+                                         bool *evaluated) {
+    *evaluated = false;
+    return ScanSelected(dst, *sel);
+  }
+
   // Finish processing the current batch, advancing the iterators
   // such that the next call to PrepareBatch() will start where the previous
   // batch left off.
@@ -302,6 +423,16 @@ class CFileIterator : public ColumnIterator {
   // TODO: do we ever want to be able to seek to the end of the file?
   Status SeekToOrdinal(rowid_t ord_idx) OVERRIDE;
 
+  // SeekToOrdinal() split in two, so that the data blocks needed by the
+  // seeks of several iterators can be read together.
+  //
+  // If the data block holding 'ord_idx' isn't cached, the read of it is
+  // appended to 'reads'. The caller must issue the read before calling
+  // FinishSeekToOrdinal() to complete the seek. No other calls may be made
+  // in between.
+  Status PrepareSeekToOrdinal(rowid_t ord_idx, vector<fs::BlockReadRequest *> *reads);
+  Status FinishSeekToOrdinal();
+
   // Seek the index to the given row_key, or to the index entry immediately
   // before it. Then (if the index is sparse) seek the data block to the
   // value matching value or to the value immediately after it.
@@ -345,6 +476,25 @@ class CFileIterator : public ColumnIterator {
   // calls to Scan() will re-read the same values.
   Status Scan(ColumnBlock *dst) OVERRIDE;
 
+  // Copy values into the prepared column block, skipping runs of rows which
+  // are not selected in 'sel' rather than decoding them. Skipped cells are
+  // zeroed (and set NULL, if the column is nullable) and are counted in
+  // io_statistics().cells_skipped.
+  Status ScanSelected(ColumnBlock *dst, const SelectionVector& sel) OVERRIDE;
+
+  // For dictionary-encoded files, evaluates RANGE and IN_LIST predicates
+  // once against each dictionary entry, and then filters rows by testing
+  // their codewords against the resulting bitmap, so the strings of rows
+  // which don't match are never copied. Data blocks which fell back to
+  // plain encoding are evaluated one cell at a time. Other predicates and
+  // encodings are not evaluated.
+  //
+  // The dictionary's match bitmap is cached for the most recently evaluated
+  // predicate, keyed by its id().
+  Status ScanSelectedAndEvaluate(const ColumnRangePredicate& pred,
+                                 ColumnBlock *dst, SelectionVector *sel,
+                                 bool *evaluated) OVERRIDE;
+
   // Finish processing the current batch, advancing the iterators
   // such that the next call to PrepareBatch() will start where the previous
   // batch left off.
@@ -411,6 +561,18 @@ class CFileIterator : public ColumnIterator {
   // Seek the given PreparedBlock to the given index within it.
   void SeekToPositionInBlock(PreparedBlock *pb, uint32_t idx_in_block);
 
+  // If decoded blocks are being cached and the block at prep_block->dblk_ptr_
+  // is in the cache, take it into 'prep_block' and return true. Hits are
+  // counted in io_stats_.data_blocks_from_decoded_cache.
+  bool TakeDecodedBlock(PreparedBlock *prep_block);
+
+  // Set up a decoder for the data read into prep_block->dblk_data_ and
+  // account for the block in the io_stats_ disk read counters.
+  Status DecodeDataBlock(PreparedBlock *prep_block);
+
+  // Reset the position of a newly read or decoded block.
+  void FinishDataBlock(PreparedBlock *prep_block);
+
   // Read the data block currently pointed to by idx_iter_
   // into the given PreparedBlock structure.
   //
@@ -418,10 +580,25 @@ class CFileIterator : public ColumnIterator {
   Status ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
                               PreparedBlock *prep_block);
 
+  // If decoded blocks are being cached, put the given block's decoder into
+  // the DecodedBlockCache so that later reads of the block can reuse it.
+  // Leaves 'pb' without a decoder.
+  void ReturnDecodedBlock(PreparedBlock *pb);
+
   // Read the data block currently pointed to by idx_iter_, and enqueue
   // it onto the end of the prepared_blocks_ deque.
   Status QueueCurrentDataBlock(const IndexTreeIterator &idx_iter);
 
+  // Enqueue the data blocks following the end of the prepared_blocks_
+  // deque until they cover 'end_idx' or the end of the file. When seeked
+  // by ordinal, the blocks which miss the cache are read in one batch.
+  Status QueueDataBlocks(rowid_t end_idx);
+
+  // Called for each data block read by advancing through the file rather
+  // than by seeking. Once enough blocks have been read in a row, hints to
+  // the reader that the data following 'ptr' will be read soon.
+  void MaybeReadAhead(const BlockPointer &ptr);
+
   // Fully initialize the underlying cfile reader if needed, and clear any
   // seek-related state.
   Status PrepareForNewSeek();
@@ -453,6 +630,30 @@ class CFileIterator : public ColumnIterator {
   // Whether this iterator will ask the cfile to cache the blocks it requests or not.
   const CFileReader::CacheControl cache_control_;
 
+  // Whether this iterator reuses decoders from the DecodedBlockCache, and
+  // returns its decoders to it once done with them. Set on each seek.
+  //
+  // Decoders of dictionary-encoded blocks refer to the iterator's own
+  // dictionary decoder, so they can't be shared and are never cached.
+  bool cache_decoded_blocks_;
+
+  // Number of data blocks read in a row since the last seek, not counting
+  // the block seeked to.
+  int sequential_blocks_read_;
+
+  // The offset up to which the file has been read ahead since the last
+  // seek, or 0 if it hasn't.
+  uint64_t readahead_end_;
+
+  // The block being seeked to by PrepareSeekToOrdinal(), or NULL if no
+  // such seek is in progress. Allocated from prepared_block_pool_.
+  PreparedBlock *pending_seek_block_;
+  rowid_t pending_seek_idx_;
+
+  // The read of pending_seek_block_, if it needs to be read.
+  CFileReader::PendingBlockRead pending_seek_read_;
+  bool pending_seek_needs_read_;
+
   // RowID of the current prepared batch, if prepared_ is true.
   // Otherwise, the RowID of the next batch that will be prepared.
   rowid_t last_prepare_idx_;
@@ -463,6 +664,36 @@ class CFileIterator : public ColumnIterator {
 
   IteratorStats io_stats_;
 
+  // Seek any prepared blocks which have already been read from back to the
+  // start of the prepared range, so the batch can be scanned again.
+  void RewindPreparedBlocks();
+
+  // Copy the next 'num_rows' prepared values into 'dst', starting with the
+  // block prepared_blocks_[*pb_idx]. Advances 'dst' and '*pb_idx'.
+  //
+  // If 'pred' is non-NULL, it is evaluated against the rows as they are
+  // copied, clearing their bits in 'sel' (see ScanSelectedAndEvaluate()).
+  Status CopyPreparedRows(uint32_t num_rows, size_t *pb_idx, ColumnDataView *dst,
+                          const ColumnRangePredicate *pred = NULL,
+                          SelectionVector *sel = NULL);
+
+  // Like CopyPreparedRows(), but skips the rows without decoding them.
+  void SkipPreparedRows(uint32_t nrows, size_t *pb_idx, ColumnDataView *dst);
+
+  // Copy the next '*n' values of the given block into 'dst'. If 'pred' is
+  // non-NULL, also evaluate it against the values, clearing the bits in
+  // 'sel' of the rows which don't match (see ScanSelectedAndEvaluate()).
+  Status CopyNextValuesAndEvaluate(PreparedBlock *pb, size_t *n, ColumnDataView *dst,
+                                   const ColumnRangePredicate *pred, SelectionVector *sel);
+
+  // Compute dict_matches_ for 'pred', unless it is already cached.
+  void EvaluatePredicateOnDictionary(const ColumnRangePredicate& pred);
+
+  // Bitmap of the dictionary's codewords whose strings match the predicate
+  // whose id() is dict_pred_id_, or -1 if none has been evaluated yet.
+  int64_t dict_pred_id_;
+  faststring dict_matches_;
+
   // a temporary buffer for encoding
   faststring tmp_buf_;
 };
@@ -54,6 +54,13 @@ struct WriterOptions {
   // Whether the file needs a value index
   bool write_validx;
 
+  // Whether to write per-block and per-file min/max statistics
+  // (zone maps), allowing readers to skip blocks which cannot match
+  // a predicate. Ignored for types without a total ordering.
+  //
+  // Default: false.
+  bool write_zone_maps;
+
   // Column storage attributes.
   //
   // Default: all default values as specified in the constructor in
@@ -25,6 +25,7 @@
 #include "kudu/cfile/index_btree.h"
 #include "kudu/common/key_encoder.h"
 #include "kudu/cfile/type_encodings.h"
+#include "kudu/cfile/zone_map.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
@@ -55,6 +56,11 @@ DEFINE_string(cfile_do_on_finish, "close",
               "Possible values are 'close', 'flush', or 'nothing'.");
 TAG_FLAG(cfile_do_on_finish, experimental);
 
+DEFINE_bool(cfile_write_zone_maps, true,
+            "Whether to write min/max statistics for cfiles which request them. "
+            "These allow scans with predicates to skip data blocks entirely.");
+TAG_FLAG(cfile_write_zone_maps, advanced);
+
 namespace kudu {
 namespace cfile {
 
@@ -74,7 +80,8 @@ WriterOptions::WriterOptions()
   : index_block_size(32*1024),
     block_restart_interval(16),
     write_posidx(false),
-    write_validx(false) {
+    write_validx(false),
+    write_zone_maps(false) {
 }
 
 
@@ -132,6 +139,12 @@ CFileWriter::CFileWriter(const WriterOptions &options,
     validx_builder_.reset(new IndexTreeBuilder(&options_,
                                                this));
   }
+
+  if (options.write_zone_maps && FLAGS_cfile_write_zone_maps &&
+      ZoneMapBuilder::SupportsType(typeinfo_)) {
+    block_zone_map_.reset(new ZoneMapBuilder(typeinfo_));
+    file_zone_map_.reset(new ZoneMapBuilder(typeinfo_));
+  }
 }
 
 CFileWriter::~CFileWriter() {
@@ -221,6 +234,10 @@ Status CFileWriter::FinishAndReleaseBlock(ScopedWritableBlockCloser* closer) {
     footer.mutable_validx_info()->CopyFrom(validx_info);
   }
 
+  if (file_zone_map_ != NULL) {
+    RETURN_NOT_OK_PREPEND(WriteZoneMaps(&footer), "Couldn't write zone maps");
+  }
+
   // Optionally append extra information to the end of cfile.
   // Example: dictionary block for dictionary encoding
   RETURN_NOT_OK(data_block_->AppendExtraInfo(this, &footer));
@@ -289,6 +306,9 @@ Status CFileWriter::AppendEntries(const void *entries, size_t count) {
   while (rem > 0) {
     int n = data_block_->Add(ptr, rem);
     DCHECK_GE(n, 0);
+    if (block_zone_map_ != NULL) {
+      block_zone_map_->AddCells(ptr, n);
+    }
 
     ptr += typeinfo_->size() * n;
     rem -= n;
@@ -319,6 +339,9 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
       do {
         int n = data_block_->Add(ptr, rem);
         DCHECK_GE(n, 0);
+        if (block_zone_map_ != NULL) {
+          block_zone_map_->AddCells(ptr, n);
+        }
 
         null_bitmap_builder_->AddRun(true, n);
         ptr += n * typeinfo_->size();
@@ -332,6 +355,9 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
       } while (rem > 0);
     } else {
       null_bitmap_builder_->AddRun(false, nblock);
+      if (block_zone_map_ != NULL) {
+        block_zone_map_->AddNulls();
+      }
       ptr += nblock * typeinfo_->size();
       value_count_ += nblock;
     }
@@ -383,6 +409,15 @@ Status CFileWriter::FinishCurDataBlock() {
                             reinterpret_cast<const void *>(key_tmp_space),
                             "data block");
 
+  if (s.ok() && block_zone_map_ != NULL) {
+    DataBlockZoneMapPB* block_pb = block_zone_maps_.add_blocks();
+    block_pb->set_first_ordinal(first_elem_ord);
+    block_pb->set_num_values(num_elems_in_block);
+    block_zone_map_->ToPB(block_pb->mutable_zone_map());
+    file_zone_map_->Merge(*block_zone_map_);
+    block_zone_map_->Reset();
+  }
+
   if (is_nullable_) {
     null_bitmap_builder_->Reset();
   }
@@ -391,6 +426,21 @@ Status CFileWriter::FinishCurDataBlock() {
   return s;
 }
 
+Status CFileWriter::WriteZoneMaps(CFileFooterPB* footer) {
+  file_zone_map_->ToPB(footer->mutable_zone_map());
+
+  faststring buf;
+  if (!pb_util::SerializeToString(block_zone_maps_, &buf)) {
+    return Status::Corruption("unable to serialize block zone maps");
+  }
+  vector<Slice> v;
+  v.push_back(Slice(buf));
+  BlockPointer ptr;
+  RETURN_NOT_OK(AddBlock(v, &ptr, "zone maps block"));
+  ptr.CopyToPB(footer->mutable_zone_maps_block_ptr());
+  return Status::OK();
+}
+
 Status CFileWriter::AppendRawBlock(const vector<Slice> &data_slices,
                                    size_t ordinal_pos,
                                    const void *validx_key,
@@ -49,6 +49,7 @@ class BTreeInfoPB;
 class GVIntBlockBuilder;
 class BinaryPrefixBlockBuilder;
 class IndexTreeBuilder;
+class ZoneMapBuilder;
 
 // Magic used in header/footer
 extern const char kMagicString[];
@@ -171,6 +172,10 @@ class CFileWriter {
 
   Status FinishCurDataBlock();
 
+  // Write the per-block zone maps as their own block, and fill in the
+  // zone map fields of 'footer'.
+  Status WriteZoneMaps(CFileFooterPB* footer);
+
   // Flush the current unflushed_metadata_ entries into the given protobuf
   // field, clearing the buffer.
   void FlushMetadataToPB(google::protobuf::RepeatedPtrField<FileMetadataPairPB> *field);
@@ -208,6 +213,14 @@ class CFileWriter {
   gscoped_ptr<NullBitmapBuilder> null_bitmap_builder_;
   gscoped_ptr<CompressedBlockBuilder> block_compressor_;
 
+  // Zone maps for the current data block and for the whole file.
+  // NULL unless zone maps are enabled for this file.
+  gscoped_ptr<ZoneMapBuilder> block_zone_map_;
+  gscoped_ptr<ZoneMapBuilder> file_zone_map_;
+
+  // Zone maps of all data blocks flushed so far.
+  DataBlockZoneMapsPB block_zone_maps_;
+
   enum State {
     kWriterInitialized,
     kWriterWriting,
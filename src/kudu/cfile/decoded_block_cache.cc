@@ -0,0 +1,128 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gflags/gflags.h>
+
+#include "kudu/cfile/decoded_block_cache.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/cache.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/malloc.h"
+
+DEFINE_int64(decoded_block_cache_capacity_mb, 0,
+             "Capacity in MB of the cache of data blocks whose decoders have "
+             "already been set up, which saves re-parsing the blocks on "
+             "repeated scans. This is in addition to the block cache. "
+             "0 disables the cache.");
+TAG_FLAG(decoded_block_cache_capacity_mb, advanced);
+TAG_FLAG(decoded_block_cache_capacity_mb, experimental);
+
+namespace kudu {
+namespace cfile {
+
+namespace {
+
+struct CacheKey {
+  CacheKey(DecodedBlockCache::FileId file_id, uint64_t offset) :
+    file_id_(file_id.id()),
+    offset_(offset)
+  {}
+
+  const Slice slice() const {
+    return Slice(reinterpret_cast<const uint8_t *>(this), sizeof(*this));
+  }
+
+  uint64_t file_id_;
+  uint64_t offset_;
+} PACKED;
+
+// The value of a cache entry. A reader claims the block before taking it,
+// so that only one of several concurrent lookups of the entry gets it.
+struct Entry {
+  explicit Entry(gscoped_ptr<DecodedBlock> b)
+    : block(b.Pass()),
+      claimed(false) {
+  }
+
+  gscoped_ptr<DecodedBlock> block;
+  AtomicBool claimed;
+};
+
+class Deleter : public CacheDeleter {
+ public:
+  Deleter() {}
+  virtual void Delete(const Slice& key, void* value) OVERRIDE {
+    delete reinterpret_cast<Entry*>(value);
+  }
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Deleter);
+};
+
+} // anonymous namespace
+
+size_t DecodedBlock::memory_footprint() const {
+  size_t size = kudu_malloc_usable_size(this);
+  size += data.data().size();
+  if (decoder) {
+    size += decoder->memory_footprint();
+  }
+  return size;
+}
+
+DecodedBlockCache::DecodedBlockCache()
+  : deleter_(new Deleter()),
+    cache_(NewLRUCache(DRAM_CACHE, FLAGS_decoded_block_cache_capacity_mb * 1024 * 1024,
+                       "decoded_block_cache")) {
+}
+
+DecodedBlockCache::DecodedBlockCache(size_t capacity)
+  : deleter_(new Deleter()),
+    cache_(NewLRUCache(DRAM_CACHE, capacity, "decoded_block_cache")) {
+}
+
+bool DecodedBlockCache::Take(FileId file_id, uint64_t offset,
+                             gscoped_ptr<DecodedBlock>* block) {
+  CacheKey key(file_id, offset);
+  Cache::Handle* h = cache_->Lookup(key.slice(), Cache::EXPECT_IN_CACHE);
+  if (h == NULL) {
+    return false;
+  }
+  Entry* e = reinterpret_cast<Entry*>(cache_->Value(h));
+  bool taken = !e->claimed.Exchange(true);
+  if (taken) {
+    *block = e->block.Pass();
+    // The entry is now empty, so there's no point in keeping it around.
+    // If another reader has already replaced it, this drops the replacement
+    // as well, which only costs that block a miss.
+    cache_->Erase(key.slice());
+  }
+  cache_->Release(h);
+  return taken;
+}
+
+void DecodedBlockCache::Put(FileId file_id, uint64_t offset,
+                            gscoped_ptr<DecodedBlock> block) {
+  CacheKey key(file_id, offset);
+  size_t charge = block->memory_footprint();
+  gscoped_ptr<Entry> e(new Entry(block.Pass()));
+  Cache::Handle* h = cache_->Insert(key.slice(), e.get(), charge, deleter_.get());
+  if (h != NULL) {
+    ignore_result(e.release());
+    cache_->Release(h);
+  }
+}
+
+} // namespace cfile
+} // namespace kudu
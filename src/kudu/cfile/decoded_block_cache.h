@@ -0,0 +1,107 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef KUDU_CFILE_DECODED_BLOCK_CACHE_H
+#define KUDU_CFILE_DECODED_BLOCK_CACHE_H
+
+#include <gflags/gflags.h>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/block_handle.h"
+#include "kudu/fs/block_id.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/singleton.h"
+#include "kudu/util/cache.h"
+#include "kudu/util/slice.h"
+
+DECLARE_int64(decoded_block_cache_capacity_mb);
+
+namespace kudu {
+namespace cfile {
+
+// A CFile data block along with a decoder which has already parsed it.
+struct DecodedBlock {
+  DecodedBlock() : num_rows_in_block(0) {}
+
+  // Return the memory usage of the block, including its data.
+  size_t memory_footprint() const;
+
+  BlockHandle data;
+  gscoped_ptr<BlockDecoder> decoder;
+
+  // For nullable columns, the null bitmap at the start of 'data'.
+  Slice null_bitmap;
+
+  // Total number of rows in the block (nulls + not nulls).
+  uint32_t num_rows_in_block;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(DecodedBlock);
+};
+
+// Second-tier cache which sits above the BlockCache, holding data blocks
+// whose decoders have already been set up, so that scans of hot blocks
+// don't have to parse their headers again.
+//
+// Decoders are stateful, so rather than sharing entries between readers,
+// a reader takes an entry out of the cache for its exclusive use while
+// scanning the block and puts it back afterwards. Concurrent readers of the
+// same block which miss decode their own copy, and whichever copy is put
+// back last stays cached.
+//
+// Each entry is charged with the size of its block data as well as its
+// decoder, since it holds a reference to the data which keeps it from
+// being freed when it is evicted from the BlockCache.
+class DecodedBlockCache {
+ public:
+  typedef BlockId FileId;
+
+  // Returns true if the cache is enabled by --decoded_block_cache_capacity_mb.
+  static bool IsEnabled() {
+    return FLAGS_decoded_block_cache_capacity_mb > 0;
+  }
+
+  static DecodedBlockCache* GetSingleton() {
+    return Singleton<DecodedBlockCache>::get();
+  }
+
+  explicit DecodedBlockCache(size_t capacity);
+
+  // Remove the given block from the cache and return it in *block.
+  //
+  // The decoder may be positioned anywhere within the block, so the caller
+  // must seek it before use.
+  //
+  // Returns true to indicate that the block was found, false otherwise.
+  bool Take(FileId file_id, uint64_t offset, gscoped_ptr<DecodedBlock>* block);
+
+  // Insert the given block into the cache, replacing any existing entry
+  // for the same block.
+  void Put(FileId file_id, uint64_t offset, gscoped_ptr<DecodedBlock> block);
+
+ private:
+  friend class Singleton<DecodedBlockCache>;
+  DecodedBlockCache();
+
+  DISALLOW_COPY_AND_ASSIGN(DecodedBlockCache);
+
+  // Deleter must be defined before cache_ so that cache_ destructs first.
+  gscoped_ptr<CacheDeleter> deleter_;
+  gscoped_ptr<Cache> cache_;
+};
+
+} // namespace cfile
+} // namespace kudu
+
+#endif
@@ -23,6 +23,7 @@
 #include "kudu/cfile/block_encodings.h"
 #include "kudu/cfile/bshuf_block.h"
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/cfile/for_block.h"
 #include "kudu/cfile/gvint_block.h"
 #include "kudu/cfile/plain_bitmap_block.h"
 #include "kudu/cfile/plain_block.h"
@@ -676,6 +677,67 @@ TEST_F(TestEncoding, TestRleIntBlockEncoder) {
   ASSERT_EQ(14UL, s.size());
 }
 
+TEST_F(TestEncoding, TestForIntBlockEncoder) {
+  gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+  ForBlockBuilder<INT64> ibb(opts.get());
+
+  // Microsecond timestamps, a few hundred micros apart, pack to ~9 bits
+  // per value rather than 64.
+  std::vector<int64_t> timestamps;
+  int64_t ts = 1440000000000000L;
+  for (int i = 0; i < 10000; i++) {
+    ts += random() % 500;
+    timestamps.push_back(ts);
+  }
+  ibb.Add(reinterpret_cast<const uint8_t *>(&timestamps[0]), timestamps.size());
+  Slice s = ibb.Finish(12345);
+  LOG(INFO) << "FOR Encoded size for 10k timestamps: " << s.size();
+  ASSERT_LT(s.size(), timestamps.size() * sizeof(int64_t) / 4);
+
+  // A block of identical values needs no packed data at all: just the
+  // header, one reference and width per mini-block, and the padding.
+  ibb.Reset();
+  std::vector<int64_t> same(1000, -42);
+  ibb.Add(reinterpret_cast<const uint8_t *>(&same[0]), same.size());
+  s = ibb.Finish(12345);
+  ASSERT_EQ(kForBlockHeaderSize + 8 * (sizeof(int64_t) + 1) + kForBlockTrailingPadding,
+            s.size());
+}
+
+TEST_F(TestEncoding, TestForIntBlockExtremes) {
+  // Full-range values exercise the widest bit widths, including 64-bit
+  // deltas which straddle nine bytes.
+  std::vector<int64_t> vals;
+  for (int i = 0; i < 1000; i++) {
+    switch (i % 4) {
+      case 0: vals.push_back(std::numeric_limits<int64_t>::min()); break;
+      case 1: vals.push_back(std::numeric_limits<int64_t>::max()); break;
+      case 2: vals.push_back(static_cast<int64_t>(random()) << 33); break;
+      case 3: vals.push_back(-static_cast<int64_t>(random())); break;
+    }
+  }
+  TestEncodeDecodeTemplateBlockEncoder<INT64, ForBlockBuilder<INT64>, ForBlockDecoder<INT64> >(
+      &vals[0], vals.size());
+
+  std::vector<uint64_t> uvals;
+  for (int i = 0; i < 1000; i++) {
+    uvals.push_back(i % 3 == 0 ? std::numeric_limits<uint64_t>::max() : random() % 100);
+  }
+  TestEncodeDecodeTemplateBlockEncoder<UINT64, ForBlockBuilder<UINT64>,
+                                       ForBlockDecoder<UINT64> >(&uvals[0], uvals.size());
+}
+
+TEST_F(TestEncoding, TestForIntBlockRoundTrip64Bit) {
+  ForBlockBuilder<UINT64> ubb;
+  TestIntBlockRoundTrip<ForBlockBuilder<UINT64>, ForBlockDecoder<UINT64>, UINT64>(&ubb);
+  ForBlockBuilder<INT64> ibb;
+  TestIntBlockRoundTrip<ForBlockBuilder<INT64>, ForBlockDecoder<INT64>, INT64>(&ibb);
+}
+
+TEST_F(TestEncoding, TestForEmptyBlockEncodeDecode) {
+  TestEmptyBlockEncodeDecode<ForBlockBuilder<INT32>, ForBlockDecoder<INT32> >();
+}
+
 TEST_F(TestEncoding, TestPlainBitMapRoundTrip) {
   TestBoolBlockRoundTrip<PlainBitMapBlockBuilder, PlainBitMapBlockDecoder>();
 }
@@ -805,7 +867,16 @@ struct BitshuffleTestTraits {
     typedef BShufBlockDecoder<type> decoder_type;
   };
 };
-typedef testing::Types<RleTestTraits, BitshuffleTestTraits, PlainTestTraits> MyTestFixtures;
+
+struct ForTestTraits {
+  template<DataType type>
+  struct Classes {
+    typedef ForBlockBuilder<type> encoder_type;
+    typedef ForBlockDecoder<type> decoder_type;
+  };
+};
+typedef testing::Types<RleTestTraits, BitshuffleTestTraits, PlainTestTraits,
+                       ForTestTraits> MyTestFixtures;
 TYPED_TEST_CASE(IntEncodingTest, MyTestFixtures);
 
 template<class TestTraits>
@@ -0,0 +1,517 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Frame-of-reference ("FOR") encoding for integer blocks.
+//
+// Values are grouped into mini-blocks of kForMiniBlockSize elements. Each
+// mini-block stores its minimum value (the "frame of reference") followed by
+// the difference between every value and that minimum, bit-packed at the
+// smallest width able to represent the largest difference. Columns whose
+// values span a narrow range within a mini-block -- counters, small enums
+// stored in wide types -- pack down to a few bits per value, and random
+// access stays O(1) since every mini-block has a fixed width.
+//
+// Mini-blocks whose values steadily increase (e.g. timestamps) may instead be
+// delta-encoded: the first value is stored as is, followed by the difference
+// between consecutive values, frame-of-reference packed in the same way.
+// The builder picks whichever representation is smaller for each mini-block.
+#ifndef KUDU_CFILE_FOR_BLOCK_H
+#define KUDU_CFILE_FOR_BLOCK_H
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/mathlimits.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/coding-inl.h"
+#include "kudu/util/faststring.h"
+
+namespace kudu {
+namespace cfile {
+
+struct WriterOptions;
+
+enum {
+  // ordinal position of the first element (uint32_t, little endian) and
+  // number of elements in the block (uint32_t, little endian).
+  kForBlockHeaderSize = 8,
+
+  // Number of values sharing a single frame of reference and bit width.
+  kForMiniBlockSize = 128,
+
+  // Set in a mini-block's width byte when it is delta-encoded.
+  kForDeltaFlag = 0x80,
+
+  // Zero bytes appended after the last mini-block so that the decoder may
+  // always use unaligned 64-bit loads, even for the final packed value.
+  kForBlockTrailingPadding = 8
+};
+
+// Bit-packing helpers shared by the FOR builder and decoder. Values are packed
+// LSB-first: value 'i' occupies bits [i * width, (i + 1) * width) of the
+// packed buffer.
+struct ForBitPacking {
+  // Pack 'n' values of 'width' bits each into 'dst', which must hold at least
+  // BytesForValues(n, width) + kForBlockTrailingPadding zeroed bytes.
+  template<typename UnsignedType>
+  static void Pack(const UnsignedType* vals, size_t n, int width, uint8_t* dst) {
+    if (width == 0) {
+      return;
+    }
+    size_t bit = 0;
+    for (size_t i = 0; i < n; i++, bit += width) {
+      uint8_t* p = dst + (bit >> 3);
+      int shift = bit & 7;
+      uint64_t v = vals[i];
+      UNALIGNED_STORE64(p, UNALIGNED_LOAD64(p) | (v << shift));
+      if (shift + width > 64) {
+        // Only reachable for 64-bit values not starting on a byte boundary.
+        p[8] |= static_cast<uint8_t>(v >> (64 - shift));
+      }
+    }
+  }
+
+  // Unpack 'n' values starting at index 'start' from 'packed', adding
+  // 'reference' to each and writing the results contiguously to 'out'.
+  //
+  // The common case (width <= 57) is a single branch-free loop of
+  // unaligned load, shift, mask and add per value, which the compiler
+  // unrolls and vectorizes well.
+  template<typename UnsignedType>
+  static void Unpack(const uint8_t* packed, int width, UnsignedType reference,
+                     size_t start, size_t n, UnsignedType* out) {
+    if (width == 0) {
+      std::fill(out, out + n, reference);
+      return;
+    }
+    const uint64_t mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+    size_t bit = start * width;
+    if (PREDICT_TRUE(width <= 57)) {
+      for (size_t i = 0; i < n; i++, bit += width) {
+        uint64_t word = UNALIGNED_LOAD64(packed + (bit >> 3));
+        out[i] = reference + static_cast<UnsignedType>((word >> (bit & 7)) & mask);
+      }
+    } else {
+      for (size_t i = 0; i < n; i++, bit += width) {
+        const uint8_t* p = packed + (bit >> 3);
+        int shift = bit & 7;
+        uint64_t word = UNALIGNED_LOAD64(p) >> shift;
+        if (shift + width > 64) {
+          word |= static_cast<uint64_t>(p[8]) << (64 - shift);
+        }
+        out[i] = reference + static_cast<UnsignedType>(word & mask);
+      }
+    }
+  }
+
+  static size_t BytesForValues(size_t n, int width) {
+    return (n * width + 7) / 8;
+  }
+};
+
+//
+// Frame-of-reference builder for integer types.
+//
+// Block layout:
+//   header (kForBlockHeaderSize bytes)
+//   one or more mini-blocks. The final mini-block may hold fewer than
+//   kForMiniBlockSize values. A frame-of-reference mini-block holds:
+//     1. the minimum value of the mini-block (sizeof(CppType) bytes,
+//        little endian).
+//     2. the bit width of the packed values (uint8_t).
+//     3. each value minus the minimum, bit-packed at that width.
+//   A delta-encoded mini-block holds:
+//     1. the first value of the mini-block (sizeof(CppType) bytes).
+//     2. the bit width of the packed deltas, or'ed with kForDeltaFlag.
+//     3. the minimum difference between consecutive values (sizeof(CppType)
+//        bytes).
+//     4. for each following value, its difference from the previous value
+//        minus that minimum, bit-packed at that width.
+//   kForBlockTrailingPadding zero bytes.
+//
+template<DataType IntType>
+class ForBlockBuilder : public BlockBuilder {
+ public:
+  explicit ForBlockBuilder(const WriterOptions* options = NULL)
+    : options_(options) {
+    Reset();
+  }
+
+  virtual bool IsBlockFull(size_t limit) const OVERRIDE {
+    return EstimateEncodedSize() > limit;
+  }
+
+  virtual int Add(const uint8_t* vals_void, size_t count) OVERRIDE {
+    const CppType* vals = reinterpret_cast<const CppType*>(vals_void);
+    if (PREDICT_FALSE(count_ == 0 && count > 0)) {
+      first_key_ = vals[0];
+    }
+    for (size_t i = 0; i < count; i++) {
+      pending_.push_back(vals[i]);
+      if (pending_.size() == kForMiniBlockSize) {
+        FlushMiniBlock();
+      }
+    }
+    count_ += count;
+    return count;
+  }
+
+  virtual Slice Finish(rowid_t ordinal_pos) OVERRIDE {
+    FlushMiniBlock();
+    InlineEncodeFixed32(&buf_[0], ordinal_pos);
+    InlineEncodeFixed32(&buf_[4], count_);
+    size_t old_size = buf_.size();
+    buf_.resize(old_size + kForBlockTrailingPadding);
+    memset(&buf_[old_size], 0, kForBlockTrailingPadding);
+    return Slice(buf_);
+  }
+
+  virtual void Reset() OVERRIDE {
+    count_ = 0;
+    pending_.clear();
+    buf_.clear();
+    if (options_ != NULL) {
+      buf_.reserve(options_->storage_attributes.cfile_block_size);
+    }
+    buf_.resize(kForBlockHeaderSize);
+  }
+
+  virtual size_t Count() const OVERRIDE {
+    return count_;
+  }
+
+  virtual Status GetFirstKey(void* key) const OVERRIDE {
+    if (count_ > 0) {
+      *reinterpret_cast<CppType*>(key) = first_key_;
+      return Status::OK();
+    }
+    return Status::NotFound("no keys in data block");
+  }
+
+ private:
+  typedef typename TypeTraits<IntType>::cpp_type CppType;
+  typedef typename MathLimits<CppType>::UnsignedType UnsignedType;
+
+  enum {
+    kCppTypeSize = TypeTraits<IntType>::size
+  };
+
+  size_t EstimateEncodedSize() const {
+    // Pessimistically assume the pending values will not pack at all.
+    return buf_.size() + pending_.size() * kCppTypeSize + kForBlockTrailingPadding;
+  }
+
+  void FlushMiniBlock() {
+    if (pending_.empty()) {
+      return;
+    }
+    size_t n = pending_.size();
+
+    // Frame of reference: values relative to the mini-block minimum.
+    CppType min_val = *std::min_element(pending_.begin(), pending_.end());
+    CppType max_val = *std::max_element(pending_.begin(), pending_.end());
+    UnsignedType reference = static_cast<UnsignedType>(min_val);
+    int width = BitWidth(static_cast<UnsignedType>(max_val) - reference);
+
+    // Delta: consecutive differences relative to the smallest difference.
+    // Differences are taken modulo 2^N, so this only pays off for runs
+    // which never decrease; otherwise the range covers nearly every value.
+    UnsignedType min_delta = 0;
+    int delta_width = kCppTypeSize * 8;
+    if (n > 1) {
+      deltas_.resize(n - 1);
+      for (size_t i = 1; i < n; i++) {
+        deltas_[i - 1] = static_cast<UnsignedType>(pending_[i]) -
+                         static_cast<UnsignedType>(pending_[i - 1]);
+      }
+      min_delta = *std::min_element(deltas_.begin(), deltas_.end());
+      UnsignedType max_delta = *std::max_element(deltas_.begin(), deltas_.end());
+      delta_width = BitWidth(max_delta - min_delta);
+    }
+
+    size_t for_size = ForBitPacking::BytesForValues(n, width);
+    size_t delta_size = kCppTypeSize + ForBitPacking::BytesForValues(n - 1, delta_width);
+    bool use_delta = delta_size < for_size;
+
+    size_t offset = buf_.size();
+    size_t header_size = kCppTypeSize + 1 + (use_delta ? kCppTypeSize : 0);
+    size_t packed_size = use_delta ? delta_size - kCppTypeSize : for_size;
+    // Leave room (zeroed) for the packer's word-at-a-time stores, and trim
+    // it off again afterwards.
+    buf_.resize(offset + header_size + packed_size + kForBlockTrailingPadding);
+    uint8_t* dst = &buf_[offset];
+    memset(dst, 0, buf_.size() - offset);
+    if (use_delta) {
+      UnsignedType first = static_cast<UnsignedType>(pending_[0]);
+      memcpy(dst, &first, kCppTypeSize);
+      dst[kCppTypeSize] = delta_width | kForDeltaFlag;
+      memcpy(dst + kCppTypeSize + 1, &min_delta, kCppTypeSize);
+      for (size_t i = 0; i < n - 1; i++) {
+        deltas_[i] -= min_delta;
+      }
+      ForBitPacking::Pack(&deltas_[0], n - 1, delta_width, dst + header_size);
+    } else {
+      memcpy(dst, &reference, kCppTypeSize);
+      dst[kCppTypeSize] = width;
+      deltas_.resize(n);
+      for (size_t i = 0; i < n; i++) {
+        deltas_[i] = static_cast<UnsignedType>(pending_[i]) - reference;
+      }
+      ForBitPacking::Pack(&deltas_[0], n, width, dst + header_size);
+    }
+    buf_.resize(offset + header_size + packed_size);
+
+    pending_.clear();
+  }
+
+  static int BitWidth(UnsignedType range) {
+    return range == 0 ? 0 : Bits::Log2Floor64(range) + 1;
+  }
+
+  const WriterOptions* options_;
+  faststring buf_;
+  size_t count_;
+  CppType first_key_;
+  std::vector<CppType> pending_;
+  std::vector<UnsignedType> deltas_;
+};
+
+//
+// Frame-of-reference decoder for integer types.
+//
+template<DataType IntType>
+class ForBlockDecoder : public BlockDecoder {
+ public:
+  explicit ForBlockDecoder(const Slice& slice)
+    : data_(slice),
+      parsed_(false),
+      num_elems_(0),
+      ordinal_pos_base_(0),
+      cur_idx_(0) {
+  }
+
+  virtual Status ParseHeader() OVERRIDE {
+    CHECK(!parsed_);
+
+    if (data_.size() < kForBlockHeaderSize + kForBlockTrailingPadding) {
+      return Status::Corruption(
+          strings::Substitute("not enough bytes for header: FOR block header "
+                              "size ($0) more than block size ($1)",
+                              kForBlockHeaderSize + kForBlockTrailingPadding,
+                              data_.size()));
+    }
+
+    ordinal_pos_base_ = DecodeFixed32(&data_[0]);
+    num_elems_ = DecodeFixed32(&data_[4]);
+
+    // Index the mini-blocks up front so that seeks and copies can jump
+    // straight to the mini-block holding a given position.
+    mini_blocks_.clear();
+    mini_blocks_.reserve((num_elems_ + kForMiniBlockSize - 1) / kForMiniBlockSize);
+    const uint8_t* p = data_.data() + kForBlockHeaderSize;
+    const uint8_t* limit = data_.data() + data_.size() - kForBlockTrailingPadding;
+    for (uint32_t remaining = num_elems_; remaining > 0;) {
+      uint32_t n = std::min<uint32_t>(remaining, kForMiniBlockSize);
+      if (limit - p < kCppTypeSize + 1) {
+        return Status::Corruption("FOR block truncated in mini-block header");
+      }
+      MiniBlock mb;
+      memcpy(&mb.reference, p, kCppTypeSize);
+      mb.width = p[kCppTypeSize] & ~kForDeltaFlag;
+      mb.delta = p[kCppTypeSize] & kForDeltaFlag;
+      if (mb.width > kCppTypeSize * 8) {
+        return Status::Corruption(
+            strings::Substitute("invalid FOR bit width $0 for $1-byte values",
+                                mb.width, kCppTypeSize));
+      }
+      mb.packed = p + kCppTypeSize + 1;
+      mb.min_delta = 0;
+      size_t num_packed = n;
+      if (mb.delta) {
+        if (limit - mb.packed < kCppTypeSize) {
+          return Status::Corruption("FOR block truncated in mini-block header");
+        }
+        memcpy(&mb.min_delta, mb.packed, kCppTypeSize);
+        mb.packed += kCppTypeSize;
+        num_packed = n - 1;
+      }
+      p = mb.packed + ForBitPacking::BytesForValues(num_packed, mb.width);
+      if (p > limit) {
+        return Status::Corruption("FOR block truncated in mini-block data");
+      }
+      mini_blocks_.push_back(mb);
+      remaining -= n;
+    }
+
+    parsed_ = true;
+    cur_idx_ = 0;
+    return Status::OK();
+  }
+
+  virtual void SeekToPositionInBlock(uint pos) OVERRIDE {
+    CHECK(parsed_) << "Must call ParseHeader()";
+
+    // In a nullable column, a block may hold no values at all, or the rows
+    // after 'pos' may all be NULL.
+    if (PREDICT_FALSE(num_elems_ == 0)) {
+      DCHECK_EQ(0, pos);
+      return;
+    }
+
+    DCHECK_LE(pos, num_elems_);
+    cur_idx_ = pos;
+  }
+
+  virtual Status SeekAtOrAfterValue(const void *value_void, bool *exact_match) OVERRIDE {
+    DCHECK(parsed_);
+    const CppType target = *reinterpret_cast<const CppType *>(value_void);
+
+    // Values within a key column are sorted, and decoding a single value is
+    // cheap, so binary search as PlainBlockDecoder does.
+    uint32_t left = 0;
+    uint32_t right = num_elems_;
+    while (left != right) {
+      uint32_t mid = (left + right) / 2;
+      CppType mid_key = ValueAt(mid);
+      if (mid_key < target) {
+        left = mid + 1;
+      } else if (mid_key > target) {
+        right = mid;
+      } else {
+        cur_idx_ = mid;
+        *exact_match = true;
+        return Status::OK();
+      }
+    }
+
+    *exact_match = false;
+    cur_idx_ = left;
+    if (cur_idx_ == num_elems_) {
+      return Status::NotFound("after last key in block");
+    }
+    return Status::OK();
+  }
+
+  virtual Status CopyNextValues(size_t *n, ColumnDataView *dst) OVERRIDE {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    size_t to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    UnsignedType* out = reinterpret_cast<UnsignedType*>(dst->data());
+    size_t remaining = to_fetch;
+    while (remaining > 0) {
+      const MiniBlock& mb = mini_blocks_[cur_idx_ / kForMiniBlockSize];
+      size_t idx_in_mb = cur_idx_ % kForMiniBlockSize;
+      size_t run = std::min(remaining, kForMiniBlockSize - idx_in_mb);
+      DecodeMiniBlock(mb, idx_in_mb, run, out);
+      out += run;
+      cur_idx_ += run;
+      remaining -= run;
+    }
+
+    *n = to_fetch;
+    return Status::OK();
+  }
+
+  virtual bool HasNext() const OVERRIDE {
+    return cur_idx_ < num_elems_;
+  }
+
+  virtual size_t Count() const OVERRIDE {
+    return num_elems_;
+  }
+
+  virtual size_t GetCurrentIndex() const OVERRIDE {
+    return cur_idx_;
+  }
+
+  virtual rowid_t GetFirstRowId() const OVERRIDE {
+    return ordinal_pos_base_;
+  }
+
+  virtual size_t memory_footprint() const OVERRIDE {
+    return kudu_malloc_usable_size(this) + mini_blocks_.capacity() * sizeof(MiniBlock);
+  }
+
+ private:
+  typedef typename TypeTraits<IntType>::cpp_type CppType;
+  typedef typename MathLimits<CppType>::UnsignedType UnsignedType;
+
+  enum {
+    kCppTypeSize = TypeTraits<IntType>::size
+  };
+
+  struct MiniBlock {
+    // The minimum value, or the first value for delta mini-blocks.
+    UnsignedType reference;
+    // The minimum delta for delta mini-blocks.
+    UnsignedType min_delta;
+    uint8_t width;
+    bool delta;
+    const uint8_t* packed;
+  };
+
+  // Decode 'n' values of 'mb' starting at index 'start' into 'out'.
+  static void DecodeMiniBlock(const MiniBlock& mb, size_t start, size_t n,
+                              UnsignedType* out) {
+    if (!mb.delta) {
+      ForBitPacking::Unpack(mb.packed, mb.width, mb.reference, start, n, out);
+      return;
+    }
+    // Delta mini-blocks have to be summed from their first value.
+    UnsignedType deltas[kForMiniBlockSize];
+    size_t num_deltas = start + n - 1;
+    ForBitPacking::Unpack(mb.packed, mb.width, mb.min_delta, 0, num_deltas, deltas);
+    UnsignedType val = mb.reference;
+    for (size_t i = 0; i < start; i++) {
+      val += deltas[i];
+    }
+    out[0] = val;
+    for (size_t i = 1; i < n; i++) {
+      val += deltas[start + i - 1];
+      out[i] = val;
+    }
+  }
+
+  CppType ValueAt(uint32_t idx) const {
+    UnsignedType val;
+    DecodeMiniBlock(mini_blocks_[idx / kForMiniBlockSize], idx % kForMiniBlockSize, 1, &val);
+    return static_cast<CppType>(val);
+  }
+
+  Slice data_;
+  bool parsed_;
+  uint32_t num_elems_;
+  rowid_t ordinal_pos_base_;
+  size_t cur_idx_;
+  std::vector<MiniBlock> mini_blocks_;
+};
+
+} // namespace cfile
+} // namespace kudu
+
+#endif // KUDU_CFILE_FOR_BLOCK_H
@@ -265,7 +265,8 @@ Status IndexTreeIterator::LoadBlock(const BlockPointer &block, int depth) {
     seeked = &seeked_indexes_.back();
   }
 
-  RETURN_NOT_OK(reader_->ReadBlock(block, CFileReader::CACHE_BLOCK, &seeked->data));
+  RETURN_NOT_OK(reader_->ReadBlock(block, CFileReader::CACHE_BLOCK, &seeked->data,
+                                   BlockCache::HIGH_PRIORITY));
   seeked->block_ptr = block;
 
   // Parse the new block.
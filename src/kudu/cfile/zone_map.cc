@@ -0,0 +1,211 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kudu/cfile/zone_map.h"
+
+#include <glog/logging.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "kudu/common/scan_predicate.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/slice.h"
+
+namespace kudu {
+namespace cfile {
+
+// Large enough to hold any fixed-width cell.
+static const size_t kMaxCellSize = 16;
+
+ZoneMapBuilder::ZoneMapBuilder(const TypeInfo* type_info)
+  : type_info_(type_info),
+    is_binary_(type_info->physical_type() == BINARY),
+    has_values_(false),
+    has_nulls_(false) {
+  DCHECK(SupportsType(type_info));
+}
+
+bool ZoneMapBuilder::SupportsType(const TypeInfo* type_info) {
+  switch (type_info->physical_type()) {
+    case FLOAT:
+    case DOUBLE:
+      return false;
+    default:
+      return type_info->physical_type() == BINARY ||
+          type_info->size() <= kMaxCellSize;
+  }
+}
+
+void ZoneMapBuilder::AddCells(const void* cells, size_t count) {
+  const uint8_t* ptr = reinterpret_cast<const uint8_t*>(cells);
+  for (size_t i = 0; i < count; i++) {
+    AddCell(ptr);
+    ptr += type_info_->size();
+  }
+}
+
+void ZoneMapBuilder::AddCell(const void* cell) {
+  if (PREDICT_FALSE(!has_values_)) {
+    CopyCellToBuffer(cell, &min_);
+    CopyCellToBuffer(cell, &max_);
+    has_values_ = true;
+    return;
+  }
+
+  Slice tmp;
+  if (type_info_->Compare(cell, CellFromBuffer(min_, &tmp)) < 0) {
+    CopyCellToBuffer(cell, &min_);
+  } else if (type_info_->Compare(cell, CellFromBuffer(max_, &tmp)) > 0) {
+    CopyCellToBuffer(cell, &max_);
+  }
+}
+
+void ZoneMapBuilder::Merge(const ZoneMapBuilder& other) {
+  DCHECK_EQ(type_info_, other.type_info_);
+  has_nulls_ |= other.has_nulls_;
+  if (other.has_values_) {
+    Slice tmp;
+    AddCell(other.CellFromBuffer(other.min_, &tmp));
+    AddCell(other.CellFromBuffer(other.max_, &tmp));
+  }
+}
+
+void ZoneMapBuilder::ToPB(ZoneMapPB* pb) const {
+  pb->Clear();
+  pb->set_has_values(has_values_);
+  pb->set_has_nulls(has_nulls_);
+  if (has_values_) {
+    pb->set_min_value(min_.data(), min_.size());
+    pb->set_max_value(max_.data(), max_.size());
+  }
+}
+
+void ZoneMapBuilder::Reset() {
+  has_values_ = false;
+  has_nulls_ = false;
+  min_.clear();
+  max_.clear();
+}
+
+const void* ZoneMapBuilder::CellFromBuffer(const faststring& buf, Slice* tmp) const {
+  if (is_binary_) {
+    *tmp = Slice(buf);
+    return tmp;
+  }
+  return buf.data();
+}
+
+void ZoneMapBuilder::CopyCellToBuffer(const void* cell, faststring* buf) const {
+  buf->clear();
+  if (is_binary_) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    buf->append(s->data(), s->size());
+  } else {
+    buf->append(cell, type_info_->size());
+  }
+}
+
+// Decode a cell stored in a ZoneMapPB into 'storage'. Returns a pointer to
+// the decoded cell, or NULL if the stored value does not fit the type.
+static const void* DecodeCell(const TypeInfo* type_info,
+                              const std::string& value,
+                              uint64_t* storage,
+                              Slice* slice) {
+  if (type_info->physical_type() == BINARY) {
+    *slice = Slice(value);
+    return slice;
+  }
+  if (PREDICT_FALSE(value.size() != type_info->size() ||
+                    value.size() > kMaxCellSize)) {
+    return NULL;
+  }
+  memcpy(storage, value.data(), value.size());
+  return storage;
+}
+
+bool ZoneMapMayMatch(const TypeInfo* type_info,
+                     const ZoneMapPB& zone_map,
+                     const ValueRange& range) {
+  // Range predicates never match nulls, so a zone map without any
+  // non-null values cannot match.
+  if (!zone_map.has_values()) {
+    return false;
+  }
+
+  uint64_t min_storage[kMaxCellSize / sizeof(uint64_t)];
+  uint64_t max_storage[kMaxCellSize / sizeof(uint64_t)];
+  Slice min_slice, max_slice;
+  const void* min_cell = DecodeCell(type_info, zone_map.min_value(), min_storage, &min_slice);
+  const void* max_cell = DecodeCell(type_info, zone_map.max_value(), max_storage, &max_slice);
+  if (PREDICT_FALSE(min_cell == NULL || max_cell == NULL)) {
+    return true;
+  }
+
+  if (range.has_upper_bound() &&
+      type_info->Compare(min_cell, range.upper_bound()) > 0) {
+    return false;
+  }
+  if (range.has_lower_bound() &&
+      type_info->Compare(max_cell, range.lower_bound()) < 0) {
+    return false;
+  }
+  return true;
+}
+
+bool ZoneMapMayMatch(const TypeInfo* type_info,
+                     const ZoneMapPB& zone_map,
+                     const ColumnRangePredicate& pred) {
+  switch (pred.predicate_type()) {
+    case ColumnRangePredicate::IS_NULL:
+      return zone_map.has_nulls();
+    case ColumnRangePredicate::IS_NOT_NULL:
+      return zone_map.has_values();
+    case ColumnRangePredicate::RANGE:
+      return ZoneMapMayMatch(type_info, zone_map, pred.range());
+    case ColumnRangePredicate::IN_LIST:
+      break;
+  }
+
+  if (!ZoneMapMayMatch(type_info, zone_map, pred.range())) {
+    return false;
+  }
+
+  // Look for the smallest listed value at or above the zone's minimum, and
+  // check that it doesn't exceed the zone's maximum.
+  uint64_t min_storage[kMaxCellSize / sizeof(uint64_t)];
+  uint64_t max_storage[kMaxCellSize / sizeof(uint64_t)];
+  Slice min_slice, max_slice;
+  const void* min_cell = DecodeCell(type_info, zone_map.min_value(), min_storage, &min_slice);
+  const void* max_cell = DecodeCell(type_info, zone_map.max_value(), max_storage, &max_slice);
+  if (PREDICT_FALSE(min_cell == NULL || max_cell == NULL)) {
+    return true;
+  }
+  const std::vector<const void*>& values = pred.in_list_values();
+  int lo = 0;
+  int hi = values.size();
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (type_info->Compare(values[mid], min_cell) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < values.size() && type_info->Compare(values[lo], max_cell) <= 0;
+}
+
+} // namespace cfile
+} // namespace kudu
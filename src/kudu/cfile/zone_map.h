@@ -0,0 +1,99 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef KUDU_CFILE_ZONE_MAP_H
+#define KUDU_CFILE_ZONE_MAP_H
+
+#include <stddef.h>
+
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+
+namespace kudu {
+
+class Slice;
+class TypeInfo;
+class ColumnRangePredicate;
+class ValueRange;
+
+namespace cfile {
+
+// Accumulates the min/max statistics (a "zone map") of a set of cells.
+//
+// The CFileWriter keeps one of these for the data block being built and
+// one for the whole file.
+class ZoneMapBuilder {
+ public:
+  explicit ZoneMapBuilder(const TypeInfo* type_info);
+
+  // Return true if zone maps may be built for cells of the given type.
+  //
+  // Floating point types are excluded: NaN does not have a well-defined
+  // ordering with respect to TypeInfo::Compare().
+  static bool SupportsType(const TypeInfo* type_info);
+
+  // Add 'count' contiguous cells, as passed to CFileWriter::AppendEntries().
+  void AddCells(const void* cells, size_t count);
+
+  // Note that at least one null value was present.
+  void AddNulls() { has_nulls_ = true; }
+
+  // Merge the statistics from 'other' into this builder.
+  void Merge(const ZoneMapBuilder& other);
+
+  void ToPB(ZoneMapPB* pb) const;
+
+  void Reset();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ZoneMapBuilder);
+
+  void AddCell(const void* cell);
+
+  // Return a pointer to the cell stored in 'buf'. For binary types, 'tmp'
+  // is used to hold a Slice pointing at the buffer.
+  const void* CellFromBuffer(const faststring& buf, Slice* tmp) const;
+
+  void CopyCellToBuffer(const void* cell, faststring* buf) const;
+
+  const TypeInfo* type_info_;
+  const bool is_binary_;
+
+  bool has_values_;
+  bool has_nulls_;
+
+  // The min/max cells. Fixed-width types hold the cell itself, while
+  // binary types hold the referenced bytes.
+  faststring min_;
+  faststring max_;
+};
+
+// Return false if no non-null cell described by 'zone_map' can fall within
+// 'range'. A return value of true means the range may (but need not) match.
+//
+// Zone maps which cannot be interpreted for 'type_info' conservatively
+// return true.
+bool ZoneMapMayMatch(const TypeInfo* type_info,
+                     const ZoneMapPB& zone_map,
+                     const ValueRange& range);
+
+// Return false if no cell described by 'zone_map' can pass 'pred'. Unlike the
+// ValueRange overload, this also handles IN-list and IS [NOT] NULL predicates.
+bool ZoneMapMayMatch(const TypeInfo* type_info,
+                     const ZoneMapPB& zone_map,
+                     const ColumnRangePredicate& pred);
+
+} // namespace cfile
+} // namespace kudu
+#endif
@@ -26,6 +26,7 @@
 #include "kudu/client/client.h"
 #include "kudu/client/client-internal.h"
 #include "kudu/client/client-test-util.h"
+#include "kudu/client/columnar_batch.h"
 #include "kudu/client/meta_cache.h"
 #include "kudu/client/row_result.h"
 #include "kudu/client/scanner-internal.h"
@@ -51,6 +52,7 @@
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/ts_tablet_manager.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/status.h"
@@ -795,6 +797,156 @@ TEST_F(ClientTest, TestScanPredicateKeyColNotProjected) {
   ASSERT_EQ(nrows, 6);
 }
 
+// Test aggregates evaluated by the tablet servers, and merged across the
+// table's two tablets.
+TEST_F(ClientTest, TestScanAggregates) {
+  const int kNumRows = FLAGS_test_scan_num_rows;
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), kNumRows));
+
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::COUNT, ""));
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::SUM, "int_val"));
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::MIN, "string_val"));
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::MAX, "key"));
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewComparisonPredicate("key", KuduPredicate::GREATER_EQUAL,
+                                                        KuduValue::FromInt(5))));
+    ASSERT_OK(scanner.Open());
+
+    vector<KuduRowResult> rows;
+    ASSERT_OK(scanner.GetAggregateResults(&rows));
+    ASSERT_EQ(1, rows.size());
+    int64_t sum = 0;
+    for (int i = 5; i < kNumRows; i++) {
+      sum += i * 2;
+    }
+    ASSERT_EQ(strings::Substitute("(int64 count(*)=$0, int64 sum(int_val)=$1, "
+                         "string min(string_val)=hello 10, int32 max(key)=$2)",
+                         kNumRows - 5, sum, kNumRows - 1),
+              rows[0].ToString());
+  }
+
+  // Group by the key, across both tablets.
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::COUNT, "string_val"));
+    ASSERT_OK(scanner.SetGroupByKeyPrefix(1));
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewComparisonPredicate("key", KuduPredicate::GREATER_EQUAL,
+                                                        KuduValue::FromInt(7))));
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewComparisonPredicate("key", KuduPredicate::LESS_EQUAL,
+                                                        KuduValue::FromInt(11))));
+    ASSERT_OK(scanner.Open());
+
+    vector<KuduRowResult> rows;
+    ASSERT_OK(scanner.GetAggregateResults(&rows));
+    ASSERT_EQ(5, rows.size());
+    for (int i = 0; i < rows.size(); i++) {
+      ASSERT_EQ(strings::Substitute("(int32 key=$0, int64 count(string_val)=1)", i + 7),
+                rows[i].ToString());
+    }
+  }
+
+  // Group by the key over many small batches, so that the groups are
+  // returned by each tablet as they finish.
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::COUNT, ""));
+    ASSERT_OK(scanner.SetGroupByKeyPrefix(1));
+    ASSERT_OK(scanner.SetBatchSizeBytes(100));
+    ASSERT_OK(scanner.Open());
+
+    vector<KuduRowResult> rows;
+    ASSERT_OK(scanner.GetAggregateResults(&rows));
+    ASSERT_EQ(kNumRows, rows.size());
+    for (int i = 0; i < rows.size(); i++) {
+      ASSERT_EQ(strings::Substitute("(int32 key=$0, int64 count(*)=1)", i),
+                rows[i].ToString());
+    }
+  }
+
+  // Aggregates must be valid for the column's type.
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.AddAggregate(KuduScanner::SUM, "string_val"));
+    Status s = scanner.Open();
+    ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  }
+}
+
+// Test a scan using the columnar layout, spread over several batches.
+TEST_F(ClientTest, TestScanColumnarLayout) {
+  const int kNumRows = FLAGS_test_scan_num_rows;
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), kNumRows));
+
+  KuduScanner scanner(client_table_.get());
+  ASSERT_OK(scanner.SetProjectedColumns(list_of<string>("key")("string_val")));
+  ASSERT_OK(scanner.SetColumnarLayout());
+  ASSERT_OK(scanner.SetBatchSizeBytes(1024));
+  ASSERT_OK(scanner.Open());
+
+  KuduColumnarBatch batch;
+  vector<int32_t> keys;
+  int num_batches = 0;
+  while (scanner.HasMoreRows()) {
+    ASSERT_OK(scanner.NextBatch(&batch));
+    num_batches++;
+    Slice key_data, offset_data, string_data, non_null_bitmap;
+    ASSERT_OK(batch.GetFixedLengthColumn(0, &key_data));
+    ASSERT_OK(batch.GetVariableLengthColumn(1, &offset_data, &string_data));
+    ASSERT_OK(batch.GetNonNullBitmapForColumn(1, &non_null_bitmap));
+    if (batch.NumRows() == 0) {
+      continue;
+    }
+    ASSERT_EQ(batch.NumRows() * sizeof(int32_t), key_data.size());
+    ASSERT_EQ((batch.NumRows() + 1) * sizeof(uint32_t), offset_data.size());
+
+    const int32_t* key_cells = reinterpret_cast<const int32_t*>(key_data.data());
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(offset_data.data());
+    for (int i = 0; i < batch.NumRows(); i++) {
+      ASSERT_TRUE(BitmapTest(non_null_bitmap.data(), i));
+      Slice str(string_data.data() + offsets[i], offsets[i + 1] - offsets[i]);
+      ASSERT_EQ(StringPrintf("hello %d", key_cells[i]), str.ToString());
+      keys.push_back(key_cells[i]);
+    }
+  }
+  ASSERT_GT(num_batches, 1);
+
+  std::sort(keys.begin(), keys.end());
+  ASSERT_EQ(kNumRows, keys.size());
+  for (int i = 0; i < kNumRows; i++) {
+    ASSERT_EQ(i, keys[i]);
+  }
+
+  // The column accessors check the type of the column.
+  Slice data, varlen_data;
+  ASSERT_TRUE(batch.GetFixedLengthColumn(1, &data).IsInvalidArgument());
+  ASSERT_TRUE(batch.GetVariableLengthColumn(0, &data, &varlen_data).IsInvalidArgument());
+  ASSERT_TRUE(batch.GetNonNullBitmapForColumn(0, &data).IsInvalidArgument());
+  ASSERT_TRUE(batch.GetFixedLengthColumn(2, &data).IsInvalidArgument());
+}
+
+// Test that a columnar scan fails, rather than dropping rows, when the
+// server responds with rows, as one which predates the columnar layout would.
+TEST_F(ClientTest, TestScanColumnarLayoutWithRowwiseResponse) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 10));
+
+  KuduScanner scanner(client_table_.get());
+  ASSERT_OK(scanner.SetColumnarLayout());
+  ASSERT_OK(scanner.Open());
+
+  // Make the last response look like it came from such a server.
+  tserver::ScanResponsePB* resp = &scanner.data_->last_response_;
+  resp->clear_columnar_data();
+  resp->mutable_data()->set_num_rows(10);
+
+  KuduColumnarBatch batch;
+  Status s = scanner.data_->ExtractColumnarBatch(&batch);
+  ASSERT_TRUE(s.IsNotSupported()) << s.ToString();
+}
+
 // Test a scan where we have a predicate on a non-key column that is
 // not in the projection.
 TEST_F(ClientTest, TestScanPredicateNonKeyColNotProjected) {
@@ -868,6 +1020,179 @@ TEST_F(ClientTest, TestInvalidPredicates) {
 }
 
 
+// Test scanning with IN-list predicates on key and non-key columns.
+TEST_F(ClientTest, TestScanInListPredicates) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 100));
+
+  vector<string> all_rows;
+  ASSERT_NO_FATAL_FAILURE(ScanTableToStrings(client_table_.get(), &all_rows));
+  ASSERT_EQ(100, all_rows.size());
+
+  // An IN-list on the key column, spanning both tablets. Duplicates and
+  // values which match no row are allowed.
+  {
+    KuduScanner scanner(client_table_.get());
+    vector<KuduValue*> values;
+    values.push_back(KuduValue::FromInt(42));
+    values.push_back(KuduValue::FromInt(5));
+    values.push_back(KuduValue::FromInt(1000));
+    values.push_back(KuduValue::FromInt(42));
+    values.push_back(KuduValue::FromInt(10));
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewInListPredicate("key", &values)));
+    ASSERT_TRUE(values.empty());
+    vector<string> rows;
+    ASSERT_NO_FATAL_FAILURE(ScanToStrings(&scanner, &rows));
+    ASSERT_EQ(3, rows.size());
+    EXPECT_EQ(all_rows[5], rows[0]);
+    EXPECT_EQ(all_rows[10], rows[1]);
+    EXPECT_EQ(all_rows[42], rows[2]);
+  }
+
+  // An IN-list on a non-key column, combined with a key range.
+  {
+    KuduScanner scanner(client_table_.get());
+    vector<KuduValue*> values;
+    values.push_back(KuduValue::FromInt(4));
+    values.push_back(KuduValue::FromInt(7));
+    values.push_back(KuduValue::FromInt(60));
+    values.push_back(KuduValue::FromInt(150));
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewInListPredicate("int_val", &values)));
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewComparisonPredicate("key", KuduPredicate::LESS_EQUAL,
+                                                        KuduValue::FromInt(50))));
+    vector<string> rows;
+    ASSERT_NO_FATAL_FAILURE(ScanToStrings(&scanner, &rows));
+    ASSERT_EQ(2, rows.size());
+    EXPECT_EQ(all_rows[2], rows[0]);
+    EXPECT_EQ(all_rows[30], rows[1]);
+  }
+
+  // An empty IN-list is rejected.
+  {
+    KuduScanner scanner(client_table_.get());
+    vector<KuduValue*> values;
+    Status s = scanner.AddConjunctPredicate(
+        client_table_->NewInListPredicate("key", &values));
+    EXPECT_EQ("Invalid argument: empty IN-list predicate on column: key", s.ToString());
+  }
+
+  // An IN-list on a column that does not exist, which also takes ownership
+  // of the values.
+  {
+    KuduScanner scanner(client_table_.get());
+    vector<KuduValue*> values;
+    values.push_back(KuduValue::FromInt(1));
+    Status s = scanner.AddConjunctPredicate(
+        client_table_->NewInListPredicate("this-does-not-exist", &values));
+    EXPECT_EQ("Not found: column not found: this-does-not-exist", s.ToString());
+    ASSERT_TRUE(values.empty());
+  }
+}
+
+// Test scanning with IS NULL, IS NOT NULL and IN-list predicates on a
+// nullable column.
+TEST_F(ClientTest, TestScanNullPredicates) {
+  // Rows [0, 10) have a non-NULL 'string_val', and rows [10, 20) leave it NULL.
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 10));
+  shared_ptr<KuduSession> session = client_->NewSession();
+  ASSERT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  session->SetTimeoutMillis(10000);
+  for (int i = 10; i < 20; i++) {
+    gscoped_ptr<KuduInsert> insert(client_table_->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt32("key", i));
+    ASSERT_OK(insert->mutable_row()->SetInt32("int_val", i * 2));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  FlushSessionOrDie(session);
+
+  vector<string> all_rows;
+  ASSERT_NO_FATAL_FAILURE(ScanTableToStrings(client_table_.get(), &all_rows));
+  ASSERT_EQ(20, all_rows.size());
+
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewIsNullPredicate("string_val")));
+    vector<string> rows;
+    ASSERT_NO_FATAL_FAILURE(ScanToStrings(&scanner, &rows));
+    ASSERT_EQ(10, rows.size());
+    EXPECT_EQ(all_rows[10], rows.front());
+    EXPECT_EQ(all_rows[19], rows.back());
+  }
+
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewIsNotNullPredicate("string_val")));
+    vector<string> rows;
+    ASSERT_NO_FATAL_FAILURE(ScanToStrings(&scanner, &rows));
+    ASSERT_EQ(10, rows.size());
+    EXPECT_EQ(all_rows[0], rows.front());
+    EXPECT_EQ(all_rows[9], rows.back());
+  }
+
+  // The predicates also apply when the column isn't projected.
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetProjectedColumns(list_of<string>("key")));
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewIsNullPredicate("string_val")));
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewComparisonPredicate("key", KuduPredicate::GREATER_EQUAL,
+                                                        KuduValue::FromInt(15))));
+    vector<string> rows;
+    ASSERT_NO_FATAL_FAILURE(ScanToStrings(&scanner, &rows));
+    ASSERT_EQ(5, rows.size());
+    EXPECT_EQ("(int32 key=15)", rows.front());
+    EXPECT_EQ("(int32 key=19)", rows.back());
+  }
+
+  // An IS NULL predicate on a non-nullable column matches nothing, and
+  // IS NOT NULL matches everything.
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewIsNullPredicate("int_val")));
+    vector<string> rows;
+    ASSERT_NO_FATAL_FAILURE(ScanToStrings(&scanner, &rows));
+    ASSERT_EQ(0, rows.size());
+  }
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewIsNotNullPredicate("int_val")));
+    vector<string> rows;
+    ASSERT_NO_FATAL_FAILURE(ScanToStrings(&scanner, &rows));
+    ASSERT_EQ(20, rows.size());
+  }
+
+  // An IN-list on the nullable column never matches the NULL rows.
+  {
+    KuduScanner scanner(client_table_.get());
+    vector<KuduValue*> values;
+    values.push_back(KuduValue::CopyString("hello 3"));
+    values.push_back(KuduValue::CopyString("hello 12"));
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  client_table_->NewInListPredicate("string_val", &values)));
+    vector<string> rows;
+    ASSERT_NO_FATAL_FAILURE(ScanToStrings(&scanner, &rows));
+    ASSERT_EQ(1, rows.size());
+    EXPECT_EQ(all_rows[3], rows[0]);
+  }
+
+  // Predicates on a column that does not exist.
+  KuduScanner scanner(client_table_.get());
+  Status s = scanner.AddConjunctPredicate(
+      client_table_->NewIsNullPredicate("this-does-not-exist"));
+  EXPECT_EQ("Not found: column not found: this-does-not-exist", s.ToString());
+  s = scanner.AddConjunctPredicate(
+      client_table_->NewIsNotNullPredicate("this-does-not-exist"));
+  EXPECT_EQ("Not found: column not found: this-does-not-exist", s.ToString());
+}
+
+
 // Check that the tserver proxy is reset on close, even for empty tables.
 TEST_F(ClientTest, TestScanCloseProxy) {
   const string kEmptyTable = "TestScanCloseProxy";
@@ -1194,6 +1519,115 @@ TEST_F(ClientTest, TestScanWithEncodedRangePredicate) {
 
 }
 
+// Scan each of 'tokens' in a scanner deserialized from the token, appending
+// the rows to 'rows'.
+static void ScanTokensToStrings(KuduClient* client, const vector<KuduScanToken*>& tokens,
+                                vector<string>* rows) {
+  BOOST_FOREACH(const KuduScanToken* token, tokens) {
+    string serialized;
+    ASSERT_OK(token->Serialize(&serialized));
+    KuduScanner* scanner_ptr;
+    ASSERT_OK(KuduScanToken::DeserializeIntoScanner(client, serialized, &scanner_ptr));
+    gscoped_ptr<KuduScanner> scanner(scanner_ptr);
+    vector<string> token_rows;
+    ASSERT_NO_FATAL_FAILURE(ScanToStrings(scanner.get(), &token_rows));
+    rows->insert(rows->end(), token_rows.begin(), token_rows.end());
+  }
+}
+
+TEST_F(ClientTest, TestScanTokens) {
+  shared_ptr<KuduTable> table;
+  ASSERT_NO_FATAL_FAILURE(CreateTable("split-table",
+                                      1, /* replicas */
+                                      GenerateSplitRows(),
+                                      &table));
+
+  // Insert the rows in batches, flushing after each, so that the tablets
+  // have several rowsets to split at.
+  const int kNumBatches = 4;
+  const int kRowsPerBatch = 250;
+  for (int i = 0; i < kNumBatches; i++) {
+    ASSERT_NO_FATAL_FAILURE(InsertTestRows(table.get(), kRowsPerBatch, i * kRowsPerBatch));
+    vector<scoped_refptr<TabletPeer> > peers;
+    cluster_->mini_tablet_server(0)->server()->tablet_manager()->GetTabletPeers(&peers);
+    BOOST_FOREACH(const scoped_refptr<TabletPeer>& peer, peers) {
+      ASSERT_OK(peer->tablet()->Flush());
+    }
+  }
+
+  vector<string> all_rows;
+  ASSERT_NO_FATAL_FAILURE(ScanTableToStrings(table.get(), &all_rows));
+  ASSERT_EQ(kNumBatches * kRowsPerBatch, all_rows.size());
+  std::sort(all_rows.begin(), all_rows.end());
+
+  // Without a target size, there is one token per tablet.
+  {
+    KuduScanner scanner(table.get());
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    ASSERT_OK(scanner.BuildScanTokens(0, &tokens));
+    ASSERT_EQ(2, tokens.size());
+    ASSERT_NE(tokens[0]->tablet_id(), tokens[1]->tablet_id());
+
+    vector<string> rows;
+    ASSERT_NO_FATAL_FAILURE(ScanTokensToStrings(client_.get(), tokens, &rows));
+    std::sort(rows.begin(), rows.end());
+    ASSERT_EQ(all_rows, rows);
+  }
+
+  // With a tiny target size, the tablets are split at their rowsets.
+  {
+    KuduScanner scanner(table.get());
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    ASSERT_OK(scanner.BuildScanTokens(1, &tokens));
+    ASSERT_GT(tokens.size(), 2);
+
+    vector<string> rows;
+    ASSERT_NO_FATAL_FAILURE(ScanTokensToStrings(client_.get(), tokens, &rows));
+    std::sort(rows.begin(), rows.end());
+    ASSERT_EQ(all_rows, rows);
+
+    // Tokens can also be turned into scanners without serializing them.
+    KuduScanner* scanner_ptr;
+    ASSERT_OK(tokens[0]->IntoKuduScanner(&scanner_ptr));
+    gscoped_ptr<KuduScanner> token_scanner(scanner_ptr);
+    vector<string> token_rows;
+    ASSERT_NO_FATAL_FAILURE(ScanToStrings(token_scanner.get(), &token_rows));
+    ASSERT_GT(token_rows.size(), 0);
+    ASSERT_LT(token_rows.size(), all_rows.size());
+  }
+
+  // The tokens carry the bounds and predicates of the scanner.
+  {
+    KuduScanner scanner(table.get());
+    gscoped_ptr<KuduPartialRow> row(table->schema().NewRow());
+    CHECK_OK(row->SetInt32(0, 5));
+    ASSERT_OK(scanner.AddLowerBound(*row));
+    ASSERT_OK(scanner.AddConjunctPredicate(
+                  table->NewComparisonPredicate("int_val", KuduPredicate::LESS_EQUAL,
+                                                KuduValue::FromInt(500))));
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    ASSERT_OK(scanner.BuildScanTokens(1, &tokens));
+
+    vector<string> rows;
+    ASSERT_NO_FATAL_FAILURE(ScanTokensToStrings(client_.get(), tokens, &rows));
+    std::sort(rows.begin(), rows.end());
+
+    KuduScanner expected_scanner(table.get());
+    ASSERT_OK(expected_scanner.AddLowerBound(*row));
+    ASSERT_OK(expected_scanner.AddConjunctPredicate(
+                  table->NewComparisonPredicate("int_val", KuduPredicate::LESS_EQUAL,
+                                                KuduValue::FromInt(500))));
+    vector<string> expected_rows;
+    ASSERT_NO_FATAL_FAILURE(ScanToStrings(&expected_scanner, &expected_rows));
+    std::sort(expected_rows.begin(), expected_rows.end());
+    ASSERT_FALSE(expected_rows.empty());
+    ASSERT_EQ(expected_rows, rows);
+  }
+}
+
 static void AssertScannersDisappear(const tserver::ScannerManager* manager) {
   // The Close call is async, so we may have to loop a bit until we see it disappear.
   // This loops for ~10sec. Typically it succeeds in only a few milliseconds.
@@ -25,6 +25,7 @@
 #include "kudu/client/callbacks.h"
 #include "kudu/client/client-internal.h"
 #include "kudu/client/client_builder-internal.h"
+#include "kudu/client/columnar_batch-internal.h"
 #include "kudu/client/error_collector.h"
 #include "kudu/client/error-internal.h"
 #include "kudu/client/meta_cache.h"
@@ -43,6 +44,7 @@
 #include "kudu/common/row_operations.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/master.h" // TODO: remove this include - just needed for default port
 #include "kudu/master/master.pb.h"
@@ -82,7 +84,7 @@ MAKE_ENUM_LIMITS(kudu::client::KuduSession::FlushMode,
 
 MAKE_ENUM_LIMITS(kudu::client::KuduScanner::ReadMode,
                  kudu::client::KuduScanner::READ_LATEST,
-                 kudu::client::KuduScanner::READ_AT_SNAPSHOT);
+                 kudu::client::KuduScanner::READ_WITH_BOUNDED_STALENESS);
 
 MAKE_ENUM_LIMITS(kudu::client::KuduScanner::OrderMode,
                  kudu::client::KuduScanner::UNORDERED,
@@ -573,6 +575,48 @@ KuduPredicate* KuduTable::NewComparisonPredicate(const Slice& col_name,
   return new KuduPredicate(new ComparisonPredicateData(s->column(col_idx), op, value));
 }
 
+KuduPredicate* KuduTable::NewInListPredicate(const Slice& col_name,
+                                             vector<KuduValue*>* values) {
+  // We always take ownership of the values, even on error.
+  ElementDeleter deleter(values);
+  StringPiece name_sp(reinterpret_cast<const char*>(col_name.data()), col_name.size());
+  const Schema* s = data_->schema_.schema_;
+  int col_idx = s->find_column(name_sp);
+  if (col_idx == Schema::kColumnNotFound) {
+    return new KuduPredicate(new ErrorPredicateData(
+                                 Status::NotFound("column not found", col_name)));
+  }
+  if (values->empty()) {
+    return new KuduPredicate(new ErrorPredicateData(
+                                 Status::InvalidArgument("empty IN-list predicate on column",
+                                                         col_name)));
+  }
+
+  return new KuduPredicate(new InListPredicateData(s->column(col_idx), values));
+}
+
+KuduPredicate* KuduTable::NewIsNullPredicate(const Slice& col_name) {
+  StringPiece name_sp(reinterpret_cast<const char*>(col_name.data()), col_name.size());
+  const Schema* s = data_->schema_.schema_;
+  int col_idx = s->find_column(name_sp);
+  if (col_idx == Schema::kColumnNotFound) {
+    return new KuduPredicate(new ErrorPredicateData(
+                                 Status::NotFound("column not found", col_name)));
+  }
+  return new KuduPredicate(new NullPredicateData(s->column(col_idx), true));
+}
+
+KuduPredicate* KuduTable::NewIsNotNullPredicate(const Slice& col_name) {
+  StringPiece name_sp(reinterpret_cast<const char*>(col_name.data()), col_name.size());
+  const Schema* s = data_->schema_.schema_;
+  int col_idx = s->find_column(name_sp);
+  if (col_idx == Schema::kColumnNotFound) {
+    return new KuduPredicate(new ErrorPredicateData(
+                                 Status::NotFound("column not found", col_name)));
+  }
+  return new KuduPredicate(new NullPredicateData(s->column(col_idx), false));
+}
+
 ////////////////////////////////////////////////////////////
 // Error
 ////////////////////////////////////////////////////////////
@@ -877,6 +921,14 @@ Status KuduScanner::SetSnapshotRaw(uint64_t snapshot_timestamp) {
   return Status::OK();
 }
 
+Status KuduScanner::SetMaxStalenessMillis(uint32_t max_staleness_ms) {
+  if (data_->open_) {
+    return Status::IllegalState("Maximum staleness must be set before Open()");
+  }
+  data_->max_staleness_ms_ = max_staleness_ms;
+  return Status::OK();
+}
+
 Status KuduScanner::SetSelection(KuduClient::ReplicaSelection selection) {
   if (data_->open_) {
     return Status::IllegalState("Replica selection must be set before Open()");
@@ -956,6 +1008,88 @@ Status KuduScanner::SetCacheBlocks(bool cache_blocks) {
   return Status::OK();
 }
 
+Status KuduScanner::SetColumnarLayout() {
+  if (data_->open_) {
+    return Status::IllegalState("Columnar layout must be set before Open()");
+  }
+  data_->columnar_layout_ = true;
+  return Status::OK();
+}
+
+Status KuduScanner::AddAggregate(AggregateFunction function, const string& col_name) {
+  if (data_->open_) {
+    return Status::IllegalState("Aggregates must be added before Open()");
+  }
+
+  AggregatePB agg;
+  switch (function) {
+    case COUNT: agg.set_function(AggregatePB::COUNT); break;
+    case SUM: agg.set_function(AggregatePB::SUM); break;
+    case MIN: agg.set_function(AggregatePB::MIN); break;
+    case MAX: agg.set_function(AggregatePB::MAX); break;
+    default: return Status::InvalidArgument("Unknown aggregate function");
+  }
+
+  if (!col_name.empty()) {
+    if (data_->table_->schema().schema_->find_column(col_name) == Schema::kColumnNotFound) {
+      return Status::NotFound(strings::Substitute("Column: \"$0\" was not found in the "
+          "table schema.", col_name));
+    }
+    agg.set_column(col_name);
+  } else if (function != COUNT) {
+    return Status::InvalidArgument("Only COUNT may be computed without a column");
+  }
+  data_->aggregates_.push_back(agg);
+  return Status::OK();
+}
+
+Status KuduScanner::SetGroupByKeyPrefix(int num_key_columns) {
+  if (data_->open_) {
+    return Status::IllegalState("Group-by columns must be set before Open()");
+  }
+  int max_columns = data_->table_->schema().schema_->num_key_columns();
+  if (num_key_columns < 0 || num_key_columns > max_columns) {
+    return Status::InvalidArgument(strings::Substitute(
+        "Cannot group by $0 key columns: the table has $1", num_key_columns, max_columns));
+  }
+  data_->group_by_key_prefix_ = num_key_columns;
+  return Status::OK();
+}
+
+Status KuduScanner::GetAggregateResults(vector<KuduRowResult>* rows) {
+  CHECK(data_->open_);
+  if (data_->aggregates_.empty()) {
+    return Status::IllegalState("The scanner has no aggregates");
+  }
+  rows->clear();
+
+  if (!data_->aggregate_merger_) {
+    gscoped_ptr<ScanAggregator> merger(new ScanAggregator);
+    RETURN_NOT_OK(merger->Init(*data_->table_->schema().schema_,
+                               data_->GroupByColumnNames(),
+                               data_->aggregates_));
+    vector<KuduRowResult> batch;
+    while (HasMoreRows()) {
+      RETURN_NOT_OK(NextBatch(&batch));
+      BOOST_FOREACH(const KuduRowResult& partial, batch) {
+        merger->MergePartialRow(ConstContiguousRow(data_->aggregate_schema_, partial.row_data_));
+      }
+    }
+    size_t row_size = ContiguousRowHelper::row_size(merger->result_schema());
+    data_->aggregate_rows_.resize(row_size * merger->num_groups());
+    merger->ExportResults(data_->aggregate_rows_.data(), &data_->arena_);
+    data_->aggregate_merger_.swap(merger);
+  }
+
+  const ScanAggregator& merger = *data_->aggregate_merger_;
+  size_t row_size = ContiguousRowHelper::row_size(merger.result_schema());
+  rows->resize(merger.num_groups());
+  for (int i = 0; i < merger.num_groups(); i++) {
+    (*rows)[i].Init(&merger.result_schema(), data_->aggregate_rows_.data() + i * row_size);
+  }
+  return Status::OK();
+}
+
 namespace {
 // Callback for the RPC sent by Close().
 // We can't use the KuduScanner response and RPC controller members for this
@@ -975,6 +1109,14 @@ struct CloseCallback {
 };
 } // anonymous namespace
 
+Status KuduScanner::BuildScanTokens(uint64_t target_chunk_size_bytes,
+                                    vector<KuduScanToken*>* tokens) {
+  if (data_->open_) {
+    return Status::IllegalState("Scan tokens must be built before Open()");
+  }
+  return data_->BuildScanTokens(target_chunk_size_bytes, tokens);
+}
+
 string KuduScanner::ToString() const {
   Slice start_key = data_->spec_.lower_bound_key() ?
     data_->spec_.lower_bound_key()->encoded_key() : Slice("INF");
@@ -988,8 +1130,19 @@ Status KuduScanner::Open() {
   CHECK(!data_->open_) << "Scanner already open";
   CHECK(data_->projection_ != NULL) << "No projection provided";
 
+  if (!data_->aggregates_.empty()) {
+    if (data_->is_fault_tolerant_) {
+      return Status::InvalidArgument("Aggregates cannot be used in fault-tolerant scans");
+    }
+    if (data_->columnar_layout_) {
+      return Status::InvalidArgument("Aggregates cannot be used with the columnar layout");
+    }
+    RETURN_NOT_OK(data_->SetupAggregateProjection());
+    data_->aggregate_merger_.reset();
+  }
+
   // Find the first tablet.
-  data_->spec_encoder_.EncodeRangePredicates(&data_->spec_, false);
+  data_->PrepareKeyRanges();
 
   VLOG(1) << "Beginning scan " << ToString();
 
@@ -997,10 +1150,8 @@ Status KuduScanner::Open() {
   deadline.AddDelta(data_->timeout_);
   set<string> blacklist;
 
-  bool is_simple_range_partitioned =
-    data_->table_->partition_schema().IsSimplePKRangePartitioning(*data_->table_->schema().schema_);
-
-  if (!is_simple_range_partitioned &&
+  if (!data_->table_->partition_schema().IsSimplePKRangePartitioning(
+          *data_->table_->schema().schema_) &&
       (data_->spec_.lower_bound_key() != NULL ||
        data_->spec_.exclusive_upper_bound_key() != NULL ||
        !data_->spec_.predicates().empty())) {
@@ -1008,31 +1159,6 @@ Status KuduScanner::Open() {
                                 "automatically optimized with partition pruning.";
   }
 
-  if (is_simple_range_partitioned) {
-    // If the table is simple range partitioned, then the partition key space is
-    // isomorphic to the primary key space. We can potentially reduce the scan
-    // length by only scanning the intersection of the primary key range and the
-    // partition key range. This is a stop-gap until real partition pruning is
-    // in place that will work across any partition type.
-    Slice start_primary_key = data_->spec_.lower_bound_key() == NULL ? Slice()
-                            : data_->spec_.lower_bound_key()->encoded_key();
-    Slice end_primary_key = data_->spec_.exclusive_upper_bound_key() == NULL ? Slice()
-                          : data_->spec_.exclusive_upper_bound_key()->encoded_key();
-    Slice start_partition_key = data_->spec_.lower_bound_partition_key();
-    Slice end_partition_key = data_->spec_.exclusive_upper_bound_partition_key();
-
-    if ((!end_partition_key.empty() && start_primary_key.compare(end_partition_key) >= 0) ||
-        (!end_primary_key.empty() && start_partition_key.compare(end_primary_key) >= 0)) {
-      // The primary key range and the partition key range do not intersect;
-      // the scan will be empty. Keep the existing partition key range.
-    } else {
-      // Assign the scan's partition key range to the intersection of the
-      // primary key and partition key ranges.
-      data_->spec_.SetLowerBoundPartitionKey(start_primary_key);
-      data_->spec_.SetExclusiveUpperBoundPartitionKey(end_primary_key);
-    }
-  }
-
   RETURN_NOT_OK(data_->OpenTablet(data_->spec_.lower_bound_partition_key(), deadline, &blacklist));
 
   data_->open_ = true;
@@ -1077,6 +1203,30 @@ bool KuduScanner::HasMoreRows() const {
 }
 
 Status KuduScanner::NextBatch(vector<KuduRowResult>* rows) {
+  CHECK(!data_->columnar_layout_) << "Columnar scans must use NextBatch(KuduColumnarBatch*)";
+  rows->clear();
+
+  bool has_response;
+  RETURN_NOT_OK(FetchNextResponse(&has_response));
+  if (has_response) {
+    return data_->ExtractRows(rows);
+  }
+  return Status::OK();
+}
+
+Status KuduScanner::NextBatch(KuduColumnarBatch* batch) {
+  CHECK(data_->columnar_layout_) << "Scanner not set up with SetColumnarLayout()";
+  batch->data_->Clear();
+
+  bool has_response;
+  RETURN_NOT_OK(FetchNextResponse(&has_response));
+  if (has_response) {
+    return data_->ExtractColumnarBatch(batch);
+  }
+  return Status::OK();
+}
+
+Status KuduScanner::FetchNextResponse(bool* has_response) {
   // TODO: do some double-buffering here -- when we return this batch
   // we should already have fired off the RPC for the next batch, but
   // need to do some swapping of the response objects around to avoid
@@ -1084,13 +1234,14 @@ Status KuduScanner::NextBatch(vector<KuduRowResult>* rows) {
   CHECK(data_->open_);
   CHECK(data_->proxy_);
 
-  rows->clear();
+  *has_response = false;
 
   if (data_->data_in_open_) {
     // We have data from a previous scan.
     VLOG(1) << "Extracting data from scan " << ToString();
     data_->data_in_open_ = false;
-    return data_->ExtractRows(rows);
+    *has_response = true;
+    return Status::OK();
   } else if (data_->last_response_.has_more_results()) {
     // More data is available in this tablet.
     VLOG(1) << "Continuing scan " << ToString();
@@ -1129,7 +1280,8 @@ Status KuduScanner::NextBatch(vector<KuduRowResult>* rows) {
         data_->last_primary_key_ = data_->last_response_.last_primary_key();
       }
       data_->scan_attempts_ = 0;
-      return data_->ExtractRows(rows);
+      *has_response = true;
+      return Status::OK();
     }
 
     data_->scan_attempts_++;
@@ -1183,6 +1335,45 @@ Status KuduScanner::GetCurrentServer(KuduTabletServer** server) {
   return Status::OK();
 }
 
+////////////////////////////////////////////////////////////
+// KuduScanToken
+////////////////////////////////////////////////////////////
+
+KuduScanToken::KuduScanToken(KuduScanToken::Data* data)
+  : data_(data) {
+}
+
+KuduScanToken::~KuduScanToken() {
+  delete data_;
+}
+
+Status KuduScanToken::IntoKuduScanner(KuduScanner** scanner) const {
+  return KuduScanToken::Data::IntoKuduScanner(data_->table_, data_->pb_, scanner);
+}
+
+const string& KuduScanToken::tablet_id() const {
+  return data_->pb_.scan().tablet_id();
+}
+
+Status KuduScanToken::Serialize(string* buf) const {
+  if (!data_->pb_.SerializeToString(buf)) {
+    return Status::Corruption("Unable to serialize scan token");
+  }
+  return Status::OK();
+}
+
+Status KuduScanToken::DeserializeIntoScanner(KuduClient* client,
+                                             const string& serialized_token,
+                                             KuduScanner** scanner) {
+  tserver::ScanTokenPB pb;
+  if (!pb.ParseFromString(serialized_token)) {
+    return Status::Corruption("Unable to deserialize scan token");
+  }
+  shared_ptr<KuduTable> table;
+  RETURN_NOT_OK(client->OpenTable(pb.table_name(), &table));
+  return KuduScanToken::Data::IntoKuduScanner(table, pb, scanner);
+}
+
 KuduTabletServer::KuduTabletServer()
   : data_(NULL) {
 }
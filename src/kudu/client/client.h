@@ -45,8 +45,10 @@ class TsAdminClient;
 
 namespace client {
 
+class KuduColumnarBatch;
 class KuduLoggingCallback;
 class KuduRowResult;
+class KuduScanToken;
 class KuduSession;
 class KuduStatusCallback;
 class KuduTable;
@@ -415,6 +417,26 @@ class KUDU_EXPORT KuduTable : public std::tr1::enable_shared_from_this<KuduTable
                                         KuduPredicate::ComparisonOp op,
                                         KuduValue* value);
 
+  // Create a new IN-list predicate, which passes rows whose value for the
+  // given column is equal to any of 'values'.
+  //
+  // As with NewComparisonPredicate(), the type of each value must correspond
+  // to the type of the column. The returned predicate takes ownership of the
+  // elements of 'values', and 'values' is cleared. An empty list is an error.
+  //
+  // An IN-list on a primary key column allows the tablet servers to seek
+  // directly to each of the listed keys rather than scanning between them.
+  KuduPredicate* NewInListPredicate(const Slice& col_name,
+                                    std::vector<KuduValue*>* values);
+
+  // Create a new predicate which passes only rows where the given column
+  // is NULL.
+  KuduPredicate* NewIsNullPredicate(const Slice& col_name);
+
+  // Create a new predicate which passes only rows where the given column
+  // is not NULL.
+  KuduPredicate* NewIsNotNullPredicate(const Slice& col_name);
+
   KuduClient* client() const;
 
   const PartitionSchema& partition_schema() const;
@@ -807,7 +829,18 @@ class KUDU_EXPORT KuduScanner {
     // checked by the server. The second one, if defined, is the actual snapshot
     // read time. When selecting both, the latter must be lower than or equal to
     // the former.
-    READ_AT_SNAPSHOT
+    READ_AT_SNAPSHOT,
+
+    // When READ_WITH_BOUNDED_STALENESS is specified the server performs a
+    // snapshot read at a timestamp of its choosing, no further in the past than
+    // the bound set with SetMaxStalenessMillis(). Unlike READ_AT_SNAPSHOT, this
+    // doesn't wait for in-flight transactions, and may be served by any replica
+    // whose safe time is recent enough, so it scales reads across followers. A
+    // replica which has fallen too far behind rejects the scan, which is then
+    // retried at another replica. The chosen snapshot timestamp is returned
+    // like that of READ_AT_SNAPSHOT scans, and a fault-tolerant scan resumes at
+    // that snapshot.
+    READ_WITH_BOUNDED_STALENESS
   };
 
   // Whether the rows should be returned in order. This affects the fault-tolerance properties
@@ -825,6 +858,15 @@ class KUDU_EXPORT KuduScanner {
     ORDERED
   };
 
+  // Aggregate functions which may be evaluated by the tablet servers.
+  // See AddAggregate().
+  enum AggregateFunction {
+    COUNT,
+    SUM,
+    MIN,
+    MAX
+  };
+
   // Default scanner timeout.
   // This is set to 3x the default RPC timeout (see KuduClientBuilder::default_rpc_timeout()).
   enum { kScanTimeoutMillis = 15000 };
@@ -890,6 +932,38 @@ class KUDU_EXPORT KuduScanner {
   // in memory and made available for future scans. Default is true.
   Status SetCacheBlocks(bool cache_blocks);
 
+  // Push an aggregate down to the tablet servers.
+  //
+  // Once an aggregate has been added, the scan returns aggregates instead of
+  // rows, and the projection is chosen automatically (any projection set by
+  // SetProjectedColumns() is ignored). Each row has the group-by columns (see
+  // SetGroupByKeyPrefix()) followed by one column per aggregate, in the order
+  // the aggregates were added, named e.g. "count(*)" or "max(col)".
+  //
+  // NextBatch() returns the partial aggregates of each tablet as it finishes
+  // scanning it; GetAggregateResults() merges them into the final results.
+  //
+  // 'col_name' may be empty for COUNT, which then counts the rows rather than
+  // the non-null cells of a column. SUM yields an INT64 for integer columns
+  // and a DOUBLE for floating point columns. MIN and MAX yield the type of the
+  // column. SUM, MIN and MAX are NULL if no non-null cell was aggregated.
+  //
+  // Aggregates cannot be used in fault-tolerant scans.
+  Status AddAggregate(AggregateFunction function,
+                      const std::string& col_name) WARN_UNUSED_RESULT;
+
+  // Group the aggregates by the first 'num_key_columns' primary key columns.
+  // Default is 0, i.e. a single group for the whole scan.
+  Status SetGroupByKeyPrefix(int num_key_columns) WARN_UNUSED_RESULT;
+
+  // Scan the remaining tablets to completion, and merge their partial
+  // aggregates. Returns one row per group, ordered by the group-by columns.
+  // Without group-by columns there is always exactly one row.
+  //
+  // Must be called after Open(), on a scanner with aggregates. The results
+  // remain valid until the scanner is closed or destroyed.
+  Status GetAggregateResults(std::vector<KuduRowResult>* rows) WARN_UNUSED_RESULT;
+
   // Begin scanning.
   Status Open();
 
@@ -930,6 +1004,11 @@ class KUDU_EXPORT KuduScanner {
   // now be pointing to garbage memory.
   Status NextBatch(std::vector<KuduRowResult>* rows);
 
+  // Same as above, but for scanners using the columnar layout: replaces the
+  // contents of 'batch' with the next batch of rows. As above, this
+  // invalidates the previously fetched batch.
+  Status NextBatch(KuduColumnarBatch* batch);
+
   // Get the KuduTabletServer that is currently handling the scan.
   // More concretely, this is the server that handled the most recent Open or NextBatch
   // RPC made by the server.
@@ -970,16 +1049,52 @@ class KUDU_EXPORT KuduScanner {
   // previous call to a server), for scans in READ_AT_SNAPSHOT mode.
   Status SetSnapshotRaw(uint64_t snapshot_timestamp) WARN_UNUSED_RESULT;
 
+  // Sets how far in the past, in milliseconds, the snapshot of a scan in
+  // READ_WITH_BOUNDED_STALENESS mode may be. Default is 5 seconds.
+  Status SetMaxStalenessMillis(uint32_t max_staleness_ms) WARN_UNUSED_RESULT;
+
   // Sets the maximum time that Open() and NextBatch() are allowed to take.
   Status SetTimeoutMillis(int millis);
 
+  // Have the tablet servers return the rows in columnar layout, i.e. with
+  // the cells of each column stored contiguously, and fetch them with
+  // NextBatch(KuduColumnarBatch*) rather than as KuduRowResults. This avoids
+  // transposing the data into rows for clients which process it by column.
+  //
+  // Must be called before Open(). The columnar layout cannot be used with
+  // aggregates.
+  Status SetColumnarLayout() WARN_UNUSED_RESULT;
+
+  // Cut this scan into tokens which can be scanned independently, possibly
+  // by other processes (see KuduScanToken). Each token covers part of a
+  // single tablet, holding roughly 'target_chunk_size_bytes' of data on disk
+  // as estimated by the tablet servers. With a target of 0, there is one
+  // token per tablet.
+  //
+  // The tokens carry the projection, predicates, primary key bounds, read
+  // mode, snapshot timestamp, block caching policy and fault-tolerance of
+  // this scanner. To give all of the tokens a consistent view of the table,
+  // scan at a fixed snapshot timestamp. Aggregates cannot be used with scan
+  // tokens.
+  //
+  // Must be called before Open(). The caller owns the returned tokens.
+  Status BuildScanTokens(uint64_t target_chunk_size_bytes,
+                         std::vector<KuduScanToken*>* tokens) WARN_UNUSED_RESULT;
+
   // Returns a string representation of this scan.
   std::string ToString() const;
  private:
   class KUDU_NO_EXPORT Data;
+  friend class KuduScanToken;
   friend class kudu::tools::TsAdminClient;
 
+  // Fetches the next response from the tablet servers, shared by both
+  // versions of NextBatch(). Sets 'has_response' if the response holds rows
+  // to be extracted.
+  Status FetchNextResponse(bool* has_response);
+
   FRIEND_TEST(ClientTest, TestScanCloseProxy);
+  FRIEND_TEST(ClientTest, TestScanColumnarLayoutWithRowwiseResponse);
   FRIEND_TEST(ClientTest, TestScanFaultTolerance);
   FRIEND_TEST(ClientTest, TestScanNoBlockCaching);
   FRIEND_TEST(ClientTest, TestScanTimeout);
@@ -990,6 +1105,47 @@ class KUDU_EXPORT KuduScanner {
   DISALLOW_COPY_AND_ASSIGN(KuduScanner);
 };
 
+// A part of a scan which can be scanned independently of the others, and
+// serialized to be scanned by another client, for example in another process.
+// See KuduScanner::BuildScanTokens().
+class KUDU_EXPORT KuduScanToken {
+ public:
+  ~KuduScanToken();
+
+  // Create a new scanner for this token's part of the scan. The scanner may
+  // be configured further (eg with SetBatchSizeBytes() or
+  // SetColumnarLayout()) before it is opened.
+  //
+  // The caller owns the returned scanner.
+  Status IntoKuduScanner(KuduScanner** scanner) const WARN_UNUSED_RESULT;
+
+  // Returns the ID of the tablet which this token scans.
+  const std::string& tablet_id() const;
+
+  // Serialize this token into 'buf', which can be passed to
+  // DeserializeIntoScanner().
+  Status Serialize(std::string* buf) const WARN_UNUSED_RESULT;
+
+  // Create a new scanner using 'client' for the token serialized in
+  // 'serialized_token'. As with IntoKuduScanner(), the caller owns the
+  // returned scanner.
+  static Status DeserializeIntoScanner(KuduClient* client,
+                                       const std::string& serialized_token,
+                                       KuduScanner** scanner) WARN_UNUSED_RESULT;
+
+ private:
+  class KUDU_NO_EXPORT Data;
+
+  friend class KuduScanner;
+
+  explicit KuduScanToken(Data* data);
+
+  // Owned.
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduScanToken);
+};
+
 // In-memory representation of a remote tablet server.
 class KUDU_EXPORT KuduTabletServer {
  public:
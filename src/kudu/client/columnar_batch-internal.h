@@ -0,0 +1,57 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef KUDU_CLIENT_COLUMNAR_BATCH_INTERNAL_H
+#define KUDU_CLIENT_COLUMNAR_BATCH_INTERNAL_H
+
+#include <vector>
+
+#include "kudu/client/columnar_batch.h"
+#include "kudu/common/wire_protocol.h"
+#include "kudu/gutil/macros.h"
+
+namespace kudu {
+
+class ColumnSchema;
+class Schema;
+
+namespace client {
+
+class KuduColumnarBatch::Data {
+ public:
+  Data();
+  ~Data();
+
+  // Empties the batch.
+  void Clear();
+
+  // Checks that 'col_idx' is a valid index into the projection.
+  Status CheckColumnIndex(int col_idx) const;
+
+  // The projection schema of the scan. NULL until the batch is filled in by
+  // the scanner.
+  const Schema* projection_;
+
+  int64_t num_rows_;
+
+  // The columns of the batch, one per projected column. They point into the
+  // last scan response received by the scanner.
+  std::vector<ColumnarColumnData> columns_;
+
+  DISALLOW_COPY_AND_ASSIGN(Data);
+};
+
+} // namespace client
+} // namespace kudu
+
+#endif
@@ -0,0 +1,93 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kudu/client/columnar_batch.h"
+
+#include "kudu/client/columnar_batch-internal.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using strings::Substitute;
+
+namespace kudu {
+namespace client {
+
+KuduColumnarBatch::Data::Data()
+  : projection_(NULL),
+    num_rows_(0) {
+}
+
+KuduColumnarBatch::Data::~Data() {
+}
+
+void KuduColumnarBatch::Data::Clear() {
+  num_rows_ = 0;
+  columns_.clear();
+}
+
+Status KuduColumnarBatch::Data::CheckColumnIndex(int col_idx) const {
+  if (PREDICT_FALSE(col_idx < 0 || col_idx >= columns_.size())) {
+    return Status::InvalidArgument(
+      Substitute("Column index $0 out of range: the batch has $1 columns",
+                 col_idx, columns_.size()));
+  }
+  return Status::OK();
+}
+
+KuduColumnarBatch::KuduColumnarBatch()
+  : data_(new Data) {
+}
+
+KuduColumnarBatch::~KuduColumnarBatch() {
+  delete data_;
+}
+
+int KuduColumnarBatch::NumRows() const {
+  return data_->num_rows_;
+}
+
+Status KuduColumnarBatch::GetFixedLengthColumn(int col_idx, Slice* data) const {
+  RETURN_NOT_OK(data_->CheckColumnIndex(col_idx));
+  const ColumnSchema& col = data_->projection_->column(col_idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() == BINARY)) {
+    return Status::InvalidArgument("Column is not of a fixed-length type", col.ToString());
+  }
+  *data = data_->columns_[col_idx].data;
+  return Status::OK();
+}
+
+Status KuduColumnarBatch::GetVariableLengthColumn(int col_idx, Slice* offsets,
+                                                  Slice* data) const {
+  RETURN_NOT_OK(data_->CheckColumnIndex(col_idx));
+  const ColumnSchema& col = data_->projection_->column(col_idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() != BINARY)) {
+    return Status::InvalidArgument("Column is not of a variable-length type", col.ToString());
+  }
+  *offsets = data_->columns_[col_idx].data;
+  *data = data_->columns_[col_idx].varlen_data;
+  return Status::OK();
+}
+
+Status KuduColumnarBatch::GetNonNullBitmapForColumn(int col_idx, Slice* bitmap) const {
+  RETURN_NOT_OK(data_->CheckColumnIndex(col_idx));
+  const ColumnSchema& col = data_->projection_->column(col_idx);
+  if (PREDICT_FALSE(!col.is_nullable())) {
+    return Status::InvalidArgument("Column is not nullable", col.ToString());
+  }
+  *bitmap = data_->columns_[col_idx].non_null_bitmap;
+  return Status::OK();
+}
+
+} // namespace client
+} // namespace kudu
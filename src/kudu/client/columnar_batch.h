@@ -0,0 +1,83 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef KUDU_CLIENT_COLUMNAR_BATCH_H
+#define KUDU_CLIENT_COLUMNAR_BATCH_H
+
+#include <stdint.h>
+
+#ifdef KUDU_HEADERS_NO_STUBS
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#else
+#include "kudu/client/stubs.h"
+#endif
+#include "kudu/util/kudu_export.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace client {
+
+// A batch of rows from a scan, in which the cells of each column are stored
+// contiguously. See KuduScanner::SetColumnarLayout().
+//
+// The data is only valid until the next call to KuduScanner::NextBatch(), or
+// until the scanner is closed or destroyed.
+class KUDU_EXPORT KuduColumnarBatch {
+ public:
+  KuduColumnarBatch();
+  ~KuduColumnarBatch();
+
+  // Returns the number of rows in the batch.
+  int NumRows() const;
+
+  // Sets 'data' to the cells of the fixed-length column at index 'col_idx'
+  // of the projection: NumRows() values in the same in-memory format as the
+  // getters of KuduRowResult return (e.g. int32_t for INT32 columns). The
+  // data for NULL cells is zeroed.
+  //
+  // Returns InvalidArgument for variable-length (STRING, BINARY) columns.
+  Status GetFixedLengthColumn(int col_idx, Slice* data) const WARN_UNUSED_RESULT;
+
+  // Sets 'offsets' to NumRows() + 1 uint32_t offsets into 'data' for the
+  // variable-length (STRING, BINARY) column at index 'col_idx' of the
+  // projection. Cell 'i' spans [offsets[i], offsets[i + 1]) of 'data'.
+  // NULL cells are empty. If the batch has no rows, 'offsets' may be empty.
+  //
+  // Returns InvalidArgument for fixed-length columns.
+  Status GetVariableLengthColumn(int col_idx, Slice* offsets,
+                                 Slice* data) const WARN_UNUSED_RESULT;
+
+  // Sets 'bitmap' to a bitmap of NumRows() bits for the nullable column at
+  // index 'col_idx' of the projection, in which bit 'i' (that is,
+  // bitmap[i / 8] & (1 << (i % 8))) is set if the cell of row 'i' is not NULL.
+  //
+  // Returns InvalidArgument for columns which are not nullable.
+  Status GetNonNullBitmapForColumn(int col_idx, Slice* bitmap) const WARN_UNUSED_RESULT;
+
+ private:
+  class KUDU_NO_EXPORT Data;
+
+  friend class KuduScanner;
+
+  // Owned.
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduColumnarBatch);
+};
+
+} // namespace client
+} // namespace kudu
+
+#endif
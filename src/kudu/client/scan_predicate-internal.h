@@ -14,6 +14,8 @@
 #ifndef KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H
 #define KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H
 
+#include <vector>
+
 #include "kudu/client/value.h"
 #include "kudu/client/value-internal.h"
 #include "kudu/common/scan_spec.h"
@@ -86,6 +88,48 @@ class ComparisonPredicateData : public KuduPredicate::Data {
   ColumnRangePredicate* pred_;
 };
 
+// A predicate which passes when a column is equal to any of a list of
+// constants.
+class InListPredicateData : public KuduPredicate::Data {
+ public:
+  // Takes ownership of the elements of 'values' and clears it.
+  InListPredicateData(const ColumnSchema& col,
+                      std::vector<KuduValue*>* values);
+  virtual ~InListPredicateData();
+
+  virtual Status AddToScanSpec(ScanSpec* spec) OVERRIDE;
+
+  virtual InListPredicateData* Clone() const OVERRIDE;
+
+ private:
+  ColumnSchema col_;
+
+  // Owned.
+  std::vector<KuduValue*> vals_;
+};
+
+// A predicate which passes when a column is (or is not) NULL.
+class NullPredicateData : public KuduPredicate::Data {
+ public:
+  NullPredicateData(const ColumnSchema& col, bool is_null)
+    : col_(col),
+      is_null_(is_null) {
+  }
+
+  virtual ~NullPredicateData() {
+  }
+
+  virtual Status AddToScanSpec(ScanSpec* spec) OVERRIDE;
+
+  virtual NullPredicateData* Clone() const OVERRIDE {
+    return new NullPredicateData(col_, is_null_);
+  }
+
+ private:
+  ColumnSchema col_;
+  bool is_null_;
+};
+
 } // namespace client
 } // namespace kudu
 #endif /* KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H */
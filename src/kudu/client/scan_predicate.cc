@@ -13,6 +13,10 @@
 // limitations under the License.
 
 #include "kudu/client/scan_predicate.h"
+
+#include <boost/foreach.hpp>
+#include <vector>
+
 #include "kudu/client/scan_predicate-internal.h"
 #include "kudu/client/value.h"
 #include "kudu/client/value-internal.h"
@@ -20,8 +24,10 @@
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/scan_predicate.h"
 
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -84,5 +90,47 @@ Status ComparisonPredicateData::AddToScanSpec(ScanSpec* spec) {
   return Status::OK();
 }
 
+InListPredicateData::InListPredicateData(const ColumnSchema& col,
+                                         vector<KuduValue*>* values) :
+  col_(col) {
+  vals_.swap(*values);
+}
+
+InListPredicateData::~InListPredicateData() {
+  STLDeleteElements(&vals_);
+}
+
+InListPredicateData* InListPredicateData::Clone() const {
+  vector<KuduValue*> vals;
+  vals.reserve(vals_.size());
+  BOOST_FOREACH(const KuduValue* val, vals_) {
+    vals.push_back(val->Clone());
+  }
+  return new InListPredicateData(col_, &vals);
+}
+
+Status InListPredicateData::AddToScanSpec(ScanSpec* spec) {
+  vector<const void*> values;
+  values.reserve(vals_.size());
+  BOOST_FOREACH(KuduValue* val, vals_) {
+    void* val_void;
+    RETURN_NOT_OK(val->data_->CheckTypeAndGetPointer(col_.name(),
+                                                     col_.type_info()->physical_type(),
+                                                     &val_void));
+    values.push_back(val_void);
+  }
+  spec->AddPredicate(ColumnRangePredicate::InList(col_, values));
+  return Status::OK();
+}
+
+Status NullPredicateData::AddToScanSpec(ScanSpec* spec) {
+  if (is_null_) {
+    spec->AddPredicate(ColumnRangePredicate::IsNull(col_));
+  } else {
+    spec->AddPredicate(ColumnRangePredicate::IsNotNull(col_));
+  }
+  return Status::OK();
+}
+
 } // namespace client
 } // namespace kudu
@@ -48,6 +48,8 @@ class KUDU_EXPORT KuduPredicate {
   friend class KuduTable;
   friend class ComparisonPredicateData;
   friend class ErrorPredicateData;
+  friend class InListPredicateData;
+  friend class NullPredicateData;
 
   explicit KuduPredicate(Data* d);
 
@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "kudu/client/client-internal.h"
+#include "kudu/client/columnar_batch-internal.h"
 #include "kudu/client/meta_cache.h"
 #include "kudu/client/row_result.h"
 #include "kudu/client/table-internal.h"
@@ -44,6 +45,7 @@ namespace client {
 using internal::RemoteTabletServer;
 
 static const int64_t kNoTimestamp = -1;
+static const uint32_t kDefaultMaxStalenessMillis = 5000;
 
 KuduScanner::Data::Data(KuduTable* table)
   : open_(false),
@@ -53,9 +55,13 @@ KuduScanner::Data::Data(KuduTable* table)
     selection_(KuduClient::CLOSEST_REPLICA),
     read_mode_(READ_LATEST),
     is_fault_tolerant_(false),
+    columnar_layout_(false),
     snapshot_timestamp_(kNoTimestamp),
+    max_staleness_ms_(kDefaultMaxStalenessMillis),
     table_(DCHECK_NOTNULL(table)),
     projection_(table->schema().schema_),
+    group_by_key_prefix_(0),
+    aggregate_schema_(NULL),
     arena_(1024, 1024*1024),
     spec_encoder_(table->schema().schema_, &arena_),
     timeout_(MonoDelta::FromMilliseconds(kScanTimeoutMillis)),
@@ -151,15 +157,18 @@ Status KuduScanner::Data::CanBeRetried(const bool isNewScan,
   //   - TABLET_NOT_RUNNING : The scan can be retried at a different tablet server, subject
   //                          to the client's specified selection criteria.
   //
+  //   - REPLICA_TOO_STALE  : Likewise, another replica may have a more recent safe time.
+  //
   //   - Any other error    : Fatal. This indicates an unexpected error while processing the scan
   //                          request.
   if (rpc_status.ok() && !server_status.ok()) {
     const tserver::TabletServerErrorPB& error = last_response_.error();
     if (error.code() == tserver::TabletServerErrorPB::SCANNER_EXPIRED) {
       VLOG(1) << "Got SCANNER_EXPIRED error code, non-fatal error.";
-    } else if (error.code() == tserver::TabletServerErrorPB::TABLET_NOT_RUNNING) {
-      VLOG(1) << "Got TABLET_NOT_RUNNING error code, temporarily blacklisting node "
-          << ts_->permanent_uuid();
+    } else if (error.code() == tserver::TabletServerErrorPB::TABLET_NOT_RUNNING ||
+               error.code() == tserver::TabletServerErrorPB::REPLICA_TOO_STALE) {
+      VLOG(1) << "Got " << tserver::TabletServerErrorPB::Code_Name(error.code())
+          << " error code, temporarily blacklisting node " << ts_->permanent_uuid();
       blacklist->insert(ts_->permanent_uuid());
       // We've blacklisted all the live candidate tservers.
       // Do a short random sleep, clear the temp blacklist, then do another round of retries.
@@ -180,16 +189,46 @@ Status KuduScanner::Data::CanBeRetried(const bool isNewScan,
   return Status::OK();
 }
 
-Status KuduScanner::Data::OpenTablet(const string& partition_key,
-                                     const MonoTime& deadline,
-                                     set<string>* blacklist) {
+void KuduScanner::Data::PrepareKeyRanges() {
+  spec_encoder_.EncodeRangePredicates(&spec_, false);
+
+  if (table_->partition_schema().IsSimplePKRangePartitioning(*table_->schema().schema_)) {
+    // If the table is simple range partitioned, then the partition key space is
+    // isomorphic to the primary key space. We can potentially reduce the scan
+    // length by only scanning the intersection of the primary key range and the
+    // partition key range. This is a stop-gap until real partition pruning is
+    // in place that will work across any partition type.
+    Slice start_primary_key = spec_.lower_bound_key() == NULL ? Slice()
+                            : spec_.lower_bound_key()->encoded_key();
+    Slice end_primary_key = spec_.exclusive_upper_bound_key() == NULL ? Slice()
+                          : spec_.exclusive_upper_bound_key()->encoded_key();
+    Slice start_partition_key = spec_.lower_bound_partition_key();
+    Slice end_partition_key = spec_.exclusive_upper_bound_partition_key();
+
+    if ((!end_partition_key.empty() && start_primary_key.compare(end_partition_key) >= 0) ||
+        (!end_primary_key.empty() && start_partition_key.compare(end_primary_key) >= 0)) {
+      // The primary key range and the partition key range do not intersect;
+      // the scan will be empty. Keep the existing partition key range.
+    } else {
+      // Assign the scan's partition key range to the intersection of the
+      // primary key and partition key ranges.
+      spec_.SetLowerBoundPartitionKey(start_primary_key);
+      spec_.SetExclusiveUpperBoundPartitionKey(end_primary_key);
+    }
+  }
+}
 
-  PrepareRequest(KuduScanner::Data::NEW);
-  next_req_.clear_scanner_id();
-  NewScanRequestPB* scan = next_req_.mutable_new_scan_request();
+Status KuduScanner::Data::FillNewScanRequest(NewScanRequestPB* scan) {
   switch (read_mode_) {
     case READ_LATEST: scan->set_read_mode(kudu::READ_LATEST); break;
     case READ_AT_SNAPSHOT: scan->set_read_mode(kudu::READ_AT_SNAPSHOT); break;
+    case READ_WITH_BOUNDED_STALENESS:
+      // Once a snapshot has been picked, e.g. when resuming a fault-tolerant
+      // scan elsewhere, it's sent along below and the server keeps reading at
+      // it. Staying in this mode lets a follower serve it without waiting.
+      scan->set_read_mode(kudu::READ_WITH_BOUNDED_STALENESS);
+      scan->set_max_staleness_ms(max_staleness_ms_);
+      break;
     default: LOG(FATAL) << "Unexpected read mode.";
   }
 
@@ -199,16 +238,10 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
     scan->set_order_mode(kudu::UNORDERED);
   }
 
-  if (last_primary_key_.length() > 0) {
-    VLOG(1) << "Setting NewScanRequestPB last_primary_key to hex value "
-        << HexDump(last_primary_key_);
-    scan->set_last_primary_key(last_primary_key_);
-  }
-
   scan->set_cache_blocks(spec_.cache_blocks());
 
   if (snapshot_timestamp_ != kNoTimestamp) {
-    if (PREDICT_FALSE(read_mode_ != READ_AT_SNAPSHOT)) {
+    if (PREDICT_FALSE(read_mode_ == READ_LATEST)) {
       LOG(WARNING) << "Scan snapshot timestamp set but read mode was READ_LATEST."
           " Ignoring timestamp.";
     } else {
@@ -222,16 +255,33 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
     const ColumnSchema& col = pred.column();
     const ValueRange& range = pred.range();
     ColumnRangePredicatePB* pb = scan->add_range_predicates();
-    if (range.has_lower_bound()) {
-      CopyPredicateBound(col, range.lower_bound(),
-                         pb->mutable_lower_bound());
-    }
-    if (range.has_upper_bound()) {
-      CopyPredicateBound(col, range.upper_bound(),
-                         pb->mutable_upper_bound());
+    switch (pred.predicate_type()) {
+      case ColumnRangePredicate::RANGE:
+        if (range.has_lower_bound()) {
+          CopyPredicateBound(col, range.lower_bound(),
+                             pb->mutable_lower_bound());
+        }
+        if (range.has_upper_bound()) {
+          CopyPredicateBound(col, range.upper_bound(),
+                             pb->mutable_upper_bound());
+        }
+        break;
+      case ColumnRangePredicate::IN_LIST:
+        pb->set_type(ColumnRangePredicatePB::IN_LIST);
+        BOOST_FOREACH(const void* value, pred.in_list_values()) {
+          CopyPredicateBound(col, value, pb->add_in_list_values());
+        }
+        break;
+      case ColumnRangePredicate::IS_NULL:
+        pb->set_type(ColumnRangePredicatePB::IS_NULL);
+        break;
+      case ColumnRangePredicate::IS_NOT_NULL:
+        pb->set_type(ColumnRangePredicatePB::IS_NOT_NULL);
+        break;
     }
     ColumnSchemaToPB(col, pb->mutable_column());
   }
+  scan->mutable_range_predicates()->MergeFrom(encoded_predicates_);
 
   if (spec_.lower_bound_key()) {
     scan->mutable_start_primary_key()->assign(
@@ -249,6 +299,31 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   }
   RETURN_NOT_OK(SchemaToColumnPBs(*projection_, scan->mutable_projected_columns(),
                                   SCHEMA_PB_WITHOUT_STORAGE_ATTRIBUTES | SCHEMA_PB_WITHOUT_IDS));
+  scan->clear_aggregates();
+  scan->clear_group_by_columns();
+  BOOST_FOREACH(const AggregatePB& agg, aggregates_) {
+    scan->add_aggregates()->CopyFrom(agg);
+  }
+  BOOST_FOREACH(const string& col_name, GroupByColumnNames()) {
+    scan->add_group_by_columns(col_name);
+  }
+  return Status::OK();
+}
+
+Status KuduScanner::Data::OpenTablet(const string& partition_key,
+                                     const MonoTime& deadline,
+                                     set<string>* blacklist) {
+
+  PrepareRequest(KuduScanner::Data::NEW);
+  next_req_.clear_scanner_id();
+  NewScanRequestPB* scan = next_req_.mutable_new_scan_request();
+  RETURN_NOT_OK(FillNewScanRequest(scan));
+
+  if (last_primary_key_.length() > 0) {
+    VLOG(1) << "Setting NewScanRequestPB last_primary_key to hex value "
+        << HexDump(last_primary_key_);
+    scan->set_last_primary_key(last_primary_key_);
+  }
 
   for (int attempt = 1;; attempt++) {
     Synchronizer sync;
@@ -346,6 +421,136 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   return Status::OK();
 }
 
+Status KuduScanner::Data::BuildScanTokens(uint64_t target_chunk_size_bytes,
+                                          vector<KuduScanToken*>* tokens) {
+  if (!aggregates_.empty()) {
+    return Status::InvalidArgument("Aggregates cannot be used with scan tokens");
+  }
+  PrepareKeyRanges();
+
+  tserver::ScanTokenPB token_template;
+  token_template.set_table_name(table_->name());
+  token_template.set_fault_tolerant(is_fault_tolerant_);
+  RETURN_NOT_OK(FillNewScanRequest(token_template.mutable_scan()));
+  const string& scan_start_key = token_template.scan().start_primary_key();
+  const string& scan_stop_key = token_template.scan().stop_primary_key();
+
+  bool is_simple_range_partitioned =
+    table_->partition_schema().IsSimplePKRangePartitioning(*table_->schema().schema_);
+  Slice end_partition_key = spec_.exclusive_upper_bound_partition_key();
+  shared_ptr<KuduTable> table = table_->shared_from_this();
+
+  MonoTime deadline = MonoTime::Now(MonoTime::FINE);
+  deadline.AddDelta(timeout_);
+
+  vector<KuduScanToken*> new_tokens;
+  ElementDeleter deleter(&new_tokens);
+  string partition_key = spec_.lower_bound_partition_key();
+  while (true) {
+    scoped_refptr<internal::RemoteTablet> tablet;
+    Synchronizer sync;
+    table_->client()->data_->meta_cache_->LookupTabletByKey(table_,
+                                                            partition_key,
+                                                            deadline,
+                                                            &tablet,
+                                                            sync.AsStatusCallback());
+    RETURN_NOT_OK(sync.Wait());
+    const Partition& partition = tablet->partition();
+
+    // The primary key range to scan within this tablet. For simple range
+    // partitioned tables, the tablet's partition bounds the range too.
+    string start_key = scan_start_key;
+    string stop_key = scan_stop_key;
+    if (is_simple_range_partitioned) {
+      if (Slice(partition.partition_key_start()).compare(start_key) > 0) {
+        start_key = partition.partition_key_start();
+      }
+      if (!partition.partition_key_end().empty() &&
+          (stop_key.empty() || Slice(partition.partition_key_end()).compare(stop_key) < 0)) {
+        stop_key = partition.partition_key_end();
+      }
+    }
+
+    if (stop_key.empty() || Slice(start_key).compare(stop_key) < 0) {
+      vector<string> split_keys;
+      if (target_chunk_size_bytes > 0) {
+        RETURN_NOT_OK(SplitKeyRange(tablet->tablet_id(), start_key, stop_key,
+                                    target_chunk_size_bytes, deadline, &split_keys));
+      }
+      split_keys.push_back(stop_key);
+
+      string chunk_start_key = start_key;
+      BOOST_FOREACH(const string& chunk_stop_key, split_keys) {
+        tserver::ScanTokenPB pb(token_template);
+        pb.set_partition_key_start(partition.partition_key_start());
+        pb.set_partition_key_end(partition.partition_key_end());
+        NewScanRequestPB* scan = pb.mutable_scan();
+        scan->set_tablet_id(tablet->tablet_id());
+        if (chunk_start_key.empty()) {
+          scan->clear_start_primary_key();
+        } else {
+          scan->set_start_primary_key(chunk_start_key);
+        }
+        if (chunk_stop_key.empty()) {
+          scan->clear_stop_primary_key();
+        } else {
+          scan->set_stop_primary_key(chunk_stop_key);
+        }
+        new_tokens.push_back(new KuduScanToken(new KuduScanToken::Data(table, pb)));
+        chunk_start_key = chunk_stop_key;
+      }
+    }
+
+    partition_key = partition.partition_key_end();
+    if (partition_key.empty() ||
+        (!end_partition_key.empty() && end_partition_key.compare(partition_key) <= 0)) {
+      break;
+    }
+  }
+
+  tokens->insert(tokens->end(), new_tokens.begin(), new_tokens.end());
+  new_tokens.clear();
+  return Status::OK();
+}
+
+Status KuduScanner::Data::SplitKeyRange(const string& tablet_id,
+                                        const string& start_key,
+                                        const string& stop_key,
+                                        uint64_t target_chunk_size_bytes,
+                                        const MonoTime& deadline,
+                                        vector<string>* split_keys) {
+  RemoteTabletServer* ts;
+  vector<RemoteTabletServer*> candidates;
+  set<string> blacklist;
+  RETURN_NOT_OK(table_->client()->data_->GetTabletServer(table_->client(),
+                                                         tablet_id,
+                                                         selection_,
+                                                         blacklist,
+                                                         &candidates,
+                                                         &ts));
+
+  tserver::SplitKeyRangeRequestPB req;
+  req.set_tablet_id(tablet_id);
+  if (!start_key.empty()) {
+    req.set_start_primary_key(start_key);
+  }
+  if (!stop_key.empty()) {
+    req.set_stop_primary_key(stop_key);
+  }
+  req.set_target_chunk_size_bytes(target_chunk_size_bytes);
+
+  tserver::SplitKeyRangeResponsePB resp;
+  RpcController controller;
+  controller.set_deadline(deadline);
+  CHECK(ts->proxy());
+  RETURN_NOT_OK(ts->proxy()->SplitKeyRange(req, &resp, &controller));
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status());
+  }
+  split_keys->assign(resp.split_keys().begin(), resp.split_keys().end());
+  return Status::OK();
+}
+
 Status KuduScanner::Data::KeepAlive() {
   if (!open_) return Status::IllegalState("Scanner was not open.");
   // If there is no scanner to keep alive, we still return Status::OK().
@@ -367,7 +572,42 @@ Status KuduScanner::Data::KeepAlive() {
 }
 
 Status KuduScanner::Data::ExtractRows(vector<KuduRowResult>* rows) {
-  return ExtractRows(controller_, projection_, &last_response_, rows);
+  const Schema* schema = aggregates_.empty() ? projection_ : aggregate_schema_;
+  return ExtractRows(controller_, schema, &last_response_, rows);
+}
+
+Status KuduScanner::Data::ExtractColumnarBatch(KuduColumnarBatch* batch) {
+  KuduColumnarBatch::Data* dst = batch->data_;
+  dst->Clear();
+  dst->projection_ = projection_;
+
+  // The server omits the row block if no rows were scanned.
+  if (!last_response_.has_columnar_data()) {
+    // A server which doesn't know about the columnar layout ignores the
+    // request for it and sends rows, which we mustn't silently drop.
+    if (PREDICT_FALSE(last_response_.has_data())) {
+      return Status::NotSupported("Server does not support the columnar layout");
+    }
+    dst->columns_.resize(projection_->num_columns());
+    return Status::OK();
+  }
+
+  const ColumnarRowBlockPB& rowblock_pb = last_response_.columnar_data();
+  Slice data, varlen_data;
+  Status s = controller_.GetSidecar(rowblock_pb.data_sidecar(), &data);
+  if (s.ok()) {
+    s = controller_.GetSidecar(rowblock_pb.varlen_data_sidecar(), &varlen_data);
+  }
+  if (!s.ok()) {
+    return Status::Corruption("Server sent invalid response: columnar data "
+                              "sidecar index corrupt", s.ToString());
+  }
+
+  RETURN_NOT_OK(ExtractColumnsFromColumnarRowBlockPB(*projection_, rowblock_pb,
+                                                     data, varlen_data, &dst->columns_));
+  dst->num_rows_ = rowblock_pb.num_rows();
+  VLOG(1) << "Extracted " << dst->num_rows_ << " rows";
+  return Status::OK();
 }
 
 Status KuduScanner::Data::ExtractRows(const RpcController& controller,
@@ -466,6 +706,8 @@ void KuduScanner::Data::PrepareRequest(RequestType state) {
     next_req_.clear_batch_size_bytes();
   }
 
+  next_req_.set_columnar_layout(columnar_layout_);
+
   if (state == KuduScanner::Data::NEW) {
     next_req_.set_call_seq_id(0);
   } else {
@@ -478,5 +720,96 @@ size_t KuduScanner::Data::CalculateProjectedRowSize(const Schema& proj) {
         (proj.has_nullables() ? BitmapSize(proj.num_columns()) : 0);
 }
 
+vector<string> KuduScanner::Data::GroupByColumnNames() const {
+  const Schema* table_schema = table_->schema().schema_;
+  vector<string> names;
+  for (int i = 0; i < group_by_key_prefix_; i++) {
+    names.push_back(table_schema->column(i).name());
+  }
+  return names;
+}
+
+Status KuduScanner::Data::SetupAggregateProjection() {
+  const Schema* table_schema = table_->schema().schema_;
+  vector<string> group_by = GroupByColumnNames();
+
+  // Project the group-by columns and the aggregated columns, each once.
+  vector<ColumnSchema> cols;
+  set<string> col_names;
+  BOOST_FOREACH(const string& col_name, group_by) {
+    if (col_names.insert(col_name).second) {
+      cols.push_back(table_schema->column(table_schema->find_column(col_name)));
+    }
+  }
+  BOOST_FOREACH(const AggregatePB& agg, aggregates_) {
+    if (agg.has_column() && col_names.insert(agg.column()).second) {
+      cols.push_back(table_schema->column(table_schema->find_column(agg.column())));
+    }
+  }
+  gscoped_ptr<Schema> projection(new Schema());
+  RETURN_NOT_OK(projection->Reset(cols, 0));
+
+  gscoped_ptr<Schema> aggregate_schema(new Schema());
+  RETURN_NOT_OK(ScanAggregator::BuildResultSchema(*table_schema, group_by, aggregates_,
+                                                  aggregate_schema.get()));
+  projection_ = pool_.Add(projection.release());
+  aggregate_schema_ = pool_.Add(aggregate_schema.release());
+  return Status::OK();
+}
+
+////////////////////////////////////////////////////////////
+// KuduScanToken
+////////////////////////////////////////////////////////////
+
+KuduScanToken::Data::Data(const shared_ptr<KuduTable>& table,
+                          const tserver::ScanTokenPB& pb)
+  : table_(table),
+    pb_(pb) {
+}
+
+Status KuduScanToken::Data::IntoKuduScanner(const shared_ptr<KuduTable>& table,
+                                            const tserver::ScanTokenPB& pb,
+                                            KuduScanner** scanner) {
+  const NewScanRequestPB& scan = pb.scan();
+  gscoped_ptr<KuduScanner> ret(new KuduScanner(table.get()));
+  ret->data_->table_ref_ = table;
+
+  vector<string> col_names;
+  BOOST_FOREACH(const ColumnSchemaPB& col, scan.projected_columns()) {
+    col_names.push_back(col.name());
+  }
+  RETURN_NOT_OK(ret->SetProjectedColumns(col_names));
+  ret->data_->encoded_predicates_.CopyFrom(scan.range_predicates());
+
+  if (scan.has_start_primary_key()) {
+    RETURN_NOT_OK(ret->AddLowerBoundRaw(scan.start_primary_key()));
+  }
+  if (scan.has_stop_primary_key()) {
+    RETURN_NOT_OK(ret->AddExclusiveUpperBoundRaw(scan.stop_primary_key()));
+  }
+  // Limit the scanner to the token's tablet.
+  RETURN_NOT_OK(ret->AddLowerBoundPartitionKeyRaw(pb.partition_key_start()));
+  RETURN_NOT_OK(ret->AddExclusiveUpperBoundPartitionKeyRaw(pb.partition_key_end()));
+
+  if (scan.read_mode() == kudu::READ_AT_SNAPSHOT) {
+    RETURN_NOT_OK(ret->SetReadMode(KuduScanner::READ_AT_SNAPSHOT));
+    if (scan.has_snap_timestamp()) {
+      RETURN_NOT_OK(ret->SetSnapshotRaw(scan.snap_timestamp()));
+    }
+  } else if (scan.read_mode() == kudu::READ_WITH_BOUNDED_STALENESS) {
+    RETURN_NOT_OK(ret->SetReadMode(KuduScanner::READ_WITH_BOUNDED_STALENESS));
+    if (scan.has_max_staleness_ms()) {
+      RETURN_NOT_OK(ret->SetMaxStalenessMillis(scan.max_staleness_ms()));
+    }
+  }
+  RETURN_NOT_OK(ret->SetCacheBlocks(scan.cache_blocks()));
+  if (pb.fault_tolerant()) {
+    RETURN_NOT_OK(ret->SetFaultTolerant());
+  }
+
+  *scanner = ret.release();
+  return Status::OK();
+}
+
 } // namespace client
 } // namespace kudu
@@ -20,6 +20,7 @@
 
 #include "kudu/gutil/macros.h"
 #include "kudu/client/client.h"
+#include "kudu/common/scan_aggregator.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/predicate_encoder.h"
 #include "kudu/tserver/tserver_service.proxy.h"
@@ -54,6 +55,28 @@ class KuduScanner::Data {
                       const std::vector<internal::RemoteTabletServer*>& candidates,
                       std::set<std::string>* blacklist);
 
+  // Encode the key column predicates into primary key bounds, and narrow the
+  // partition key range to match them where possible.
+  void PrepareKeyRanges();
+
+  // Fill in 'scan' with the projection, predicates, bounds and other
+  // options of this scan. The tablet ID is left unset.
+  Status FillNewScanRequest(tserver::NewScanRequestPB* scan);
+
+  // See KuduScanner::BuildScanTokens().
+  Status BuildScanTokens(uint64_t target_chunk_size_bytes,
+                         std::vector<KuduScanToken*>* tokens);
+
+  // Ask a replica of the given tablet to split the encoded primary key range
+  // ['start_key', 'stop_key') into chunks of about 'target_chunk_size_bytes',
+  // setting 'split_keys' to the keys at which the chunks begin.
+  Status SplitKeyRange(const std::string& tablet_id,
+                       const std::string& start_key,
+                       const std::string& stop_key,
+                       uint64_t target_chunk_size_bytes,
+                       const MonoTime& deadline,
+                       std::vector<std::string>* split_keys);
+
   // Open a tablet.
   // The deadline is the time budget for this operation.
   // The blacklist is used to temporarily filter out nodes that are experiencing transient errors.
@@ -65,6 +88,9 @@ class KuduScanner::Data {
   // Extracts data from the last scan response and adds them to 'rows'.
   Status ExtractRows(std::vector<KuduRowResult>* rows);
 
+  // Points 'batch' at the columnar data of the last scan response.
+  Status ExtractColumnarBatch(KuduColumnarBatch* batch);
+
   // Static implementation of ExtractRows. This is used by some external
   // tools.
   static Status ExtractRows(const rpc::RpcController& controller,
@@ -99,6 +125,13 @@ class KuduScanner::Data {
   // Returns the size of a row for the given projection 'proj'.
   static size_t CalculateProjectedRowSize(const Schema& proj);
 
+  // Returns the names of the columns to group the aggregates by.
+  std::vector<std::string> GroupByColumnNames() const;
+
+  // Sets the projection to the columns needed to compute the aggregates,
+  // and builds 'aggregate_schema_'.
+  Status SetupAggregateProjection();
+
   bool open_;
   bool data_in_open_;
   bool has_batch_size_bytes_;
@@ -107,7 +140,9 @@ class KuduScanner::Data {
 
   ReadMode read_mode_;
   bool is_fault_tolerant_;
+  bool columnar_layout_;
   int64_t snapshot_timestamp_;
+  uint32_t max_staleness_ms_;
 
   // The encoded last primary key from the most recent tablet scan response.
   std::string last_primary_key_;
@@ -131,9 +166,27 @@ class KuduScanner::Data {
   // The table we're scanning.
   KuduTable* table_;
 
+  // Keeps 'table_' alive for scanners created from scan tokens, which open
+  // the table themselves. NULL otherwise.
+  std::tr1::shared_ptr<KuduTable> table_ref_;
+
   // The projection schema used in the scan.
   const Schema* projection_;
 
+  // The aggregates pushed down to the tablet servers, and the number of key
+  // columns to group them by. See KuduScanner::AddAggregate().
+  std::vector<AggregatePB> aggregates_;
+  int group_by_key_prefix_;
+
+  // The schema of the partial aggregates returned by the tablet servers.
+  // Set by Open() if 'aggregates_' is non-empty.
+  const Schema* aggregate_schema_;
+
+  // Merges the partial aggregates, and the merged result rows.
+  // See KuduScanner::GetAggregateResults().
+  gscoped_ptr<ScanAggregator> aggregate_merger_;
+  faststring aggregate_rows_;
+
   Arena arena_;
   AutoReleasePool pool_;
 
@@ -142,6 +195,10 @@ class KuduScanner::Data {
   ScanSpec spec_;
   RangePredicateEncoder spec_encoder_;
 
+  // Predicates which are already in wire format, such as those of a scan
+  // token. These are sent along with the predicates in 'spec_'.
+  google::protobuf::RepeatedPtrField<tserver::ColumnRangePredicatePB> encoded_predicates_;
+
   // The tablet we're scanning.
   scoped_refptr<internal::RemoteTablet> remote_;
 
@@ -154,6 +211,23 @@ class KuduScanner::Data {
   DISALLOW_COPY_AND_ASSIGN(Data);
 };
 
+class KuduScanToken::Data {
+ public:
+  Data(const std::tr1::shared_ptr<KuduTable>& table,
+       const tserver::ScanTokenPB& pb);
+
+  // Create a scanner of 'table' for the scan described by 'pb'.
+  static Status IntoKuduScanner(const std::tr1::shared_ptr<KuduTable>& table,
+                                const tserver::ScanTokenPB& pb,
+                                KuduScanner** scanner);
+
+  const std::tr1::shared_ptr<KuduTable> table_;
+  const tserver::ScanTokenPB pb_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Data);
+};
+
 } // namespace client
 } // namespace kudu
 
@@ -49,7 +49,8 @@ class KUDU_EXPORT KuduColumnStorageAttributes {
     GROUP_VARINT = 3,
     RLE = 4,
     DICT_ENCODING = 5,
-    BIT_SHUFFLE = 6
+    BIT_SHUFFLE = 6,
+    FRAME_OF_REFERENCE = 7
   };
 
   enum CompressionType {
@@ -182,6 +182,10 @@ class ColumnDataView {
 
   Arena *arena() { return column_block_->arena(); }
 
+  bool is_nullable() const {
+    return column_block_->is_nullable();
+  }
+
   size_t nrows() const {
     return column_block_->nrows() - row_offset_;
   }
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <boost/assign/list_of.hpp>
+#include <boost/foreach.hpp>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <tr1/memory>
@@ -28,6 +29,7 @@
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(num_lists, 3, "Number of lists to merge");
 DEFINE_int32(num_rows, 1000, "Number of entries per list");
@@ -303,4 +305,133 @@ TEST(TestPredicateEvaluatingIterator, TestDontWrapWhenNoPredicates) {
   ASSERT_EQ(outer_iter, materializing) << "InitAndMaybeWrap should not have wrapped iter";
 }
 
+// Build 'num_lists' prefetching iterators over consecutive runs of
+// 'rows_per_list' integers, decoding on 'pool'.
+static void BuildPrefetchingIterators(ThreadPool* pool, int parallelism,
+                                      int num_lists, int rows_per_list,
+                                      vector<shared_ptr<RowwiseIterator> >* iters,
+                                      int max_buffered_blocks =
+                                          PrefetchingIterator::kDefaultMaxBufferedBlocks) {
+  uint32_t entry = 0;
+  for (int i = 0; i < num_lists; i++) {
+    vector<uint32_t> ints;
+    for (int j = 0; j < rows_per_list; j++) {
+      ints.push_back(entry++);
+    }
+    iters->push_back(shared_ptr<RowwiseIterator>(
+        new MaterializingIterator(
+            shared_ptr<ColumnwiseIterator>(new VectorIterator(ints)))));
+  }
+  PrefetchingIterator::WrapForParallelScan(pool, parallelism, max_buffered_blocks, iters);
+}
+
+// Test that a union of prefetching iterators yields the selected rows of
+// its inputs in order, even when the destination block is smaller than the
+// prefetched blocks.
+TEST(TestPrefetchingIterator, TestUnion) {
+  const int kNumLists = 7;
+  const int kRowsPerList = 1000;
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("prefetch").set_max_threads(3).Build(&pool));
+
+  for (int parallelism = 1; parallelism <= kNumLists + 1; parallelism *= 2) {
+    ScanSpec spec;
+    TestIntRangePredicate pred(500, 4321);
+    spec.AddPredicate(pred.pred_);
+
+    vector<shared_ptr<RowwiseIterator> > iters;
+    BuildPrefetchingIterators(pool.get(), parallelism, kNumLists, kRowsPerList, &iters);
+    UnionIterator union_iter(iters);
+    ASSERT_OK(union_iter.Init(&spec));
+
+    Arena arena(1024, 1024);
+    RowBlock dst(kIntSchema, 7, &arena);
+    uint32_t expected = pred.lower_;
+    while (union_iter.HasNext()) {
+      ASSERT_OK(union_iter.NextBlock(&dst));
+      ASSERT_GT(dst.nrows(), 0);
+      for (int i = 0; i < dst.nrows(); i++) {
+        if (!dst.selection_vector()->IsRowSelected(i)) continue;
+        uint32_t val = *kIntSchema.ExtractColumnFromRow<UINT32>(dst.row(i), 0);
+        ASSERT_EQ(expected, val) << "parallelism " << parallelism;
+        expected++;
+      }
+    }
+    ASSERT_EQ(pred.upper_ + 1, expected) << "parallelism " << parallelism;
+  }
+}
+
+// Test that a merge of prefetching iterators yields sorted results.
+TEST(TestPrefetchingIterator, TestMerge) {
+  const int kNumLists = 5;
+  const int kRowsPerList = 1000;
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("prefetch").set_max_threads(2).Build(&pool));
+
+  vector<shared_ptr<RowwiseIterator> > iters;
+  BuildPrefetchingIterators(pool.get(), kNumLists, kNumLists, kRowsPerList, &iters);
+  // Reverse the inputs so that the merge has to interleave them.
+  std::reverse(iters.begin(), iters.end());
+  MergeIterator merger(kIntSchema, iters);
+  ASSERT_OK(merger.Init(NULL));
+
+  RowBlock dst(kIntSchema, 100, NULL);
+  uint32_t expected = 0;
+  while (merger.HasNext()) {
+    ASSERT_OK(merger.NextBlock(&dst));
+    for (int i = 0; i < dst.nrows(); i++) {
+      ASSERT_EQ(expected++, *kIntSchema.ExtractColumnFromRow<UINT32>(dst.row(i), 0));
+    }
+  }
+  ASSERT_EQ(kNumLists * kRowsPerList, expected);
+}
+
+// Test that the iterators of a merge each buffer no more than the given
+// number of blocks.
+TEST(TestPrefetchingIterator, TestMergeWithBoundedBuffers) {
+  const int kNumLists = 5;
+  const int kRowsPerList = 1000;
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("prefetch").set_max_threads(2).Build(&pool));
+
+  vector<shared_ptr<RowwiseIterator> > iters;
+  BuildPrefetchingIterators(pool.get(), kNumLists, kNumLists, kRowsPerList, &iters, 1);
+  vector<PrefetchingIterator*> prefetchers;
+  BOOST_FOREACH(const shared_ptr<RowwiseIterator>& iter, iters) {
+    prefetchers.push_back(down_cast<PrefetchingIterator*>(iter.get()));
+  }
+  std::reverse(iters.begin(), iters.end());
+  MergeIterator merger(kIntSchema, iters);
+  ASSERT_OK(merger.Init(NULL));
+
+  RowBlock dst(kIntSchema, 100, NULL);
+  uint32_t expected = 0;
+  while (merger.HasNext()) {
+    ASSERT_OK(merger.NextBlock(&dst));
+    for (int i = 0; i < dst.nrows(); i++) {
+      ASSERT_EQ(expected++, *kIntSchema.ExtractColumnFromRow<UINT32>(dst.row(i), 0));
+    }
+  }
+  ASSERT_EQ(kNumLists * kRowsPerList, expected);
+
+  // Each iterator only ever allocated the one buffer it was allowed.
+  BOOST_FOREACH(PrefetchingIterator* prefetcher, prefetchers) {
+    MutexLock l(prefetcher->lock_);
+    ASSERT_EQ(1, prefetcher->all_buffers_.size());
+  }
+}
+
+// Test that destroying a prefetching iterator which hasn't been fully read
+// waits for its in-flight prefetching.
+TEST(TestPrefetchingIterator, TestDestroyWhilePrefetching) {
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("prefetch").set_max_threads(2).Build(&pool));
+  for (int i = 0; i < 10; i++) {
+    vector<shared_ptr<RowwiseIterator> > iters;
+    BuildPrefetchingIterators(pool.get(), 2, 4, 10000, &iters);
+    UnionIterator union_iter(iters);
+    ASSERT_OK(union_iter.Init(NULL));
+  }
+}
+
 } // namespace kudu
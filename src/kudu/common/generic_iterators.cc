@@ -21,13 +21,20 @@
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
+#include "kudu/gutil/bind.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_bool(materializing_iterator_do_pushdown, true,
             "Should MaterializingIterator do predicate pushdown");
 TAG_FLAG(materializing_iterator_do_pushdown, hidden);
+DEFINE_bool(materializing_iterator_late_materialization, true,
+            "Should MaterializingIterator skip decoding cells of rows which "
+            "were already filtered out by predicates on earlier columns");
+TAG_FLAG(materializing_iterator_late_materialization, advanced);
 
 namespace kudu {
 
@@ -502,15 +509,34 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
 
   BOOST_FOREACH(size_t col_idx, materialization_order_) {
     // Materialize the column itself into the row block.
+    // Once predicates (or deletions) have unselected some rows, only the
+    // surviving rows need to be decoded for the remaining columns.
+    //
+    // The underlying iterator may also evaluate the column's first predicate
+    // as it materializes it (e.g. against a dictionary), in which case the
+    // cells of the rows it rejects need not be materialized at all.
+    typedef unordered_multimap<size_t, ColumnRangePredicate>::const_iterator PredIter;
+    std::pair<PredIter, PredIter> col_preds = preds_by_column_.equal_range(col_idx);
+    bool first_pred_evaluated = false;
     ColumnBlock dst_col(dst->column_block(col_idx));
-    RETURN_NOT_OK(iter_->MaterializeColumn(col_idx, &dst_col));
+    if (!FLAGS_materializing_iterator_late_materialization) {
+      RETURN_NOT_OK(iter_->MaterializeColumn(col_idx, &dst_col));
+    } else if (col_preds.first != col_preds.second) {
+      RETURN_NOT_OK(iter_->MaterializeColumnAndEvaluate(col_idx, col_preds.first->second,
+                                                        &dst_col, dst->selection_vector(),
+                                                        &first_pred_evaluated));
+    } else {
+      RETURN_NOT_OK(iter_->MaterializeColumnSelected(col_idx, &dst_col,
+                                                     *dst->selection_vector()));
+    }
 
     // Evaluate any predicates that apply to this column.
-    typedef std::pair<size_t, ColumnRangePredicate> MapEntry;
-    BOOST_FOREACH(const MapEntry &entry, preds_by_column_.equal_range(col_idx)) {
-      const ColumnRangePredicate &pred = entry.second;
+    for (PredIter it = col_preds.first; it != col_preds.second; ++it) {
+      const ColumnRangePredicate &pred = it->second;
 
-      pred.Evaluate(dst, dst->selection_vector());
+      if (it != col_preds.first || !first_pred_evaluated) {
+        pred.Evaluate(dst, dst->selection_vector());
+      }
 
       // If after evaluating this predicate, the entire row block has now been
       // filtered out, we don't need to materialize other columns at all.
@@ -595,4 +621,257 @@ string PredicateEvaluatingIterator::ToString() const {
 }
 
 
+////////////////////////////////////////////////////////////
+// PrefetchingIterator
+////////////////////////////////////////////////////////////
+
+struct PrefetchingIterator::Buffer {
+  Buffer(const Schema& schema, size_t nrows)
+    : arena(32 * 1024, 1 * 1024 * 1024),
+      block(schema, nrows, &arena),
+      next_row(0) {
+  }
+
+  Arena arena;
+  RowBlock block;
+
+  // The first row of 'block' which hasn't yet been returned.
+  size_t next_row;
+};
+
+// Copy rows [src_offset, src_offset + dst->nrows()) of 'src' into 'dst',
+// along with their selection bits. The indirect data of selected cells is
+// relocated into dst's arena.
+static Status CopyRowBlockRange(const RowBlock& src, size_t src_offset, RowBlock* dst) {
+  size_t nrows = dst->nrows();
+  DCHECK_LE(src_offset + nrows, src.nrows());
+
+  const SelectionVector* src_sel = src.selection_vector();
+  SelectionVector* dst_sel = dst->selection_vector();
+  for (size_t i = 0; i < nrows; i++) {
+    BitmapChange(dst_sel->mutable_bitmap(), i, src_sel->IsRowSelected(src_offset + i));
+  }
+
+  for (size_t col_idx = 0; col_idx < src.schema().num_columns(); col_idx++) {
+    ColumnBlock src_col(src.column_block(col_idx));
+    ColumnBlock dst_col(dst->column_block(col_idx));
+    memcpy(dst_col.data(), src_col.cell_ptr(src_offset), src_col.stride() * nrows);
+    if (src_col.is_nullable()) {
+      for (size_t i = 0; i < nrows; i++) {
+        dst_col.SetCellIsNull(i, src_col.is_null(src_offset + i));
+      }
+    }
+
+    if (src_col.type_info()->physical_type() != BINARY) {
+      continue;
+    }
+    Slice* slices = reinterpret_cast<Slice*>(dst_col.data());
+    for (size_t i = 0; i < nrows; i++) {
+      if (!dst_sel->IsRowSelected(i) || (dst_col.is_nullable() && dst_col.is_null(i))) {
+        continue;
+      }
+      if (PREDICT_FALSE(!dst->arena()->RelocateSlice(slices[i], &slices[i]))) {
+        return Status::IOError("out of memory copying slice", slices[i].ToString());
+      }
+    }
+  }
+  return Status::OK();
+}
+
+void PrefetchingIterator::WrapForParallelScan(ThreadPool* pool, int parallelism,
+                                              int max_buffered_blocks,
+                                              vector<shared_ptr<RowwiseIterator> >* iters) {
+  CHECK_GT(parallelism, 0);
+  vector<PrefetchingIterator*> wrappers;
+  BOOST_FOREACH(shared_ptr<RowwiseIterator>& iter, *iters) {
+    PrefetchingIterator* wrapper = new PrefetchingIterator(iter, pool, max_buffered_blocks);
+    iter.reset(wrapper);
+    wrappers.push_back(wrapper);
+  }
+  for (int i = 0; i < wrappers.size(); i++) {
+    if (i < parallelism) {
+      wrappers[i]->start_on_init_ = true;
+    }
+    if (i + parallelism < wrappers.size()) {
+      wrappers[i]->successor_ = wrappers[i + parallelism];
+    }
+  }
+}
+
+PrefetchingIterator::PrefetchingIterator(const shared_ptr<RowwiseIterator>& iter,
+                                         ThreadPool* pool,
+                                         int max_buffered_blocks)
+  : iter_(iter),
+    pool_(pool),
+    max_buffered_blocks_(max_buffered_blocks),
+    successor_(NULL),
+    start_on_init_(false),
+    cond_(&lock_),
+    initted_(false),
+    start_requested_(false),
+    running_(false),
+    exhausted_(false),
+    stopping_(false) {
+  CHECK_GT(max_buffered_blocks_, 0);
+}
+
+PrefetchingIterator::~PrefetchingIterator() {
+  {
+    MutexLock l(lock_);
+    stopping_ = true;
+    while (running_) {
+      cond_.Wait();
+    }
+  }
+  STLDeleteElements(&all_buffers_);
+}
+
+Status PrefetchingIterator::Init(ScanSpec *spec) {
+  // Let the wrapped iterator (or a wrapper around it) evaluate all of the
+  // predicates, so that the evaluation happens on the pool too.
+  RETURN_NOT_OK(PredicateEvaluatingIterator::InitAndMaybeWrap(&iter_, spec));
+
+  MutexLock l(lock_);
+  initted_ = true;
+  if (start_on_init_) {
+    start_requested_ = true;
+  }
+  MaybeSubmitPrefetchTaskUnlocked();
+  return Status::OK();
+}
+
+void PrefetchingIterator::StartPrefetching() {
+  MutexLock l(lock_);
+  start_requested_ = true;
+  MaybeSubmitPrefetchTaskUnlocked();
+}
+
+void PrefetchingIterator::MaybeSubmitPrefetchTaskUnlocked() {
+  lock_.AssertAcquired();
+  if (!initted_ || !start_requested_ || running_ || exhausted_ || stopping_ ||
+      !status_.ok() || buffered_.size() >= max_buffered_blocks_) {
+    return;
+  }
+  Status s = pool_->SubmitClosure(Bind(&PrefetchingIterator::PrefetchTask, Unretained(this)));
+  if (PREDICT_FALSE(!s.ok())) {
+    status_ = s.CloneAndPrepend("Unable to submit prefetch task");
+    return;
+  }
+  running_ = true;
+}
+
+void PrefetchingIterator::PrefetchTask() {
+  MutexLock l(lock_);
+  DCHECK(running_);
+  while (!stopping_ && !exhausted_ && status_.ok() &&
+         buffered_.size() < max_buffered_blocks_) {
+    Buffer* buf;
+    if (free_.empty()) {
+      buf = new Buffer(iter_->schema(), kBufferRows);
+      all_buffers_.push_back(buf);
+    } else {
+      buf = free_.back();
+      free_.pop_back();
+    }
+
+    l.Unlock();
+    bool has_next = iter_->HasNext();
+    Status s;
+    if (has_next) {
+      s = iter_->NextBlock(&buf->block);
+    }
+    l.Lock();
+
+    if (!has_next || !s.ok() || buf->block.nrows() == 0) {
+      exhausted_ = !has_next;
+      status_ = s;
+      free_.push_back(buf);
+      continue;
+    }
+    buf->next_row = 0;
+    buffered_.push_back(buf);
+    cond_.Broadcast();
+  }
+
+  // Hand off to the next iterator in the scan, if any, once this one has
+  // nothing left to decode.
+  if (exhausted_ || !status_.ok()) {
+    PrefetchingIterator* successor = successor_;
+    successor_ = NULL;
+    if (successor != NULL) {
+      l.Unlock();
+      successor->StartPrefetching();
+      l.Lock();
+    }
+  }
+  running_ = false;
+  cond_.Broadcast();
+}
+
+void PrefetchingIterator::WaitForBlockUnlocked() const {
+  lock_.AssertAcquired();
+  while (buffered_.empty() && running_) {
+    cond_.Wait();
+  }
+}
+
+bool PrefetchingIterator::HasNext() const {
+  // A consumer may read this iterator before it was started, e.g. if the
+  // scan reaches it before its predecessor is exhausted.
+  const_cast<PrefetchingIterator*>(this)->StartPrefetching();
+
+  MutexLock l(lock_);
+  DCHECK(initted_);
+  WaitForBlockUnlocked();
+  return !buffered_.empty() || !status_.ok();
+}
+
+Status PrefetchingIterator::NextBlock(RowBlock *dst) {
+  StartPrefetching();
+  if (dst->arena()) {
+    dst->arena()->Reset();
+  }
+
+  Buffer* buf;
+  {
+    MutexLock l(lock_);
+    DCHECK(initted_);
+    WaitForBlockUnlocked();
+    if (buffered_.empty()) {
+      RETURN_NOT_OK(status_);
+      return Status::NotFound("No more rows");
+    }
+    // The front buffer is only accessed by the consumer, so it can be
+    // copied from without holding the lock.
+    buf = buffered_.front();
+  }
+
+  size_t nrows = std::min(dst->row_capacity(), buf->block.nrows() - buf->next_row);
+  dst->Resize(nrows);
+  Status s = CopyRowBlockRange(buf->block, buf->next_row, dst);
+  buf->next_row += nrows;
+
+  MutexLock l(lock_);
+  if (buf->next_row == buf->block.nrows()) {
+    buffered_.pop_front();
+    free_.push_back(buf);
+    MaybeSubmitPrefetchTaskUnlocked();
+  }
+  return s;
+}
+
+string PrefetchingIterator::ToString() const {
+  string s;
+  s.append("Prefetching(").append(iter_->ToString()).append(")");
+  return s;
+}
+
+void PrefetchingIterator::GetIteratorStats(std::vector<IteratorStats>* stats) const {
+  MutexLock l(lock_);
+  while (running_) {
+    cond_.Wait();
+  }
+  iter_->GetIteratorStats(stats);
+}
+
 } // namespace kudu
@@ -23,12 +23,16 @@
 
 #include "kudu/common/iterator.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/object_pool.h"
+#include "kudu/util/status.h"
 
 namespace kudu {
 
 class Arena;
 class MergeIterState;
+class ThreadPool;
 
 using std::deque;
 using std::tr1::shared_ptr;
@@ -224,5 +228,122 @@ class PredicateEvaluatingIterator : public RowwiseIterator {
   vector<ColumnRangePredicate> predicates_;
 };
 
+// An iterator which wraps another iterator and decodes its blocks ahead of
+// time on a thread pool, so that several iterators (e.g. one per rowset)
+// can be decoded in parallel while their results are consumed by a single
+// thread. The wrapped iterator's blocks are buffered and then copied into
+// the caller's blocks, in order.
+//
+// The wrapped iterator evaluates any predicates itself, so the predicate
+// evaluation is done on the thread pool as well.
+class PrefetchingIterator : public RowwiseIterator {
+ public:
+  // The default maximum number of decoded blocks buffered ahead of the
+  // consumer by each iterator.
+  static const int kDefaultMaxBufferedBlocks = 4;
+
+  // Wrap each of 'iters' in a PrefetchingIterator which decodes on 'pool'
+  // and buffers at most 'max_buffered_blocks' blocks.
+  //
+  // The first 'parallelism' iterators start prefetching as soon as they are
+  // initialized. Each of the others starts once the iterator 'parallelism'
+  // positions before it is exhausted, which suits consumers which read the
+  // iterators one after another, such as UnionIterator. Consumers which read
+  // them all at once, such as MergeIterator, should pass a 'parallelism' of
+  // at least iters->size(), and a 'max_buffered_blocks' small enough that
+  // all of the iterators' buffers together fit the memory they may use.
+  static void WrapForParallelScan(ThreadPool* pool, int parallelism,
+                                  int max_buffered_blocks,
+                                  vector<shared_ptr<RowwiseIterator> >* iters);
+
+  // Construct an iterator which prefetches 'iter' on 'pool', buffering at
+  // most 'max_buffered_blocks' blocks. 'iter' must not yet be initialized.
+  // Prefetching doesn't start until StartPrefetching() is called, or until
+  // the iterator is first read from.
+  PrefetchingIterator(const shared_ptr<RowwiseIterator>& iter, ThreadPool* pool,
+                      int max_buffered_blocks = kDefaultMaxBufferedBlocks);
+
+  // Waits for any in-flight prefetching to finish.
+  virtual ~PrefetchingIterator();
+
+  // Initialize the wrapped iterator.
+  // POSTCONDITION: spec->predicates().empty()
+  Status Init(ScanSpec *spec) OVERRIDE;
+
+  // Waits until a prefetched block is available or the wrapped iterator is
+  // exhausted.
+  bool HasNext() const OVERRIDE;
+
+  virtual Status NextBlock(RowBlock *dst) OVERRIDE;
+
+  string ToString() const OVERRIDE;
+
+  const Schema &schema() const OVERRIDE {
+    return iter_->schema();
+  }
+
+  // Waits for any in-flight prefetching to finish before collecting the
+  // wrapped iterator's stats.
+  virtual void GetIteratorStats(std::vector<IteratorStats>* stats) const OVERRIDE;
+
+  // Start decoding blocks in the background. If the iterator hasn't been
+  // initialized yet, it starts once it is. Calling this more than once has
+  // no effect.
+  void StartPrefetching();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PrefetchingIterator);
+  FRIEND_TEST(TestPrefetchingIterator, TestMergeWithBoundedBuffers);
+
+  struct Buffer;
+
+  // The number of rows in each decoded block.
+  static const size_t kBufferRows = 100;
+
+  // Submit PrefetchTask() to the pool, unless it is already running or
+  // there's nothing left for it to do.
+  // REQUIRES: lock_ is held.
+  void MaybeSubmitPrefetchTaskUnlocked();
+
+  // Decode blocks into free buffers until max_buffered_blocks_ are buffered,
+  // the wrapped iterator is exhausted, or it returns an error. Runs on the
+  // pool; the wrapped iterator is only accessed by this task while it runs.
+  void PrefetchTask();
+
+  // Wait until a block is buffered or there's no prefetching in progress.
+  // REQUIRES: lock_ is held.
+  void WaitForBlockUnlocked() const;
+
+  shared_ptr<RowwiseIterator> iter_;
+  ThreadPool* const pool_;
+
+  // The maximum number of decoded blocks buffered ahead of the consumer.
+  const int max_buffered_blocks_;
+
+  // The iterator to start prefetching once this one is exhausted.
+  // See WrapForParallelScan().
+  PrefetchingIterator* successor_;
+  bool start_on_init_;
+
+  // Protects all of the members below, and signals changes to them.
+  mutable Mutex lock_;
+  mutable ConditionVariable cond_;
+
+  bool initted_;
+  bool start_requested_;
+  bool running_;
+  bool exhausted_;
+  bool stopping_;
+
+  // The first error returned by the wrapped iterator, if any. It is returned
+  // once all of the blocks decoded before it have been consumed.
+  Status status_;
+
+  // Decoded blocks, in order, and buffers available for decoding into.
+  deque<Buffer*> buffered_;
+  vector<Buffer*> free_;
+  vector<Buffer*> all_buffers_;
+};
+
 } // namespace kudu
 #endif
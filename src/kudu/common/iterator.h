@@ -27,6 +27,7 @@
 namespace kudu {
 
 class Arena;
+class ColumnRangePredicate;
 class RowBlock;
 class ScanSpec;
 
@@ -96,6 +97,35 @@ class ColumnwiseIterator : public virtual IteratorBase {
   // arena, if non-null.
   virtual Status MaterializeColumn(size_t col_idx, ColumnBlock *dst) = 0;
 
+  // Like MaterializeColumn(), but only the rows which are set in 'sel' are
+  // guaranteed to be materialized. The contents of unselected cells are
+  // undefined. Implementations may use this to avoid decoding runs of
+  // rows which were already filtered out by predicates on other columns.
+  //
+  // The default implementation materializes every row.
+  virtual Status MaterializeColumnSelected(size_t col_idx, ColumnBlock *dst,
+                                           const SelectionVector& sel) {
+    return MaterializeColumn(col_idx, dst);
+  }
+
+  // Like MaterializeColumnSelected(), but also gives the implementation a
+  // chance to evaluate 'pred', a predicate on the column, while
+  // materializing it. If the implementation evaluates the predicate, it
+  // clears the bits in 'sel' of the rows which do not match and sets
+  // '*evaluated' to true; the cells of those rows may then be left
+  // unmaterialized. Otherwise it sets '*evaluated' to false, leaves 'sel'
+  // unchanged, and the caller must evaluate the predicate itself.
+  //
+  // The default implementation never evaluates the predicate.
+  virtual Status MaterializeColumnAndEvaluate(size_t col_idx,
+                                              const ColumnRangePredicate& pred,
+                                              ColumnBlock *dst,
+                                              SelectionVector *sel,
+                                              bool *evaluated) {
+    *evaluated = false;
+    return MaterializeColumnSelected(col_idx, dst, *sel);
+  }
+
   // Finish the current batch.
   virtual Status FinishBatch() = 0;
 
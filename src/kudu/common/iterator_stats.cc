@@ -25,22 +25,30 @@ using strings::Substitute;
 IteratorStats::IteratorStats()
     : data_blocks_read_from_disk(0),
       bytes_read_from_disk(0),
-      cells_read_from_disk(0) {
+      cells_read_from_disk(0),
+      data_blocks_from_decoded_cache(0),
+      cells_skipped(0) {
 }
 
 string IteratorStats::ToString() const {
   return Substitute("data_blocks_read_from_disk=$0 "
                     "bytes_read_from_disk=$1 "
-                    "cells_read_from_disk=$2",
+                    "cells_read_from_disk=$2 "
+                    "data_blocks_from_decoded_cache=$3 "
+                    "cells_skipped=$4",
                     data_blocks_read_from_disk,
                     bytes_read_from_disk,
-                    cells_read_from_disk);
+                    cells_read_from_disk,
+                    data_blocks_from_decoded_cache,
+                    cells_skipped);
 }
 
 void IteratorStats::AddStats(const IteratorStats& other) {
   data_blocks_read_from_disk += other.data_blocks_read_from_disk;
   bytes_read_from_disk += other.bytes_read_from_disk;
   cells_read_from_disk += other.cells_read_from_disk;
+  data_blocks_from_decoded_cache += other.data_blocks_from_decoded_cache;
+  cells_skipped += other.cells_skipped;
   DCheckNonNegative();
 }
 
@@ -48,6 +56,8 @@ void IteratorStats::SubtractStats(const IteratorStats& other) {
   data_blocks_read_from_disk -= other.data_blocks_read_from_disk;
   bytes_read_from_disk -= other.bytes_read_from_disk;
   cells_read_from_disk -= other.cells_read_from_disk;
+  data_blocks_from_decoded_cache -= other.data_blocks_from_decoded_cache;
+  cells_skipped -= other.cells_skipped;
   DCheckNonNegative();
 }
 
@@ -55,6 +65,8 @@ void IteratorStats::DCheckNonNegative() const {
   DCHECK_GE(data_blocks_read_from_disk, 0);
   DCHECK_GE(bytes_read_from_disk, 0);
   DCHECK_GE(cells_read_from_disk, 0);
+  DCHECK_GE(data_blocks_from_decoded_cache, 0);
+  DCHECK_GE(cells_skipped, 0);
 }
 
 
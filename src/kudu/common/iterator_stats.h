@@ -25,6 +25,7 @@ struct IteratorStats {
   std::string ToString() const;
 
   // The number of data blocks read from disk (or cache) by the iterator.
+  // Blocks served from the decoded block cache are not included.
   int64_t data_blocks_read_from_disk;
 
   // The number of bytes read from disk (or cache) by the iterator.
@@ -34,6 +35,15 @@ struct IteratorStats {
   // they were decoded/materialized.
   int64_t cells_read_from_disk;
 
+  // The number of data blocks which the iterator took already decoded from
+  // the decoded block cache, without reading or decoding them again.
+  int64_t data_blocks_from_decoded_cache;
+
+  // The number of cells which the iterator skipped over without decoding
+  // because no row in the selection vector referenced them (late
+  // materialization).
+  int64_t cells_skipped;
+
   // Add statistics contained 'other' to this object (for each field
   // in this object, increment it by the value of the equivalent field
   // in 'other').
@@ -15,8 +15,12 @@
 #include <boost/assign/list_of.hpp>
 #include <gtest/gtest.h>
 
+#include "kudu/common/predicate_kernels.h"
 #include "kudu/common/scan_predicate.h"
 #include "kudu/common/rowblock.h"
+#include "kudu/gutil/mathlimits.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/random.h"
 #include "kudu/util/test_util.h"
 
 namespace kudu {
@@ -110,6 +114,151 @@ TEST_F(TestPredicate, TestColumnRange) {
   ASSERT_EQ(5, selvec.CountSelected()) << "Only 5 rows should be left (25-29)";
 }
 
+TEST_F(TestPredicate, TestInList) {
+  SelectionVector selvec(n_rows_);
+  selvec.SetAllTrue();
+
+  // Apply predicate col1 IN (990, 30, 35, 500, 30, 5000). Duplicates and
+  // values which don't appear in the block are allowed.
+  uint32_t vals[] = { 990, 30, 35, 500, 30, 5000 };
+  vector<const void*> in_list;
+  for (int i = 0; i < arraysize(vals); i++) {
+    in_list.push_back(&vals[i]);
+  }
+  ColumnRangePredicate pred = ColumnRangePredicate::InList(schema_.column(1), in_list);
+  ASSERT_EQ(ColumnRangePredicate::IN_LIST, pred.predicate_type());
+  ASSERT_EQ("(`col1` IN (30, 35, 500, 990, 5000))", pred.ToString());
+  ASSERT_EQ(30, *reinterpret_cast<const uint32_t*>(pred.range().lower_bound()));
+  ASSERT_EQ(5000, *reinterpret_cast<const uint32_t*>(pred.range().upper_bound()));
+  pred.Evaluate(&row_block_, &selvec);
+  ASSERT_EQ(3, selvec.CountSelected());
+  ASSERT_TRUE(selvec.IsRowSelected(3));
+  ASSERT_TRUE(selvec.IsRowSelected(50));
+  ASSERT_TRUE(selvec.IsRowSelected(99));
+
+  // A list with a single distinct value is just an equality predicate.
+  in_list.assign(3, &vals[1]);
+  ColumnRangePredicate eq = ColumnRangePredicate::InList(schema_.column(1), in_list);
+  ASSERT_EQ(ColumnRangePredicate::RANGE, eq.predicate_type());
+  ASSERT_TRUE(eq.range().IsEquality());
+  ASSERT_EQ("(`col1` BETWEEN 30 AND 30)", eq.ToString());
+}
+
+TEST_F(TestPredicate, TestNullPredicates) {
+  Schema schema(boost::assign::list_of
+                (ColumnSchema("key", UINT32))
+                (ColumnSchema("val", UINT32, true)),
+                1);
+  RowBlock block(schema, n_rows_, &arena_);
+
+  // Every third row has a NULL value.
+  ColumnBlock val_col = block.column_block(1, n_rows_);
+  for (uint32_t i = 0; i < n_rows_; i++) {
+    block.column_block(0, n_rows_).SetCellValue(i, &i);
+    val_col.SetCellIsNull(i, i % 3 == 0);
+    val_col.SetCellValue(i, &i);
+  }
+  int num_nulls = (n_rows_ + 2) / 3;
+
+  SelectionVector selvec(n_rows_);
+  selvec.SetAllTrue();
+  ColumnRangePredicate is_null = ColumnRangePredicate::IsNull(schema.column(1));
+  ASSERT_EQ("(`val` IS NULL)", is_null.ToString());
+  ASSERT_FALSE(is_null.range().has_lower_bound());
+  ASSERT_FALSE(is_null.range().has_upper_bound());
+  is_null.Evaluate(&block, &selvec);
+  ASSERT_EQ(num_nulls, selvec.CountSelected());
+
+  selvec.SetAllTrue();
+  ColumnRangePredicate not_null = ColumnRangePredicate::IsNotNull(schema.column(1));
+  ASSERT_EQ("(`val` IS NOT NULL)", not_null.ToString());
+  not_null.Evaluate(&block, &selvec);
+  ASSERT_EQ(n_rows_ - num_nulls, selvec.CountSelected());
+
+  // A non-nullable column is never NULL.
+  selvec.SetAllTrue();
+  ColumnRangePredicate::IsNotNull(schema.column(0)).Evaluate(&block, &selvec);
+  ASSERT_EQ(n_rows_, selvec.CountSelected());
+  ColumnRangePredicate::IsNull(schema.column(0)).Evaluate(&block, &selvec);
+  ASSERT_EQ(0, selvec.CountSelected());
+}
+
+// Compare the word-at-a-time range kernel for 'Type' against evaluating
+// ValueRange::ContainsCell() on each row, over a nullable column with an
+// arbitrary initial selection.
+template<DataType Type>
+static void CheckRangeKernel(Random* rng, size_t nrows) {
+  typedef typename DataTypeTraits<Type>::cpp_type T;
+  SCOPED_TRACE(strings::Substitute("$0: $1 rows", DataTypeTraits<Type>::name(), nrows));
+
+  Arena arena(1024, 1024 * 1024);
+  Schema schema(boost::assign::list_of
+                (ColumnSchema("key", UINT32))
+                (ColumnSchema("c", Type, true)),
+                1);
+  RowBlock block(schema, nrows, &arena);
+  ColumnBlock cblock = block.column_block(1, nrows);
+
+  // Use a narrow value domain, including negative values for signed types,
+  // so that a good fraction of rows match. For unsigned types, the negative
+  // values wrap around to just below the maximum.
+  for (size_t i = 0; i < nrows; i++) {
+    T val = static_cast<T>(static_cast<int>(rng->Uniform(20)) - 10);
+    cblock.SetCellValue(i, &val);
+    cblock.SetCellIsNull(i, rng->OneIn(5));
+  }
+
+  // For unsigned types, the range covers values at both ends of the domain,
+  // which a signed comparison would get wrong.
+  T lower, upper;
+  if (MathLimits<T>::kIsSigned) {
+    lower = static_cast<T>(-3);
+    upper = 4;
+  } else {
+    lower = 3;
+    upper = MathLimits<T>::kMax - 3;
+  }
+  const void* bounds[][2] = {
+    { &lower, &upper },
+    { &lower, NULL },
+    { NULL, &upper }
+  };
+  for (int b = 0; b < arraysize(bounds); b++) {
+    ValueRange range(cblock.type_info(), bounds[b][0], bounds[b][1]);
+
+    SelectionVector expected(nrows);
+    SelectionVector actual(nrows);
+    for (size_t i = 0; i < nrows; i++) {
+      bool selected = !rng->OneIn(4);
+      BitmapChange(actual.mutable_bitmap(), i, selected);
+      BitmapChange(expected.mutable_bitmap(), i,
+                   selected && !cblock.is_null(i) && range.ContainsCell(cblock.cell_ptr(i)));
+    }
+
+    predicate_kernels::EvaluateRange(cblock, bounds[b][0], bounds[b][1], &actual);
+    for (size_t i = 0; i < nrows; i++) {
+      ASSERT_EQ(expected.IsRowSelected(i), actual.IsRowSelected(i)) << "row " << i;
+    }
+  }
+}
+
+TEST_F(TestPredicate, TestRangeKernels) {
+  Random rng(SeedRandom());
+  // Exercise partial, exact and multiple 64-row words.
+  const size_t kRowCounts[] = { 1, 7, 63, 64, 65, 130, 1000 };
+  for (int i = 0; i < arraysize(kRowCounts); i++) {
+    size_t nrows = kRowCounts[i];
+    CheckRangeKernel<INT8>(&rng, nrows);
+    CheckRangeKernel<UINT8>(&rng, nrows);
+    CheckRangeKernel<INT16>(&rng, nrows);
+    CheckRangeKernel<UINT16>(&rng, nrows);
+    CheckRangeKernel<INT32>(&rng, nrows);
+    CheckRangeKernel<UINT32>(&rng, nrows);
+    CheckRangeKernel<INT64>(&rng, nrows);
+    CheckRangeKernel<UINT64>(&rng, nrows);
+  }
+}
+
 // Regression test for KUDU-54: should not try to access rows for which the
 // selection vector is 0.
 TEST_F(TestPredicate, TestDontEvalauteOnUnselectedRows) {
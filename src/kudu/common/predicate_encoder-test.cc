@@ -182,6 +182,40 @@ TEST_F(CompositeIntKeysTest, TestRedundantUpperBound2) {
             spec.ToStringWithSchema(schema_));
 }
 
+// Test that an IN-list following the equality prefix is converted into one
+// key range per value, and that the IN-list itself is never erased.
+//
+// Predicate: a == 1 AND b IN (7, 3, 255, 100) AND b <= 200
+TEST_F(CompositeIntKeysTest, TestInListKeyRanges) {
+  ScanSpec spec;
+  AddPredicate<uint8_t>(&spec, "a", EQ, 1);
+  AddPredicate<uint8_t>(&spec, "b", LE, 200);
+  uint8_t vals[] = { 7, 3, 255, 100 };
+  vector<const void*> in_list;
+  for (int i = 0; i < arraysize(vals); i++) {
+    in_list.push_back(&vals[i]);
+  }
+  spec.AddPredicate(ColumnRangePredicate::InList(schema_.column(1), in_list));
+  SCOPED_TRACE(spec.ToStringWithSchema(schema_));
+  ASSERT_NO_FATAL_FAILURE(enc_.EncodeRangePredicates(&spec, true));
+  EXPECT_EQ("PK >= (uint8 a=1, uint8 b=3, uint8 c=0) AND "
+            "PK < (uint8 a=1, uint8 b=201, uint8 c=0)\n"
+            "(`b` IN (3, 7, 100, 255))",
+            spec.ToStringWithSchema(schema_));
+
+  // 255 is excluded by the upper bound on 'b'.
+  ASSERT_EQ(3, spec.key_ranges().size());
+  const char* expected[] = {
+    "PK >= (uint8 a=1, uint8 b=3, uint8 c=0) AND PK < (uint8 a=1, uint8 b=4, uint8 c=0)",
+    "PK >= (uint8 a=1, uint8 b=7, uint8 c=0) AND PK < (uint8 a=1, uint8 b=8, uint8 c=0)",
+    "PK >= (uint8 a=1, uint8 b=100, uint8 c=0) AND PK < (uint8 a=1, uint8 b=101, uint8 c=0)"
+  };
+  for (int i = 0; i < spec.key_ranges().size(); i++) {
+    EXPECT_EQ(expected[i], EncodedKey::RangeToStringWithSchema(
+                  spec.key_ranges()[i].lower, spec.key_ranges()[i].exclusive_upper, schema_));
+  }
+}
+
 // Test that, if so desired, pushed predicates are not erased.
 //
 // Predicate: a == 254
@@ -149,12 +149,19 @@ void RangePredicateEncoder::EncodeRangePredicates(ScanSpec *spec, bool erase_pus
   VLOG(4) << "Lower: " << key_schema_->DebugRowKey(lower_key) << "(" << lower_len << ")";
   VLOG(4) << "Upper: " << key_schema_->DebugRowKey(upper_key) << "(" << upper_len << ")";
 
-  // Step 5. Erase the pushed predicates from the ScanSpec.
+  // Step 5. Convert an IN-list following the equality prefix into one key
+  // range per value, so that storage can seek between them.
+  if (equality_prefix < max_push_len &&
+      key_bounds[equality_prefix].in_list_values.size() > 1) {
+    EncodeInListKeyRanges(lower_buf, equality_prefix, key_bounds[equality_prefix], spec);
+  }
+
+  // Step 6. Erase the pushed predicates from the ScanSpec.
   if (erase_pushed) {
     ErasePushedPredicates(spec, was_pushed);
   }
 
-  // Step 6. Add the new range predicates to the spec.
+  // Step 7. Add the new range predicates to the spec.
   if (lower_len) {
     EncodedKey* lower = EncodedKey::FromContiguousRow(ConstContiguousRow(lower_key)).release();
     pool_.Add(lower);
@@ -180,9 +187,25 @@ void RangePredicateEncoder::SimplifyBounds(const ScanSpec& spec,
     }
     const ColumnSchema& col = key_schema_->column(idx);
 
-    // Add to the list of pushable predicates for this column.
-    CHECK(pred.range().has_lower_bound() || pred.range().has_upper_bound());
-    (*key_bounds)[idx].orig_predicate_indexes.push_back(i);
+    switch (pred.predicate_type()) {
+      case ColumnRangePredicate::RANGE:
+        // Add to the list of pushable predicates for this column.
+        CHECK(pred.range().has_lower_bound() || pred.range().has_upper_bound());
+        (*key_bounds)[idx].orig_predicate_indexes.push_back(i);
+        break;
+      case ColumnRangePredicate::IN_LIST:
+        // The IN-list's [min, max] range tightens the bounds, but the
+        // predicate itself still has to be evaluated, so it isn't recorded
+        // as pushable.
+        if ((*key_bounds)[idx].in_list_values.empty()) {
+          (*key_bounds)[idx].in_list_values = pred.in_list_values();
+        }
+        break;
+      case ColumnRangePredicate::IS_NULL:
+      case ColumnRangePredicate::IS_NOT_NULL:
+        // Key columns are never NULL; leave these for evaluation.
+        continue;
+    }
 
     if (pred.range().has_upper_bound()) {
       // If we haven't seen any upper bound, or this upper bound is tighter than
@@ -206,6 +229,39 @@ void RangePredicateEncoder::SimplifyBounds(const ScanSpec& spec,
   }
 }
 
+void RangePredicateEncoder::EncodeInListKeyRanges(const uint8_t* prefix_key,
+                                                  int col_idx,
+                                                  const SimplifiedBounds& bounds,
+                                                  ScanSpec* spec) {
+  const ColumnSchema& col = key_schema_->column(col_idx);
+  const TypeInfo* type = col.type_info();
+
+  BOOST_FOREACH(const void* value, bounds.in_list_values) {
+    // Other predicates on the column may have narrowed the bounds further.
+    if ((bounds.lower && type->Compare(value, bounds.lower) < 0) ||
+        (bounds.upper && type->Compare(value, bounds.upper) > 0)) {
+      continue;
+    }
+
+    // The range for 'value' is [(prefix, value, <min>...), (prefix, value + 1, <min>...)).
+    uint8_t* buf = static_cast<uint8_t*>(
+        CHECK_NOTNULL(arena_->AllocateBytes(key_schema_->key_byte_size())));
+    ContiguousRow key(key_schema_, buf);
+    memcpy(buf, prefix_key, key_schema_->key_byte_size());
+    memcpy(key.mutable_cell_ptr(col_idx), value, type->size());
+
+    EncodedKey* lower = EncodedKey::FromContiguousRow(ConstContiguousRow(key)).release();
+    pool_.Add(lower);
+
+    EncodedKey* upper = NULL;
+    if (row_key_util::IncrementKeyPrefix(&key, col_idx + 1, arena_)) {
+      upper = EncodedKey::FromContiguousRow(ConstContiguousRow(key)).release();
+      pool_.Add(upper);
+    }
+    spec->AddKeyRange(lower, upper);
+  }
+}
+
 int RangePredicateEncoder::CountKeyPrefixEqualities(
     const vector<SimplifiedBounds>& key_bounds) const {
 
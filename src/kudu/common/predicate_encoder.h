@@ -46,6 +46,10 @@ class RangePredicateEncoder {
   // then emitted back into 'spec'.
   //
   // If 'erase_pushed' is true, pushed predicates are removed from 'spec'.
+  //
+  // An IN-list predicate on the first key column past the equality prefix
+  // additionally yields one key range per value (see ScanSpec::AddKeyRange).
+  // IN-list predicates are never erased from 'spec'.
   void EncodeRangePredicates(ScanSpec *spec, bool erase_pushed);
 
  private:
@@ -57,11 +61,21 @@ class RangePredicateEncoder {
     const void* upper;
     const void* lower;
     vector<int> orig_predicate_indexes;
+    // Sorted values of the first IN-list predicate on the column, if any.
+    vector<const void*> in_list_values;
   };
 
   void SimplifyBounds(const ScanSpec& spec,
                       std::vector<SimplifiedBounds>* key_bounds) const;
 
+  // Adds a key range to 'spec' for each IN-list value on key column
+  // 'col_idx' which lies within that column's bounds. 'prefix_key' is a
+  // key tuple holding the values of the preceding equality columns.
+  void EncodeInListKeyRanges(const uint8_t* prefix_key,
+                             int col_idx,
+                             const SimplifiedBounds& bounds,
+                             ScanSpec* spec);
+
   // Returns the number of contiguous equalities in the key prefix.
   int CountKeyPrefixEqualities(const std::vector<SimplifiedBounds>& bounds) const;
 
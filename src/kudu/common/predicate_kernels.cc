@@ -0,0 +1,341 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kudu/common/predicate_kernels.h"
+
+#include <algorithm>
+#include <glog/logging.h>
+#include <nmmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include <string.h>
+
+#include "kudu/common/rowblock.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/mathlimits.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/bitmap.h"
+
+// The kernels load bitmaps 64 bits at a time, relying on bit 'i' of a
+// little-endian word corresponding to bit 'i % 8' of byte 'i / 8'.
+#ifndef IS_LITTLE_ENDIAN
+#error "predicate kernels require a little-endian platform"
+#endif
+
+namespace kudu {
+namespace predicate_kernels {
+
+namespace {
+
+const size_t kRowsPerWord = 64;
+
+// Load the bits for 'nrows' rows starting at 'row' (a multiple of
+// kRowsPerWord). Bits past 'nrows' are zero.
+inline uint64_t LoadWord(const uint8_t* bitmap, size_t row, size_t nrows) {
+  uint64_t word = 0;
+  memcpy(&word, bitmap + row / 8, BitmapSize(nrows));
+  return word;
+}
+
+inline void StoreWord(uint8_t* bitmap, size_t row, size_t nrows, uint64_t word) {
+  memcpy(bitmap + row / 8, &word, BitmapSize(nrows));
+}
+
+// Pack an array of 'n' 0/1 bytes into a bitmap word.
+inline uint64_t PackBytes(const uint8_t* bytes, size_t n) {
+  uint64_t word = 0;
+  if (PREDICT_TRUE(n == kRowsPerWord)) {
+    for (int i = 0; i < kRowsPerWord; i += 16) {
+      // Shift each 0/1 byte's low bit into its high bit for movemask.
+      __m128i v = _mm_slli_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i)), 7);
+      word |= static_cast<uint64_t>(_mm_movemask_epi8(v)) << i;
+    }
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      word |= static_cast<uint64_t>(bytes[i]) << i;
+    }
+  }
+  return word;
+}
+
+// Matches cells of any integer type against an inclusive range with a
+// branch-free loop.
+template<typename T>
+class ScalarRangeMatcher {
+ public:
+  ScalarRangeMatcher(T lower, T upper)
+    : lower_(lower),
+      upper_(upper) {
+  }
+
+  // Return a word with bit 'i' set if cells[i] is within the range,
+  // for i < n <= kRowsPerWord.
+  uint64_t Match(const T* cells, size_t n) const {
+    uint8_t matches[kRowsPerWord];
+    for (size_t i = 0; i < n; i++) {
+      matches[i] = (cells[i] >= lower_) & (cells[i] <= upper_);
+    }
+    return PackBytes(matches, n);
+  }
+
+ private:
+  const T lower_;
+  const T upper_;
+};
+
+// SSE/AVX only provide signed integer comparisons. Flipping the sign bit
+// maps unsigned values onto signed values with the same ordering.
+template<typename T, typename SignedT>
+inline SignedT SignBias() {
+  return MathLimits<T>::kIsSigned ? 0 : MathLimits<SignedT>::kMin;
+}
+
+// Matches 32-bit integer cells using SIMD comparisons.
+template<typename T>
+class Simd32RangeMatcher {
+ public:
+  Simd32RangeMatcher(T lower, T upper)
+    : scalar_(lower, upper) {
+    int32_t bias = SignBias<T, int32_t>();
+#ifdef __AVX2__
+    bias_ = _mm256_set1_epi32(bias);
+    lower_ = _mm256_set1_epi32(static_cast<int32_t>(lower) ^ bias);
+    upper_ = _mm256_set1_epi32(static_cast<int32_t>(upper) ^ bias);
+#else
+    bias_ = _mm_set1_epi32(bias);
+    lower_ = _mm_set1_epi32(static_cast<int32_t>(lower) ^ bias);
+    upper_ = _mm_set1_epi32(static_cast<int32_t>(upper) ^ bias);
+#endif
+  }
+
+  uint64_t Match(const T* cells, size_t n) const {
+    if (PREDICT_FALSE(n < kRowsPerWord)) {
+      return scalar_.Match(cells, n);
+    }
+    // A cell matches unless it's below the lower bound or above the upper
+    // bound, so collect the mismatches and invert.
+    uint64_t mismatches = 0;
+#ifdef __AVX2__
+    for (int i = 0; i < kRowsPerWord; i += 8) {
+      __m256i v = _mm256_xor_si256(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i)), bias_);
+      __m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(lower_, v),
+                                    _mm256_cmpgt_epi32(v, upper_));
+      mismatches |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(out))) << i;
+    }
+#else
+    for (int i = 0; i < kRowsPerWord; i += 4) {
+      __m128i v = _mm_xor_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i)), bias_);
+      __m128i out = _mm_or_si128(_mm_cmpgt_epi32(lower_, v),
+                                 _mm_cmpgt_epi32(v, upper_));
+      mismatches |= static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(out))) << i;
+    }
+#endif
+    return ~mismatches;
+  }
+
+ private:
+  ScalarRangeMatcher<T> scalar_;
+#ifdef __AVX2__
+  __m256i bias_;
+  __m256i lower_;
+  __m256i upper_;
+#else
+  __m128i bias_;
+  __m128i lower_;
+  __m128i upper_;
+#endif
+};
+
+// Matches 64-bit integer cells using SIMD comparisons. The 64-bit
+// comparison (pcmpgtq) was introduced in SSE4.2.
+template<typename T>
+class Simd64RangeMatcher {
+ public:
+  Simd64RangeMatcher(T lower, T upper)
+    : scalar_(lower, upper) {
+    int64_t bias = SignBias<T, int64_t>();
+#ifdef __AVX2__
+    bias_ = _mm256_set1_epi64x(bias);
+    lower_ = _mm256_set1_epi64x(static_cast<int64_t>(lower) ^ bias);
+    upper_ = _mm256_set1_epi64x(static_cast<int64_t>(upper) ^ bias);
+#else
+    bias_ = _mm_set1_epi64x(bias);
+    lower_ = _mm_set1_epi64x(static_cast<int64_t>(lower) ^ bias);
+    upper_ = _mm_set1_epi64x(static_cast<int64_t>(upper) ^ bias);
+#endif
+  }
+
+  uint64_t Match(const T* cells, size_t n) const {
+    if (PREDICT_FALSE(n < kRowsPerWord)) {
+      return scalar_.Match(cells, n);
+    }
+    uint64_t mismatches = 0;
+#ifdef __AVX2__
+    for (int i = 0; i < kRowsPerWord; i += 4) {
+      __m256i v = _mm256_xor_si256(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i)), bias_);
+      __m256i out = _mm256_or_si256(_mm256_cmpgt_epi64(lower_, v),
+                                    _mm256_cmpgt_epi64(v, upper_));
+      mismatches |= static_cast<uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(out))) << i;
+    }
+#else
+    for (int i = 0; i < kRowsPerWord; i += 2) {
+      __m128i v = _mm_xor_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i)), bias_);
+      __m128i out = _mm_or_si128(_mm_cmpgt_epi64(lower_, v),
+                                 _mm_cmpgt_epi64(v, upper_));
+      mismatches |= static_cast<uint64_t>(_mm_movemask_pd(_mm_castsi128_pd(out))) << i;
+    }
+#endif
+    return ~mismatches;
+  }
+
+ private:
+  ScalarRangeMatcher<T> scalar_;
+#ifdef __AVX2__
+  __m256i bias_;
+  __m256i lower_;
+  __m256i upper_;
+#else
+  __m128i bias_;
+  __m128i lower_;
+  __m128i upper_;
+#endif
+};
+
+// Selects the fastest matcher for each cell type.
+template<typename T>
+struct RangeMatcherFor {
+  typedef ScalarRangeMatcher<T> type;
+};
+template<> struct RangeMatcherFor<int32_t> { typedef Simd32RangeMatcher<int32_t> type; };
+template<> struct RangeMatcherFor<uint32_t> { typedef Simd32RangeMatcher<uint32_t> type; };
+template<> struct RangeMatcherFor<int64_t> { typedef Simd64RangeMatcher<int64_t> type; };
+template<> struct RangeMatcherFor<uint64_t> { typedef Simd64RangeMatcher<uint64_t> type; };
+
+// Return a mask of the bits which correspond to rows for a word of 'n' rows.
+inline uint64_t ValidRowsMask(size_t n) {
+  return n == kRowsPerWord ? ~0ULL : (1ULL << n) - 1;
+}
+
+template<DataType Type>
+void EvaluateRangeForType(const ColumnBlock& block,
+                          const void* lower,
+                          const void* upper,
+                          SelectionVector* sel) {
+  typedef typename DataTypeTraits<Type>::cpp_type T;
+  T lower_val = lower ? *reinterpret_cast<const T*>(lower) : MathLimits<T>::kMin;
+  T upper_val = upper ? *reinterpret_cast<const T*>(upper) : MathLimits<T>::kMax;
+  typename RangeMatcherFor<T>::type matcher(lower_val, upper_val);
+
+  const T* cells = reinterpret_cast<const T*>(block.data());
+  const uint8_t* non_null = block.null_bitmap();
+  uint8_t* sel_bitmap = sel->mutable_bitmap();
+  size_t nrows = block.nrows();
+
+  for (size_t row = 0; row < nrows; row += kRowsPerWord) {
+    size_t n = std::min(kRowsPerWord, nrows - row);
+    uint64_t valid = ValidRowsMask(n);
+    uint64_t sel_word = LoadWord(sel_bitmap, row, n);
+    if ((sel_word & valid) == 0) {
+      // Nothing left to filter in these rows.
+      continue;
+    }
+    // Cells in NULL slots hold arbitrary data, but comparing them is harmless
+    // since the null bitmap masks out their results.
+    uint64_t match = matcher.Match(cells + row, n);
+    if (non_null != NULL) {
+      match &= LoadWord(non_null, row, n);
+    }
+    // Leave any bits past the end of the block untouched.
+    StoreWord(sel_bitmap, row, n, sel_word & (match | ~valid));
+  }
+}
+
+} // anonymous namespace
+
+bool SupportsRangeType(DataType physical_type) {
+  switch (physical_type) {
+    case UINT8:
+    case INT8:
+    case UINT16:
+    case INT16:
+    case UINT32:
+    case INT32:
+    case UINT64:
+    case INT64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void EvaluateRange(const ColumnBlock& block,
+                   const void* lower,
+                   const void* upper,
+                   SelectionVector* sel) {
+  DCHECK_LE(block.nrows(), sel->nrows());
+  switch (block.type_info()->physical_type()) {
+    case UINT8:
+      EvaluateRangeForType<UINT8>(block, lower, upper, sel);
+      break;
+    case INT8:
+      EvaluateRangeForType<INT8>(block, lower, upper, sel);
+      break;
+    case UINT16:
+      EvaluateRangeForType<UINT16>(block, lower, upper, sel);
+      break;
+    case INT16:
+      EvaluateRangeForType<INT16>(block, lower, upper, sel);
+      break;
+    case UINT32:
+      EvaluateRangeForType<UINT32>(block, lower, upper, sel);
+      break;
+    case INT32:
+      EvaluateRangeForType<INT32>(block, lower, upper, sel);
+      break;
+    case UINT64:
+      EvaluateRangeForType<UINT64>(block, lower, upper, sel);
+      break;
+    case INT64:
+      EvaluateRangeForType<INT64>(block, lower, upper, sel);
+      break;
+    default:
+      LOG(FATAL) << "Unsupported type for range kernel: "
+                 << block.type_info()->name();
+  }
+}
+
+void EvaluateNullness(const ColumnBlock& block, bool is_null, SelectionVector* sel) {
+  DCHECK(block.is_nullable());
+  DCHECK_LE(block.nrows(), sel->nrows());
+  const uint8_t* non_null = block.null_bitmap();
+  uint8_t* sel_bitmap = sel->mutable_bitmap();
+  size_t nrows = block.nrows();
+
+  for (size_t row = 0; row < nrows; row += kRowsPerWord) {
+    size_t n = std::min(kRowsPerWord, nrows - row);
+    uint64_t valid = ValidRowsMask(n);
+    uint64_t non_null_word = LoadWord(non_null, row, n);
+    uint64_t match = is_null ? ~non_null_word : non_null_word;
+    uint64_t sel_word = LoadWord(sel_bitmap, row, n);
+    StoreWord(sel_bitmap, row, n, sel_word & (match | ~valid));
+  }
+}
+
+} // namespace predicate_kernels
+} // namespace kudu
@@ -0,0 +1,60 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef KUDU_COMMON_PREDICATE_KERNELS_H
+#define KUDU_COMMON_PREDICATE_KERNELS_H
+
+#include "kudu/common/columnblock.h"
+
+namespace kudu {
+
+class SelectionVector;
+
+// Type-specialized predicate evaluation over whole column blocks.
+//
+// Rather than testing one cell at a time through TypeInfo::Compare() and
+// clearing selection bits individually, these kernels compare 64 cells at
+// a time, producing a 64-bit match word which is ANDed into the selection
+// vector together with the column's null bitmap. Words in which no row is
+// selected are skipped entirely.
+//
+// The integer kernels use SSE4.2 (or AVX2, when the build enables it)
+// comparisons. Other fixed-width integer types use a branch-free scalar
+// loop which the compiler is able to auto-vectorize.
+namespace predicate_kernels {
+
+// Return true if EvaluateRange() supports cells of the given physical type.
+//
+// Floating point types are not supported: TypeInfo::Compare() treats NaN as
+// equal to every value, which the kernels do not replicate.
+bool SupportsRangeType(DataType physical_type);
+
+// Clear the bits in 'sel' for each of the first block.nrows() cells which
+// are NULL, or are not within [lower, upper]. Either bound may be NULL, in
+// which case the range is open on that end.
+//
+// Requires SupportsRangeType(block.type_info()->physical_type()).
+void EvaluateRange(const ColumnBlock& block,
+                   const void* lower,
+                   const void* upper,
+                   SelectionVector* sel);
+
+// Clear the bits in 'sel' for each of the first block.nrows() cells which
+// are not NULL (if 'is_null' is true) or which are NULL (if 'is_null' is
+// false). 'block' must be nullable.
+void EvaluateNullness(const ColumnBlock& block, bool is_null, SelectionVector* sel);
+
+} // namespace predicate_kernels
+} // namespace kudu
+
+#endif /* KUDU_COMMON_PREDICATE_KERNELS_H */
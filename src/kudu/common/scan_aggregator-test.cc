@@ -0,0 +1,262 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <boost/assign/list_of.hpp>
+#include <boost/foreach.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "kudu/common/row.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/scan_aggregator.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/test_util.h"
+
+namespace kudu {
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+class ScanAggregatorTest : public KuduTest {
+ public:
+  ScanAggregatorTest()
+    : arena_(1024, 1024 * 1024),
+      schema_(boost::assign::list_of
+              (ColumnSchema("key", INT32))
+              (ColumnSchema("val", INT32, true))
+              (ColumnSchema("str", STRING)),
+              1) {
+  }
+
+ protected:
+  // Fills 'block' with rows [start, start + nrows) where:
+  //   key = row index / 10
+  //   val = row index, or NULL for every 3rd row
+  //   str = "s<row index % 7>"
+  void FillBlock(int start, int nrows, RowBlock* block) {
+    block->Resize(nrows);
+    block->selection_vector()->SetAllTrue();
+    for (int i = 0; i < nrows; i++) {
+      int idx = start + i;
+      RowBlockRow row = block->row(i);
+      *reinterpret_cast<int32_t*>(row.mutable_cell_ptr(0)) = idx / 10;
+      row.cell(1).set_null(idx % 3 == 0);
+      *reinterpret_cast<int32_t*>(row.mutable_cell_ptr(1)) = idx;
+      Slice s(Substitute("s$0", idx % 7));
+      CHECK(block->arena()->RelocateSlice(s, reinterpret_cast<Slice*>(row.mutable_cell_ptr(2))));
+    }
+  }
+
+  static AggregatePB MakeAggregate(AggregatePB::Function function, const string& col) {
+    AggregatePB agg;
+    agg.set_function(function);
+    if (!col.empty()) {
+      agg.set_column(col);
+    }
+    return agg;
+  }
+
+  Arena arena_;
+  Schema schema_;
+};
+
+TEST_F(ScanAggregatorTest, TestInvalidAggregates) {
+  vector<string> no_group_by;
+  Schema result;
+  Status s = ScanAggregator::BuildResultSchema(
+      schema_, no_group_by, boost::assign::list_of(MakeAggregate(AggregatePB::SUM, "str")),
+      &result);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  s = ScanAggregator::BuildResultSchema(
+      schema_, no_group_by, boost::assign::list_of(MakeAggregate(AggregatePB::MIN, "")),
+      &result);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  s = ScanAggregator::BuildResultSchema(
+      schema_, no_group_by, boost::assign::list_of(MakeAggregate(AggregatePB::MAX, "nope")),
+      &result);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  s = ScanAggregator::BuildResultSchema(
+      schema_, boost::assign::list_of("nope"),
+      boost::assign::list_of(MakeAggregate(AggregatePB::COUNT, "")), &result);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  // Duplicate result columns.
+  s = ScanAggregator::BuildResultSchema(
+      schema_, no_group_by,
+      boost::assign::list_of(MakeAggregate(AggregatePB::COUNT, ""))
+                            (MakeAggregate(AggregatePB::COUNT, "")),
+      &result);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
+// Without group-by columns, an empty input still yields a single row.
+TEST_F(ScanAggregatorTest, TestEmptyInput) {
+  ScanAggregator agg;
+  ASSERT_OK(agg.Init(schema_, vector<string>(),
+                     boost::assign::list_of(MakeAggregate(AggregatePB::COUNT, ""))
+                                           (MakeAggregate(AggregatePB::SUM, "val"))));
+  ASSERT_EQ("Schema [\n"
+            "\tcount(*)[int64 NOT NULL],\n"
+            "\tsum(val)[int64 NULLABLE]\n"
+            "]",
+            agg.result_schema().ToString());
+  ASSERT_EQ(1, agg.num_groups());
+
+  RowBlock results(agg.result_schema(), 1, &arena_);
+  agg.ExportResults(&results);
+  ASSERT_EQ(1, results.nrows());
+  ASSERT_EQ("(int64 count(*)=0, int64 sum(val)=NULL)",
+            agg.result_schema().DebugRow(results.row(0)));
+}
+
+// Aggregates two halves of the input separately, as two tablets would, and
+// then merges their partial results.
+TEST_F(ScanAggregatorTest, TestAggregateAndMerge) {
+  const int kNumRows = 1000;
+  vector<string> group_by = boost::assign::list_of("key");
+  vector<AggregatePB> aggs = boost::assign::list_of
+    (MakeAggregate(AggregatePB::COUNT, ""))
+    (MakeAggregate(AggregatePB::COUNT, "val"))
+    (MakeAggregate(AggregatePB::SUM, "val"))
+    (MakeAggregate(AggregatePB::MIN, "str"))
+    (MakeAggregate(AggregatePB::MAX, "val"));
+
+  ScanAggregator merger;
+  ASSERT_OK(merger.Init(schema_, group_by, aggs));
+
+  for (int half = 0; half < 2; half++) {
+    ScanAggregator agg;
+    ASSERT_OK(agg.Init(schema_, group_by, aggs));
+
+    // Feed the rows in blocks of 100, starting mid-group so that the groups
+    // at the boundary get partial results from both halves.
+    int start = half * (kNumRows / 2 + 5);
+    int end = half == 0 ? kNumRows / 2 + 5 : kNumRows;
+    RowBlock block(schema_, 100, &arena_);
+    for (int i = start; i < end; i += 100) {
+      FillBlock(i, std::min(100, end - i), &block);
+      // Deselect one row per block.
+      block.selection_vector()->SetRowUnselected(1);
+      agg.AddRowBlock(block);
+    }
+
+    Arena results_arena(1024, 1024 * 1024);
+    RowBlock results(agg.result_schema(), agg.num_groups(), &results_arena);
+    agg.ExportResults(&results);
+    for (int i = 0; i < results.nrows(); i++) {
+      merger.MergePartialRow(results.row(i));
+    }
+  }
+
+  // Compute the expected results.
+  vector<string> expected;
+  for (int key = 0; key < kNumRows / 10; key++) {
+    int64_t count = 0, count_val = 0, sum = 0;
+    int32_t max = -1;
+    string min_str;
+    for (int idx = key * 10; idx < key * 10 + 10; idx++) {
+      // The deselected rows.
+      int start = idx < kNumRows / 2 + 5 ? 0 : kNumRows / 2 + 5;
+      if ((idx - start) % 100 == 1) continue;
+      count++;
+      string str = Substitute("s$0", idx % 7);
+      if (min_str.empty() || str < min_str) min_str = str;
+      if (idx % 3 == 0) continue;
+      count_val++;
+      sum += idx;
+      max = std::max(max, idx);
+    }
+    expected.push_back(Substitute(
+        "(int32 key=$0, int64 count(*)=$1, int64 count(val)=$2, int64 sum(val)=$3, "
+        "string min(str)=$4, int32 max(val)=$5)",
+        key, count, count_val, sum, min_str, max));
+  }
+
+  ASSERT_EQ(kNumRows / 10, merger.num_groups());
+  size_t row_size = ContiguousRowHelper::row_size(merger.result_schema());
+  gscoped_ptr<uint8_t[]> rows(new uint8_t[row_size * merger.num_groups()]);
+  merger.ExportResults(rows.get(), &arena_);
+  for (int i = 0; i < merger.num_groups(); i++) {
+    ConstContiguousRow row(&merger.result_schema(), rows.get() + i * row_size);
+    ASSERT_EQ(expected[i], merger.result_schema().DebugRow(row));
+  }
+}
+
+// Tests that exporting the finished groups while rows are added, and merging
+// them, yields the same results as aggregating all of the rows at once.
+TEST_F(ScanAggregatorTest, TestExportFinishedGroups) {
+  vector<string> group_by = boost::assign::list_of("key");
+  vector<AggregatePB> aggs = boost::assign::list_of
+    (MakeAggregate(AggregatePB::COUNT, ""))
+    (MakeAggregate(AggregatePB::SUM, "val"))
+    (MakeAggregate(AggregatePB::MIN, "str"));
+
+  ScanAggregator expected;
+  ASSERT_OK(expected.Init(schema_, group_by, aggs));
+  ScanAggregator agg;
+  ASSERT_OK(agg.Init(schema_, group_by, aggs));
+  ScanAggregator merger;
+  ASSERT_OK(merger.Init(schema_, group_by, aggs));
+
+  // Blocks of 25 rows, so that groups of 10 rows span blocks. The last block
+  // goes back to rows of groups which were already finished.
+  vector<int> starts = boost::assign::list_of(0)(25)(50)(75)(100)(5);
+  Arena results_arena(1024, 1024 * 1024);
+  BOOST_FOREACH(int start, starts) {
+    RowBlock block(schema_, 25, &arena_);
+    FillBlock(start, 25, &block);
+    expected.AddRowBlock(block);
+    agg.AddRowBlock(block);
+
+    // Only the group which the last row fell into is kept.
+    ASSERT_EQ(agg.num_groups() - 1, agg.num_finished_groups());
+    RowBlock results(agg.result_schema(), agg.num_finished_groups(), &results_arena);
+    agg.ExportFinishedGroups(&results);
+    ASSERT_EQ(1, agg.num_groups());
+    for (int i = 0; i < results.nrows(); i++) {
+      merger.MergePartialRow(results.row(i));
+    }
+  }
+  RowBlock results(agg.result_schema(), agg.num_groups(), &results_arena);
+  agg.ExportResults(&results);
+  for (int i = 0; i < results.nrows(); i++) {
+    merger.MergePartialRow(results.row(i));
+  }
+
+  ASSERT_EQ(expected.num_groups(), merger.num_groups());
+  RowBlock expected_rows(expected.result_schema(), expected.num_groups(), &results_arena);
+  expected.ExportResults(&expected_rows);
+  RowBlock merged_rows(merger.result_schema(), merger.num_groups(), &results_arena);
+  merger.ExportResults(&merged_rows);
+  for (int i = 0; i < expected.num_groups(); i++) {
+    ASSERT_EQ(expected.result_schema().DebugRow(expected_rows.row(i)),
+              merger.result_schema().DebugRow(merged_rows.row(i)));
+  }
+
+  // Without group-by columns, the single group is never finished.
+  ScanAggregator single;
+  ASSERT_OK(single.Init(schema_, vector<string>(), aggs));
+  RowBlock block(schema_, 25, &arena_);
+  FillBlock(0, 25, &block);
+  single.AddRowBlock(block);
+  ASSERT_EQ(0, single.num_finished_groups());
+}
+
+} // namespace kudu
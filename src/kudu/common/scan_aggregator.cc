@@ -0,0 +1,508 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kudu/common/scan_aggregator.h"
+
+#include <boost/foreach.hpp>
+
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/row.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/memory/arena.h"
+
+namespace kudu {
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+struct ScanAggregator::Accumulator {
+  Accumulator() : has_value(false), count(0), sum_int(0), sum_double(0) {}
+
+  // Whether any non-null cell has been accumulated (SUM, MIN and MAX).
+  bool has_value;
+  int64_t count;
+  int64_t sum_int;
+  double sum_double;
+  // The current MIN or MAX: the raw cell, or the data of a BINARY cell.
+  string min_max;
+};
+
+struct ScanAggregator::Group {
+  // The group-by cells: the raw cell, or the data of a BINARY cell.
+  vector<string> key_cells;
+  vector<bool> key_is_null;
+  vector<Accumulator> accumulators;
+};
+
+struct ScanAggregator::AggregateInfo {
+  AggregatePB::Function function;
+  // The aggregated column in the input schema, or -1 for COUNT(*).
+  int input_col_idx;
+  // The type of the aggregated column, or NULL for COUNT(*).
+  const TypeInfo* type;
+};
+
+namespace {
+
+// Returns the name of the result column for 'agg'.
+string AggregateColumnName(const AggregatePB& agg) {
+  string col = agg.has_column() ? agg.column() : "*";
+  switch (agg.function()) {
+    case AggregatePB::COUNT: return Substitute("count($0)", col);
+    case AggregatePB::SUM: return Substitute("sum($0)", col);
+    case AggregatePB::MIN: return Substitute("min($0)", col);
+    case AggregatePB::MAX: return Substitute("max($0)", col);
+    default: return Substitute("unknown($0)", col);
+  }
+}
+
+bool IsIntegralType(DataType type) {
+  switch (type) {
+    case UINT8: case INT8: case UINT16: case INT16:
+    case UINT32: case INT32: case UINT64: case INT64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+int64_t ReadIntegralCell(DataType physical_type, const void* cell) {
+  switch (physical_type) {
+    case UINT8: return *reinterpret_cast<const uint8_t*>(cell);
+    case INT8: return *reinterpret_cast<const int8_t*>(cell);
+    case UINT16: return *reinterpret_cast<const uint16_t*>(cell);
+    case INT16: return *reinterpret_cast<const int16_t*>(cell);
+    case UINT32: return *reinterpret_cast<const uint32_t*>(cell);
+    case INT32: return *reinterpret_cast<const int32_t*>(cell);
+    case UINT64: return static_cast<int64_t>(*reinterpret_cast<const uint64_t*>(cell));
+    case INT64: return *reinterpret_cast<const int64_t*>(cell);
+    default:
+      LOG(FATAL) << "not an integral type: " << physical_type;
+      return 0;
+  }
+}
+
+// Copies the value of 'cell' into 'dst': the data of a BINARY cell, or the
+// raw cell otherwise.
+void CopyCellValue(const TypeInfo* type, const void* cell, string* dst) {
+  if (type->physical_type() == BINARY) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    dst->assign(reinterpret_cast<const char*>(s->data()), s->size());
+  } else {
+    dst->assign(reinterpret_cast<const char*>(cell), type->size());
+  }
+}
+
+// Compares 'cell' against a value stored by CopyCellValue().
+int CompareCellValue(const TypeInfo* type, const void* cell, const string& stored) {
+  if (type->physical_type() == BINARY) {
+    return reinterpret_cast<const Slice*>(cell)->compare(Slice(stored));
+  }
+  return type->Compare(cell, stored.data());
+}
+
+// Writes a value stored by CopyCellValue() into 'cell', copying any
+// indirect data into 'arena'.
+void WriteCellValue(const TypeInfo* type, const string& stored, void* cell, Arena* arena) {
+  if (type->physical_type() == BINARY) {
+    Slice s(stored);
+    CHECK(arena->RelocateSlice(s, reinterpret_cast<Slice*>(cell))) << "out of memory";
+  } else {
+    DCHECK_EQ(type->size(), stored.size());
+    memcpy(cell, stored.data(), stored.size());
+  }
+}
+
+// Returns the cell of column 'col_idx' in 'row', or NULL if the cell is NULL.
+template<class RowType>
+const void* GetCell(const RowType& row, int col_idx) {
+  if (row.schema()->column(col_idx).is_nullable() && row.is_null(col_idx)) {
+    return NULL;
+  }
+  return row.cell_ptr(col_idx);
+}
+
+void SetCellNull(RowBlockRow* row, int col_idx, bool is_null) {
+  row->cell(col_idx).set_null(is_null);
+}
+
+void SetCellNull(ContiguousRow* row, int col_idx, bool is_null) {
+  row->set_null(col_idx, is_null);
+}
+
+} // anonymous namespace
+
+ScanAggregator::ScanAggregator()
+  : input_schema_(NULL),
+    count_star_only_(true),
+    last_group_(NULL) {
+}
+
+ScanAggregator::~ScanAggregator() {
+  STLDeleteValues(&groups_);
+}
+
+Status ScanAggregator::BuildResultSchema(const Schema& input_schema,
+                                         const vector<string>& group_by_columns,
+                                         const vector<AggregatePB>& aggregates,
+                                         Schema* result_schema) {
+  vector<ColumnSchema> cols;
+  BOOST_FOREACH(const string& name, group_by_columns) {
+    int idx = input_schema.find_column(name);
+    if (idx == Schema::kColumnNotFound) {
+      return Status::InvalidArgument("Unknown group-by column", name);
+    }
+    const ColumnSchema& col = input_schema.column(idx);
+    cols.push_back(ColumnSchema(col.name(), col.type_info()->type(), col.is_nullable()));
+  }
+
+  BOOST_FOREACH(const AggregatePB& agg, aggregates) {
+    const ColumnSchema* col = NULL;
+    if (agg.has_column()) {
+      int idx = input_schema.find_column(agg.column());
+      if (idx == Schema::kColumnNotFound) {
+        return Status::InvalidArgument("Unknown aggregate column", agg.column());
+      }
+      col = &input_schema.column(idx);
+    } else if (agg.function() != AggregatePB::COUNT) {
+      return Status::InvalidArgument("Only COUNT may omit the aggregate column",
+                                     agg.ShortDebugString());
+    }
+
+    string name = AggregateColumnName(agg);
+    switch (agg.function()) {
+      case AggregatePB::COUNT:
+        cols.push_back(ColumnSchema(name, INT64));
+        break;
+      case AggregatePB::SUM: {
+        DataType type = col->type_info()->type();
+        if (IsIntegralType(type)) {
+          cols.push_back(ColumnSchema(name, INT64, true));
+        } else if (type == FLOAT || type == DOUBLE) {
+          cols.push_back(ColumnSchema(name, DOUBLE, true));
+        } else {
+          return Status::InvalidArgument(
+              Substitute("Cannot compute SUM of column $0", col->ToString()));
+        }
+        break;
+      }
+      case AggregatePB::MIN:
+      case AggregatePB::MAX:
+        cols.push_back(ColumnSchema(name, col->type_info()->type(), true));
+        break;
+      default:
+        return Status::InvalidArgument("Unknown aggregate function", agg.ShortDebugString());
+    }
+  }
+
+  Status s = result_schema->Reset(cols, 0);
+  if (!s.ok()) {
+    return Status::InvalidArgument("Invalid aggregates", s.message());
+  }
+  return Status::OK();
+}
+
+Status ScanAggregator::Init(const Schema& input_schema,
+                            const vector<string>& group_by_columns,
+                            const vector<AggregatePB>& aggregates) {
+  CHECK(input_schema_ == NULL) << "already initialized";
+  RETURN_NOT_OK(BuildResultSchema(input_schema, group_by_columns, aggregates,
+                                  &result_schema_));
+  input_schema_ = &input_schema;
+
+  for (int i = 0; i < group_by_columns.size(); i++) {
+    group_by_col_idxs_.push_back(input_schema.find_column(group_by_columns[i]));
+    result_group_by_col_idxs_.push_back(i);
+  }
+  BOOST_FOREACH(const AggregatePB& agg, aggregates) {
+    AggregateInfo info;
+    info.function = agg.function();
+    info.input_col_idx = agg.has_column() ? input_schema.find_column(agg.column()) : -1;
+    info.type = agg.has_column() ? input_schema.column(info.input_col_idx).type_info() : NULL;
+    aggregates_.push_back(info);
+    if (info.input_col_idx != -1) {
+      count_star_only_ = false;
+    }
+  }
+
+  // Without any group-by columns, there's a single group even if no rows
+  // are aggregated, so that e.g. COUNT(*) yields 0.
+  if (group_by_col_idxs_.empty()) {
+    Group* group = new Group;
+    group->accumulators.resize(aggregates_.size());
+    groups_[""] = group;
+  }
+  return Status::OK();
+}
+
+template<class RowType>
+ScanAggregator::Group* ScanAggregator::FindOrCreateGroup(const RowType& row,
+                                                         const vector<int>& col_idxs) {
+  if (col_idxs.empty()) {
+    return groups_.begin()->second;
+  }
+
+  tmp_key_.clear();
+  for (int i = 0; i < col_idxs.size(); i++) {
+    const void* cell = GetCell(row, col_idxs[i]);
+    // Prefix each cell with a NULL marker so that NULLs sort first.
+    tmp_key_.push_back(cell == NULL ? 0 : 1);
+    if (cell != NULL) {
+      const TypeInfo* type = row.schema()->column(col_idxs[i]).type_info();
+      GetKeyEncoder<faststring>(type).Encode(cell, i == col_idxs.size() - 1, &tmp_key_);
+    }
+  }
+
+  if (last_group_ != NULL && Slice(tmp_key_) == Slice(last_group_key_)) {
+    return last_group_;
+  }
+
+  string key(reinterpret_cast<const char*>(tmp_key_.data()), tmp_key_.size());
+  Group*& group = groups_[key];
+  if (group == NULL) {
+    group = new Group;
+    group->key_cells.resize(col_idxs.size());
+    group->key_is_null.resize(col_idxs.size());
+    for (int i = 0; i < col_idxs.size(); i++) {
+      const void* cell = GetCell(row, col_idxs[i]);
+      group->key_is_null[i] = (cell == NULL);
+      if (cell != NULL) {
+        CopyCellValue(row.schema()->column(col_idxs[i]).type_info(), cell,
+                      &group->key_cells[i]);
+      }
+    }
+    group->accumulators.resize(aggregates_.size());
+  }
+  last_group_ = group;
+  last_group_key_.assign_copy(tmp_key_.data(), tmp_key_.size());
+  return group;
+}
+
+void ScanAggregator::AddRowBlock(const RowBlock& block) {
+  DCHECK(input_schema_ != NULL) << "not initialized";
+  const SelectionVector* sel = block.selection_vector();
+
+  // COUNT(*) without group-by columns only needs the number of selected
+  // rows, which is added up once for the whole block below.
+  bool single_group = group_by_col_idxs_.empty();
+  if (single_group && count_star_only_) {
+    AddSelectedRowCount(sel->CountSelected());
+    return;
+  }
+
+  for (size_t i = 0; i < block.nrows(); i++) {
+    if (!sel->IsRowSelected(i)) continue;
+    RowBlockRow row = block.row(i);
+    Group* group = FindOrCreateGroup(row, group_by_col_idxs_);
+
+    for (int a = 0; a < aggregates_.size(); a++) {
+      const AggregateInfo& agg = aggregates_[a];
+      Accumulator* acc = &group->accumulators[a];
+      if (agg.input_col_idx == -1) {
+        if (!single_group) acc->count++;
+        continue;
+      }
+      const void* cell = GetCell(row, agg.input_col_idx);
+      if (cell == NULL) continue;
+
+      switch (agg.function) {
+        case AggregatePB::COUNT:
+          acc->count++;
+          break;
+        case AggregatePB::SUM:
+          if (IsIntegralType(agg.type->physical_type())) {
+            acc->sum_int += ReadIntegralCell(agg.type->physical_type(), cell);
+          } else if (agg.type->physical_type() == FLOAT) {
+            acc->sum_double += *reinterpret_cast<const float*>(cell);
+          } else {
+            acc->sum_double += *reinterpret_cast<const double*>(cell);
+          }
+          acc->has_value = true;
+          break;
+        case AggregatePB::MIN:
+        case AggregatePB::MAX: {
+          bool is_min = agg.function == AggregatePB::MIN;
+          if (!acc->has_value) {
+            CopyCellValue(agg.type, cell, &acc->min_max);
+            acc->has_value = true;
+          } else {
+            int cmp = CompareCellValue(agg.type, cell, acc->min_max);
+            if (is_min ? cmp < 0 : cmp > 0) {
+              CopyCellValue(agg.type, cell, &acc->min_max);
+            }
+          }
+          break;
+        }
+        default:
+          LOG(FATAL) << "unknown aggregate function: " << agg.function;
+      }
+    }
+  }
+
+  if (single_group) {
+    AddSelectedRowCount(sel->CountSelected());
+  }
+}
+
+void ScanAggregator::AddSelectedRowCount(size_t nrows) {
+  Group* group = groups_.begin()->second;
+  for (int a = 0; a < aggregates_.size(); a++) {
+    if (aggregates_[a].input_col_idx == -1) {
+      group->accumulators[a].count += nrows;
+    }
+  }
+}
+
+template<class RowType>
+void ScanAggregator::MergePartialRow(const RowType& row) {
+  DCHECK(input_schema_ != NULL) << "not initialized";
+  Group* group = FindOrCreateGroup(row, result_group_by_col_idxs_);
+
+  int first_agg_col = result_group_by_col_idxs_.size();
+  for (int a = 0; a < aggregates_.size(); a++) {
+    const AggregateInfo& agg = aggregates_[a];
+    Accumulator* acc = &group->accumulators[a];
+    const void* cell = GetCell(row, first_agg_col + a);
+    if (cell == NULL) continue;
+
+    switch (agg.function) {
+      case AggregatePB::COUNT:
+        acc->count += *reinterpret_cast<const int64_t*>(cell);
+        break;
+      case AggregatePB::SUM:
+        if (IsIntegralType(agg.type->physical_type())) {
+          acc->sum_int += *reinterpret_cast<const int64_t*>(cell);
+        } else {
+          acc->sum_double += *reinterpret_cast<const double*>(cell);
+        }
+        acc->has_value = true;
+        break;
+      case AggregatePB::MIN:
+      case AggregatePB::MAX: {
+        bool is_min = agg.function == AggregatePB::MIN;
+        if (!acc->has_value) {
+          CopyCellValue(agg.type, cell, &acc->min_max);
+          acc->has_value = true;
+        } else {
+          int cmp = CompareCellValue(agg.type, cell, acc->min_max);
+          if (is_min ? cmp < 0 : cmp > 0) {
+            CopyCellValue(agg.type, cell, &acc->min_max);
+          }
+        }
+        break;
+      }
+      default:
+        LOG(FATAL) << "unknown aggregate function: " << agg.function;
+    }
+  }
+}
+
+// Explicit instantiations for the row types which can hold partial results.
+template void ScanAggregator::MergePartialRow<RowBlockRow>(const RowBlockRow& row);
+template void ScanAggregator::MergePartialRow<ConstContiguousRow>(const ConstContiguousRow& row);
+
+template<class RowType>
+void ScanAggregator::WriteGroup(const Group& group, RowType* row, Arena* arena) const {
+  int col_idx = 0;
+  for (int i = 0; i < group_by_col_idxs_.size(); i++, col_idx++) {
+    const ColumnSchema& col = result_schema_.column(col_idx);
+    bool is_null = group.key_is_null[i];
+    if (col.is_nullable()) {
+      SetCellNull(row, col_idx, is_null);
+    }
+    if (!is_null) {
+      WriteCellValue(col.type_info(), group.key_cells[i], row->mutable_cell_ptr(col_idx), arena);
+    }
+  }
+
+  for (int a = 0; a < aggregates_.size(); a++, col_idx++) {
+    const AggregateInfo& agg = aggregates_[a];
+    const Accumulator& acc = group.accumulators[a];
+    uint8_t* cell = row->mutable_cell_ptr(col_idx);
+    if (agg.function == AggregatePB::COUNT) {
+      *reinterpret_cast<int64_t*>(cell) = acc.count;
+      continue;
+    }
+
+    SetCellNull(row, col_idx, !acc.has_value);
+    if (!acc.has_value) continue;
+    if (agg.function == AggregatePB::SUM) {
+      if (IsIntegralType(agg.type->physical_type())) {
+        *reinterpret_cast<int64_t*>(cell) = acc.sum_int;
+      } else {
+        *reinterpret_cast<double*>(cell) = acc.sum_double;
+      }
+    } else {
+      WriteCellValue(agg.type, acc.min_max, cell, arena);
+    }
+  }
+}
+
+void ScanAggregator::ExportResults(RowBlock* block) const {
+  DCHECK(block->schema().Equals(result_schema_));
+  CHECK_GE(block->row_capacity(), groups_.size());
+  block->Resize(groups_.size());
+  block->selection_vector()->SetAllTrue();
+
+  size_t i = 0;
+  BOOST_FOREACH(const GroupMap::value_type& entry, groups_) {
+    RowBlockRow row = block->row(i++);
+    WriteGroup(*entry.second, &row, block->arena());
+  }
+}
+
+size_t ScanAggregator::num_finished_groups() const {
+  if (group_by_col_idxs_.empty() || groups_.empty()) {
+    return 0;
+  }
+  return last_group_ != NULL ? groups_.size() - 1 : groups_.size();
+}
+
+void ScanAggregator::ExportFinishedGroups(RowBlock* block) {
+  DCHECK(block->schema().Equals(result_schema_));
+  size_t num_finished = num_finished_groups();
+  CHECK_GE(block->row_capacity(), num_finished);
+  block->Resize(num_finished);
+  block->selection_vector()->SetAllTrue();
+  if (num_finished == 0) {
+    return;
+  }
+
+  size_t i = 0;
+  GroupMap::iterator it = groups_.begin();
+  while (it != groups_.end()) {
+    if (it->second == last_group_) {
+      ++it;
+      continue;
+    }
+    RowBlockRow row = block->row(i++);
+    WriteGroup(*it->second, &row, block->arena());
+    delete it->second;
+    groups_.erase(it++);
+  }
+}
+
+void ScanAggregator::ExportResults(uint8_t* row_data, Arena* arena) const {
+  size_t row_size = ContiguousRowHelper::row_size(result_schema_);
+  BOOST_FOREACH(const GroupMap::value_type& entry, groups_) {
+    ContiguousRow row(&result_schema_, row_data);
+    WriteGroup(*entry.second, &row, arena);
+    row_data += row_size;
+  }
+}
+
+} // namespace kudu
@@ -0,0 +1,152 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef KUDU_COMMON_SCAN_AGGREGATOR_H
+#define KUDU_COMMON_SCAN_AGGREGATOR_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Arena;
+class RowBlock;
+
+// Evaluates COUNT/SUM/MIN/MAX aggregates, optionally grouped by a set of
+// columns, over the rows of a scan.
+//
+// The same aggregator serves both sides of an aggregate pushdown: the tablet
+// server feeds it the scanned row blocks (AddRowBlock()) and returns the
+// per-tablet partial results, and the client merges the partial results of
+// each tablet (MergePartialRow()) into the final ones.
+//
+// The results have one row per group, made up of the group-by columns
+// followed by one column per aggregate (see BuildResultSchema()). Groups are
+// returned in the order of their encoded group-by keys. If there are no
+// group-by columns, there is always exactly one group.
+class ScanAggregator {
+ public:
+  ScanAggregator();
+  ~ScanAggregator();
+
+  // Builds the schema of the results of aggregating rows of 'input_schema':
+  //
+  //   - each group-by column, with its type from 'input_schema'.
+  //   - "count(*)" or "count(<col>)": a non-nullable INT64.
+  //   - "sum(<col>)": a nullable INT64 for integer columns, or a nullable
+  //     DOUBLE for floating point columns.
+  //   - "min(<col>)" and "max(<col>)": nullable, of the column's type.
+  //
+  // SUM, MIN and MAX are NULL for groups without any non-null cell. SUMs of
+  // integers wrap around on overflow.
+  static Status BuildResultSchema(const Schema& input_schema,
+                                  const std::vector<std::string>& group_by_columns,
+                                  const std::vector<AggregatePB>& aggregates,
+                                  Schema* result_schema);
+
+  // Prepares to aggregate rows of 'input_schema', which must remain valid for
+  // the lifetime of this object. Returns a bad Status if the aggregates can't
+  // be evaluated on 'input_schema'.
+  Status Init(const Schema& input_schema,
+              const std::vector<std::string>& group_by_columns,
+              const std::vector<AggregatePB>& aggregates);
+
+  // Accumulates the selected rows of 'block', which must have the input schema.
+  void AddRowBlock(const RowBlock& block);
+
+  // Merges a row of partial results, i.e. a row in result_schema() produced
+  // by another aggregator with the same specification. 'RowType' is either
+  // a RowBlockRow or a ConstContiguousRow.
+  template<class RowType>
+  void MergePartialRow(const RowType& row);
+
+  const Schema& result_schema() const { return result_schema_; }
+
+  size_t num_groups() const { return groups_.size(); }
+
+  // Returns the number of groups other than the one which the last row added
+  // fell into. When rows are added in the order of the group-by columns, as
+  // when grouping by a prefix of the primary key, these won't get any more
+  // rows. Without group-by columns, the single group is never finished.
+  size_t num_finished_groups() const;
+
+  // Writes one row per group into 'block', which must have result_schema()
+  // and a capacity of at least num_groups(). Indirect data is copied into the
+  // block's arena.
+  void ExportResults(RowBlock* block) const;
+
+  // Like the above, but writes contiguous rows of result_schema() into
+  // 'row_data', which must hold num_groups() rows. Indirect data is copied
+  // into 'arena'.
+  void ExportResults(uint8_t* row_data, Arena* arena) const;
+
+  // Like ExportResults(RowBlock*), but only writes the finished groups (see
+  // num_finished_groups()), and then removes them. Should rows of a removed
+  // group be added later on, it's started anew, and merging the partial
+  // results still yields the right ones.
+  void ExportFinishedGroups(RowBlock* block);
+
+ private:
+  struct Accumulator;
+  struct Group;
+  struct AggregateInfo;
+  typedef std::map<std::string, Group*> GroupMap;
+
+  // Returns the group for 'row', whose group-by cells are in the columns
+  // 'col_idxs', creating the group if necessary.
+  template<class RowType>
+  Group* FindOrCreateGroup(const RowType& row, const std::vector<int>& col_idxs);
+
+  // Adds 'nrows' to each COUNT(*) of the single group used when there are
+  // no group-by columns.
+  void AddSelectedRowCount(size_t nrows);
+
+  template<class RowType>
+  void WriteGroup(const Group& group, RowType* row, Arena* arena) const;
+
+  const Schema* input_schema_;
+  Schema result_schema_;
+
+  // Indexes of the group-by columns in the input schema, and in the
+  // result schema.
+  std::vector<int> group_by_col_idxs_;
+  std::vector<int> result_group_by_col_idxs_;
+
+  std::vector<AggregateInfo> aggregates_;
+
+  // Whether every aggregate is a COUNT(*).
+  bool count_star_only_;
+
+  GroupMap groups_;
+
+  // The most recently used group and its encoded key. Scans mostly return
+  // rows in key order, so consecutive rows usually fall into the same group.
+  Group* last_group_;
+  faststring last_group_key_;
+
+  // Scratch space for encoding group keys.
+  faststring tmp_key_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanAggregator);
+};
+
+} // namespace kudu
+
+#endif
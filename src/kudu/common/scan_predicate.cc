@@ -14,15 +14,44 @@
 
 #include "kudu/common/scan_predicate.h"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
+#include "kudu/common/predicate_kernels.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/types.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/bitmap.h"
 
 namespace kudu {
 
 using std::string;
+using std::vector;
+
+namespace {
+
+// The source of ColumnRangePredicate::id().
+AtomicInt<int64_t> next_predicate_id(0);
+
+// Orders cells of a given type, for sorting and searching IN-lists.
+struct CellLess {
+  explicit CellLess(const TypeInfo* type) : type_(type) {}
+  bool operator()(const void* a, const void* b) const {
+    return type_->Compare(a, b) < 0;
+  }
+  const TypeInfo* type_;
+};
+
+struct CellEqual {
+  explicit CellEqual(const TypeInfo* type) : type_(type) {}
+  bool operator()(const void* a, const void* b) const {
+    return type_->Compare(a, b) == 0;
+  }
+  const TypeInfo* type_;
+};
+
+} // anonymous namespace
 
 ValueRange::ValueRange(const TypeInfo* type,
                        const void* lower_bound,
@@ -30,8 +59,6 @@ ValueRange::ValueRange(const TypeInfo* type,
   : type_info_(type),
     lower_bound_(lower_bound),
     upper_bound_(upper_bound) {
-  CHECK(has_lower_bound() || has_upper_bound())
-    << "range predicate has no bounds";
 }
 
 bool ValueRange::IsEquality() const {
@@ -57,9 +84,65 @@ ColumnRangePredicate::ColumnRangePredicate(const ColumnSchema &col,
                                            const void* lower_bound,
                                            const void* upper_bound) :
   col_(col),
-  range_(col_.type_info(), lower_bound, upper_bound) {
+  type_(RANGE),
+  range_(col_.type_info(), lower_bound, upper_bound),
+  id_(next_predicate_id.Increment()) {
+  CHECK(range_.has_lower_bound() || range_.has_upper_bound())
+    << "range predicate has no bounds";
+}
+
+ColumnRangePredicate::ColumnRangePredicate(const ColumnSchema &col,
+                                           PredicateType type,
+                                           const void* lower_bound,
+                                           const void* upper_bound) :
+  col_(col),
+  type_(type),
+  range_(col_.type_info(), lower_bound, upper_bound),
+  id_(next_predicate_id.Increment()) {
 }
 
+ColumnRangePredicate ColumnRangePredicate::InList(const ColumnSchema &col,
+                                                  const vector<const void*>& values) {
+  CHECK(!values.empty()) << "IN-list predicate has no values";
+  const TypeInfo* type = col.type_info();
+
+  vector<const void*> sorted(values);
+  std::sort(sorted.begin(), sorted.end(), CellLess(type));
+  sorted.erase(std::unique(sorted.begin(), sorted.end(), CellEqual(type)),
+               sorted.end());
+
+  if (sorted.size() == 1) {
+    return ColumnRangePredicate(col, sorted[0], sorted[0]);
+  }
+  ColumnRangePredicate pred(col, IN_LIST, sorted.front(), sorted.back());
+  pred.in_list_values_.swap(sorted);
+  return pred;
+}
+
+ColumnRangePredicate ColumnRangePredicate::IsNull(const ColumnSchema &col) {
+  return ColumnRangePredicate(col, IS_NULL, NULL, NULL);
+}
+
+ColumnRangePredicate ColumnRangePredicate::IsNotNull(const ColumnSchema &col) {
+  return ColumnRangePredicate(col, IS_NOT_NULL, NULL, NULL);
+}
+
+bool ColumnRangePredicate::MatchesCell(const void* cell) const {
+  switch (type_) {
+    case RANGE:
+      return range_.ContainsCell(cell);
+    case IN_LIST:
+      return range_.ContainsCell(cell) &&
+        std::binary_search(in_list_values_.begin(), in_list_values_.end(), cell,
+                           CellLess(col_.type_info()));
+    case IS_NULL:
+      return false;
+    case IS_NOT_NULL:
+      return true;
+  }
+  LOG(FATAL) << "Unknown predicate type: " << type_;
+  return false;
+}
 
 void ColumnRangePredicate::Evaluate(RowBlock* block, SelectionVector* vec) const {
   int col_idx = block->schema().find_column(col_.name());
@@ -67,15 +150,39 @@ void ColumnRangePredicate::Evaluate(RowBlock* block, SelectionVector* vec) const
 
   ColumnBlock cblock(block->column_block(col_idx, block->nrows()));
 
+  if (type_ == IS_NOT_NULL && !cblock.is_nullable()) {
+    // Every cell passes.
+    return;
+  }
+  if (type_ == IS_NULL && !cblock.is_nullable()) {
+    // No cell passes.
+    for (size_t i = 0; i < block->nrows(); i++) {
+      BitmapClear(vec->mutable_bitmap(), i);
+    }
+    return;
+  }
+
+  // Use the word-at-a-time kernels where possible.
+  if (type_ == IS_NULL || type_ == IS_NOT_NULL) {
+    predicate_kernels::EvaluateNullness(cblock, type_ == IS_NULL, vec);
+    return;
+  }
+  if (type_ == RANGE &&
+      predicate_kernels::SupportsRangeType(col_.type_info()->physical_type())) {
+    predicate_kernels::EvaluateRange(cblock, range_.lower_bound(), range_.upper_bound(), vec);
+    return;
+  }
+
+  // Fall back to evaluating one cell at a time for the remaining types.
+  //
   // TODO: this is all rather slow, could probably push down all the way
   // to the TypeInfo so we only make one virtual call, or use codegen.
-  // Not concerned for now -- plan of record is to eventually embed Impala
-  // expression evaluation somewhere here, so this is just a stub.
   if (cblock.is_nullable()) {
     for (size_t i = 0; i < block->nrows(); i++) {
       if (!vec->IsRowSelected(i)) continue;
       const void *cell = cblock.nullable_cell_ptr(i);
-      if (cell == NULL || !range_.ContainsCell(cell)) {
+      bool matches = (cell == NULL) ? (type_ == IS_NULL) : MatchesCell(cell);
+      if (!matches) {
         BitmapClear(vec->mutable_bitmap(), i);
       }
     }
@@ -83,7 +190,7 @@ void ColumnRangePredicate::Evaluate(RowBlock* block, SelectionVector* vec) const
     for (size_t i = 0; i < block->nrows(); i++) {
       if (!vec->IsRowSelected(i)) continue;
       const void *cell = cblock.cell_ptr(i);
-      if (!range_.ContainsCell(cell)) {
+      if (!MatchesCell(cell)) {
         BitmapClear(vec->mutable_bitmap(), i);
       }
     }
@@ -91,6 +198,24 @@ void ColumnRangePredicate::Evaluate(RowBlock* block, SelectionVector* vec) const
 }
 
 string ColumnRangePredicate::ToString() const {
+  switch (type_) {
+    case IS_NULL:
+      return StringPrintf("(`%s` IS NULL)", col_.name().c_str());
+    case IS_NOT_NULL:
+      return StringPrintf("(`%s` IS NOT NULL)", col_.name().c_str());
+    case IN_LIST: {
+      string ret = StringPrintf("(`%s` IN (", col_.name().c_str());
+      for (int i = 0; i < in_list_values_.size(); i++) {
+        if (i > 0) ret.append(", ");
+        ret.append(col_.Stringify(in_list_values_[i]));
+      }
+      ret.append("))");
+      return ret;
+    }
+    case RANGE:
+      break;
+  }
+
   if (range_.has_lower_bound() && range_.has_upper_bound()) {
     return StringPrintf("(`%s` BETWEEN %s AND %s)", col_.name().c_str(),
                         col_.Stringify(range_.lower_bound()).c_str(),
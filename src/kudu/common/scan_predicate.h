@@ -15,6 +15,7 @@
 #define KUDU_COMMON_SCAN_PREDICATE_H
 
 #include <string>
+#include <vector>
 
 #include <gtest/gtest_prod.h>
 
@@ -40,9 +41,8 @@ class ValueRange {
   // for the lifetime of this object.
   //
   // If either optional is unspecified (i.e. NULL), then the range is
-  // open on that end.
-  //
-  // A range must be bounded on at least one end.
+  // open on that end. A range which is open on both ends contains every
+  // non-null cell.
   ValueRange(const TypeInfo* type,
              const void* lower_bound,
              const void* upper_bound);
@@ -76,36 +76,98 @@ class ValueRange {
 // Predicate which evaluates to true when the value for a given column
 // is within a specified range.
 //
+// In addition to plain ranges, a predicate may match a column against a
+// list of values (IN-list), or match on whether the column is NULL.
+//
 // TODO: extract an interface for this once it's clearer what the interface should
 // look like. Column range is not the only predicate in the world.
 class ColumnRangePredicate {
  public:
+  enum PredicateType {
+    // The cell is within range().
+    RANGE,
+    // The cell is equal to one of in_list_values().
+    IN_LIST,
+    // The cell is NULL.
+    IS_NULL,
+    // The cell is not NULL.
+    IS_NOT_NULL
+  };
 
   // Construct a new column range predicate.
   // The lower_bound and upper_bound pointers should point to storage
   // which represents a constant cell value to be used as a range.
   // The range is inclusive on both ends.
   // If either optional is unspecified (i.e. NULL), then the range is
-  // open on that end.
+  // open on that end. At least one of the bounds must be specified.
   ColumnRangePredicate(const ColumnSchema &col,
                        const void* lower_bound,
                        const void* upper_bound);
 
+  // Construct a predicate which passes when the column is equal to any of
+  // 'values'. As with range bounds, the cells are not copied and must
+  // remain valid for the lifetime of the predicate. 'values' may contain
+  // duplicates and need not be sorted, but must not be empty.
+  //
+  // range() is set to the smallest range containing all of the values, so
+  // code which only understands ranges may treat this predicate as the
+  // range [min(values), max(values)]. A list with only one distinct value
+  // yields a plain equality RANGE predicate.
+  static ColumnRangePredicate InList(const ColumnSchema &col,
+                                     const std::vector<const void*>& values);
+
+  // Construct a predicate which passes only for NULL cells.
+  static ColumnRangePredicate IsNull(const ColumnSchema &col);
+
+  // Construct a predicate which passes only for non-NULL cells.
+  static ColumnRangePredicate IsNotNull(const ColumnSchema &col);
+
   const ColumnSchema &column() const {
     return col_;
   }
 
+  PredicateType predicate_type() const {
+    return type_;
+  }
+
   string ToString() const;
 
   // Return the value range for which this predicate passes.
+  //
+  // For IN_LIST predicates this is a superset of the passing values. For
+  // IS_NULL and IS_NOT_NULL predicates the range is unbounded.
   const ValueRange &range() const { return range_; }
 
+  // Return the sorted, de-duplicated values of an IN_LIST predicate.
+  const std::vector<const void*>& in_list_values() const {
+    return in_list_values_;
+  }
+
+  // Return true if the non-null 'cell' passes this predicate.
+  //
+  // This lets storage layers which can evaluate a predicate more cheaply
+  // than once per row (e.g. once per dictionary entry) do so themselves.
+  bool MatchesCell(const void* cell) const;
+
+  // Return an identifier which is unique to this predicate within the
+  // process. It is assigned when the predicate is constructed and is shared
+  // only with its copies, so storage layers may use it to cache the results
+  // of evaluating the predicate without relying on its address.
+  int64_t id() const { return id_; }
+
  private:
   // For Evaluate.
   friend class MaterializingIterator;
   friend class PredicateEvaluatingIterator;
   FRIEND_TEST(TestPredicate, TestColumnRange);
   FRIEND_TEST(TestPredicate, TestDontEvalauteOnUnselectedRows);
+  FRIEND_TEST(TestPredicate, TestInList);
+  FRIEND_TEST(TestPredicate, TestNullPredicates);
+
+  ColumnRangePredicate(const ColumnSchema &col,
+                       PredicateType type,
+                       const void* lower_bound,
+                       const void* upper_bound);
 
   // Evaluate the predicate on every row in the rowblock.
   //
@@ -123,7 +185,10 @@ class ColumnRangePredicate {
   void Evaluate(RowBlock *block, SelectionVector *sel) const;
 
   ColumnSchema col_;
+  PredicateType type_;
   ValueRange range_;
+  std::vector<const void*> in_list_values_;
+  int64_t id_;
 };
 
 } // namespace kudu
@@ -42,6 +42,13 @@ void ScanSpec::SetExclusiveUpperBoundKey(const EncodedKey* key) {
   }
 }
 
+void ScanSpec::AddKeyRange(const EncodedKey* lower, const EncodedKey* exclusive_upper) {
+  DCHECK(key_ranges_.empty() || key_ranges_.back().exclusive_upper != NULL);
+  DCHECK(key_ranges_.empty() || lower == NULL ||
+         lower->encoded_key().compare(key_ranges_.back().exclusive_upper->encoded_key()) >= 0);
+  key_ranges_.push_back(KeyRange(lower, exclusive_upper));
+}
+
 void ScanSpec::SetLowerBoundPartitionKey(const Slice& partitionKey) {
   if (partitionKey.compare(lower_bound_partition_key_) > 0) {
     lower_bound_partition_key_ = partitionKey.ToString();
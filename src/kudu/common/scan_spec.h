@@ -36,6 +36,17 @@ class ScanSpec {
 
   typedef vector<ColumnRangePredicate> PredicateList;
 
+  // A range of primary keys: [lower, exclusive_upper). Either end may be
+  // NULL, in which case the range is unbounded on that end.
+  struct KeyRange {
+    KeyRange(const EncodedKey* lower, const EncodedKey* exclusive_upper)
+      : lower(lower),
+        exclusive_upper(exclusive_upper) {
+    }
+    const EncodedKey* lower;
+    const EncodedKey* exclusive_upper;
+  };
+
   void AddPredicate(const ColumnRangePredicate &pred);
 
   // Set the lower bound (inclusive) primary key for the scan.
@@ -48,6 +59,16 @@ class ScanSpec {
   // If called multiple times, the most restrictive key will be used.
   void SetExclusiveUpperBoundKey(const EncodedKey* key);
 
+  // Add a primary key range to the scan. Once any key ranges have been added,
+  // rows whose keys fall outside of all of them cannot pass the predicates.
+  //
+  // Key ranges are derived from the predicates (e.g. an IN-list on a key
+  // column) and only serve to let storage seek past non-matching rows. The
+  // predicates which produced them remain in the spec. Ranges must be added
+  // in increasing key order and must not overlap. Does not take ownership
+  // of the keys, which must remain valid.
+  void AddKeyRange(const EncodedKey* lower, const EncodedKey* exclusive_upper);
+
   // Sets the lower bound (inclusive) partition key for the scan.
   //
   // The scan spec makes a copy of 'slice'; the caller may free it afterward.
@@ -82,6 +103,10 @@ class ScanSpec {
     return exclusive_upper_bound_key_;
   }
 
+  const vector<KeyRange>& key_ranges() const {
+    return key_ranges_;
+  }
+
   const string& lower_bound_partition_key() const {
     return lower_bound_partition_key_;
   }
@@ -107,6 +132,7 @@ class ScanSpec {
   vector<ColumnRangePredicate> predicates_;
   const EncodedKey* lower_bound_key_;
   const EncodedKey* exclusive_upper_bound_key_;
+  vector<KeyRange> key_ranges_;
   std::string lower_bound_partition_key_;
   std::string exclusive_upper_bound_partition_key_;
   bool cache_blocks_;
@@ -18,6 +18,8 @@
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
@@ -272,6 +274,66 @@ TEST_F(WireProtocolTest, TestBlockWithNoColumns) {
   ASSERT_EQ(900, pb.num_rows());
 }
 
+// Encode two blocks in columnar layout, with some NULL and some unselected
+// rows, and ensure that the columns extracted from the result match.
+TEST_F(WireProtocolTest, TestColumnarRowBlockEncoder) {
+  Arena arena(1024, 1024 * 1024);
+  ColumnarRowBlockEncoder encoder;
+  vector<string> expected_strs;
+  vector<int> expected_ints;
+  for (int b = 0; b < 2; b++) {
+    RowBlock block(schema_, 10, &arena);
+    block.selection_vector()->SetAllTrue();
+    for (int i = 0; i < block.nrows(); i++) {
+      int val = b * block.nrows() + i;
+      RowBlockRow row = block.row(i);
+      string str = strings::Substitute("row $0", val);
+      CHECK(arena.RelocateSlice(str, reinterpret_cast<Slice*>(row.mutable_cell_ptr(0))));
+      *reinterpret_cast<Slice*>(row.mutable_cell_ptr(1)) = Slice("hello world col2");
+      *reinterpret_cast<uint32_t*>(row.mutable_cell_ptr(2)) = val;
+      row.cell(2).set_null(val % 3 == 0);
+      if (i == 1) {
+        block.selection_vector()->SetRowUnselected(i);
+      } else {
+        expected_strs.push_back(str);
+        expected_ints.push_back(val % 3 == 0 ? -1 : val);
+      }
+    }
+    ASSERT_OK(encoder.AppendRowBlock(block, NULL));
+  }
+  ASSERT_EQ(expected_ints.size(), encoder.num_rows());
+
+  ColumnarRowBlockPB pb;
+  faststring data, varlen_data;
+  encoder.Finish(&pb, &data, &varlen_data);
+  SCOPED_TRACE(pb.DebugString());
+
+  vector<ColumnarColumnData> columns;
+  ASSERT_OK(ExtractColumnsFromColumnarRowBlockPB(schema_, pb, data, varlen_data, &columns));
+  ASSERT_EQ(3, columns.size());
+  ASSERT_EQ(0, (columns[2].data.data() - data.data()) % 8);
+  const uint32_t* offsets = reinterpret_cast<const uint32_t*>(columns[0].data.data());
+  const uint32_t* ints = reinterpret_cast<const uint32_t*>(columns[2].data.data());
+  for (int i = 0; i < pb.num_rows(); i++) {
+    SCOPED_TRACE(i);
+    Slice str(columns[0].varlen_data.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    EXPECT_EQ(expected_strs[i], str.ToString());
+    bool non_null = BitmapTest(columns[2].non_null_bitmap.data(), i);
+    EXPECT_EQ(expected_ints[i] != -1, non_null);
+    EXPECT_EQ(non_null ? expected_ints[i] : 0, ints[i]);
+  }
+
+  // A block with the wrong number of columns or a bad varlen offset is
+  // rejected.
+  Schema one_col(boost::assign::list_of(ColumnSchema("col1", STRING)), 1);
+  Status s = ExtractColumnsFromColumnarRowBlockPB(one_col, pb, data, varlen_data, &columns);
+  ASSERT_STR_CONTAINS(s.ToString(), "Corruption: Columnar row block has 18 rows and 3 columns");
+
+  reinterpret_cast<uint32_t*>(data.data() + pb.columns(0).data_offset())[5] = 10000;
+  s = ExtractColumnsFromColumnarRowBlockPB(schema_, pb, data, varlen_data, &columns);
+  ASSERT_STR_CONTAINS(s.ToString(), "Corruption: Row #5 contained bad varlen offset");
+}
+
 TEST_F(WireProtocolTest, TestColumnDefaultValue) {
   Slice write_default_str("Hello Write");
   Slice read_default_str("Hello Read");
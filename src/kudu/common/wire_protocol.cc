@@ -23,6 +23,8 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/fastmem.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/alignment.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/net/sockaddr.h"
@@ -554,4 +556,268 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
   rowblock_pb->set_num_rows(rowblock_pb->num_rows() + num_rows);
 }
 
+
+struct ColumnarRowBlockEncoder::ColumnBuffers {
+  ColumnBuffers(bool nullable, bool varlen)
+    : is_nullable(nullable),
+      is_varlen(varlen) {
+  }
+
+  const bool is_nullable;
+  const bool is_varlen;
+  faststring data;
+  faststring varlen_data;
+  faststring non_null_bitmap;
+};
+
+ColumnarRowBlockEncoder::ColumnarRowBlockEncoder()
+  : num_rows_(0) {
+}
+
+ColumnarRowBlockEncoder::~ColumnarRowBlockEncoder() {
+  STLDeleteElements(&columns_);
+}
+
+// Appends the selected cells of column 'col_idx' of 'block' to 'dst'.
+//
+// IS_NULLABLE and IS_VARLEN are template parameters for the same reason as
+// in CopyColumn() above.
+template<bool IS_NULLABLE, bool IS_VARLEN>
+Status ColumnarRowBlockEncoder::AppendColumn(const RowBlock& block, int col_idx,
+                                             ColumnBuffers* dst) {
+  ColumnBlock cblock = block.column_block(col_idx);
+  size_t cell_size = cblock.stride();
+  int num_selected = block.selection_vector()->CountSelected();
+
+  uint8_t* non_null_bitmap = NULL;
+  if (IS_NULLABLE) {
+    // Bits beyond 'num_rows_' are always clear, since each newly added byte
+    // is zeroed.
+    size_t old_size = dst->non_null_bitmap.size();
+    size_t new_size = BitmapSize(num_rows_ + num_selected);
+    dst->non_null_bitmap.resize(new_size);
+    non_null_bitmap = dst->non_null_bitmap.data();
+    memset(non_null_bitmap + old_size, 0, new_size - old_size);
+  }
+
+  uint8_t* dst_cell = NULL;
+  if (IS_VARLEN) {
+    if (dst->data.size() == 0) {
+      uint32_t zero = 0;
+      dst->data.append(&zero, sizeof(zero));
+    }
+  } else {
+    size_t old_size = dst->data.size();
+    dst->data.resize(old_size + num_selected * cell_size);
+    dst_cell = dst->data.data() + old_size;
+  }
+
+  BitmapIterator selected_row_iter(block.selection_vector()->bitmap(),
+                                   block.nrows());
+  int run_size;
+  bool selected;
+  int row_idx = 0;
+  int64_t dst_row_idx = num_rows_;
+  while ((run_size = selected_row_iter.Next(&selected))) {
+    if (!selected) {
+      row_idx += run_size;
+      continue;
+    }
+    if (!IS_VARLEN) {
+      // Copy the whole run, then fix up the NULL cells below.
+      strings::memcpy_inlined(dst_cell, cblock.cell_ptr(row_idx), run_size * cell_size);
+    }
+    if (IS_NULLABLE || IS_VARLEN) {
+      for (int i = 0; i < run_size; i++) {
+        bool is_null = IS_NULLABLE && cblock.is_null(row_idx + i);
+        if (IS_NULLABLE && !is_null) {
+          BitmapSet(non_null_bitmap, dst_row_idx + i);
+        }
+        if (IS_VARLEN) {
+          if (!is_null) {
+            const Slice* slice = reinterpret_cast<const Slice*>(cblock.cell_ptr(row_idx + i));
+            dst->varlen_data.append(slice->data(), slice->size());
+          }
+          if (PREDICT_FALSE(dst->varlen_data.size() > kuint32max)) {
+            return Status::InvalidArgument(strings::Substitute(
+                "Variable-length data of a columnar row block exceeds $0 bytes", kuint32max));
+          }
+          uint32_t end_offset = dst->varlen_data.size();
+          dst->data.append(&end_offset, sizeof(end_offset));
+        } else if (is_null) {
+          memset(dst_cell + i * cell_size, 0, cell_size);
+        }
+      }
+    }
+    if (!IS_VARLEN) {
+      dst_cell += run_size * cell_size;
+    }
+    row_idx += run_size;
+    dst_row_idx += run_size;
+  }
+  return Status::OK();
+}
+
+Status ColumnarRowBlockEncoder::AppendRowBlock(const RowBlock& block,
+                                               const Schema* projection_schema) {
+  const Schema& tablet_schema = block.schema();
+  if (projection_schema == NULL) {
+    projection_schema = &tablet_schema;
+  }
+
+  if (columns_.empty()) {
+    for (int i = 0; i < projection_schema->num_columns(); i++) {
+      const ColumnSchema& col = projection_schema->column(i);
+      columns_.push_back(new ColumnBuffers(col.is_nullable(),
+                                           col.type_info()->physical_type() == BINARY));
+    }
+  }
+  DCHECK_EQ(columns_.size(), projection_schema->num_columns());
+
+  for (int t_schema_idx = 0; t_schema_idx < tablet_schema.num_columns(); t_schema_idx++) {
+    const ColumnSchema& col = tablet_schema.column(t_schema_idx);
+    int proj_schema_idx = projection_schema->find_column(col.name());
+    if (proj_schema_idx == -1) {
+      continue;
+    }
+
+    ColumnBuffers* dst = columns_[proj_schema_idx];
+    if (dst->is_nullable && dst->is_varlen) {
+      RETURN_NOT_OK((AppendColumn<true, true>(block, t_schema_idx, dst)));
+    } else if (dst->is_nullable && !dst->is_varlen) {
+      RETURN_NOT_OK((AppendColumn<true, false>(block, t_schema_idx, dst)));
+    } else if (!dst->is_nullable && dst->is_varlen) {
+      RETURN_NOT_OK((AppendColumn<false, true>(block, t_schema_idx, dst)));
+    } else {
+      RETURN_NOT_OK((AppendColumn<false, false>(block, t_schema_idx, dst)));
+    }
+  }
+  num_rows_ += block.selection_vector()->CountSelected();
+  return Status::OK();
+}
+
+size_t ColumnarRowBlockEncoder::buffered_size() const {
+  size_t size = 0;
+  BOOST_FOREACH(const ColumnBuffers* col, columns_) {
+    size += col->data.size() + col->varlen_data.size() + col->non_null_bitmap.size();
+  }
+  return size;
+}
+
+namespace {
+
+// Appends 'src' to 'dst' at the next 8-byte aligned offset, and returns that
+// offset.
+int64_t AppendAligned(const faststring& src, faststring* dst) {
+  size_t old_size = dst->size();
+  size_t offset = KUDU_ALIGN_UP(old_size, 8);
+  dst->resize(offset + src.size());
+  memset(dst->data() + old_size, 0, offset - old_size);
+  if (src.size() > 0) {
+    memcpy(dst->data() + offset, src.data(), src.size());
+  }
+  return offset;
+}
+
+} // anonymous namespace
+
+void ColumnarRowBlockEncoder::Finish(ColumnarRowBlockPB* pb,
+                                     faststring* data,
+                                     faststring* varlen_data) const {
+  pb->set_num_rows(num_rows_);
+  BOOST_FOREACH(const ColumnBuffers* col, columns_) {
+    ColumnarRowBlockPB::Column* col_pb = pb->add_columns();
+    col_pb->set_data_offset(AppendAligned(col->data, data));
+    col_pb->set_data_size(col->data.size());
+    if (col->is_varlen) {
+      col_pb->set_varlen_data_offset(varlen_data->size());
+      col_pb->set_varlen_data_size(col->varlen_data.size());
+      varlen_data->append(col->varlen_data.data(), col->varlen_data.size());
+    }
+    if (col->is_nullable) {
+      col_pb->set_non_null_bitmap_offset(AppendAligned(col->non_null_bitmap, data));
+      col_pb->set_non_null_bitmap_size(col->non_null_bitmap.size());
+    }
+  }
+}
+
+namespace {
+
+// Sets 'part' to the given range of 'sidecar', or returns Corruption if the
+// range does not lie within it or does not have the expected size.
+Status GetColumnPart(const Slice& sidecar, int64_t offset, int64_t size,
+                     int64_t expected_size, const ColumnSchema& col, const char* part_name,
+                     Slice* part) {
+  bool overflowed = false;
+  int64_t end = AddWithOverflowCheck(offset, size, &overflowed);
+  if (PREDICT_FALSE(overflowed || offset < 0 || size < 0 ||
+                    end > static_cast<int64_t>(sidecar.size()) ||
+                    (expected_size >= 0 && size != expected_size))) {
+    return Status::Corruption(
+      strings::Substitute("Column $0 has bad $1: offset $2, size $3 (expected size $4, "
+                          "sidecar size $5)", col.ToString(), part_name, offset, size,
+                          expected_size, sidecar.size()));
+  }
+  *part = Slice(sidecar.data() + offset, size);
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+Status ExtractColumnsFromColumnarRowBlockPB(const Schema& schema,
+                                            const ColumnarRowBlockPB& rowblock_pb,
+                                            const Slice& data,
+                                            const Slice& varlen_data,
+                                            vector<ColumnarColumnData>* columns) {
+  int64_t num_rows = rowblock_pb.num_rows();
+  if (PREDICT_FALSE(num_rows < 0 || num_rows > kint32max ||
+                    rowblock_pb.columns_size() != schema.num_columns())) {
+    return Status::Corruption(
+      strings::Substitute("Columnar row block has $0 rows and $1 columns but expected $2 columns",
+                          num_rows, rowblock_pb.columns_size(), schema.num_columns()));
+  }
+
+  columns->clear();
+  columns->resize(schema.num_columns());
+  for (int i = 0; i < schema.num_columns(); i++) {
+    const ColumnSchema& col = schema.column(i);
+    const ColumnarRowBlockPB::Column& col_pb = rowblock_pb.columns(i);
+    ColumnarColumnData* dst = &(*columns)[i];
+    bool is_varlen = col.type_info()->physical_type() == BINARY;
+
+    // An empty block may omit the column data altogether.
+    int64_t expected_data_size = is_varlen ? (num_rows + 1) * sizeof(uint32_t)
+                                           : num_rows * col.type_info()->size();
+    if (num_rows > 0 || col_pb.data_size() > 0) {
+      RETURN_NOT_OK(GetColumnPart(data, col_pb.data_offset(), col_pb.data_size(),
+                                  expected_data_size, col, "data", &dst->data));
+    }
+    if (is_varlen) {
+      RETURN_NOT_OK(GetColumnPart(varlen_data, col_pb.varlen_data_offset(),
+                                  col_pb.varlen_data_size(), -1, col, "varlen data",
+                                  &dst->varlen_data));
+      // Ensure that every cell lies within the varlen data.
+      if (dst->data.size() > 0) {
+        const uint8_t* offsets = dst->data.data();
+        uint32_t prev = 0;
+        for (int64_t row = 0; row <= num_rows; row++) {
+          uint32_t offset = UNALIGNED_LOAD32(offsets + row * sizeof(uint32_t));
+          if (PREDICT_FALSE(offset < prev || offset > dst->varlen_data.size())) {
+            return Status::Corruption(
+              strings::Substitute("Row #$0 contained bad varlen offset for column $1: $2",
+                                  row, col.ToString(), offset));
+          }
+          prev = offset;
+        }
+      }
+    }
+    if (col.is_nullable()) {
+      RETURN_NOT_OK(GetColumnPart(data, col_pb.non_null_bitmap_offset(),
+                                  col_pb.non_null_bitmap_size(), BitmapSize(num_rows), col,
+                                  "non-null bitmap", &dst->non_null_bitmap));
+    }
+  }
+  return Status::OK();
+}
+
 } // namespace kudu
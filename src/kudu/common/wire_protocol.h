@@ -19,6 +19,8 @@
 #include <vector>
 
 #include "kudu/common/wire_protocol.pb.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -31,7 +33,6 @@ class RowBlock;
 class RowBlockRow;
 class RowChangeList;
 class Schema;
-class Slice;
 class Sockaddr;
 
 // Convert the given C++ Status object into the equivalent Protobuf.
@@ -107,6 +108,71 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
                        const Schema* client_projection_schema,
                        faststring* data_buf, faststring* indirect_data);
 
+// Accumulates row blocks in the columnar layout described by
+// ColumnarRowBlockPB.
+//
+// Unlike SerializeRowBlock(), the cells of each column are appended to a
+// buffer of their own, so fixed-length columns are copied in runs rather
+// than transposed into rows.
+class ColumnarRowBlockEncoder {
+ public:
+  ColumnarRowBlockEncoder();
+  ~ColumnarRowBlockEncoder();
+
+  // Appends the selected rows of 'block'. If 'client_projection_schema' is
+  // not NULL, only the columns it specifies are appended, as in
+  // SerializeRowBlock(). Every call must use the same projection.
+  //
+  // Returns an error if a column's variable-length data would no longer be
+  // addressable by its 32-bit offsets, after which the encoder must not be
+  // used anymore.
+  Status AppendRowBlock(const RowBlock& block, const Schema* client_projection_schema);
+
+  // The number of rows appended so far.
+  int64_t num_rows() const { return num_rows_; }
+
+  // The number of bytes buffered so far.
+  size_t buffered_size() const;
+
+  // Sets the columns and the row count of 'pb', and concatenates the
+  // buffered columns into 'data' and 'varlen_data', which are to be sent
+  // as the 'data_sidecar' and 'varlen_data_sidecar' of 'pb'.
+  void Finish(ColumnarRowBlockPB* pb, faststring* data, faststring* varlen_data) const;
+
+ private:
+  struct ColumnBuffers;
+
+  template<bool IS_NULLABLE, bool IS_VARLEN>
+  Status AppendColumn(const RowBlock& block, int col_idx, ColumnBuffers* dst);
+
+  // One entry per projected column. Empty until the first call to
+  // AppendRowBlock().
+  std::vector<ColumnBuffers*> columns_;
+  int64_t num_rows_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnarRowBlockEncoder);
+};
+
+// A column of a ColumnarRowBlockPB, as returned by
+// ExtractColumnsFromColumnarRowBlockPB(). See ColumnarRowBlockPB for the
+// format of each part; the parts which do not apply to the column are empty.
+struct ColumnarColumnData {
+  Slice data;
+  Slice varlen_data;
+  Slice non_null_bitmap;
+};
+
+// Locates the columns of the given ColumnarRowBlockPB, which must have exactly
+// the given Schema, within its sidecars 'data' and 'varlen_data', and
+// replaces the contents of 'columns' with them.
+//
+// Returns a bad Status if the provided data is invalid or corrupt.
+Status ExtractColumnsFromColumnarRowBlockPB(const Schema& schema,
+                                            const ColumnarRowBlockPB& rowblock_pb,
+                                            const Slice& data,
+                                            const Slice& varlen_data,
+                                            std::vector<ColumnarColumnData>* columns);
+
 // Rewrites the data pointed-to by row data slice 'row_data_slice' by replacing
 // relative indirect data pointers with absolute ones in 'indirect_data_slice'.
 // At the time of this writing, this rewriting is only done for STRING types.
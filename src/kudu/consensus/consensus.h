@@ -20,6 +20,7 @@
 #include <tr1/memory>
 #include <vector>
 
+#include "kudu/common/timestamp.h"
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/gutil/callback.h"
@@ -312,6 +313,23 @@ class ReplicaTransactionFactory {
  public:
   virtual Status StartReplicaTransaction(const scoped_refptr<ConsensusRound>& context) = 0;
 
+  // Returns the safe time to send to followers while this replica is leader:
+  // a timestamp such that every write with a lower timestamp has already been
+  // started, and no new write will be assigned a lower one. Returns
+  // Timestamp::kInvalidTimestamp if there is no such timestamp.
+  virtual Timestamp GetSafeTimestampForFollowers() {
+    return Timestamp::kInvalidTimestamp;
+  }
+
+  // Called on a follower once every write below the leader's 'safe_time' has
+  // been passed to StartReplicaTransaction(). See
+  // ConsensusRequestPB.safe_timestamp.
+  virtual void AdvanceSafeTimestamp(const Timestamp& safe_time) {}
+
+  // Called when this replica becomes leader, before it assigns timestamps to
+  // any new writes.
+  virtual void BecomingLeader() {}
+
   virtual ~ReplicaTransactionFactory() {}
 };
 
@@ -28,6 +28,8 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/rpc_sidecar.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
@@ -59,6 +61,13 @@ DEFINE_bool(enable_remote_bootstrap, true,
             "replica. For testing purposes only.");
 TAG_FLAG(enable_remote_bootstrap, unsafe);
 
+DEFINE_bool(consensus_send_ops_in_sidecar, false,
+            "Whether the leader sends the operations to replicate to its followers "
+            "in an RPC sidecar, so that each operation is serialized only once "
+            "rather than once per follower. Requires that all tablet servers "
+            "understand such requests.");
+TAG_FLAG(consensus_send_ops_in_sidecar, experimental);
+
 namespace kudu {
 namespace consensus {
 
@@ -216,11 +225,33 @@ void Peer::SendNextRequest(bool even_if_queue_empty) {
   VLOG_WITH_PREFIX_UNLOCKED(2) << "Sending to peer " << peer_pb().permanent_uuid() << ": "
       << request_.ShortDebugString();
   controller_.Reset();
+  request_.clear_ops_sidecar_idx();
+  if (FLAGS_consensus_send_ops_in_sidecar &&
+      request_.ops_size() > 0 &&
+      proxy_->SupportsOpsSidecar()) {
+    MoveOpsToSidecar();
+  }
 
   proxy_->UpdateAsync(&request_, &response_, &controller_,
                       boost::bind(&Peer::ProcessResponse, this));
 }
 
+void Peer::MoveOpsToSidecar() {
+  gscoped_ptr<faststring> ops(new faststring());
+  queue_->SerializeOpsForPeer(replicate_msg_refs_, ops.get());
+  int idx;
+  Status s = controller_.AddOutboundSidecar(
+      make_gscoped_ptr(new rpc::RpcSidecar(ops.Pass())), &idx);
+  if (PREDICT_FALSE(!s.ok())) {
+    // Just send the ops in the request itself.
+    LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to add ops sidecar: " << s.ToString();
+    return;
+  }
+  request_.set_ops_sidecar_idx(idx);
+  // We don't own the ops (the queue does).
+  request_.mutable_ops()->ExtractSubrange(0, request_.ops_size(), NULL);
+}
+
 void Peer::ProcessResponse() {
   // Note: This method runs on the reactor thread.
 
@@ -353,6 +384,10 @@ RpcPeerProxy::RpcPeerProxy(gscoped_ptr<HostPort> hostport,
       consensus_proxy_(consensus_proxy.Pass()) {
 }
 
+bool RpcPeerProxy::SupportsOpsSidecar() const {
+  return true;
+}
+
 void RpcPeerProxy::UpdateAsync(const ConsensusRequestPB* request,
                                ConsensusResponsePB* response,
                                rpc::RpcController* controller,
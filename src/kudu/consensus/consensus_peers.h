@@ -151,6 +151,10 @@ class Peer {
 
   void SendNextRequest(bool even_if_queue_empty);
 
+  // Moves the ops of 'request_' into an RPC sidecar of 'controller_'. If
+  // the sidecar can't be added, the ops are left in the request.
+  void MoveOpsToSidecar();
+
   // Signals that a response was received from the peer.
   // This method is called from the reactor thread and calls
   // DoProcessResponse() on thread_pool_ to do any work that requires IO or
@@ -257,6 +261,12 @@ class PeerProxy {
     LOG(DFATAL) << "Not implemented";
   }
 
+  // Whether the requests passed to UpdateAsync() may carry their ops in an
+  // RPC sidecar. See ConsensusRequestPB.ops_sidecar_idx.
+  virtual bool SupportsOpsSidecar() const {
+    return false;
+  }
+
   virtual ~PeerProxy() {}
 };
 
@@ -292,6 +302,8 @@ class RpcPeerProxy : public PeerProxy {
                                     rpc::RpcController* controller,
                                     const rpc::ResponseCallback& callback) OVERRIDE;
 
+  virtual bool SupportsOpsSidecar() const OVERRIDE;
+
   virtual ~RpcPeerProxy();
 
  private:
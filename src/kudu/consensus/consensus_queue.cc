@@ -273,12 +273,25 @@ Status PeerMessageQueue::AppendOperations(const vector<ReplicateRefPtr>& msgs,
   return Status::OK();
 }
 
+void PeerMessageQueue::SetSafeTimestampCallback(const Callback<Timestamp(void)>& callback) {
+  safe_timestamp_callback_ = callback;
+}
+
 Status PeerMessageQueue::RequestForPeer(const string& uuid,
                                         ConsensusRequestPB* request,
                                         vector<ReplicateRefPtr>* msg_refs,
                                         bool* needs_remote_bootstrap) {
+  // Take the safe time before looking at the end of the log: every write below
+  // it must already have been appended, since writes are started before they
+  // are replicated.
+  Timestamp safe_timestamp = Timestamp::kInvalidTimestamp;
+  if (!safe_timestamp_callback_.is_null()) {
+    safe_timestamp = safe_timestamp_callback_.Run();
+  }
+
   TrackedPeer* peer = NULL;
   OpId preceding_id;
+  int64_t last_appended_index;
   {
     lock_guard<simple_spinlock> lock(&queue_lock_);
     DCHECK_EQ(queue_state_.state, kQueueOpen);
@@ -295,8 +308,10 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
     // This is initialized to the queue's last appended op but gets set to the id of the
     // log entry preceding the first one in 'messages' if messages are found for the peer.
     preceding_id = queue_state_.last_appended;
+    last_appended_index = queue_state_.last_appended.index();
     request->mutable_committed_index()->CopyFrom(queue_state_.committed_index);
     request->set_caller_term(queue_state_.current_term);
+    request->clear_safe_timestamp();
   }
 
   MonoDelta unreachable_time =
@@ -373,6 +388,15 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
   DCHECK(preceding_id.IsInitialized());
   request->mutable_preceding_id()->CopyFrom(preceding_id);
 
+  // The safe time only covers the ops up to where the log ended when it was
+  // taken, so only send it if the peer will have all of those.
+  int64_t last_sent_index = request->ops_size() > 0 ?
+      request->ops(request->ops_size() - 1).id().index() : preceding_id.index();
+  if (safe_timestamp != Timestamp::kInvalidTimestamp &&
+      last_sent_index >= last_appended_index) {
+    request->set_safe_timestamp(safe_timestamp.ToUint64());
+  }
+
   if (PREDICT_FALSE(VLOG_IS_ON(2))) {
     if (request->ops_size() > 0) {
       VLOG_WITH_PREFIX_UNLOCKED(2) << "Sending request with operations to Peer: " << uuid
@@ -414,6 +438,11 @@ Status PeerMessageQueue::GetRemoteBootstrapRequestForPeer(const string& uuid,
   return Status::OK();
 }
 
+void PeerMessageQueue::SerializeOpsForPeer(const vector<ReplicateRefPtr>& msgs,
+                                           faststring* buf) {
+  log_cache_.AppendSerializedOps(msgs, buf);
+}
+
 void PeerMessageQueue::AdvanceQueueWatermark(const char* type,
                                              OpId* watermark,
                                              const OpId& replicated_before,
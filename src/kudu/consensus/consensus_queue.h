@@ -28,6 +28,8 @@
 #include "kudu/consensus/log_util.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/ref_counted_replicate.h"
+#include "kudu/common/timestamp.h"
+#include "kudu/gutil/callback.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/status.h"
@@ -35,6 +37,7 @@
 namespace kudu {
 template<class T>
 class AtomicGauge;
+class faststring;
 class MemTracker;
 class MetricEntity;
 class ThreadPool;
@@ -129,6 +132,11 @@ class PeerMessageQueue {
   // Initialize the queue.
   virtual void Init(const OpId& last_locally_replicated);
 
+  // Sets the callback which supplies the safe time sent to peers in leader
+  // mode. See ConsensusRequestPB.safe_timestamp. Must be called before the
+  // queue is used.
+  void SetSafeTimestampCallback(const Callback<Timestamp(void)>& callback);
+
   // Changes the queue to leader mode, meaning it tracks majority replicated
   // operations and notifies observers when those change.
   // 'committed_index' corresponds to the id of the last committed operation,
@@ -200,6 +208,10 @@ class PeerMessageQueue {
   virtual Status GetRemoteBootstrapRequestForPeer(const std::string& uuid,
                                                   StartRemoteBootstrapRequestPB* req);
 
+  // Append the serialized form of 'msgs', as returned by RequestForPeer(),
+  // to 'buf', in the format described for ConsensusRequestPB.ops_sidecar_idx.
+  void SerializeOpsForPeer(const std::vector<ReplicateRefPtr>& msgs, faststring* buf);
+
   // Update the last successful communication timestamp for the given peer
   // to the current time. This should be called when a non-network related
   // error is received from the peer, indicating that it is alive, even if it
@@ -383,6 +395,9 @@ class PeerMessageQueue {
 
   QueueState queue_state_;
 
+  // Supplies the safe time sent to peers. May be null.
+  Callback<Timestamp(void)> safe_timestamp_callback_;
+
   // The currently tracked peers.
   PeersMap peers_map_;
   mutable simple_spinlock queue_lock_; // TODO: rename
@@ -33,6 +33,8 @@ DEFINE_int32(num_batches, 10000,
 
 DECLARE_int32(log_min_segments_to_retain);
 
+METRIC_DECLARE_counter(log_bytes_logged);
+
 namespace kudu {
 namespace log {
 
@@ -783,6 +785,99 @@ TEST_F(LogTest, TestLogReaderReturnsLatestSegmentIfIndexEmpty) {
   ASSERT_EQ(2, entries.size());
 }
 
+// Appends a NO_OP with a highly compressible payload to 'log', and waits
+// for it to be durable.
+static void AppendCompressibleNoOp(const scoped_refptr<Clock>& clock, Log* log, int64_t index) {
+  consensus::ReplicateRefPtr replicate = make_scoped_refptr_replicate(new ReplicateMsg());
+  replicate->get()->mutable_id()->CopyFrom(MakeOpId(1, index));
+  replicate->get()->set_op_type(NO_OP);
+  replicate->get()->set_timestamp(clock->Now().ToUint64());
+  replicate->get()->mutable_noop_request()->set_payload_for_tests(string(4096, 'x'));
+  Synchronizer s;
+  ASSERT_OK(log->AsyncAppendReplicates(boost::assign::list_of(replicate),
+                                       s.AsStatusCallback()));
+  ASSERT_OK(s.Wait());
+}
+
+// Tests that a compressed segment records its codec, is smaller on disk than
+// the same entries uncompressed, and that its entries can be read back both
+// by scanning the segment and through the index.
+TEST_F(LogTest, TestCompressedSegment) {
+  options_.compression_codec = LZ4;
+  BuildLog();
+
+  // Write the same entries to an uncompressed log, with metrics of its own,
+  // to compare against.
+  LogOptions uncompressed_options = options_;
+  uncompressed_options.compression_codec = NO_COMPRESSION;
+  scoped_refptr<MetricEntity> uncompressed_entity =
+      METRIC_ENTITY_tablet.Instantiate(metric_registry_.get(), "uncompressed");
+  scoped_refptr<Log> uncompressed_log;
+  ASSERT_OK(Log::Open(uncompressed_options,
+                      fs_manager_.get(),
+                      "uncompressed-test-log-tablet",
+                      SchemaBuilder(schema_).Build(),
+                      0, // schema_version
+                      uncompressed_entity.get(),
+                      &uncompressed_log));
+
+  const int kNumEntries = 20;
+  for (int i = 1; i <= kNumEntries; i++) {
+    ASSERT_NO_FATAL_FAILURE(AppendCompressibleNoOp(clock_, log_.get(), i));
+    ASSERT_NO_FATAL_FAILURE(AppendCompressibleNoOp(clock_, uncompressed_log.get(), i));
+  }
+  ASSERT_OK(log_->AllocateSegmentAndRollOver());
+  ASSERT_OK(uncompressed_log->AllocateSegmentAndRollOver());
+
+  SegmentSequence segments;
+  ASSERT_OK(log_->GetLogReader()->GetSegmentsSnapshot(&segments));
+  SegmentSequence uncompressed_segments;
+  ASSERT_OK(uncompressed_log->GetLogReader()->GetSegmentsSnapshot(&uncompressed_segments));
+
+  // Reopen the segments from disk, so that their entry format is taken from
+  // the headers they were written with.
+  scoped_refptr<ReadableLogSegment> segment;
+  ASSERT_OK(ReadableLogSegment::Open(env_.get(), segments[0]->path(), &segment));
+  ASSERT_EQ(LZ4, segment->header().compression_codec());
+  scoped_refptr<ReadableLogSegment> uncompressed_segment;
+  ASSERT_OK(ReadableLogSegment::Open(env_.get(), uncompressed_segments[0]->path(),
+                                     &uncompressed_segment));
+  ASSERT_FALSE(uncompressed_segment->header().has_compression_codec());
+
+  vector<LogEntryPB*> entries;
+  ElementDeleter deleter(&entries);
+  int64_t end_offset;
+  ASSERT_OK(segment->ReadEntries(&entries, &end_offset));
+  ASSERT_EQ(kNumEntries, entries.size());
+  for (int i = 0; i < kNumEntries; i++) {
+    ASSERT_EQ(REPLICATE, entries[i]->type());
+    ASSERT_EQ(i + 1, entries[i]->replicate().id().index());
+    ASSERT_EQ(4096, entries[i]->replicate().noop_request().payload_for_tests().size());
+  }
+  int64_t compressed_size = end_offset - segment->first_entry_offset();
+
+  vector<LogEntryPB*> uncompressed_entries;
+  ElementDeleter uncompressed_deleter(&uncompressed_entries);
+  ASSERT_OK(uncompressed_segment->ReadEntries(&uncompressed_entries, &end_offset));
+  ASSERT_EQ(kNumEntries, uncompressed_entries.size());
+  int64_t uncompressed_size = end_offset - uncompressed_segment->first_entry_offset();
+  ASSERT_LT(compressed_size * 4, uncompressed_size);
+
+  // Each log counts the bytes it actually wrote to its segment.
+  ASSERT_EQ(compressed_size, METRIC_log_bytes_logged.Instantiate(metric_entity_)->value());
+  ASSERT_EQ(uncompressed_size,
+            METRIC_log_bytes_logged.Instantiate(uncompressed_entity)->value());
+
+  vector<ReplicateMsg*> repls;
+  ElementDeleter repl_deleter(&repls);
+  ASSERT_OK(log_->GetLogReader()->ReadReplicatesInRange(
+      1, kNumEntries, LogReader::kNoSizeLimit, &repls));
+  ASSERT_EQ(kNumEntries, repls.size());
+  ASSERT_EQ(kNumEntries, repls.back()->id().index());
+
+  ASSERT_OK(uncompressed_log->Close());
+}
+
 TEST_F(LogTest, TestOpIdUtils) {
   OpId id = MakeOpId(1, 2);
   ASSERT_EQ("1.2", consensus::OpIdToString(id));
@@ -15,6 +15,8 @@
 #include "kudu/consensus/log.h"
 
 #include <algorithm>
+#include <deque>
+#include <map>
 
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/log_index.h"
@@ -36,6 +38,7 @@
 #include "kudu/util/kernel_stack_watchdog.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/random.h"
@@ -116,6 +119,11 @@ using std::tr1::shared_ptr;
 
 // This class is responsible for managing the thread that appends to
 // the log file.
+//
+// If the log is configured to pipeline appends, a second thread syncs the
+// log and runs the callbacks of the appended entry batches, so that the
+// next group of batches can be written while the previous one is being
+// synced. Entry batches are serialized by the threads which enqueue them.
 class Log::AppendThread {
  public:
   explicit AppendThread(Log* log);
@@ -129,24 +137,72 @@ class Log::AppendThread {
   // method.
   void Shutdown();
 
+  // Waits until all of the appended entry batches have been synced and
+  // their callbacks run.
+  void WaitForPendingSyncs();
+
  private:
+  // A group of entry batches which were appended together, and are waiting
+  // for the log to be synced before their callbacks can run.
+  struct AppendedGroup {
+    std::vector<LogEntryBatch*> entry_batches;
+    bool needs_sync;
+    MonoTime start_time;
+  };
+
+  // The maximum number of appended groups waiting for the sync thread
+  // before appending blocks.
+  static const size_t kMaxGroupsToSync = 4;
+
   void RunThread();
 
+  // Syncs the log for the appended groups and runs their callbacks, in the
+  // order they were appended.
+  void RunSyncThread();
+
+  // Hands 'group' over to the sync thread.
+  void EnqueueForSync(gscoped_ptr<AppendedGroup> group);
+
   Log* const log_;
 
   // Lock to protect access to thread_ during shutdown.
   mutable boost::mutex lock_;
   scoped_refptr<Thread> thread_;
+  scoped_refptr<Thread> sync_thread_;
+
+  // Lock protecting the members below.
+  Mutex sync_lock_;
+
+  // Signaled when groups are enqueued for the sync thread, when their
+  // callbacks have run, and when the append thread exits.
+  ConditionVariable sync_cond_;
+
+  // The groups which are waiting for the sync thread.
+  std::deque<AppendedGroup*> groups_to_sync_;
+
+  // The number of groups handed over to the sync thread whose callbacks
+  // haven't run yet.
+  int num_groups_in_flight_;
+
+  // Set once the append thread has handed over its last group.
+  bool appends_done_;
 };
 
 
 Log::AppendThread::AppendThread(Log *log)
-  : log_(log) {
+  : log_(log),
+    sync_cond_(&sync_lock_),
+    num_groups_in_flight_(0),
+    appends_done_(false) {
 }
 
 Status Log::AppendThread::Init() {
   DCHECK(!thread_) << "Already initialized";
   VLOG(1) << "Starting log append thread for tablet " << log_->tablet_id();
+  if (log_->options_.pipelined_append) {
+    RETURN_NOT_OK(kudu::Thread::Create("log", "syncer",
+        &AppendThread::RunSyncThread, this, &sync_thread_));
+  }
   RETURN_NOT_OK(kudu::Thread::Create("log", "appender",
       &AppendThread::RunThread, this, &thread_));
   return Status::OK();
@@ -156,7 +212,6 @@ void Log::AppendThread::RunThread() {
   bool shutting_down = false;
   while (PREDICT_TRUE(!shutting_down)) {
     std::vector<LogEntryBatch*> entry_batches;
-    ElementDeleter d(&entry_batches);
 
     // We shut down the entry_queue when it's time to shut down the append
     // thread, which causes this call to return false, while still populating
@@ -166,66 +221,91 @@ void Log::AppendThread::RunThread() {
     if (PREDICT_FALSE(!log_->entry_queue()->BlockingDrainTo(&entry_batches))) {
       shutting_down = true;
     }
-
-    if (log_->metrics_) {
-      log_->metrics_->entry_batches_per_group->Increment(entry_batches.size());
+    if (!sync_thread_) {
+      log_->AppendAndSyncEntryBatches(&entry_batches);
+      continue;
     }
-    TRACE_EVENT1("log", "batch", "batch_size", entry_batches.size());
-
-    SCOPED_LATENCY_METRIC(log_->metrics_, group_commit_latency);
-
-    bool is_all_commits = true;
-    BOOST_FOREACH(LogEntryBatch* entry_batch, entry_batches) {
-      entry_batch->WaitForReady();
-      TRACE_EVENT_FLOW_END0("log", "Batch", entry_batch);
-      Status s = log_->DoAppend(entry_batch);
-      if (PREDICT_FALSE(!s.ok())) {
-        LOG(ERROR) << "Error appending to the log: " << s.ToString();
-        DLOG(FATAL) << "Aborting: " << s.ToString();
-        entry_batch->set_failed_to_append();
-        // TODO If a single transaction fails to append, should we
-        // abort all subsequent transactions in this batch or allow
-        // them to be appended? What about transactions in future
-        // batches?
-        if (!entry_batch->callback().is_null()) {
-          entry_batch->callback().Run(s);
-        }
+    if (entry_batches.empty()) {
+      continue;
+    }
+    gscoped_ptr<AppendedGroup> group(new AppendedGroup);
+    group->start_time = MonoTime::Now(MonoTime::FINE);
+    group->entry_batches.swap(entry_batches);
+    group->needs_sync = log_->AppendEntryBatches(group->entry_batches);
+    EnqueueForSync(group.Pass());
+  }
+
+  if (sync_thread_) {
+    MutexLock l(sync_lock_);
+    appends_done_ = true;
+    sync_cond_.Broadcast();
+  }
+  VLOG(1) << "Exiting AppendThread for tablet " << log_->tablet_id();
+}
+
+void Log::AppendThread::EnqueueForSync(gscoped_ptr<AppendedGroup> group) {
+  MutexLock l(sync_lock_);
+  while (groups_to_sync_.size() >= kMaxGroupsToSync) {
+    sync_cond_.Wait();
+  }
+  groups_to_sync_.push_back(group.release());
+  num_groups_in_flight_++;
+  sync_cond_.Broadcast();
+}
+
+void Log::AppendThread::RunSyncThread() {
+  while (true) {
+    std::vector<AppendedGroup*> groups;
+    {
+      MutexLock l(sync_lock_);
+      while (groups_to_sync_.empty() && !appends_done_) {
+        sync_cond_.Wait();
       }
-      if (is_all_commits && entry_batch->type_ != COMMIT) {
-        is_all_commits = false;
+      if (groups_to_sync_.empty()) {
+        break;
       }
+      groups.assign(groups_to_sync_.begin(), groups_to_sync_.end());
+      groups_to_sync_.clear();
+      // Let the append thread enqueue more groups while these are synced.
+      sync_cond_.Broadcast();
     }
+    ElementDeleter d(&groups);
 
+    // A single sync covers all of the groups which have been appended.
+    bool needs_sync = false;
+    BOOST_FOREACH(const AppendedGroup* group, groups) {
+      needs_sync |= group->needs_sync;
+    }
     Status s;
-    if (!is_all_commits) {
-      s = log_->Sync();
+    if (needs_sync) {
+      s = log_->SyncConcurrentlyWithAppends();
     }
-    if (PREDICT_FALSE(!s.ok())) {
-      LOG(ERROR) << "Error syncing log" << s.ToString();
-      DLOG(FATAL) << "Aborting: " << s.ToString();
-      BOOST_FOREACH(LogEntryBatch* entry_batch, entry_batches) {
-        if (!entry_batch->callback().is_null()) {
-          entry_batch->callback().Run(s);
-        }
-      }
-    } else {
-      TRACE_EVENT0("log", "Callbacks");
-      VLOG(2) << "Synchronized " << entry_batches.size() << " entry batches";
-      SCOPED_WATCH_STACK(100);
-      BOOST_FOREACH(LogEntryBatch* entry_batch, entry_batches) {
-        if (PREDICT_TRUE(!entry_batch->failed_to_append()
-                         && !entry_batch->callback().is_null())) {
-          entry_batch->callback().Run(Status::OK());
-        }
-        // It's important to delete each batch as we see it, because
-        // deleting it may free up memory from memory trackers, and the
-        // callback of a later batch may want to use that memory.
-        delete entry_batch;
+
+    BOOST_FOREACH(AppendedGroup* group, groups) {
+      log_->FinishEntryBatches(&group->entry_batches, s);
+      if (log_->metrics_) {
+        log_->metrics_->group_commit_latency->Increment(
+            MonoTime::Now(MonoTime::FINE).GetDeltaSince(group->start_time).ToMicroseconds());
       }
-      entry_batches.clear();
+    }
+
+    {
+      MutexLock l(sync_lock_);
+      num_groups_in_flight_ -= groups.size();
+      sync_cond_.Broadcast();
     }
   }
-  VLOG(1) << "Exiting AppendThread for tablet " << log_->tablet_id();
+  VLOG(1) << "Exiting log sync thread for tablet " << log_->tablet_id();
+}
+
+void Log::AppendThread::WaitForPendingSyncs() {
+  if (!sync_thread_) {
+    return;
+  }
+  MutexLock l(sync_lock_);
+  while (num_groups_in_flight_ > 0) {
+    sync_cond_.Wait();
+  }
 }
 
 void Log::AppendThread::Shutdown() {
@@ -234,6 +314,10 @@ void Log::AppendThread::Shutdown() {
   if (thread_) {
     VLOG(1) << "Shutting down log append thread for tablet " << log_->tablet_id();
     CHECK_OK(ThreadJoiner(thread_.get()).Join());
+    if (sync_thread_) {
+      CHECK_OK(ThreadJoiner(sync_thread_.get()).Join());
+      sync_thread_.reset();
+    }
     VLOG(1) << "Log append thread for tablet " << log_->tablet_id() << " is shut down";
     thread_.reset();
   }
@@ -375,6 +459,9 @@ Status Log::RollOver() {
 
   DCHECK_EQ(allocation_state(), kAllocationFinished);
 
+  // The sync stage of a pipelined append thread syncs the active segment,
+  // so it must be done before the segment is closed and switched.
+  append_thread_->WaitForPendingSyncs();
   RETURN_NOT_OK(Sync());
   RETURN_NOT_OK(CloseCurrentSegment());
 
@@ -467,6 +554,75 @@ Status Log::AsyncAppendCommit(gscoped_ptr<consensus::CommitMsg> commit_msg,
   return Status::OK();
 }
 
+void Log::AppendAndSyncEntryBatches(std::vector<LogEntryBatch*>* entry_batches) {
+  SCOPED_LATENCY_METRIC(metrics_, group_commit_latency);
+
+  Status s;
+  if (AppendEntryBatches(*entry_batches)) {
+    s = Sync();
+  }
+  FinishEntryBatches(entry_batches, s);
+}
+
+bool Log::AppendEntryBatches(const std::vector<LogEntryBatch*>& entry_batches) {
+  if (metrics_) {
+    metrics_->entry_batches_per_group->Increment(entry_batches.size());
+  }
+  TRACE_EVENT1("log", "batch", "batch_size", entry_batches.size());
+
+  bool is_all_commits = true;
+  BOOST_FOREACH(LogEntryBatch* entry_batch, entry_batches) {
+    entry_batch->WaitForReady();
+    TRACE_EVENT_FLOW_END0("log", "Batch", entry_batch);
+    Status s = DoAppend(entry_batch);
+    if (PREDICT_FALSE(!s.ok())) {
+      LOG(ERROR) << "Error appending to the log: " << s.ToString();
+      DLOG(FATAL) << "Aborting: " << s.ToString();
+      entry_batch->set_failed_to_append();
+      // TODO If a single transaction fails to append, should we
+      // abort all subsequent transactions in this batch or allow
+      // them to be appended? What about transactions in future
+      // batches?
+      if (!entry_batch->callback().is_null()) {
+        entry_batch->callback().Run(s);
+      }
+    }
+    if (is_all_commits && entry_batch->type_ != COMMIT) {
+      is_all_commits = false;
+    }
+  }
+  return !is_all_commits;
+}
+
+void Log::FinishEntryBatches(std::vector<LogEntryBatch*>* entry_batches,
+                             const Status& sync_status) {
+  if (PREDICT_FALSE(!sync_status.ok())) {
+    LOG(ERROR) << "Error syncing log" << sync_status.ToString();
+    DLOG(FATAL) << "Aborting: " << sync_status.ToString();
+    BOOST_FOREACH(LogEntryBatch* entry_batch, *entry_batches) {
+      if (!entry_batch->callback().is_null()) {
+        entry_batch->callback().Run(sync_status);
+      }
+    }
+    STLDeleteElements(entry_batches);
+  } else {
+    TRACE_EVENT0("log", "Callbacks");
+    VLOG(2) << "Synchronized " << entry_batches->size() << " entry batches";
+    SCOPED_WATCH_STACK(100);
+    BOOST_FOREACH(LogEntryBatch* entry_batch, *entry_batches) {
+      if (PREDICT_TRUE(!entry_batch->failed_to_append()
+                       && !entry_batch->callback().is_null())) {
+        entry_batch->callback().Run(Status::OK());
+      }
+      // It's important to delete each batch as we see it, because
+      // deleting it may free up memory from memory trackers, and the
+      // callback of a later batch may want to use that memory.
+      delete entry_batch;
+    }
+    entry_batches->clear();
+  }
+}
+
 Status Log::DoAppend(LogEntryBatch* entry_batch, bool caller_owns_operation) {
   size_t num_entries = entry_batch->count();
   DCHECK_GT(num_entries, 0) << "Cannot call DoAppend() with zero entries reserved";
@@ -526,7 +682,9 @@ Status Log::DoAppend(LogEntryBatch* entry_batch, bool caller_owns_operation) {
   }
 
   if (metrics_) {
-    metrics_->bytes_logged->IncrementBy(entry_batch_bytes);
+    // Count the bytes actually written to the segment, which are fewer than
+    // the batch's if the segment is compressed.
+    metrics_->bytes_logged->IncrementBy(active_segment_->written_offset() - start_offset);
   }
 
   CHECK_OK(UpdateIndexForBatch(*entry_batch, start_offset));
@@ -595,6 +753,14 @@ FsManager* Log::GetFsManager() {
 }
 
 Status Log::Sync() {
+  return DoSync(FSYNC_SEGMENT);
+}
+
+Status Log::SyncConcurrentlyWithAppends() {
+  return DoSync(FSYNC_SEGMENT_BY_PATH);
+}
+
+Status Log::DoSync(FsyncMethod fsync_method) {
   TRACE_EVENT0("log", "Sync");
   SCOPED_LATENCY_METRIC(metrics_, sync_latency);
 
@@ -611,7 +777,16 @@ Status Log::Sync() {
 
   if (force_sync_all_ && !sync_disabled_) {
     LOG_SLOW_EXECUTION(WARNING, 50, "Fsync log took a long time") {
-      RETURN_NOT_OK(active_segment_->Sync());
+      switch (fsync_method) {
+        case FSYNC_SEGMENT:
+          RETURN_NOT_OK(active_segment_->Sync());
+          break;
+        case FSYNC_SEGMENT_BY_PATH:
+          // The active segment can't be switched while syncs are in flight,
+          // see Log::RollOver().
+          RETURN_NOT_OK(fs_manager_->env()->SyncFile(active_segment_->path()));
+          break;
+      }
 
       if (log_hooks_) {
         RETURN_NOT_OK_PREPEND(log_hooks_->PostSyncIfFsyncEnabled(),
@@ -882,6 +1057,9 @@ Status Log::SwitchToAllocatedSegment() {
   header.set_minor_version(kLogMinorVersion);
   header.set_sequence_number(active_segment_sequence_number_);
   header.set_tablet_id(tablet_id_);
+  if (options_.compression_codec != NO_COMPRESSION) {
+    header.set_compression_codec(options_.compression_codec);
+  }
 
   // Set up the new footer. This will be maintained as the segment is written.
   footer_builder_.Clear();
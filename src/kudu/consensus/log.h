@@ -287,6 +287,21 @@ class Log : public RefCountedThreadSafe<Log> {
   // associated logic will no longer be needed.
   Status DoAppend(LogEntryBatch* entry, bool caller_owns_operation = true);
 
+  // Appends 'entry_batches', syncs the log if needed, and runs their
+  // callbacks. Deletes the batches and clears the vector.
+  void AppendAndSyncEntryBatches(std::vector<LogEntryBatch*>* entry_batches);
+
+  // Waits for each of 'entry_batches' to be ready and appends it, running the
+  // callbacks of those which fail to. Returns whether any of the batches are
+  // of an entry type which requires the log to be synced.
+  bool AppendEntryBatches(const std::vector<LogEntryBatch*>& entry_batches);
+
+  // Runs the callbacks of 'entry_batches' once they have been appended and
+  // the log synced with 'sync_status'. Deletes the batches and clears the
+  // vector.
+  void FinishEntryBatches(std::vector<LogEntryBatch*>* entry_batches,
+                          const Status& sync_status);
+
   // Update footer_builder_ to reflect the log indexes seen in 'batch'.
   void UpdateFooterForBatch(LogEntryBatch* batch);
 
@@ -302,6 +317,21 @@ class Log : public RefCountedThreadSafe<Log> {
 
   Status Sync();
 
+  // Like Sync(), but may be called while entries are being appended to the
+  // active segment, from the thread of the append pipeline's sync stage.
+  Status SyncConcurrentlyWithAppends();
+
+  // How DoSync() makes the active segment durable.
+  enum FsyncMethod {
+    // Fsync through the segment's writable file.
+    FSYNC_SEGMENT,
+    // Fsync the segment's file by path, which is safe to do concurrently
+    // with appends to its writable file.
+    FSYNC_SEGMENT_BY_PATH
+  };
+
+  Status DoSync(FsyncMethod fsync_method);
+
   // Helper method to get the segment sequence to GC based on the provided min_op_idx.
   Status GetSegmentsToGCUnlocked(int64_t min_op_idx, SegmentSequence* segments_to_gc) const;
 
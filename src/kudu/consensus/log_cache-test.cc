@@ -24,6 +24,7 @@
 #include "kudu/gutil/bind_helpers.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/server/hybrid_clock.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/test_util.h"
@@ -156,6 +157,49 @@ TEST_F(LogCacheTest, TestAppendAndGetMessages) {
 // even if that message is larger than the batch size. This ensures
 // that we don't get "stuck" in the case that a large message enters
 // the cache.
+// Test that serialized ops round-trip through ParseOpsSidecar(), and that
+// their cached serialized form is accounted for until eviction.
+TEST_F(LogCacheTest, TestAppendSerializedOps) {
+  ASSERT_OK(AppendReplicateMessagesToCache(1, 10));
+  log_->WaitUntilAllFlushed();
+  int64_t size_before = cache_->metrics_.log_cache_size->value();
+
+  vector<ReplicateRefPtr> messages;
+  OpId preceding;
+  ASSERT_OK(cache_->ReadOps(0, 8 * 1024 * 1024, &messages, &preceding));
+  ASSERT_EQ(10, messages.size());
+
+  faststring buf;
+  cache_->AppendSerializedOps(messages, &buf);
+  int64_t size_serialized = cache_->metrics_.log_cache_size->value();
+  ASSERT_GT(size_serialized, size_before);
+  ASSERT_EQ(size_serialized, cache_->BytesUsed());
+
+  // Serializing again should reuse the cached bytes.
+  faststring buf2;
+  cache_->AppendSerializedOps(messages, &buf2);
+  ASSERT_EQ(buf.ToString(), buf2.ToString());
+  ASSERT_EQ(size_serialized, cache_->metrics_.log_cache_size->value());
+
+  ConsensusRequestPB req;
+  ASSERT_OK(ParseOpsSidecar(Slice(buf), &req));
+  ASSERT_EQ(10, req.ops_size());
+  for (int i = 0; i < req.ops_size(); i++) {
+    ASSERT_EQ(messages[i]->get()->SerializeAsString(), req.ops(i).SerializeAsString());
+  }
+
+  // A truncated sidecar should be rejected.
+  req.Clear();
+  Status s = ParseOpsSidecar(Slice(buf.data(), buf.size() - 1), &req);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+
+  // Evicting the ops releases their serialized form too.
+  messages.clear();
+  cache_->EvictThroughOp(10);
+  ASSERT_EQ(0, cache_->metrics_.log_cache_num_ops->value());
+  ASSERT_EQ(0, cache_->metrics_.log_cache_size->value());
+}
+
 TEST_F(LogCacheTest, TestAlwaysYieldsAtLeastOneMessage) {
   // generate a 2MB dummy payload
   const int kPayloadSize = 2 * 1024 * 1024;
@@ -261,6 +305,36 @@ TEST_F(LogCacheTest, TestMemoryLimit) {
   ASSERT_EQ(cache_->BytesUsed(), 0);
 }
 
+// Test that caching the serialized form of the ops respects the memory limit.
+TEST_F(LogCacheTest, TestAppendSerializedOpsMemoryLimit) {
+  FLAGS_log_cache_size_limit_mb = 1;
+  CloseAndReopenCache(MinimumOpId());
+
+  const int kPayloadSize = 400 * 1024;
+  ASSERT_OK(AppendReplicateMessagesToCache(1, 2, kPayloadSize));
+  log_->WaitUntilAllFlushed();
+  int64_t size_before = cache_->BytesUsed();
+
+  vector<ReplicateRefPtr> messages;
+  OpId preceding;
+  ASSERT_OK(cache_->ReadOps(0, 8 * 1024 * 1024, &messages, &preceding));
+  ASSERT_EQ(2, messages.size());
+
+  // Neither serialized op fits under the limit, and the ops themselves can't
+  // be evicted since we hold references to them, so nothing is cached.
+  faststring buf;
+  cache_->AppendSerializedOps(messages, &buf);
+  ASSERT_EQ(size_before, cache_->BytesUsed());
+  ASSERT_EQ(size_before, cache_->metrics_.log_cache_size->value());
+  ASSERT_TRUE(messages[0]->serialized() == NULL);
+  ASSERT_TRUE(messages[1]->serialized() == NULL);
+
+  // The ops were still serialized into the sidecar.
+  ConsensusRequestPB req;
+  ASSERT_OK(ParseOpsSidecar(Slice(buf), &req));
+  ASSERT_EQ(2, req.ops_size());
+}
+
 TEST_F(LogCacheTest, TestGlobalMemoryLimit) {
   FLAGS_global_log_cache_size_limit_mb = 4;
   CloseAndReopenCache(MinimumOpId());
@@ -30,6 +30,7 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/human_readable.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/coding.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/mem_tracker.h"
@@ -264,6 +265,16 @@ int64_t TotalByteSizeForMessage(const ReplicateMsg& msg) {
   msg_size += 1; // for the type tag
   return msg_size;
 }
+
+// Return the memory charged to the cache for the given message, including
+// its serialized form if that has been cached.
+int64_t CachedBytesForMessage(const ReplicateRefPtr& msg) {
+  int64_t size = msg->get()->SpaceUsed();
+  if (msg->serialized()) {
+    size += msg->serialized()->size();
+  }
+  return size;
+}
 } // anonymous namespace
 
 Status LogCache::ReadOps(int64_t after_op_index,
@@ -377,7 +388,7 @@ void LogCache::EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evic
 
     VLOG_WITH_PREFIX_UNLOCKED(2) << "Evicting cache. Removing: " << msg->get()->id();
     AccountForMessageRemovalUnlocked(msg);
-    bytes_evicted += msg->get()->SpaceUsed();
+    bytes_evicted += CachedBytesForMessage(msg);
     cache_.erase(iter++);
 
     if (bytes_evicted >= bytes_to_evict) {
@@ -388,11 +399,67 @@ void LogCache::EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evic
 }
 
 void LogCache::AccountForMessageRemovalUnlocked(const ReplicateRefPtr& msg) {
-  tracker_->Release(msg->get()->SpaceUsed());
-  metrics_.log_cache_size->DecrementBy(msg->get()->SpaceUsed());
+  int64_t size = CachedBytesForMessage(msg);
+  tracker_->Release(size);
+  metrics_.log_cache_size->DecrementBy(size);
   metrics_.log_cache_num_ops->Decrement();
 }
 
+void LogCache::AppendSerializedOps(const vector<ReplicateRefPtr>& msgs, faststring* buf) {
+  // Messages which are retained by 'msgs' never lose their serialized form,
+  // so the strings can be used after dropping the lock.
+  vector<const string*> serialized(msgs.size());
+  {
+    lock_guard<simple_spinlock> l(&lock_);
+    for (int i = 0; i < msgs.size(); i++) {
+      serialized[i] = msgs[i]->serialized();
+    }
+  }
+
+  // Serialize whichever messages weren't cached yet outside of the lock.
+  vector<string*> fresh(msgs.size());
+  ElementDeleter deleter(&fresh);
+  for (int i = 0; i < msgs.size(); i++) {
+    if (serialized[i] == NULL) {
+      fresh[i] = new string();
+      CHECK(msgs[i]->get()->SerializeToString(fresh[i]));
+      serialized[i] = fresh[i];
+    }
+  }
+
+  for (int i = 0; i < msgs.size(); i++) {
+    PutLengthPrefixedSlice(buf, Slice(*serialized[i]));
+  }
+
+  // Cache the newly serialized messages for the other peers, as long as
+  // they're still in the cache, so that the memory is released on eviction.
+  lock_guard<simple_spinlock> l(&lock_);
+  for (int i = 0; i < msgs.size(); i++) {
+    if (fresh[i] == NULL || msgs[i]->serialized() != NULL) {
+      continue;
+    }
+    int64_t size = fresh[i]->size();
+    if (!tracker_->TryConsume(size)) {
+      // As in AppendOperations(), try to make room by evicting unpinned ops.
+      // Unlike there, we never force the consumption: the serialized form is
+      // only an optimization, so it's simply not cached if it doesn't fit.
+      EvictSomeUnlocked(min_pinned_op_index_, size - tracker_->SpareCapacity());
+      if (!tracker_->TryConsume(size)) {
+        continue;
+      }
+    }
+    // Check for the message only now, since the eviction above may have removed it.
+    MessageCache::const_iterator iter = cache_.find(msgs[i]->get()->id().index());
+    if (iter == cache_.end() || iter->second != msgs[i]) {
+      tracker_->Release(size);
+      continue;
+    }
+    msgs[i]->set_serialized(make_gscoped_ptr(fresh[i]));
+    fresh[i] = NULL;
+    metrics_.log_cache_size->IncrementBy(size);
+  }
+}
+
 int64_t LogCache::BytesUsed() const {
   return tracker_->consumption();
 }
@@ -32,6 +32,7 @@
 
 namespace kudu {
 
+class faststring;
 class MetricEntity;
 class MemTracker;
 
@@ -95,6 +96,14 @@ class LogCache {
   Status AppendOperations(const std::vector<ReplicateRefPtr>& msgs,
                           const StatusCallback& callback);
 
+  // Append the serialized form of each of 'msgs' to 'buf', each preceded by
+  // its length as a varint32.
+  //
+  // Messages which are still in the cache keep their serialized form, so
+  // that it is only built once no matter how many peers the message is sent
+  // to. This memory is charged to the cache until the message is evicted.
+  void AppendSerializedOps(const std::vector<ReplicateRefPtr>& msgs, faststring* buf);
+
   // Return true if an operation with the given index has been written through
   // the cache. The operation may not necessarily be durable yet -- it could still be
   // en route to the log.
@@ -133,6 +142,8 @@ class LogCache {
 
  private:
   FRIEND_TEST(LogCacheTest, TestAppendAndGetMessages);
+  FRIEND_TEST(LogCacheTest, TestAppendSerializedOps);
+  FRIEND_TEST(LogCacheTest, TestAppendSerializedOpsMemoryLimit);
   FRIEND_TEST(LogCacheTest, TestGlobalMemoryLimit);
   FRIEND_TEST(LogCacheTest, TestReplaceMessages);
   friend class LogCacheTest;
@@ -23,6 +23,7 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "kudu/cfile/compression_codec.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/fs/fs_manager.h"
@@ -55,9 +56,36 @@ DEFINE_bool(log_async_preallocate_segments, true,
             "Whether the WAL segments preallocation should happen asynchronously");
 TAG_FLAG(log_async_preallocate_segments, advanced);
 
+DEFINE_string(log_compression_codec, "none",
+              "Codec to compress the entry batches of new WAL segments with: "
+              "one of 'none', 'snappy', 'lz4' or 'zlib'. Existing segments are "
+              "read with whichever codec they were written with.");
+TAG_FLAG(log_compression_codec, experimental);
+
+// Validate that log_compression_codec names a known codec.
+static bool ValidateLogCompressionCodec(const char* flagname, const std::string& value) {
+  if (value == "none" ||
+      kudu::cfile::GetCompressionCodecType(value) != kudu::NO_COMPRESSION) {
+    return true;
+  }
+  LOG(ERROR) << strings::Substitute("$0 must be one of 'none', 'snappy', 'lz4' or 'zlib', "
+                                    "value '$1' is invalid", flagname, value);
+  return false;
+}
+static bool dummy = google::RegisterFlagValidator(
+    &FLAGS_log_compression_codec, &ValidateLogCompressionCodec);
+
+DEFINE_bool(log_pipelined_append, false,
+            "Whether each WAL should be synced by a separate thread from the one "
+            "writing to it, so that the next group of entries is written while the "
+            "previous group is being synced. Callbacks still run in the order the "
+            "entries were appended.");
+TAG_FLAG(log_pipelined_append, experimental);
+
 namespace kudu {
 namespace log {
 
+using cfile::CompressionCodec;
 using consensus::OpId;
 using env_util::ReadFully;
 using std::vector;
@@ -81,6 +109,7 @@ const size_t kLogSegmentHeaderMagicAndHeaderLength = 12;
 const size_t kLogSegmentFooterMagicAndFooterLength  = 12;
 
 const size_t kEntryHeaderSize = 12;
+const size_t kCompressedEntryHeaderSize = 16;
 
 const int kLogMajorVersion = 1;
 const int kLogMinorVersion = 0;
@@ -92,9 +121,28 @@ LogOptions::LogOptions()
 : segment_size_mb(FLAGS_log_segment_size_mb),
   force_fsync_all(FLAGS_log_force_fsync_all),
   preallocate_segments(FLAGS_log_preallocate_segments),
-  async_preallocate_segments(FLAGS_log_async_preallocate_segments) {
+  async_preallocate_segments(FLAGS_log_async_preallocate_segments),
+  compression_codec(cfile::GetCompressionCodecType(FLAGS_log_compression_codec)),
+  pipelined_append(FLAGS_log_pipelined_append) {
+}
+
+namespace {
+
+// Returns the codec which the entry batches of a segment with the given
+// header are compressed with, or NULL if they aren't.
+Status GetEntryCodec(const LogSegmentHeaderPB& header, const CompressionCodec** codec) {
+  *codec = NULL;
+  if (!header.has_compression_codec()) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK_PREPEND(cfile::GetCompressionCodec(header.compression_codec(), codec),
+                        Substitute("Unable to get log segment codec $0",
+                                   CompressionType_Name(header.compression_codec())));
+  return Status::OK();
 }
 
+} // anonymous namespace
+
 Status ReadableLogSegment::Open(Env* env,
                                 const string& path,
                                 scoped_refptr<ReadableLogSegment>* segment) {
@@ -115,7 +163,9 @@ ReadableLogSegment::ReadableLogSegment(const std::string &path,
     readable_to_offset_(0),
     readable_file_(readable_file),
     is_initialized_(false),
-    footer_was_rebuilt_(false) {
+    footer_was_rebuilt_(false),
+    codec_(NULL),
+    entry_header_size_(kEntryHeaderSize) {
 }
 
 Status ReadableLogSegment::Init(const LogSegmentHeaderPB& header,
@@ -128,6 +178,7 @@ Status ReadableLogSegment::Init(const LogSegmentHeaderPB& header,
   RETURN_NOT_OK(ReadFileSize());
 
   header_.CopyFrom(header);
+  RETURN_NOT_OK(InitEntryFormat());
   footer_.CopyFrom(footer);
   first_entry_offset_ = first_entry_offset;
   is_initialized_ = true;
@@ -144,6 +195,7 @@ Status ReadableLogSegment::Init(const LogSegmentHeaderPB& header,
   RETURN_NOT_OK(ReadFileSize());
 
   header_.CopyFrom(header);
+  RETURN_NOT_OK(InitEntryFormat());
   first_entry_offset_ = first_entry_offset;
   is_initialized_ = true;
 
@@ -269,11 +321,18 @@ Status ReadableLogSegment::ReadHeader() {
                         "Unable to parse protobuf");
 
   header_.CopyFrom(header);
+  RETURN_NOT_OK(InitEntryFormat());
   first_entry_offset_ = header_size + kLogSegmentHeaderMagicAndHeaderLength;
 
   return Status::OK();
 }
 
+Status ReadableLogSegment::InitEntryFormat() {
+  RETURN_NOT_OK(GetEntryCodec(header_, &codec_));
+  entry_header_size_ = codec_ ? kCompressedEntryHeaderSize : kEntryHeaderSize;
+  return Status::OK();
+}
+
 
 Status ReadableLogSegment::ReadHeaderMagicAndHeaderLength(uint32_t *len) {
   uint8_t scratch[kLogSegmentHeaderMagicAndHeaderLength];
@@ -441,7 +500,7 @@ Status ReadableLogSegment::ReadEntries(vector<LogEntryPB*>* entries,
 
     // Read and validate the entry header first.
     Status s;
-    if (offset + kEntryHeaderSize < read_up_to) {
+    if (offset + entry_header_size_ < read_up_to) {
       s = ReadEntryHeaderAndBatch(&offset, &tmp_buf, &current_batch);
     } else {
       s = Status::Corruption(Substitute("Truncated log entry at offset $0", offset));
@@ -524,8 +583,8 @@ Status ReadableLogSegment::ScanForValidEntryHeaders(int64_t offset, bool* has_va
   // We overlap the reads by the size of the header, so that if a header
   // spans chunks, we don't miss it.
   for (;
-       offset < file_size() - kEntryHeaderSize;
-       offset += kChunkSize - kEntryHeaderSize) {
+       offset < file_size() - entry_header_size_;
+       offset += kChunkSize - entry_header_size_) {
     int rem = std::min<int64_t>(file_size() - offset, kChunkSize);
     Slice chunk;
     RETURN_NOT_OK(ReadFully(readable_file().get(), offset, rem, &chunk, &buf[0]));
@@ -538,9 +597,9 @@ Status ReadableLogSegment::ScanForValidEntryHeaders(int64_t offset, bool* has_va
 
     // Check if this chunk has a valid entry header.
     for (int off_in_chunk = 0;
-         off_in_chunk < chunk.size() - kEntryHeaderSize;
+         off_in_chunk < chunk.size() - entry_header_size_;
          off_in_chunk++) {
-      Slice potential_header = Slice(&chunk[off_in_chunk], kEntryHeaderSize);
+      Slice potential_header = Slice(&chunk[off_in_chunk], entry_header_size_);
 
       EntryHeader header;
       if (DecodeEntryHeader(potential_header, &header)) {
@@ -602,9 +661,9 @@ Status ReadableLogSegment::ReadEntryHeaderAndBatch(int64_t* offset, faststring*
 
 
 Status ReadableLogSegment::ReadEntryHeader(int64_t *offset, EntryHeader* header) {
-  uint8_t scratch[kEntryHeaderSize];
+  uint8_t scratch[kCompressedEntryHeaderSize];
   Slice slice;
-  RETURN_NOT_OK_PREPEND(ReadFully(readable_file().get(), *offset, kEntryHeaderSize,
+  RETURN_NOT_OK_PREPEND(ReadFully(readable_file().get(), *offset, entry_header_size_,
                                   &slice, scratch),
                         "Could not read log entry header");
 
@@ -616,13 +675,22 @@ Status ReadableLogSegment::ReadEntryHeader(int64_t *offset, EntryHeader* header)
 }
 
 bool ReadableLogSegment::DecodeEntryHeader(const Slice& data, EntryHeader* header) {
-  DCHECK_EQ(kEntryHeaderSize, data.size());
-  header->msg_length = DecodeFixed32(&data[0]);
-  header->msg_crc    = DecodeFixed32(&data[4]);
-  header->header_crc = DecodeFixed32(&data[8]);
+  DCHECK_EQ(entry_header_size_, data.size());
+  const uint8_t* p = data.data();
+  header->msg_length = DecodeFixed32(p);
+  p += 4;
+  if (codec_) {
+    header->uncompressed_length = DecodeFixed32(p);
+    p += 4;
+  } else {
+    header->uncompressed_length = 0;
+  }
+  header->msg_crc    = DecodeFixed32(p);
+  p += 4;
+  header->header_crc = DecodeFixed32(p);
 
   // Verify the header.
-  uint32_t computed_crc = crc::Crc32c(&data[0], 8);
+  uint32_t computed_crc = crc::Crc32c(data.data(), p - data.data());
   return computed_crc == header->header_crc;
 }
 
@@ -670,10 +738,25 @@ Status ReadableLogSegment::ReadEntryBatch(int64_t *offset,
   }
 
 
+  // Uncompress the batch data, if needed. The CRC covers the compressed data.
+  Slice pb_slice = entry_batch_slice;
+  faststring uncompressed_buf;
+  if (codec_) {
+    if (PREDICT_FALSE(header.uncompressed_length == 0)) {
+      return Status::Corruption("Invalid 0 uncompressed entry length");
+    }
+    uncompressed_buf.resize(header.uncompressed_length);
+    s = codec_->Uncompress(entry_batch_slice, uncompressed_buf.data(),
+                           header.uncompressed_length);
+    if (!s.ok()) return Status::Corruption(Substitute("Could not uncompress entry. Cause: $0",
+                                                      s.ToString()));
+    pb_slice = Slice(uncompressed_buf);
+  }
+
   gscoped_ptr<LogEntryBatchPB> read_entry_batch(new LogEntryBatchPB());
   s = pb_util::ParseFromArray(read_entry_batch.get(),
-                              entry_batch_slice.data(),
-                              header.msg_length);
+                              pb_slice.data(),
+                              pb_slice.size());
 
   if (!s.ok()) return Status::Corruption(Substitute("Could parse PB. Cause: $0",
                                                     s.ToString()));
@@ -691,13 +774,15 @@ WritableLogSegment::WritableLogSegment(
   writable_file_(writable_file),
   is_header_written_(false),
   is_footer_written_(false),
-  written_offset_(0) {
+  written_offset_(0),
+  codec_(NULL) {
 }
 
 Status WritableLogSegment::WriteHeaderAndOpen(const LogSegmentHeaderPB& new_header) {
   DCHECK(!IsHeaderWritten()) << "Can only call WriteHeader() once";
   DCHECK(new_header.IsInitialized())
       << "Log segment header must be initialized" << new_header.InitializationErrorString();
+  RETURN_NOT_OK(GetEntryCodec(new_header, &codec_));
   faststring buf;
 
   // First the magic.
@@ -747,26 +832,47 @@ Status WritableLogSegment::WriteFooterAndClose(const LogSegmentFooterPB& footer)
 }
 
 
-Status WritableLogSegment::WriteEntryBatch(const Slice& data) {
+Status WritableLogSegment::WriteEntryBatch(const Slice& entry_batch_data) {
   DCHECK(is_header_written_);
   DCHECK(!is_footer_written_);
-  uint8_t header_buf[kEntryHeaderSize];
+  uint8_t header_buf[kCompressedEntryHeaderSize];
+  uint8_t* p = header_buf;
+
+  // Compress the batch, if the segment calls for it.
+  Slice data = entry_batch_data;
+  if (codec_) {
+    compress_buf_.resize(codec_->MaxCompressedLength(entry_batch_data.size()));
+    size_t compressed_len;
+    RETURN_NOT_OK_PREPEND(codec_->Compress(entry_batch_data, compress_buf_.data(),
+                                           &compressed_len),
+                          "Unable to compress log entry batch");
+    data = Slice(compress_buf_.data(), compressed_len);
+  }
 
   // First encode the length of the message.
   uint32_t len = data.size();
-  InlineEncodeFixed32(&header_buf[0], len);
+  InlineEncodeFixed32(p, len);
+  p += 4;
+
+  // For compressed segments, then the uncompressed length.
+  if (codec_) {
+    InlineEncodeFixed32(p, entry_batch_data.size());
+    p += 4;
+  }
 
   // Then the CRC of the message.
   uint32_t msg_crc = crc::Crc32c(&data[0], data.size());
-  InlineEncodeFixed32(&header_buf[4], msg_crc);
+  InlineEncodeFixed32(p, msg_crc);
+  p += 4;
 
   // Then the CRC of the header
-  uint32_t header_crc = crc::Crc32c(&header_buf, 8);
-  InlineEncodeFixed32(&header_buf[8], header_crc);
+  uint32_t header_crc = crc::Crc32c(header_buf, p - header_buf);
+  InlineEncodeFixed32(p, header_crc);
+  p += 4;
 
   // Write the header to the file, followed by the batch data itself.
-  RETURN_NOT_OK(writable_file_->Append(Slice(header_buf, sizeof(header_buf))));
-  written_offset_ += sizeof(header_buf);
+  RETURN_NOT_OK(writable_file_->Append(Slice(header_buf, p - header_buf)));
+  written_offset_ += p - header_buf;
 
   RETURN_NOT_OK(writable_file_->Append(data));
   written_offset_ += data.size();
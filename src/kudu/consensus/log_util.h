@@ -29,12 +29,17 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
 
 // Used by other classes, now part of the API.
 DECLARE_bool(log_force_fsync_all);
 
 namespace kudu {
 
+namespace cfile {
+class CompressionCodec;
+} // namespace cfile
+
 namespace consensus {
 struct OpIdBiggerThanFunctor;
 } // namespace consensus
@@ -48,6 +53,10 @@ extern const char kTmpSuffix[];
 // and checksum of the other two fields (see EntryHeader struct below).
 extern const size_t kEntryHeaderSize;
 
+// In segments whose header specifies a compression codec, the length is
+// followed by the uncompressed length of the entry (4 bytes).
+extern const size_t kCompressedEntryHeaderSize;
+
 extern const int kLogMajorVersion;
 extern const int kLogMinorVersion;
 
@@ -69,6 +78,13 @@ struct LogOptions {
   // Whether the allocation should happen asynchronously.
   bool async_preallocate_segments;
 
+  // The codec to compress entry batches of new segments with.
+  CompressionType compression_codec;
+
+  // Whether to sync the log on a separate thread, so that entry batches
+  // can be written while the previously written ones are being synced.
+  bool pipelined_append;
+
   LogOptions();
 };
 
@@ -187,10 +203,14 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   FRIEND_TEST(LogTest, TestWriteAndReadToAndFromInProgressSegment);
 
   struct EntryHeader {
-    // The length of the batch data.
+    // The length of the batch data, as stored in the segment.
     uint32_t msg_length;
 
-    // The CRC32C of the batch data.
+    // The length of the batch data once uncompressed, if the segment is
+    // compressed. Otherwise 0.
+    uint32_t uncompressed_length;
+
+    // The CRC32C of the batch data, as stored in the segment.
     uint32_t msg_crc;
 
     // The CRC32C of this EntryHeader.
@@ -205,6 +225,9 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
 
   Status ReadHeader();
 
+  // Set up the entry format of the segment according to its header.
+  Status InitEntryFormat();
+
   Status ReadHeaderMagicAndHeaderLength(uint32_t *len);
 
   Status ParseHeaderMagicAndHeaderLength(const Slice &data, uint32_t *parsed_len);
@@ -235,8 +258,8 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   // Also increments the passed offset* by the length of the entry.
   Status ReadEntryHeader(int64_t *offset, EntryHeader* header);
 
-  // Decode a log entry header from the given slice, which must be kEntryHeaderSize
-  // bytes long. Returns true if successful, false if corrupt.
+  // Decode a log entry header from the given slice, which must be
+  // entry_header_size_ bytes long. Returns true if successful, false if corrupt.
   //
   // NOTE: this is performance-critical since it is used by ScanForValidEntryHeaders
   // and thus returns bool instead of Status.
@@ -283,6 +306,11 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   // the offset of the first entry in the log
   int64_t first_entry_offset_;
 
+  // The codec which the entry batches are compressed with, or NULL if they
+  // aren't, and the resulting size of the entry headers.
+  const cfile::CompressionCodec* codec_;
+  size_t entry_header_size_;
+
   DISALLOW_COPY_AND_ASSIGN(ReadableLogSegment);
 };
 
@@ -308,7 +336,8 @@ class WritableLogSegment {
   }
 
   // Appends the provided batch of data, including a header
-  // and checksum.
+  // and checksum. If the segment header specifies a compression codec, the
+  // data is compressed first.
   // Makes sure that the log segment has not been closed.
   Status WriteEntryBatch(const Slice& entry_batch_data);
 
@@ -375,6 +404,11 @@ class WritableLogSegment {
   // The offset where the last written entry ends.
   int64_t written_offset_;
 
+  // The codec to compress entry batches with, or NULL, and the buffer they
+  // are compressed into.
+  const cfile::CompressionCodec* codec_;
+  faststring compress_buf_;
+
   DISALLOW_COPY_AND_ASSIGN(WritableLogSegment);
 };
 
@@ -24,7 +24,12 @@
 
 #include "kudu/gutil/algorithm.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/async_util.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/hdr_histogram.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/random.h"
 #include "kudu/util/thread.h"
@@ -32,6 +37,12 @@
 DEFINE_int32(num_writer_threads, 4, "Number of threads writing to the log");
 DEFINE_int32(num_batches_per_thread, 2000, "Number of batches per thread");
 DEFINE_int32(num_ops_per_batch_avg, 5, "Target average number of ops per batch");
+DEFINE_string(benchmark_writer_thread_counts, "1,4,16",
+              "Comma-separated numbers of concurrent writers to run the append "
+              "benchmark with");
+DEFINE_int32(benchmark_batches_per_thread, 500,
+             "Number of batches each writer appends, one at a time, in the append "
+             "benchmark");
 
 namespace kudu {
 namespace log {
@@ -80,45 +91,52 @@ class MultiThreadedLogTest : public LogTestBase {
     LogTestBase::SetUp();
   }
 
+  // Appends a batch of a random number of ops, calling 'callback' once it
+  // is durable. Sets 'num_ops' to the number of ops in the batch.
+  void AppendRandomBatch(const StatusCallback& callback, int* num_ops) {
+    LogEntryBatch* entry_batch;
+    vector<consensus::ReplicateRefPtr> batch_replicates;
+    *num_ops = static_cast<int>(random_.Normal(
+        static_cast<double>(FLAGS_num_ops_per_batch_avg), 1.0));
+    DVLOG(1) << *num_ops << " ops in this batch";
+    *num_ops = std::max(*num_ops, 1);
+    {
+      boost::lock_guard<simple_spinlock> lock_guard(lock_);
+      for (int j = 0; j < *num_ops; j++) {
+        ReplicateRefPtr replicate = make_scoped_refptr_replicate(new ReplicateMsg);
+        int32_t index = current_index_++;
+        OpId* op_id = replicate->get()->mutable_id();
+        op_id->set_term(0);
+        op_id->set_index(index);
+
+        replicate->get()->set_op_type(WRITE_OP);
+        replicate->get()->set_timestamp(clock_->Now().ToUint64());
+
+        tserver::WriteRequestPB* request = replicate->get()->mutable_write_request();
+        AddTestRowToPB(RowOperationsPB::INSERT, schema_, index, 0,
+                       "this is a test insert",
+                       request->mutable_row_operations());
+        request->set_tablet_id(kTestTablet);
+        batch_replicates.push_back(replicate);
+      }
+
+      gscoped_ptr<log::LogEntryBatchPB> entry_batch_pb;
+      CreateBatchFromAllocatedOperations(batch_replicates,
+                                         &entry_batch_pb);
+
+      ASSERT_OK(log_->Reserve(REPLICATE, entry_batch_pb.Pass(), &entry_batch));
+    } // lock_guard scope
+    entry_batch->SetReplicates(batch_replicates);
+    ASSERT_OK(log_->AsyncAppend(entry_batch, callback));
+  }
+
   void LogWriterThread(int thread_id) {
     CountDownLatch latch(FLAGS_num_batches_per_thread);
     vector<Status> errors;
     for (int i = 0; i < FLAGS_num_batches_per_thread; i++) {
-      LogEntryBatch* entry_batch;
-      vector<consensus::ReplicateRefPtr> batch_replicates;
-      int num_ops = static_cast<int>(random_.Normal(
-          static_cast<double>(FLAGS_num_ops_per_batch_avg), 1.0));
-      DVLOG(1) << num_ops << " ops in this batch";
-      num_ops =  std::max(num_ops, 1);
-      {
-        boost::lock_guard<simple_spinlock> lock_guard(lock_);
-        for (int j = 0; j < num_ops; j++) {
-          ReplicateRefPtr replicate = make_scoped_refptr_replicate(new ReplicateMsg);
-          int32_t index = current_index_++;
-          OpId* op_id = replicate->get()->mutable_id();
-          op_id->set_term(0);
-          op_id->set_index(index);
-
-          replicate->get()->set_op_type(WRITE_OP);
-          replicate->get()->set_timestamp(clock_->Now().ToUint64());
-
-          tserver::WriteRequestPB* request = replicate->get()->mutable_write_request();
-          AddTestRowToPB(RowOperationsPB::INSERT, schema_, index, 0,
-                         "this is a test insert",
-                         request->mutable_row_operations());
-          request->set_tablet_id(kTestTablet);
-          batch_replicates.push_back(replicate);
-        }
-
-        gscoped_ptr<log::LogEntryBatchPB> entry_batch_pb;
-        CreateBatchFromAllocatedOperations(batch_replicates,
-                                           &entry_batch_pb);
-
-        ASSERT_OK(log_->Reserve(REPLICATE, entry_batch_pb.Pass(), &entry_batch));
-      } // lock_guard scope
       CustomLatchCallback* cb = new CustomLatchCallback(&latch, &errors);
-      entry_batch->SetReplicates(batch_replicates);
-      ASSERT_OK(log_->AsyncAppend(entry_batch, cb->AsStatusCallback()));
+      int num_ops;
+      ASSERT_NO_FATAL_FAILURE(AppendRandomBatch(cb->AsStatusCallback(), &num_ops));
     }
     LOG_TIMING(INFO, strings::Substitute("thread $0 waiting to append and sync $1 batches",
                                         thread_id, FLAGS_num_batches_per_thread)) {
@@ -130,6 +148,21 @@ class MultiThreadedLogTest : public LogTestBase {
     ASSERT_EQ(0, errors.size());
   }
 
+  // Appends batches one at a time, waiting for each to be durable, and
+  // records how long each took.
+  void BenchmarkWriterThread(HdrHistogram* latency_hist, AtomicInt<int64_t>* ops_appended) {
+    for (int i = 0; i < FLAGS_benchmark_batches_per_thread; i++) {
+      Synchronizer s;
+      int num_ops;
+      MonoTime start = MonoTime::Now(MonoTime::FINE);
+      ASSERT_NO_FATAL_FAILURE(AppendRandomBatch(s.AsStatusCallback(), &num_ops));
+      ASSERT_OK(s.Wait());
+      latency_hist->Increment(
+          MonoTime::Now(MonoTime::FINE).GetDeltaSince(start).ToMicroseconds());
+      ops_appended->IncrementBy(num_ops);
+    }
+  }
+
   void Run() {
     for (int i = 0; i < FLAGS_num_writer_threads; i++) {
       scoped_refptr<kudu::Thread> new_thread;
@@ -141,6 +174,57 @@ class MultiThreadedLogTest : public LogTestBase {
       ASSERT_OK(ThreadJoiner(thread.get()).Join());
     }
   }
+
+  // Runs the append benchmark with 'num_threads' concurrent writers, and
+  // logs the throughput and latency percentiles.
+  void RunBenchmark(int num_threads) {
+    HdrHistogram latency_hist(10 * 1000 * 1000, 2); // 10 seconds, in micros.
+    AtomicInt<int64_t> ops_appended(0);
+    vector<scoped_refptr<kudu::Thread> > threads;
+    Stopwatch sw;
+    sw.start();
+    for (int i = 0; i < num_threads; i++) {
+      scoped_refptr<kudu::Thread> new_thread;
+      CHECK_OK(kudu::Thread::Create("test", "bench-writer",
+          &MultiThreadedLogTest::BenchmarkWriterThread, this,
+          &latency_hist, &ops_appended, &new_thread));
+      threads.push_back(new_thread);
+    }
+    BOOST_FOREACH(scoped_refptr<kudu::Thread>& thread, threads) {
+      ASSERT_OK(ThreadJoiner(thread.get()).Join());
+    }
+    sw.stop();
+
+    LOG(INFO) << strings::Substitute(
+        "$0 writers: $1 ops/sec, $2 batches/sec, batch latency (us): "
+        "mean $3, p50 $4, p95 $5, p99 $6, p99.9 $7, max $8",
+        num_threads,
+        static_cast<int64_t>(ops_appended.Load() / sw.elapsed().wall_seconds()),
+        static_cast<int64_t>(latency_hist.TotalCount() / sw.elapsed().wall_seconds()),
+        static_cast<int64_t>(latency_hist.MeanValue()),
+        latency_hist.ValueAtPercentile(50),
+        latency_hist.ValueAtPercentile(95),
+        latency_hist.ValueAtPercentile(99),
+        latency_hist.ValueAtPercentile(99.9),
+        latency_hist.MaxValue());
+  }
+
+  // Verifies that all of the ops appended since 'start_current_id' can be
+  // read back, in order.
+  void VerifyAppendedOps(int start_current_id) {
+    SegmentSequence segments;
+    ASSERT_OK(log_->GetLogReader()->GetSegmentsSnapshot(&segments));
+
+    BOOST_FOREACH(const SegmentSequence::value_type& entry, segments) {
+      ASSERT_OK(entry->ReadEntries(&entries_));
+    }
+    vector<uint32_t> ids;
+    EntriesToIdList(&ids);
+    DVLOG(1) << "Wrote total of " << current_index_ - start_current_id << " ops";
+    ASSERT_EQ(current_index_ - start_current_id, ids.size());
+    ASSERT_TRUE(util::gtl::is_sorted(ids.begin(), ids.end()));
+  }
+
  private:
   ThreadSafeRandom random_;
   simple_spinlock lock_;
@@ -156,18 +240,41 @@ TEST_F(MultiThreadedLogTest, TestAppends) {
     ASSERT_NO_FATAL_FAILURE(Run());
   }
   ASSERT_OK(log_->Close());
+  ASSERT_NO_FATAL_FAILURE(VerifyAppendedOps(start_current_id));
+}
 
-  SegmentSequence segments;
-  ASSERT_OK(log_->GetLogReader()->GetSegmentsSnapshot(&segments));
+// Tests appends when the log is synced by a separate thread from the one
+// writing to it, across several segments.
+TEST_F(MultiThreadedLogTest, TestPipelinedAppends) {
+  options_.pipelined_append = true;
+  options_.force_fsync_all = true;
+  options_.segment_size_mb = 1;
+  BuildLog();
+  int start_current_id = current_index_;
+  ASSERT_NO_FATAL_FAILURE(Run());
+  ASSERT_OK(log_->Close());
+  ASSERT_NO_FATAL_FAILURE(VerifyAppendedOps(start_current_id));
+}
 
-  BOOST_FOREACH(const SegmentSequence::value_type& entry, segments) {
-    ASSERT_OK(entry->ReadEntries(&entries_));
+// Measures append throughput and latency at several levels of concurrency.
+// Run with --log_force_fsync_all, with and without --log_pipelined_append,
+// to compare the appenders.
+TEST_F(MultiThreadedLogTest, TestAppendBenchmark) {
+  if (!AllowSlowTests()) {
+    LOG(INFO) << "Skipped: must enable slow tests.";
+    return;
   }
-  vector<uint32_t> ids;
-  EntriesToIdList(&ids);
-  DVLOG(1) << "Wrote total of " << current_index_ - start_current_id << " ops";
-  ASSERT_EQ(current_index_ - start_current_id, ids.size());
-  ASSERT_TRUE(util::gtl::is_sorted(ids.begin(), ids.end()));
+  BuildLog();
+  int start_current_id = current_index_;
+  vector<string> thread_counts = strings::Split(FLAGS_benchmark_writer_thread_counts, ",",
+                                                strings::SkipEmpty());
+  BOOST_FOREACH(const string& thread_count, thread_counts) {
+    int num_threads;
+    ASSERT_TRUE(safe_strto32(thread_count, &num_threads)) << thread_count;
+    ASSERT_NO_FATAL_FAILURE(RunBenchmark(num_threads));
+  }
+  ASSERT_OK(log_->Close());
+  ASSERT_NO_FATAL_FAILURE(VerifyAppendedOps(start_current_id));
 }
 
 } // namespace log
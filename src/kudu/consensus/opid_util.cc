@@ -21,6 +21,8 @@
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/slice.h"
 
 namespace kudu {
 namespace consensus {
@@ -149,6 +151,23 @@ std::string OpsRangeString(const ConsensusRequestPB& req) {
   return ret;
 }
 
+Status ParseOpsSidecar(const Slice& sidecar, ConsensusRequestPB* req) {
+  Slice remaining(sidecar);
+  while (!remaining.empty()) {
+    Slice op;
+    if (PREDICT_FALSE(!GetLengthPrefixedSlice(&remaining, &op))) {
+      return Status::Corruption(
+          strings::Substitute("Truncated operation after $0 ops in sidecar", req->ops_size()));
+    }
+    if (PREDICT_FALSE(!req->add_ops()->ParseFromArray(op.data(), op.size()))) {
+      req->mutable_ops()->RemoveLast();
+      return Status::Corruption(
+          strings::Substitute("Unable to parse operation $0 in sidecar", req->ops_size()));
+    }
+  }
+  return Status::OK();
+}
+
 OpId MakeOpId(int term, int index) {
   OpId ret;
   ret.set_index(index);
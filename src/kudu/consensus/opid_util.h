@@ -21,7 +21,12 @@
 #include <string>
 #include <utility>
 
+#include "kudu/util/status.h"
+
 namespace kudu {
+
+class Slice;
+
 namespace consensus {
 
 class ConsensusRequestPB;
@@ -103,6 +108,10 @@ std::string OpIdToString(const OpId& id);
 
 std::string OpsRangeString(const ConsensusRequestPB& req);
 
+// Parse the operations sent in an RPC sidecar, in the format described for
+// ConsensusRequestPB.ops_sidecar_idx, appending them to 'req->ops'.
+Status ParseOpsSidecar(const Slice& sidecar, ConsensusRequestPB* req);
+
 OpId MakeOpId(int term, int index);
 
 }  // namespace consensus
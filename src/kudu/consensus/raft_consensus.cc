@@ -159,6 +159,9 @@ scoped_refptr<RaftConsensus> RaftConsensus::Create(
                                                            log,
                                                            local_peer_pb,
                                                            options.tablet_id));
+  queue->SetSafeTimestampCallback(
+      Bind(&ReplicaTransactionFactory::GetSafeTimestampForFollowers,
+           Unretained(txn_factory)));
 
   gscoped_ptr<ThreadPool> thread_pool;
   CHECK_OK(ThreadPoolBuilder(Substitute("$0-raft", options.tablet_id.substr(0, 6)))
@@ -447,6 +450,8 @@ Status RaftConsensus::BecomeLeaderUnlocked() {
   queue_->RegisterObserver(this);
   RETURN_NOT_OK(RefreshConsensusQueueAndPeersUnlocked());
 
+  state_->GetReplicaTransactionFactoryUnlocked()->BecomingLeader();
+
   // Initiate a NO_OP transaction that is sent at the beginning of every term
   // change in raft.
   ReplicateMsg* replicate = new ReplicateMsg;
@@ -1163,6 +1168,19 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
                 deduped_req.preceding_opid->index());
     }
 
+    // The leader's safe time covers every op in the request. If we've started
+    // all of them, pass it on to the tablet, which will advance its own safe time
+    // once their prepares have run.
+    if (request->has_safe_timestamp()) {
+      int64_t last_in_request = request->ops_size() > 0 ?
+          request->ops(request->ops_size() - 1).id().index() : request->preceding_id().index();
+      if (last_from_leader.index() >= last_in_request) {
+        Timestamp safe_timestamp(request->safe_timestamp());
+        clock_->Update(safe_timestamp);
+        state_->GetReplicaTransactionFactoryUnlocked()->AdvanceSafeTimestamp(safe_timestamp);
+      }
+    }
+
     // Fill the response with the current state. We will not mutate anymore state until
     // we actually reply to the leader, we'll just wait for the messages to be durable.
     FillConsensusResponseOKUnlocked(response);
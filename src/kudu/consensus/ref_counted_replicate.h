@@ -15,6 +15,8 @@
 #ifndef KUDU_CONSENSUS_REF_COUNTED_REPLICATE_H_
 #define KUDU_CONSENSUS_REF_COUNTED_REPLICATE_H_
 
+#include <string>
+
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -31,8 +33,20 @@ class RefCountedReplicate : public RefCountedThreadSafe<RefCountedReplicate> {
     return msg_.get();
   }
 
+  // The serialized form of the message, or NULL if it hasn't been cached.
+  // Once set, this isn't changed for the life of the object. Set and read
+  // under the lock of the LogCache holding the message.
+  const std::string* serialized() const {
+    return serialized_.get();
+  }
+
+  void set_serialized(gscoped_ptr<std::string> serialized) {
+    serialized_ = serialized.Pass();
+  }
+
  private:
   gscoped_ptr<ReplicateMsg> msg_;
+  gscoped_ptr<std::string> serialized_;
 };
 
 typedef scoped_refptr<RefCountedReplicate> ReplicateRefPtr;
@@ -23,6 +23,7 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
+#include "kudu/util/env.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/path_util.h"
@@ -44,6 +45,7 @@ using strings::Substitute;
 DEFINE_int32(num_blocks_close, 500,
              "Number of blocks to simultaneously close in CloseManyBlocksTest");
 
+DECLARE_bool(block_manager_direct_io_writes);
 DECLARE_uint64(log_container_preallocate_bytes);
 DECLARE_uint64(log_container_max_size);
 
@@ -60,6 +62,7 @@ METRIC_DECLARE_gauge_uint64(log_block_manager_bytes_under_management);
 METRIC_DECLARE_gauge_uint64(log_block_manager_blocks_under_management);
 METRIC_DECLARE_counter(log_block_manager_containers);
 METRIC_DECLARE_counter(log_block_manager_full_containers);
+METRIC_DECLARE_counter(log_block_manager_metadata_checkpoints);
 
 namespace kudu {
 namespace fs {
@@ -108,6 +111,8 @@ class BlockManagerTest : public KuduTest {
 
   void RunLogContainerPreallocationTest();
 
+  void RunLogMetadataCheckpointTest();
+
   void RunMemTrackerTest();
 
   gscoped_ptr<BlockManager> bm_;
@@ -308,6 +313,101 @@ void BlockManagerTest<LogBlockManager>::RunLogContainerPreallocationTest() {
   ASSERT_TRUE(found);
 }
 
+template <>
+void BlockManagerTest<FileBlockManager>::RunLogMetadataCheckpointTest() {
+  LOG(INFO) << "Test skipped; wrong block manager";
+}
+
+static void CheckBlockContents(BlockManager* bm, const BlockId& id,
+                               const string& expected) {
+  gscoped_ptr<ReadableBlock> read_block;
+  ASSERT_OK(bm->OpenBlock(id, &read_block));
+  size_t sz;
+  ASSERT_OK(read_block->Size(&sz));
+  ASSERT_EQ(expected.length(), sz);
+  Slice data;
+  gscoped_ptr<uint8_t[]> scratch(new uint8_t[sz]);
+  ASSERT_OK(read_block->Read(0, sz, &data, scratch.get()));
+  ASSERT_EQ(expected, data);
+}
+
+static int64_t MetadataCheckpoints(const scoped_refptr<MetricEntity>& entity) {
+  return down_cast<Counter*>(
+      entity->FindOrNull(METRIC_log_block_manager_metadata_checkpoints).get())->value();
+}
+
+template <>
+void BlockManagerTest<LogBlockManager>::RunLogMetadataCheckpointTest() {
+  // Write ten blocks to the same container, then delete all but two of
+  // them, including the last one.
+  vector<BlockId> ids;
+  for (int i = 0; i < 10; i++) {
+    gscoped_ptr<WritableBlock> written_block;
+    ASSERT_OK(this->bm_->CreateBlock(&written_block));
+    ASSERT_OK(written_block->Append(Substitute("block $0", i)));
+    ASSERT_OK(written_block->Close());
+    ids.push_back(written_block->id());
+  }
+  for (int i = 1; i < 10; i++) {
+    if (i != 8) {
+      ASSERT_OK(this->bm_->DeleteBlock(ids[i]));
+    }
+  }
+
+  vector<string> children;
+  ASSERT_OK(this->env_->GetChildren(GetTestDataDirectory(), &children));
+  string metadata_path;
+  BOOST_FOREACH(const string& child, children) {
+    if (HasSuffixString(child, ".metadata")) {
+      metadata_path = JoinPathSegments(GetTestDataDirectory(), child);
+    }
+  }
+  ASSERT_FALSE(metadata_path.empty());
+  uint64_t orig_size;
+  ASSERT_OK(this->env_->GetFileSize(metadata_path, &orig_size));
+
+  // Reopening the block manager checkpoints the container's metadata.
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  ASSERT_NO_FATAL_FAILURE(this->ReopenBlockManager(entity,
+                                                   shared_ptr<MemTracker>(),
+                                                   list_of(GetTestDataDirectory()),
+                                                   false));
+  ASSERT_EQ(1, MetadataCheckpoints(entity));
+  uint64_t new_size;
+  ASSERT_OK(this->env_->GetFileSize(metadata_path, &new_size));
+  ASSERT_LT(new_size, orig_size);
+  ASSERT_NO_FATAL_FAILURE(CheckBlockContents(this->bm_.get(), ids[0], "block 0"));
+  ASSERT_NO_FATAL_FAILURE(CheckBlockContents(this->bm_.get(), ids[8], "block 8"));
+  ASSERT_TRUE(this->bm_->OpenBlock(ids[1], NULL).IsNotFound());
+
+  // New blocks are written after the live blocks, and their records are
+  // appended to the checkpoint.
+  gscoped_ptr<WritableBlock> written_block;
+  ASSERT_OK(this->bm_->CreateBlock(&written_block));
+  ASSERT_OK(written_block->Append("new block"));
+  ASSERT_OK(written_block->Close());
+  BlockId new_id = written_block->id();
+
+  // This time, all records are live, so there's nothing to checkpoint.
+  MetricRegistry new_registry;
+  scoped_refptr<MetricEntity> new_entity =
+      METRIC_ENTITY_server.Instantiate(&new_registry, "test");
+  ASSERT_NO_FATAL_FAILURE(this->ReopenBlockManager(new_entity,
+                                                   shared_ptr<MemTracker>(),
+                                                   list_of(GetTestDataDirectory()),
+                                                   false));
+  ASSERT_EQ(0, MetadataCheckpoints(new_entity));
+  ASSERT_NO_FATAL_FAILURE(CheckBlockContents(this->bm_.get(), ids[0], "block 0"));
+  ASSERT_NO_FATAL_FAILURE(CheckBlockContents(this->bm_.get(), ids[8], "block 8"));
+  ASSERT_NO_FATAL_FAILURE(CheckBlockContents(this->bm_.get(), new_id, "new block"));
+
+  // No temporary files were left behind: dot, dotdot, test metadata,
+  // instance file, and one container file pair.
+  ASSERT_OK(this->env_->GetChildren(GetTestDataDirectory(), &children));
+  ASSERT_EQ(6, children.size());
+}
+
 template <>
 void BlockManagerTest<FileBlockManager>::RunMemTrackerTest() {
   shared_ptr<MemTracker> tracker = MemTracker::CreateTracker(-1, "test tracker");
@@ -376,6 +476,96 @@ TYPED_TEST(BlockManagerTest, EndToEndTest) {
               .IsNotFound());
 }
 
+// Test that a batch of reads returns the same data as individual reads, for
+// a block which doesn't start at the beginning of its file.
+TYPED_TEST(BlockManagerTest, ReadBatchTest) {
+  gscoped_ptr<WritableBlock> first_block;
+  ASSERT_OK(this->bm_->CreateBlock(&first_block));
+  ASSERT_OK(first_block->Append("first block"));
+  ASSERT_OK(first_block->Close());
+
+  gscoped_ptr<WritableBlock> written_block;
+  ASSERT_OK(this->bm_->CreateBlock(&written_block));
+  string test_data;
+  for (int i = 0; i < 1000; i++) {
+    test_data.append(Substitute("$0,", i));
+  }
+  ASSERT_OK(written_block->Append(test_data));
+  ASSERT_OK(written_block->Close());
+
+  gscoped_ptr<ReadableBlock> read_block;
+  ASSERT_OK(this->bm_->OpenBlock(written_block->id(), &read_block));
+  gscoped_ptr<uint8_t[]> scratch(new uint8_t[test_data.length()]);
+  vector<ReadRequest> requests;
+  for (int i = 0; i < 10; i++) {
+    size_t offset = i * test_data.length() / 10;
+    size_t length = test_data.length() / 10 - i;
+    requests.push_back(ReadRequest(offset, length, scratch.get() + offset));
+  }
+  ASSERT_OK(read_block->ReadBatch(&requests));
+  BOOST_FOREACH(const ReadRequest& req, requests) {
+    ASSERT_EQ(test_data.substr(req.offset, req.length), req.result.ToString());
+  }
+
+  // Reads past the end of the block fail, even if the file continues.
+  requests.push_back(ReadRequest(test_data.length() - 1, 2, scratch.get()));
+  ASSERT_TRUE(read_block->ReadBatch(&requests).IsIOError());
+}
+
+TYPED_TEST(BlockManagerTest, BlockManagerReadBatchTest) {
+  // Write several blocks one after another. With the log block manager,
+  // they share a container, so reads of them can be merged.
+  const int kNumBlocks = 5;
+  vector<string> test_data(kNumBlocks);
+  vector<ReadableBlock*> blocks;
+  ElementDeleter deleter(&blocks);
+  for (int b = 0; b < kNumBlocks; b++) {
+    for (int i = 0; i < 500; i++) {
+      test_data[b].append(Substitute("$0:$1,", b, i));
+    }
+    gscoped_ptr<WritableBlock> written_block;
+    ASSERT_OK(this->bm_->CreateBlock(&written_block));
+    ASSERT_OK(written_block->Append(test_data[b]));
+    ASSERT_OK(written_block->Close());
+    gscoped_ptr<ReadableBlock> read_block;
+    ASSERT_OK(this->bm_->OpenBlock(written_block->id(), &read_block));
+    blocks.push_back(read_block.release());
+  }
+
+  // Read every block in full, along with some overlapping ranges, issuing
+  // the reads in reverse order.
+  vector<BlockReadRequest> requests;
+  vector<string> expected;
+  for (int b = kNumBlocks - 1; b >= 0; b--) {
+    size_t len = test_data[b].length();
+    requests.push_back(BlockReadRequest(blocks[b], len / 2, len / 4, NULL));
+    expected.push_back(test_data[b].substr(len / 2, len / 4));
+    requests.push_back(BlockReadRequest(blocks[b], 0, len, NULL));
+    expected.push_back(test_data[b]);
+    requests.push_back(BlockReadRequest(blocks[b], len - 1, 1, NULL));
+    expected.push_back(test_data[b].substr(len - 1));
+  }
+  size_t total_length = 0;
+  BOOST_FOREACH(const BlockReadRequest& req, requests) {
+    total_length += req.read.length;
+  }
+  gscoped_ptr<uint8_t[]> scratch(new uint8_t[total_length]);
+  uint8_t* next_scratch = scratch.get();
+  BOOST_FOREACH(BlockReadRequest& req, requests) {
+    req.read.scratch = next_scratch;
+    next_scratch += req.read.length;
+  }
+  ASSERT_OK(this->bm_->ReadBatch(&requests));
+  for (int i = 0; i < requests.size(); i++) {
+    ASSERT_EQ(expected[i], requests[i].read.result.ToString());
+  }
+
+  // A read past the end of any of the blocks fails the batch.
+  requests.push_back(BlockReadRequest(blocks[0], test_data[0].length(), 1,
+                                      scratch.get()));
+  ASSERT_TRUE(this->bm_->ReadBatch(&requests).IsIOError());
+}
+
 // Test that we can still read from an opened block after deleting it
 // (even if we can't open it again).
 TYPED_TEST(BlockManagerTest, ReadAfterDeleteTest) {
@@ -457,6 +647,57 @@ TYPED_TEST(BlockManagerTest, FlushDataAsyncTest) {
   ASSERT_OK(written_block->FlushDataAsync());
 }
 
+// Test that blocks written with direct I/O, whose lengths aren't aligned,
+// read back intact, both right away and after reopening the block manager.
+TYPED_TEST(BlockManagerTest, DirectIOWritesTest) {
+  FLAGS_block_manager_direct_io_writes = true;
+
+  // Lengths smaller than, not a multiple of, and larger than both the
+  // direct I/O alignment and the block managers' buffers. Blocks written one
+  // after the other may share a container, so the padding of each mustn't
+  // run into the next.
+  const size_t kLengths[] = { 1, 4097, 300000, 0, 5000 };
+  vector<string> test_data;
+  vector<BlockId> ids;
+  for (int i = 0; i < arraysize(kLengths); i++) {
+    test_data.push_back(string(kLengths[i], 'a' + i));
+    gscoped_ptr<WritableBlock> written_block;
+    ASSERT_OK(this->bm_->CreateBlock(&written_block));
+    // Append in uneven pieces.
+    const string& data = test_data.back();
+    for (size_t pos = 0; pos < data.size(); pos += 1000 + i) {
+      ASSERT_OK(written_block->Append(Slice(
+          data.data() + pos, std::min<size_t>(1000 + i, data.size() - pos))));
+    }
+    if (i % 2 == 0) {
+      ASSERT_OK(written_block->FlushDataAsync());
+    }
+    ASSERT_OK(written_block->Close());
+    ids.push_back(written_block->id());
+  }
+
+  gscoped_ptr<BlockManager> new_bm(this->CreateBlockManager(
+      scoped_refptr<MetricEntity>(),
+      MemTracker::CreateTracker(-1, "other tracker"),
+      list_of(GetTestDataDirectory())));
+  ASSERT_OK(new_bm->Open());
+
+  BlockManager* bms[] = { this->bm_.get(), new_bm.get() };
+  BOOST_FOREACH(BlockManager* bm, bms) {
+    for (int i = 0; i < ids.size(); i++) {
+      gscoped_ptr<ReadableBlock> read_block;
+      ASSERT_OK(bm->OpenBlock(ids[i], &read_block));
+      size_t sz;
+      ASSERT_OK(read_block->Size(&sz));
+      ASSERT_EQ(test_data[i].length(), sz);
+      Slice data;
+      gscoped_ptr<uint8_t[]> scratch(new uint8_t[sz]);
+      ASSERT_OK(read_block->Read(0, sz, &data, scratch.get()));
+      ASSERT_EQ(test_data[i], data);
+    }
+  }
+}
+
 TYPED_TEST(BlockManagerTest, WritableBlockStateTest) {
   gscoped_ptr<WritableBlock> written_block;
 
@@ -680,6 +921,10 @@ TYPED_TEST(BlockManagerTest, LogContainerPreallocationTest) {
   ASSERT_NO_FATAL_FAILURE(this->RunLogContainerPreallocationTest());
 }
 
+TYPED_TEST(BlockManagerTest, LogMetadataCheckpointTest) {
+  ASSERT_NO_FATAL_FAILURE(this->RunLogMetadataCheckpointTest());
+}
+
 TYPED_TEST(BlockManagerTest, MemTrackerTest) {
   ASSERT_NO_FATAL_FAILURE(this->RunMemTrackerTest());
 }
@@ -32,6 +32,12 @@ DEFINE_bool(block_manager_lock_dirs, true,
             "Note that read-only concurrent usage is still allowed.");
 TAG_FLAG(block_manager_lock_dirs, unsafe);
 
+DEFINE_bool(block_manager_direct_io_writes, false,
+            "Write data blocks with direct I/O, bypassing the page cache. This "
+            "keeps flushes and compactions from evicting data being read, and "
+            "from leaving behind large amounts of dirty pages to write back.");
+TAG_FLAG(block_manager_direct_io_writes, experimental);
+
 namespace kudu {
 namespace fs {
 
@@ -27,6 +27,7 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/env.h"
 #include "kudu/util/status.h"
 
 DECLARE_bool(block_coalesce_close);
@@ -145,10 +146,40 @@ class ReadableBlock : public Block {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const = 0;
 
+  // Hints that 'length' bytes beginning from 'offset' in the block will be
+  // read soon. Ranges extending past the end of the block are clipped.
+  // Does not wait for the data to be read.
+  virtual Status ReadAhead(uint64_t offset, size_t length) const = 0;
+
+  // Reads each of 'requests', whose offsets are relative to the start of
+  // the block, as if by Read(). The reads may be issued concurrently; the
+  // call returns once all of them have completed.
+  virtual Status ReadBatch(std::vector<ReadRequest>* requests) const = 0;
+
   // Returns the memory usage of this object including the object itself.
   virtual size_t memory_footprint() const = 0;
 };
 
+// One of the reads of a BlockManager::ReadBatch() call.
+struct BlockReadRequest {
+  BlockReadRequest()
+    : block(NULL) {
+  }
+
+  BlockReadRequest(const ReadableBlock* block, uint64_t offset, size_t length,
+                   uint8_t* scratch)
+    : block(block),
+      read(offset, length, scratch) {
+  }
+
+  // The block to read from, which must have been opened by the block
+  // manager issuing the read.
+  const ReadableBlock* block;
+
+  // The range to read, relative to the start of the block.
+  ReadRequest read;
+};
+
 // Provides options and hints for block placement.
 struct CreateBlockOptions {
 };
@@ -225,6 +256,14 @@ class BlockManager {
   // On success, guarantees that outstanding data is durable.
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) = 0;
 
+  // Reads each of 'requests', which may span many blocks, as if by
+  // ReadableBlock::Read(). The reads are issued together, and the call
+  // returns once all of them have completed.
+  //
+  // Returns the first error encountered, in which case the results of the
+  // other reads are undefined.
+  virtual Status ReadBatch(std::vector<BlockReadRequest>* requests) = 0;
+
  protected:
   static const char* kInstanceMetadataFileName;
 };
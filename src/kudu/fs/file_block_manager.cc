@@ -38,6 +38,7 @@
 #include "kudu/util/status.h"
 
 using kudu::env_util::ScopedFileDeleter;
+using std::map;
 using std::string;
 using std::tr1::shared_ptr;
 using std::tr1::unordered_set;
@@ -46,6 +47,7 @@ using strings::Substitute;
 
 DECLARE_bool(enable_data_block_fsync);
 DECLARE_bool(block_manager_lock_dirs);
+DECLARE_bool(block_manager_direct_io_writes);
 
 namespace kudu {
 namespace fs {
@@ -387,6 +389,10 @@ class FileReadableBlock : public ReadableBlock {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const OVERRIDE;
 
+  virtual Status ReadAhead(uint64_t offset, size_t length) const OVERRIDE;
+
+  virtual Status ReadBatch(vector<ReadRequest>* requests) const OVERRIDE;
+
   virtual size_t memory_footprint() const OVERRIDE;
 
  private:
@@ -457,6 +463,28 @@ Status FileReadableBlock::Read(uint64_t offset, size_t length,
   return Status::OK();
 }
 
+Status FileReadableBlock::ReadAhead(uint64_t offset, size_t length) const {
+  DCHECK(!closed_.Load());
+
+  // The block is the whole file, so there's nothing to clip.
+  return reader_->ReadAhead(offset, length);
+}
+
+Status FileReadableBlock::ReadBatch(vector<ReadRequest>* requests) const {
+  DCHECK(!closed_.Load());
+
+  RETURN_NOT_OK(reader_->ReadBatch(requests));
+  if (block_manager_->metrics_) {
+    size_t bytes_read = 0;
+    BOOST_FOREACH(const ReadRequest& req, *requests) {
+      bytes_read += req.length;
+    }
+    block_manager_->metrics_->total_bytes_read->IncrementBy(bytes_read);
+  }
+
+  return Status::OK();
+}
+
 size_t FileReadableBlock::memory_footprint() const {
   DCHECK(reader_);
   return kudu_malloc_usable_size(this) + reader_->memory_footprint();
@@ -682,6 +710,7 @@ Status FileBlockManager::CreateBlock(const CreateBlockOptions& opts,
     RETURN_NOT_OK_PREPEND(location.CreateBlockDir(env_, &created_dirs), path);
     WritableFileOptions wr_opts;
     wr_opts.mode = Env::CREATE_NON_EXISTING;
+    wr_opts.direct_io = FLAGS_block_manager_direct_io_writes;
     s = env_util::OpenFileForWrite(wr_opts, env_, path, &writer);
   } while (PREDICT_FALSE(s.IsAlreadyPresent()));
   if (s.ok()) {
@@ -761,5 +790,27 @@ Status FileBlockManager::CloseBlocks(const vector<WritableBlock*>& blocks) {
   return Status::OK();
 }
 
+Status FileBlockManager::ReadBatch(vector<BlockReadRequest>* requests) {
+  // Group the requests by block.
+  typedef map<const ReadableBlock*, vector<int> > RequestsByBlock;
+  RequestsByBlock by_block;
+  for (int i = 0; i < requests->size(); i++) {
+    by_block[(*requests)[i].block].push_back(i);
+  }
+
+  BOOST_FOREACH(const RequestsByBlock::value_type& e, by_block) {
+    vector<ReadRequest> reads;
+    reads.reserve(e.second.size());
+    BOOST_FOREACH(int i, e.second) {
+      reads.push_back((*requests)[i].read);
+    }
+    RETURN_NOT_OK(e.first->ReadBatch(&reads));
+    for (int j = 0; j < reads.size(); j++) {
+      (*requests)[e.second[j]].read.result = reads[j].result;
+    }
+  }
+  return Status::OK();
+}
+
 } // namespace fs
 } // namespace kudu
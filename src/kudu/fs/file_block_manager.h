@@ -88,6 +88,9 @@ class FileBlockManager : public BlockManager {
 
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) OVERRIDE;
 
+  // Each block is a separate file, so the reads are only batched per block.
+  virtual Status ReadBatch(std::vector<BlockReadRequest>* requests) OVERRIDE;
+
  private:
   friend class internal::FileBlockLocation;
   friend class internal::FileReadableBlock;
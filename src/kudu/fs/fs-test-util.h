@@ -15,7 +15,11 @@
 #ifndef KUDU_FS_FS_TEST_UTIL_H
 #define KUDU_FS_FS_TEST_UTIL_H
 
+#include <boost/foreach.hpp>
+#include <vector>
+
 #include "kudu/fs/block_manager.h"
+#include "kudu/util/env.h"
 #include "kudu/util/malloc.h"
 
 namespace kudu {
@@ -37,11 +41,15 @@ namespace fs {
 //   tr_block->Read(0, 200, ...);
 //   ASSERT_EQ(300, bytes_read);
 //
+// If 'bytes_read_ahead' is provided, the bytes hinted at by ReadAhead() are
+// counted there. They don't count towards 'bytes_read'.
 class CountingReadableBlock : public ReadableBlock {
  public:
-  CountingReadableBlock(gscoped_ptr<ReadableBlock> block, size_t* bytes_read)
+  CountingReadableBlock(gscoped_ptr<ReadableBlock> block, size_t* bytes_read,
+                        size_t* bytes_read_ahead = NULL)
     : block_(block.Pass()),
-      bytes_read_(bytes_read) {
+      bytes_read_(bytes_read),
+      bytes_read_ahead_(bytes_read_ahead) {
   }
 
   virtual const BlockId& id() const OVERRIDE {
@@ -63,6 +71,22 @@ class CountingReadableBlock : public ReadableBlock {
     return Status::OK();
   }
 
+  virtual Status ReadAhead(uint64_t offset, size_t length) const OVERRIDE {
+    RETURN_NOT_OK(block_->ReadAhead(offset, length));
+    if (bytes_read_ahead_) {
+      *bytes_read_ahead_ += length;
+    }
+    return Status::OK();
+  }
+
+  virtual Status ReadBatch(std::vector<ReadRequest>* requests) const OVERRIDE {
+    RETURN_NOT_OK(block_->ReadBatch(requests));
+    BOOST_FOREACH(const ReadRequest& req, *requests) {
+      *bytes_read_ += req.length;
+    }
+    return Status::OK();
+  }
+
   virtual size_t memory_footprint() const OVERRIDE {
     return block_->memory_footprint();
   }
@@ -70,6 +94,7 @@ class CountingReadableBlock : public ReadableBlock {
  private:
   gscoped_ptr<ReadableBlock> block_;
   size_t* bytes_read_;
+  size_t* bytes_read_ahead_;
 };
 
 } // namespace fs
@@ -491,6 +491,10 @@ Status FsManager::OpenBlock(const BlockId& block_id, gscoped_ptr<ReadableBlock>*
   return block_manager_->OpenBlock(block_id, block);
 }
 
+Status FsManager::ReadBatch(vector<fs::BlockReadRequest>* requests) {
+  return block_manager_->ReadBatch(requests);
+}
+
 Status FsManager::DeleteBlock(const BlockId& block_id) {
   CHECK(!read_only_);
 
@@ -43,6 +43,7 @@ class MetricEntity;
 
 namespace fs {
 class BlockManager;
+struct BlockReadRequest;
 class ReadableBlock;
 class WritableBlock;
 } // namespace fs
@@ -130,6 +131,10 @@ class FsManager {
 
   Status DeleteBlock(const BlockId& block_id);
 
+  // Reads ranges of several open blocks together. See
+  // fs::BlockManager::ReadBatch().
+  Status ReadBatch(std::vector<fs::BlockReadRequest>* requests);
+
   bool BlockExists(const BlockId& block_id) const;
 
   // ==========================================================================
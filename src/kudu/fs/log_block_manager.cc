@@ -14,11 +14,13 @@
 
 #include "kudu/fs/log_block_manager.h"
 
+#include <algorithm>
 #include <boost/foreach.hpp>
 
 #include "kudu/fs/block_manager_metrics.h"
 #include "kudu/fs/block_manager_util.h"
 #include "kudu/gutil/callback.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/strcat.h"
 #include "kudu/gutil/strings/strip.h"
@@ -28,9 +30,11 @@
 #include "kudu/util/atomic.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
+#include "kudu/util/errno.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
@@ -48,6 +52,26 @@ DEFINE_uint64(log_container_preallocate_bytes, 32LU * 1024 * 1024,
               "creating new blocks. Set to 0 to disable preallocation");
 TAG_FLAG(log_container_preallocate_bytes, advanced);
 
+DEFINE_uint64(log_container_read_coalesce_bytes, 64 * 1024,
+              "Reads of a container issued together are merged into one when "
+              "separated by no more than this many bytes. Blocks are padded "
+              "to filesystem block boundaries, so adjacent blocks are always "
+              "separated by a few bytes.");
+TAG_FLAG(log_container_read_coalesce_bytes, advanced);
+
+DEFINE_double(log_container_live_metadata_before_checkpoint_ratio, 0.50,
+              "When a container's metadata is loaded at startup and less than "
+              "this fraction of its records describe live blocks, the metadata "
+              "is checkpointed: rewritten with just the live blocks' records, "
+              "so that later startups have fewer records to replay. Set to 0 "
+              "to disable checkpoints.");
+TAG_FLAG(log_container_live_metadata_before_checkpoint_ratio, experimental);
+
+DEFINE_int32(log_block_manager_open_threads_per_dir, 4,
+             "Number of threads per data directory used to load the "
+             "directory's containers when opening the block manager");
+TAG_FLAG(log_block_manager_open_threads_per_dir, advanced);
+
 DEFINE_bool(log_block_manager_test_hole_punching, true,
             "Ensure hole punching is supported by the underlying filesystem");
 TAG_FLAG(log_block_manager_test_hole_punching, advanced);
@@ -55,6 +79,7 @@ TAG_FLAG(log_block_manager_test_hole_punching, unsafe);
 
 DECLARE_bool(enable_data_block_fsync);
 DECLARE_bool(block_manager_lock_dirs);
+DECLARE_bool(block_manager_direct_io_writes);
 
 METRIC_DEFINE_gauge_uint64(server, log_block_manager_bytes_under_management,
                            "Bytes Under Management",
@@ -76,9 +101,22 @@ METRIC_DEFINE_counter(server, log_block_manager_full_containers,
                       kudu::MetricUnit::kLogBlockContainers,
                       "Number of full log block containers");
 
+METRIC_DEFINE_counter(server, log_block_manager_metadata_checkpoints,
+                      "Number of Container Metadata Checkpoints",
+                      kudu::MetricUnit::kLogBlockContainers,
+                      "Number of log block container metadata files rewritten "
+                      "with just the records of live blocks");
+
+METRIC_DEFINE_gauge_uint64(server, log_block_manager_open_time,
+                           "Block Manager Open Time",
+                           kudu::MetricUnit::kMilliseconds,
+                           "Time taken to load all log block containers when "
+                           "the block manager was opened");
+
 using std::tr1::shared_ptr;
 using std::tr1::unordered_map;
 using std::tr1::unordered_set;
+using std::vector;
 using strings::Substitute;
 using kudu::env_util::ScopedFileDeleter;
 using kudu::fs::internal::LogBlock;
@@ -92,6 +130,10 @@ namespace fs {
 
 namespace internal {
 
+// Appended to a container's metadata file name to name its checkpoint
+// while it's being written.
+static const char* const kCheckpointTmpSuffix = ".tmp.XXXXXX";
+
 ////////////////////////////////////////////////////////////
 // LogBlockManagerMetrics
 ////////////////////////////////////////////////////////////
@@ -111,6 +153,9 @@ struct LogBlockManagerMetrics {
 
   scoped_refptr<Counter> containers;
   scoped_refptr<Counter> full_containers;
+  scoped_refptr<Counter> metadata_checkpoints;
+
+  scoped_refptr<AtomicGauge<uint64_t> > open_time;
 };
 
 #define MINIT(x) x(METRIC_log_block_manager_##x.Instantiate(metric_entity))
@@ -120,7 +165,9 @@ LogBlockManagerMetrics::LogBlockManagerMetrics(const scoped_refptr<MetricEntity>
     GINIT(bytes_under_management),
     GINIT(blocks_under_management),
     MINIT(containers),
-    MINIT(full_containers) {
+    MINIT(full_containers),
+    MINIT(metadata_checkpoints),
+    GINIT(open_time) {
 }
 #undef GINIT
 #undef MINIT
@@ -181,10 +228,22 @@ class LogBlockContainer {
   // The on-disk effects of this call are made durable only after SyncData().
   Status WriteData(int64_t offset, const Slice& data);
 
+  // Like WriteData(), but bypasses the page cache. 'offset' as well as the
+  // size and memory address of 'data' must be aligned to kDirectIOAlignment.
+  //
+  // Only valid if direct_io() is true.
+  Status WriteDataDirect(int64_t offset, const Slice& data);
+
   // See RWFile::Read().
   Status ReadData(int64_t offset, size_t length,
                   Slice* result, uint8_t* scratch) const;
 
+  // See RWFile::ReadAhead().
+  Status ReadAheadData(int64_t offset, size_t length) const;
+
+  // See RWFile::ReadBatch().
+  Status ReadDataBatch(vector<ReadRequest>* requests) const;
+
   // Appends 'pb' to this container's metadata file.
   //
   // The on-disk effects of this call are made durable only after SyncMetadata().
@@ -227,6 +286,15 @@ class LogBlockContainer {
   // returning the records.
   Status ReadContainerRecords(deque<BlockRecordPB>* records) const;
 
+  // Replaces the container's metadata file with a checkpoint holding just
+  // 'records', which must describe the container's live blocks. The
+  // checkpoint is written to a temporary file and renamed into place, so a
+  // crash leaves either the old or the new metadata file behind.
+  //
+  // This function is thread unsafe, and may only be called while the
+  // container is being opened.
+  Status CheckpointMetadata(const vector<BlockRecordPB>& records);
+
   // Updates 'total_bytes_written_', marking this container as full if
   // needed. Should only be called when a block is fully written, as it
   // will round up the container data file's position.
@@ -234,6 +302,14 @@ class LogBlockContainer {
   // This function is thread unsafe.
   void UpdateBytesWritten(int64_t more_bytes);
 
+  // Ensures that 'total_bytes_written_' extends past the block at 'offset'
+  // with 'length', rounded up as in UpdateBytesWritten(). Used when loading
+  // the container, whose metadata may not cover every block once written
+  // to it if it was checkpointed.
+  //
+  // This function is thread unsafe.
+  void UpdateBytesWrittenToInclude(int64_t offset, int64_t length);
+
   // Run a task on this container's root path thread pool.
   //
   // Normally the task is performed asynchronously. However, if submission to
@@ -250,6 +326,8 @@ class LogBlockContainer {
   }
   const LogBlockManagerMetrics* metrics() const { return metrics_; }
   const PathInstanceMetadataPB* instance() const { return instance_; }
+  const RWFile* data_file() const { return data_file_.get(); }
+  bool direct_io() const { return direct_io_; }
 
  private:
   // RAII-style class for finishing containers in FinishBlock().
@@ -293,6 +371,16 @@ class LogBlockContainer {
   Mutex data_writer_lock_;
   gscoped_ptr<RWFile> data_file_;
 
+  // Whether blocks are written with direct I/O. Only possible if padding a
+  // block's data to kDirectIOAlignment keeps it within its last filesystem
+  // block, so as not to spill over into the next block.
+  const bool direct_io_;
+
+  // A second handle to the data file, opened for direct I/O on the first
+  // WriteDataDirect(). Reads still go through 'data_file_', since they
+  // needn't be aligned. Protected by 'data_writer_lock_'.
+  gscoped_ptr<RWFile> direct_data_file_;
+
   // The amount of data written thus far in the container.
   int64_t total_bytes_written_;
 
@@ -317,6 +405,8 @@ LogBlockContainer::LogBlockContainer(LogBlockManager* block_manager,
     path_(path),
     metadata_pb_writer_(metadata_writer.Pass()),
     data_file_(data_file.Pass()),
+    direct_io_(FLAGS_block_manager_direct_io_writes &&
+               instance->filesystem_block_size_bytes() % kDirectIOAlignment == 0),
     total_bytes_written_(0),
     metrics_(block_manager->metrics()),
     instance_(instance) {
@@ -457,6 +547,46 @@ Status LogBlockContainer::ReadContainerRecords(deque<BlockRecordPB>* records) co
   return ret;
 }
 
+Status LogBlockContainer::CheckpointMetadata(const vector<BlockRecordPB>& records) {
+  Env* env = block_manager()->env();
+  string metadata_path = StrCat(path_, kMetadataFileSuffix);
+  string tmp_path;
+  gscoped_ptr<WritableFile> tmp_file;
+  WritableFileOptions wr_opts;
+
+  // See the comment in LogBlockContainer::Create() to understand why we're
+  // not using memory mapped files.
+  wr_opts.mmap_file = false;
+  RETURN_NOT_OK(env->NewTempWritableFile(wr_opts,
+                                         StrCat(metadata_path, kCheckpointTmpSuffix),
+                                         &tmp_path, &tmp_file));
+  ScopedFileDeleter tmp_deleter(env, tmp_path);
+  WritablePBContainerFile pb_writer(tmp_file.Pass());
+  RETURN_NOT_OK(pb_writer.Init(BlockRecordPB()));
+  BOOST_FOREACH(const BlockRecordPB& record, records) {
+    RETURN_NOT_OK(pb_writer.Append(record));
+  }
+  if (FLAGS_enable_data_block_fsync) {
+    RETURN_NOT_OK(pb_writer.Sync());
+  }
+  RETURN_NOT_OK(pb_writer.Close());
+
+  lock_guard<Mutex> l(&metadata_pb_writer_lock_);
+  RETURN_NOT_OK(env->RenameFile(tmp_path, metadata_path));
+  tmp_deleter.Cancel();
+  if (FLAGS_enable_data_block_fsync) {
+    RETURN_NOT_OK(env->SyncDir(dir()));
+  }
+
+  // The existing writer still refers to the replaced file.
+  gscoped_ptr<WritableFile> metadata_writer;
+  wr_opts.mode = Env::OPEN_EXISTING;
+  RETURN_NOT_OK(env->NewWritableFile(wr_opts, metadata_path, &metadata_writer));
+  RETURN_NOT_OK(metadata_pb_writer_->Close());
+  metadata_pb_writer_.reset(new WritablePBContainerFile(metadata_writer.Pass()));
+  return Status::OK();
+}
+
 void LogBlockContainer::CheckBlockRecord(const BlockRecordPB& record,
                                          uint64_t data_file_size) const {
   if (record.op_type() == CREATE &&
@@ -521,6 +651,23 @@ Status LogBlockContainer::WriteData(int64_t offset, const Slice& data) {
   return data_file_->Write(offset, data);
 }
 
+Status LogBlockContainer::WriteDataDirect(int64_t offset, const Slice& data) {
+  DCHECK(direct_io_);
+  DCHECK_EQ(0, offset % kDirectIOAlignment);
+  DCHECK_EQ(0, data.size() % kDirectIOAlignment);
+
+  lock_guard<Mutex> l(&data_writer_lock_);
+  if (!direct_data_file_) {
+    RWFileOptions opts;
+    opts.mode = Env::OPEN_EXISTING;
+    opts.direct_io = true;
+    RETURN_NOT_OK(block_manager()->env()->NewRWFile(opts,
+                                                    StrCat(path_, kDataFileSuffix),
+                                                    &direct_data_file_));
+  }
+  return direct_data_file_->Write(offset, data);
+}
+
 Status LogBlockContainer::ReadData(int64_t offset, size_t length,
                                    Slice* result, uint8_t* scratch) const {
   DCHECK_GE(offset, 0);
@@ -528,6 +675,16 @@ Status LogBlockContainer::ReadData(int64_t offset, size_t length,
   return data_file_->Read(offset, length, result, scratch);
 }
 
+Status LogBlockContainer::ReadAheadData(int64_t offset, size_t length) const {
+  DCHECK_GE(offset, 0);
+
+  return data_file_->ReadAhead(offset, length);
+}
+
+Status LogBlockContainer::ReadDataBatch(vector<ReadRequest>* requests) const {
+  return data_file_->ReadBatch(requests);
+}
+
 Status LogBlockContainer::AppendMetadata(const BlockRecordPB& pb) {
   lock_guard<Mutex> l(&metadata_pb_writer_lock_);
   return metadata_pb_writer_->Append(pb);
@@ -549,6 +706,9 @@ Status LogBlockContainer::FlushMetadata() {
 Status LogBlockContainer::SyncData() {
   if (FLAGS_enable_data_block_fsync) {
     lock_guard<Mutex> l(&data_writer_lock_);
+    if (direct_data_file_) {
+      RETURN_NOT_OK(direct_data_file_->Sync());
+    }
     return data_file_->Sync();
   }
   return Status::OK();
@@ -590,6 +750,16 @@ void LogBlockContainer::UpdateBytesWritten(int64_t more_bytes) {
   }
 }
 
+void LogBlockContainer::UpdateBytesWrittenToInclude(int64_t offset, int64_t length) {
+  DCHECK_GE(offset, 0);
+  DCHECK_GE(length, 0);
+
+  int64_t end = offset + KUDU_ALIGN_UP(length, instance()->filesystem_block_size_bytes());
+  if (end > total_bytes_written_) {
+    total_bytes_written_ = end;
+  }
+}
+
 void LogBlockContainer::ExecClosure(const Closure& task) {
   ThreadPool* pool = FindOrDie(block_manager()->thread_pools_by_root_path_,
                                dir());
@@ -705,8 +875,11 @@ class LogWritableBlock : public WritableBlock {
     NO_SYNC
   };
 
+  // If the container writes with direct I/O, 'direct_buf' must be a buffer
+  // of kDirectIOBufferSize bytes aligned to kDirectIOAlignment, in which the
+  // block's data is staged.
   LogWritableBlock(LogBlockContainer* container, const BlockId& block_id,
-                   int64_t block_offset);
+                   int64_t block_offset, gscoped_ptr<uint8_t[], FreeDeleter> direct_buf);
 
   virtual ~LogWritableBlock();
 
@@ -736,6 +909,14 @@ class LogWritableBlock : public WritableBlock {
   Status AppendMetadata();
 
  private:
+  // Write out the contents of the direct I/O buffer, padded with zeroes to
+  // kDirectIOAlignment. The padding lies before the next filesystem block
+  // boundary, where the container's next block will begin.
+  Status WriteDirectBuffer();
+
+  // Write out what remains of the direct I/O buffer and free it, once no
+  // more data will be appended. A no-op if not using direct I/O.
+  Status FinishDirectWrites();
 
   // RAII-style class for finishing writable blocks in DoClose().
   class ScopedFinisher {
@@ -767,6 +948,13 @@ class LogWritableBlock : public WritableBlock {
   // The block's length. Changes with each Append().
   int64_t block_length_;
 
+  // With direct I/O, the appended data that hasn't been written out yet;
+  // otherwise NULL. It's written out whenever it fills up, so its offset in
+  // the container, 'direct_buf_offset_', remains aligned.
+  gscoped_ptr<uint8_t[], FreeDeleter> direct_buf_;
+  int64_t direct_buf_offset_;
+  size_t direct_buf_len_;
+
   // The state of the block describing where it is in the write lifecycle,
   // for example, has it been synchronized to disk?
   WritableBlock::State state_;
@@ -776,14 +964,22 @@ class LogWritableBlock : public WritableBlock {
 
 LogWritableBlock::LogWritableBlock(LogBlockContainer* container,
                                    const BlockId& block_id,
-                                   int64_t block_offset)
+                                   int64_t block_offset,
+                                   gscoped_ptr<uint8_t[], FreeDeleter> direct_buf)
   : container_(container),
     block_id_(block_id),
     block_offset_(block_offset),
     block_length_(0),
+    direct_buf_(direct_buf.Pass()),
+    direct_buf_offset_(block_offset),
+    direct_buf_len_(0),
     state_(CLEAN) {
   DCHECK_GE(block_offset, 0);
   DCHECK_EQ(0, block_offset % container->instance()->filesystem_block_size_bytes());
+  DCHECK_EQ(container->direct_io(), direct_buf_.get() != NULL);
+  if (direct_buf_) {
+    container->ConsumeMemory(kDirectIOBufferSize);
+  }
   if (container->metrics()) {
     container->metrics()->generic_metrics.blocks_open_writing->Increment();
     container->metrics()->generic_metrics.total_writable_blocks->Increment();
@@ -793,6 +989,9 @@ LogWritableBlock::LogWritableBlock(LogBlockContainer* container,
 LogWritableBlock::~LogWritableBlock() {
   WARN_NOT_OK(Close(), Substitute("Failed to close block $0",
                                   id().ToString()));
+  if (direct_buf_) {
+    container_->ReleaseMemory(kDirectIOBufferSize);
+  }
 }
 
 Status LogWritableBlock::Close() {
@@ -822,7 +1021,22 @@ Status LogWritableBlock::Append(const Slice& data) {
   // The metadata change is deferred to Close() or FlushDataAsync(),
   // whichever comes first. We can't do it now because the block's
   // length is still in flux.
-  RETURN_NOT_OK(container_->WriteData(block_offset_ + block_length_, data));
+  if (direct_buf_) {
+    const uint8_t* src = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+      size_t n = std::min(left, kDirectIOBufferSize - direct_buf_len_);
+      memcpy(direct_buf_.get() + direct_buf_len_, src, n);
+      direct_buf_len_ += n;
+      src += n;
+      left -= n;
+      if (direct_buf_len_ == kDirectIOBufferSize) {
+        RETURN_NOT_OK(WriteDirectBuffer());
+      }
+    }
+  } else {
+    RETURN_NOT_OK(container_->WriteData(block_offset_ + block_length_, data));
+  }
 
   block_length_ += data.size();
   state_ = DIRTY;
@@ -834,6 +1048,7 @@ Status LogWritableBlock::FlushDataAsync() {
       << "Invalid state: " << state_;
   if (state_ == DIRTY) {
     VLOG(3) << "Flushing block " << id();
+    RETURN_NOT_OK(FinishDirectWrites());
     RETURN_NOT_OK(container_->FlushData(block_offset_, block_length_));
 
     RETURN_NOT_OK(AppendMetadata());
@@ -873,6 +1088,9 @@ Status LogWritableBlock::DoClose(SyncMode mode) {
 
     // FlushDataAsync() was not called; append the metadata now.
     if (state_ == CLEAN || state_ == DIRTY) {
+      s = FinishDirectWrites();
+      RETURN_NOT_OK(s);
+
       s = AppendMetadata();
       RETURN_NOT_OK(s);
     }
@@ -900,6 +1118,29 @@ Status LogWritableBlock::DoClose(SyncMode mode) {
   return s;
 }
 
+Status LogWritableBlock::WriteDirectBuffer() {
+  if (direct_buf_len_ == 0) {
+    return Status::OK();
+  }
+  size_t len = KUDU_ALIGN_UP(direct_buf_len_, kDirectIOAlignment);
+  memset(direct_buf_.get() + direct_buf_len_, 0, len - direct_buf_len_);
+  RETURN_NOT_OK(container_->WriteDataDirect(direct_buf_offset_,
+                                            Slice(direct_buf_.get(), len)));
+  direct_buf_offset_ += len;
+  direct_buf_len_ = 0;
+  return Status::OK();
+}
+
+Status LogWritableBlock::FinishDirectWrites() {
+  if (!direct_buf_) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(WriteDirectBuffer());
+  direct_buf_.reset();
+  container_->ReleaseMemory(kDirectIOBufferSize);
+  return Status::OK();
+}
+
 Status LogWritableBlock::AppendMetadata() {
   BlockRecordPB record;
   id().CopyToPB(record.mutable_block_id());
@@ -933,9 +1174,22 @@ class LogReadableBlock : public ReadableBlock {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const OVERRIDE;
 
+  virtual Status ReadAhead(uint64_t offset, size_t length) const OVERRIDE;
+
+  virtual Status ReadBatch(vector<ReadRequest>* requests) const OVERRIDE;
+
   virtual size_t memory_footprint() const OVERRIDE;
 
+  // Translates 'req' into a read of the container's data file, returning
+  // an error if it is out of the block's bounds.
+  Status TranslateRead(const ReadRequest& req, ReadRequest* container_req) const;
+
+  LogBlockContainer* container() const { return container_; }
+
  private:
+  // Returns an error if the given range of the block is out of bounds.
+  Status CheckBounds(uint64_t offset, size_t length) const;
+
   // The owning container. Must outlive this block.
   LogBlockContainer* container_;
 
@@ -987,12 +1241,9 @@ Status LogReadableBlock::Size(size_t* sz) const {
   return Status::OK();
 }
 
-Status LogReadableBlock::Read(uint64_t offset, size_t length,
-                              Slice* result, uint8_t* scratch) const {
-  DCHECK(!closed_.Load());
-
-  uint64_t read_offset = log_block_->offset() + offset;
+Status LogReadableBlock::CheckBounds(uint64_t offset, size_t length) const {
   if (log_block_->length() < offset + length) {
+    uint64_t read_offset = log_block_->offset() + offset;
     return Status::IOError("Out-of-bounds read",
                            Substitute("read of [$0-$1) in block [$2-$3)",
                                       read_offset,
@@ -1000,6 +1251,15 @@ Status LogReadableBlock::Read(uint64_t offset, size_t length,
                                       log_block_->offset(),
                                       log_block_->offset() + log_block_->length()));
   }
+  return Status::OK();
+}
+
+Status LogReadableBlock::Read(uint64_t offset, size_t length,
+                              Slice* result, uint8_t* scratch) const {
+  DCHECK(!closed_.Load());
+
+  RETURN_NOT_OK(CheckBounds(offset, length));
+  uint64_t read_offset = log_block_->offset() + offset;
   RETURN_NOT_OK(container_->ReadData(read_offset, length, result, scratch));
 
   if (container_->metrics()) {
@@ -1008,6 +1268,45 @@ Status LogReadableBlock::Read(uint64_t offset, size_t length,
   return Status::OK();
 }
 
+Status LogReadableBlock::ReadAhead(uint64_t offset, size_t length) const {
+  DCHECK(!closed_.Load());
+
+  // Don't read ahead into whatever block follows this one in the container.
+  if (offset >= log_block_->length()) {
+    return Status::OK();
+  }
+  length = std::min<uint64_t>(length, log_block_->length() - offset);
+  return container_->ReadAheadData(log_block_->offset() + offset, length);
+}
+
+Status LogReadableBlock::TranslateRead(const ReadRequest& req,
+                                       ReadRequest* container_req) const {
+  DCHECK(!closed_.Load());
+
+  RETURN_NOT_OK(CheckBounds(req.offset, req.length));
+  *container_req = ReadRequest(log_block_->offset() + req.offset, req.length, req.scratch);
+  return Status::OK();
+}
+
+Status LogReadableBlock::ReadBatch(vector<ReadRequest>* requests) const {
+  // Translate the requests into reads of the container's data file.
+  vector<ReadRequest> container_requests(requests->size());
+  size_t bytes_read = 0;
+  for (int i = 0; i < requests->size(); i++) {
+    RETURN_NOT_OK(TranslateRead((*requests)[i], &container_requests[i]));
+    bytes_read += (*requests)[i].length;
+  }
+  RETURN_NOT_OK(container_->ReadDataBatch(&container_requests));
+  for (int i = 0; i < requests->size(); i++) {
+    (*requests)[i].result = container_requests[i].result;
+  }
+
+  if (container_->metrics()) {
+    container_->metrics()->generic_metrics.total_bytes_read->IncrementBy(bytes_read);
+  }
+  return Status::OK();
+}
+
 size_t LogReadableBlock::memory_footprint() const {
   return kudu_malloc_usable_size(this);
 }
@@ -1127,6 +1426,7 @@ Status LogBlockManager::Create() {
 }
 
 Status LogBlockManager::Open() {
+  MonoTime start = MonoTime::Now(MonoTime::FINE);
   RETURN_NOT_OK(Init());
 
   vector<Status> statuses(root_paths_.size());
@@ -1162,6 +1462,14 @@ Status LogBlockManager::Open() {
   }
 
   instances_by_root_path_.swap(metadata_files);
+
+  MonoDelta elapsed = MonoTime::Now(MonoTime::FINE).GetDeltaSince(start);
+  LOG(INFO) << Substitute("Opened log block manager with $0 blocks in $1 containers in $2 ms",
+                          blocks_by_block_id_.size(), all_containers_.size(),
+                          elapsed.ToMilliseconds());
+  if (metrics()) {
+    metrics()->open_time->set_value(elapsed.ToMilliseconds());
+  }
   return Status::OK();
 }
 
@@ -1209,6 +1517,18 @@ Status LogBlockManager::CreateBlock(const CreateBlockOptions& opts,
     RETURN_NOT_OK(container->Preallocate(FLAGS_log_container_preallocate_bytes));
   }
 
+  gscoped_ptr<uint8_t[], FreeDeleter> direct_buf;
+  if (container->direct_io()) {
+    void* buf;
+    int err = posix_memalign(&buf, kDirectIOAlignment, kDirectIOBufferSize);
+    if (err != 0) {
+      MakeContainerAvailable(container);
+      return Status::IOError("Unable to allocate a direct I/O buffer",
+                             ErrnoToString(err), err);
+    }
+    direct_buf.reset(static_cast<uint8_t*>(buf));
+  }
+
   // Generate a free block ID.
   BlockId new_block_id;
   do {
@@ -1217,7 +1537,8 @@ Status LogBlockManager::CreateBlock(const CreateBlockOptions& opts,
 
   block->reset(new internal::LogWritableBlock(container,
                                               new_block_id,
-                                              container->total_bytes_written()));
+                                              container->total_bytes_written(),
+                                              direct_buf.Pass()));
   VLOG(3) << "Created block " << (*block)->id() << " in container "
           << container->ToString();
   return Status::OK();
@@ -1290,6 +1611,120 @@ Status LogBlockManager::CloseBlocks(const std::vector<WritableBlock*>& blocks) {
   return Status::OK();
 }
 
+namespace {
+
+// Orders the reads of LogBlockManager::ReadBatch() by container, and then
+// by offset within the container.
+class ContainerReadComparator {
+ public:
+  ContainerReadComparator(const vector<LogBlockContainer*>& containers,
+                          const vector<ReadRequest>& reads)
+    : containers_(containers),
+      reads_(reads) {
+  }
+
+  bool operator()(int a, int b) const {
+    if (containers_[a] != containers_[b]) {
+      return containers_[a] < containers_[b];
+    }
+    return reads_[a].offset < reads_[b].offset;
+  }
+
+ private:
+  const vector<LogBlockContainer*>& containers_;
+  const vector<ReadRequest>& reads_;
+};
+
+} // anonymous namespace
+
+Status LogBlockManager::ReadBatch(vector<BlockReadRequest>* requests) {
+  const int num_requests = requests->size();
+
+  // Translate the requests into reads of the containers' data files.
+  vector<LogBlockContainer*> containers(num_requests);
+  vector<ReadRequest> reads(num_requests);
+  size_t bytes_read = 0;
+  for (int i = 0; i < num_requests; i++) {
+    const BlockReadRequest& req = (*requests)[i];
+    const internal::LogReadableBlock* block =
+        down_cast<const internal::LogReadableBlock*>(req.block);
+    RETURN_NOT_OK(block->TranslateRead(req.read, &reads[i]));
+    containers[i] = block->container();
+    bytes_read += req.read.length;
+  }
+
+  // Sort the reads so that those of nearby ranges of the same container
+  // are next to each other, and merge such neighbors into runs.
+  vector<int> order(num_requests);
+  for (int i = 0; i < num_requests; i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), ContainerReadComparator(containers, reads));
+
+  // Each run covers order[run_starts[j]] up to order[run_starts[j + 1]].
+  vector<int> run_starts;
+  vector<FileReadRequest> file_reads;
+  size_t merged_bytes = 0;
+  for (int i = 0; i < num_requests; i++) {
+    int idx = order[i];
+    const ReadRequest& read = reads[idx];
+    if (!file_reads.empty()) {
+      FileReadRequest& run = file_reads.back();
+      uint64_t run_end = run.read.offset + run.read.length;
+      if (run.file == containers[idx]->data_file() &&
+          read.offset <= run_end + FLAGS_log_container_read_coalesce_bytes) {
+        uint64_t new_end = std::max<uint64_t>(run_end, read.offset + read.length);
+        run.read.length = new_end - run.read.offset;
+        continue;
+      }
+    }
+    run_starts.push_back(i);
+    file_reads.push_back(FileReadRequest(containers[idx]->data_file(),
+                                         read.offset, read.length, read.scratch));
+  }
+  run_starts.push_back(num_requests);
+
+  // Runs of a single read go straight into its scratch buffer. Merged runs
+  // are read into a shared buffer and copied out afterwards.
+  for (int j = 0; j < file_reads.size(); j++) {
+    if (run_starts[j + 1] - run_starts[j] > 1) {
+      merged_bytes += file_reads[j].read.length;
+    }
+  }
+  gscoped_array<uint8_t> merged_buf(merged_bytes > 0 ? new uint8_t[merged_bytes] : NULL);
+  uint8_t* next_buf = merged_buf.get();
+  for (int j = 0; j < file_reads.size(); j++) {
+    if (run_starts[j + 1] - run_starts[j] > 1) {
+      file_reads[j].read.scratch = next_buf;
+      next_buf += file_reads[j].read.length;
+    }
+  }
+
+  VLOG(3) << "Reading " << num_requests << " ranges of blocks with "
+          << file_reads.size() << " reads";
+  RETURN_NOT_OK(env_->ReadBatch(&file_reads));
+
+  for (int j = 0; j < file_reads.size(); j++) {
+    const ReadRequest& run = file_reads[j].read;
+    for (int i = run_starts[j]; i < run_starts[j + 1]; i++) {
+      int idx = order[i];
+      ReadRequest* req = &(*requests)[idx].read;
+      if (run_starts[j + 1] - run_starts[j] == 1) {
+        req->result = run.result;
+      } else {
+        memcpy(req->scratch, run.result.data() + (reads[idx].offset - run.offset),
+               req->length);
+        req->result = Slice(req->scratch, req->length);
+      }
+    }
+  }
+
+  if (metrics()) {
+    metrics()->generic_metrics.total_bytes_read->IncrementBy(bytes_read);
+  }
+  return Status::OK();
+}
+
 void LogBlockManager::AddNewContainerUnlocked(LogBlockContainer* container) {
   DCHECK(lock_.is_locked());
   all_containers_.push_back(container);
@@ -1453,80 +1888,167 @@ void LogBlockManager::OpenRootPath(const string& root_path,
         "Could not list children of $0", root_path));
     return;
   }
+  vector<string> container_ids;
   BOOST_FOREACH(const string& child, children) {
     string id;
-    if (!TryStripSuffixString(child, LogBlockContainer::kMetadataFileSuffix, &id)) {
-      continue;
+    if (TryStripSuffixString(child, LogBlockContainer::kMetadataFileSuffix, &id)) {
+      container_ids.push_back(id);
+    } else if (!read_only_ &&
+               child.find(StrCat(LogBlockContainer::kMetadataFileSuffix, ".tmp.")) !=
+               string::npos) {
+      // A checkpoint left behind by a crash; the original metadata file
+      // is still intact.
+      WARN_NOT_OK(env_->DeleteFile(JoinPathSegments(root_path, child)),
+                  "Could not delete incomplete container metadata checkpoint");
     }
-    gscoped_ptr<LogBlockContainer> container;
-    s = LogBlockContainer::Open(this, metadata->metadata(),
-                                root_path, id, &container);
+  }
+
+  // Reading the containers' records takes the bulk of the time, so the
+  // containers are opened in parallel.
+  gscoped_ptr<ThreadPool> pool;
+  s = ThreadPoolBuilder(Substitute("lbm open $0", root_path))
+      .set_max_threads(FLAGS_log_block_manager_open_threads_per_dir)
+      .Build(&pool);
+  if (!s.ok()) {
+    *result_status = s.CloneAndPrepend("Could not build thread pool");
+    return;
+  }
+  vector<Status> statuses(container_ids.size());
+  for (int i = 0; i < container_ids.size(); i++) {
+    s = pool->SubmitClosure(Bind(&LogBlockManager::OpenContainer,
+                                 Unretained(this),
+                                 metadata->metadata(),
+                                 root_path,
+                                 container_ids[i],
+                                 &statuses[i]));
     if (!s.ok()) {
-      *result_status = s.CloneAndPrepend(Substitute(
-          "Could not open container $0", id));
+      statuses[i] = s.CloneAndPrepend(Substitute(
+          "Could not open container $0", container_ids[i]));
+      break;
+    }
+  }
+  pool->Wait();
+  BOOST_FOREACH(const Status& status, statuses) {
+    if (!status.ok()) {
+      *result_status = status;
       return;
     }
+  }
+
+  *result_status = Status::OK();
+  *result_metadata = metadata.release();
+}
+
+void LogBlockManager::OpenContainer(PathInstanceMetadataPB* instance,
+                                    const string& root_path,
+                                    const string& id,
+                                    Status* result_status) {
+  gscoped_ptr<LogBlockContainer> container;
+  Status s = LogBlockContainer::Open(this, instance, root_path, id, &container);
+  if (!s.ok()) {
+    *result_status = s.CloneAndPrepend(Substitute(
+        "Could not open container $0", id));
+    return;
+  }
 
-    // Populate the in-memory block maps using each container's records.
-    deque<BlockRecordPB> records;
-    s = container->ReadContainerRecords(&records);
+  deque<BlockRecordPB> records;
+  s = container->ReadContainerRecords(&records);
+  if (!s.ok()) {
+    *result_status = s.CloneAndPrepend(Substitute(
+        "Could not read records from container $0", container->ToString()));
+    return;
+  }
+  vector<BlockRecordPB> live_records;
+  ReplayContainerRecords(container.get(), records, &live_records);
+
+  if (!read_only_ &&
+      live_records.size() <
+      records.size() * FLAGS_log_container_live_metadata_before_checkpoint_ratio) {
+    VLOG(1) << Substitute("Checkpointing metadata of container $0 ($1 of $2 records live)",
+                          container->ToString(), live_records.size(), records.size());
+    s = container->CheckpointMetadata(live_records);
     if (!s.ok()) {
       *result_status = s.CloneAndPrepend(Substitute(
-          "Could not read records from container $0", container->ToString()));
+          "Could not checkpoint metadata of container $0", container->ToString()));
       return;
     }
-    {
-      lock_guard<simple_spinlock> l(&lock_);
-      BOOST_FOREACH(const BlockRecordPB& r, records) {
-        ProcessBlockRecordUnlocked(container.get(), r);
-      }
-      AddNewContainerUnlocked(container.get());
-      MakeContainerAvailableUnlocked(container.release());
+    if (metrics()) {
+      metrics()->metadata_checkpoints->Increment();
     }
   }
 
+  // Populate the in-memory block maps with the container's live blocks.
+  {
+    lock_guard<simple_spinlock> l(&lock_);
+    BOOST_FOREACH(const BlockRecordPB& r, live_records) {
+      if (!AddLogBlockUnlocked(container.get(), BlockId::FromPB(r.block_id()),
+                               r.offset(), r.length())) {
+        LOG(FATAL) << "Found already existent block record: " << r.DebugString();
+      }
+    }
+    AddNewContainerUnlocked(container.get());
+    MakeContainerAvailableUnlocked(container.release());
+  }
   *result_status = Status::OK();
-  *result_metadata = metadata.release();
 }
 
-void LogBlockManager::ProcessBlockRecordUnlocked(LogBlockContainer* container,
-                                                 const BlockRecordPB& record) {
-  DCHECK(lock_.is_locked());
-
-  BlockId block_id(BlockId::FromPB(record.block_id()));
-  switch (record.op_type()) {
-    case CREATE: {
-      if (!AddLogBlockUnlocked(container, block_id,
-                               record.offset(), record.length())) {
-        LOG(FATAL) << "Found already existent block record: "
-                   << record.DebugString();
+namespace {
+
+bool BlockRecordOffsetLess(const BlockRecordPB& a, const BlockRecordPB& b) {
+  return a.offset() < b.offset();
+}
+
+} // anonymous namespace
+
+void LogBlockManager::ReplayContainerRecords(LogBlockContainer* container,
+                                             const deque<BlockRecordPB>& records,
+                                             vector<BlockRecordPB>* live_records) {
+  typedef unordered_map<BlockId, const BlockRecordPB*, BlockIdHash, BlockIdEqual> RecordMap;
+  RecordMap live;
+  BOOST_FOREACH(const BlockRecordPB& record, records) {
+    BlockId block_id(BlockId::FromPB(record.block_id()));
+    switch (record.op_type()) {
+      case CREATE: {
+        if (!InsertIfNotPresent(&live, block_id, &record)) {
+          LOG(FATAL) << "Found already existent block record: "
+                     << record.DebugString();
+        }
+
+        VLOG(2) << Substitute("Found CREATE block $0 at offset $1 with length $2",
+                              block_id.ToString(),
+                              record.offset(), record.length());
+
+        // This block must be included in the container's logical size, even if
+        // it has since been deleted. This helps satisfy one of our invariants:
+        // once a container byte range has been used, it may never be reused in
+        // the future.
+        //
+        // If we ignored deleted blocks, we would end up reusing the space
+        // belonging to the last deleted block in the container. A checkpoint
+        // drops deleted blocks' records, so it may allow just that; but then
+        // nothing refers to the reused range anymore either.
+        container->UpdateBytesWrittenToInclude(record.offset(), record.length());
+        break;
       }
-
-      VLOG(2) << Substitute("Found CREATE block $0 at offset $1 with length $2",
-                            block_id.ToString(),
-                            record.offset(), record.length());
-
-      // This block must be included in the container's logical size, even if
-      // it has since been deleted. This helps satisfy one of our invariants:
-      // once a container byte range has been used, it may never be reused in
-      // the future.
-      //
-      // If we ignored deleted blocks, we would end up reusing the space
-      // belonging to the last deleted block in the container.
-      container->UpdateBytesWritten(record.length());
-      break;
-    }
-    case DELETE:
-      if (!RemoveLogBlockUnlocked(block_id)) {
-        LOG(FATAL) << "Found already non-existent block record: "
+      case DELETE:
+        if (live.erase(block_id) == 0) {
+          LOG(FATAL) << "Found already non-existent block record: "
+                     << record.DebugString();
+        }
+        VLOG(2) << Substitute("Found DELETE block $0", block_id.ToString());
+        break;
+      default:
+        LOG(FATAL) << "Found unknown op type in block record: "
                    << record.DebugString();
-      }
-      VLOG(2) << Substitute("Found DELETE block $0", block_id.ToString());
-      break;
-    default:
-      LOG(FATAL) << "Found unknown op type in block record: "
-                 << record.DebugString();
+    }
+  }
+
+  live_records->clear();
+  live_records->reserve(live.size());
+  BOOST_FOREACH(const RecordMap::value_type& e, live) {
+    live_records->push_back(*e.second);
   }
+  std::sort(live_records->begin(), live_records->end(), BlockRecordOffsetLess);
 }
 
 Status LogBlockManager::CheckHolePunch(const string& path) {
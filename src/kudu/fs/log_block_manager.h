@@ -71,9 +71,10 @@ struct LogBlockManagerMetrics;
 // orphaned data can be reclaimed instantaneously via hole punching, or
 // later via garbage collection. The latter is used when hole punching is
 // not supported on the filesystem, or on next boot if there's a crash
-// after deletion but before hole punching. The metadata file itself is not
-// compacted, as it is expected to remain quite small even after a great
-// many create/delete cycles.
+// after deletion but before hole punching. The metadata file isn't
+// compacted while in use. Instead, when a container is loaded and most of
+// its records are obsolete, its metadata file is replaced by a checkpoint
+// holding only the records of its live blocks.
 //
 // Data and metadata operations are carefully ordered to ensure the
 // correctness of the persistent representation at all times. During the
@@ -97,9 +98,10 @@ struct LogBlockManagerMetrics;
 //
 // All log block manager metadata requests are served from memory. When an
 // existing block manager is opened, all on-disk container metadata is
-// parsed to build a single in-memory map describing the existence and
-// locations of various blocks. Each entry in the map consumes ~64 bytes,
-// putting the memory overhead at ~610 MB for 10 million blocks.
+// parsed (by several threads per data directory) to build a single
+// in-memory map describing the existence and locations of various blocks.
+// Each entry in the map consumes ~64 bytes, putting the memory overhead at
+// ~610 MB for 10 million blocks.
 //
 // New blocks are placed on a filesystem block boundary, and the size of
 // hole punch requests is rounded up to the nearest filesystem block size.
@@ -167,6 +169,10 @@ class LogBlockManager : public BlockManager {
 
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) OVERRIDE;
 
+  // Reads of the same container are sorted by offset, and those of nearby
+  // ranges are merged into single reads.
+  virtual Status ReadBatch(std::vector<BlockReadRequest>* requests) OVERRIDE;
+
  private:
   friend class internal::LogBlockContainer;
 
@@ -220,11 +226,14 @@ class LogBlockManager : public BlockManager {
   // Unlocked variant of RemoveLogBlock(); must hold 'lock_'.
   scoped_refptr<internal::LogBlock> RemoveLogBlockUnlocked(const BlockId& block_id);
 
-  // Parse a block record and use it to update in-memory maps.
+  // Replay a container's block records in order, returning the records of
+  // the blocks that are still live, sorted by offset, in 'live_records'.
+  // Also updates the container's logical size to cover all of its blocks.
   //
-  // Must be called with 'lock_' held.
-  void ProcessBlockRecordUnlocked(internal::LogBlockContainer* container,
-                                  const BlockRecordPB& record);
+  // Doesn't touch the in-memory maps, so needn't be called with 'lock_' held.
+  void ReplayContainerRecords(internal::LogBlockContainer* container,
+                              const std::deque<BlockRecordPB>& records,
+                              std::vector<BlockRecordPB>* live_records);
 
   // Open a particular root path belonging to the block manager.
   //
@@ -234,6 +243,16 @@ class LogBlockManager : public BlockManager {
                     Status* result_status,
                     PathInstanceMetadataFile** result_metadata);
 
+  // Open the container 'id' in 'root_path' and add its blocks to the
+  // in-memory maps, checkpointing its metadata first if it's mostly made up
+  // of obsolete records.
+  //
+  // Success or failure is set in 'result_status'.
+  void OpenContainer(PathInstanceMetadataPB* instance,
+                     const std::string& root_path,
+                     const std::string& id,
+                     Status* result_status);
+
   // Test for hole punching support at 'path'.
   Status CheckHolePunch(const std::string& path);
 
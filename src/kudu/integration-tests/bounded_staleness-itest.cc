@@ -0,0 +1,274 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <boost/assign/list_of.hpp>
+#include <boost/foreach.hpp>
+#include <boost/optional.hpp>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "kudu/client/client.h"
+#include "kudu/client/client-test-util.h"
+#include "kudu/common/wire_protocol.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/integration-tests/ts_itest-base.h"
+#include "kudu/util/test_util.h"
+
+namespace kudu {
+namespace tserver {
+
+using boost::assign::list_of;
+using client::KuduClient;
+using client::KuduScanner;
+using itest::StartElection;
+using itest::TServerDetails;
+using itest::WaitForServersToAgree;
+using itest::WriteSimpleTestRow;
+using rpc::RpcController;
+using std::string;
+using std::vector;
+
+static const int kNumRows = 100;
+static const uint32_t kMaxStalenessMs = 2000;
+
+// Tests READ_WITH_BOUNDED_STALENESS scans against the replicas of a tablet,
+// and in particular reads from followers, which rely on the safe time sent
+// along with the leader's consensus requests.
+class BoundedStalenessITest : public TabletServerIntegrationTestBase {
+ public:
+  virtual void SetUp() OVERRIDE {
+    TabletServerIntegrationTestBase::SetUp();
+
+    // Leader election is done by hand so that the tests know which replicas
+    // are the followers, and so that a follower which stops accepting updates
+    // doesn't depose the leader.
+    vector<string> ts_flags = list_of("--enable_leader_failure_detection=false");
+    vector<string> master_flags =
+        list_of("--catalog_manager_wait_for_new_tablets_to_elect_leader=false");
+    NO_FATALS(BuildAndStart(ts_flags, master_flags));
+
+    AppendValuesFromMap(tablet_servers_, &tservers_);
+    ASSERT_EQ(3, tservers_.size());
+    leader_ = tservers_[0];
+    followers_.push_back(tservers_[1]);
+    followers_.push_back(tservers_[2]);
+    ASSERT_OK(StartElection(leader_, tablet_id_, MonoDelta::FromSeconds(10)));
+    ASSERT_OK(WaitForServersToAgree(MonoDelta::FromSeconds(10), tablet_servers_, tablet_id_, 1));
+  }
+
+ protected:
+  // Writes 'kNumRows' rows through the leader and waits for every replica to
+  // have them in its log. The new leader's no-op is at index 1.
+  void WriteRowsAndWait() {
+    for (int i = 0; i < kNumRows; i++) {
+      ASSERT_OK(WriteSimpleTestRow(leader_, tablet_id_, RowOperationsPB::INSERT,
+                                   i, i, "hello", MonoDelta::FromSeconds(10)));
+    }
+    ASSERT_OK(WaitForServersToAgree(MonoDelta::FromSeconds(10), tablet_servers_, tablet_id_,
+                                    kNumRows + 1));
+  }
+
+  // Opens a READ_WITH_BOUNDED_STALENESS scan on 'replica' and, if it
+  // succeeds, drains it into 'results'. If 'snap_timestamp' is set, the scan
+  // resumes at that snapshot. Server errors are left in 'resp'.
+  void ScanAtBoundedStaleness(TServerDetails* replica,
+                              uint32_t max_staleness_ms,
+                              const boost::optional<uint64_t>& snap_timestamp,
+                              ScanResponsePB* resp,
+                              vector<string>* results) {
+    ScanRequestPB req;
+    RpcController rpc;
+    rpc.set_timeout(MonoDelta::FromSeconds(10));
+
+    NewScanRequestPB* scan = req.mutable_new_scan_request();
+    scan->set_tablet_id(tablet_id_);
+    scan->set_read_mode(READ_WITH_BOUNDED_STALENESS);
+    scan->set_max_staleness_ms(max_staleness_ms);
+    if (snap_timestamp) {
+      scan->set_snap_timestamp(*snap_timestamp);
+    }
+    ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+    req.set_batch_size_bytes(0);
+
+    SCOPED_TRACE(req.DebugString());
+    ASSERT_OK(replica->tserver_proxy->Scan(req, resp, &rpc));
+    SCOPED_TRACE(resp->DebugString());
+    results->clear();
+    if (resp->has_error() || !resp->has_more_results()) {
+      return;
+    }
+    NO_FATALS(DrainScannerToStrings(resp->scanner_id(), schema_, results,
+                                    replica->tserver_proxy.get()));
+  }
+
+  // Like ScanAtBoundedStaleness(), but fails the test on any server error.
+  void ScanAtBoundedStalenessOK(TServerDetails* replica,
+                                uint32_t max_staleness_ms,
+                                const boost::optional<uint64_t>& snap_timestamp,
+                                uint64_t* resp_snap_timestamp,
+                                vector<string>* results) {
+    ScanResponsePB resp;
+    NO_FATALS(ScanAtBoundedStaleness(replica, max_staleness_ms, snap_timestamp,
+                                     &resp, results));
+    ASSERT_FALSE(resp.has_error()) << resp.error().ShortDebugString();
+    ASSERT_TRUE(resp.has_snap_timestamp());
+    *resp_snap_timestamp = resp.snap_timestamp();
+  }
+
+  // Asserts that 'replica' rejects a scan as too stale to serve.
+  void AssertReplicaTooStale(TServerDetails* replica,
+                             uint32_t max_staleness_ms,
+                             const boost::optional<uint64_t>& snap_timestamp) {
+    ScanResponsePB resp;
+    vector<string> results;
+    NO_FATALS(ScanAtBoundedStaleness(replica, max_staleness_ms, snap_timestamp,
+                                     &resp, &results));
+    ASSERT_TRUE(resp.has_error()) << replica->ToString() << " served the scan";
+    ASSERT_EQ(TabletServerErrorPB::REPLICA_TOO_STALE, resp.error().code());
+    Status s = StatusFromPB(resp.error().status());
+    ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  }
+
+  Status SetRejectUpdates(TServerDetails* replica, bool reject) {
+    return cluster_->SetFlag(cluster_->tablet_server_by_uuid(replica->uuid()),
+                             "follower_reject_update_consensus_requests",
+                             reject ? "true" : "false");
+  }
+
+  vector<TServerDetails*> tservers_;
+  TServerDetails* leader_;
+  vector<TServerDetails*> followers_;
+};
+
+// Test that followers serve bounded staleness reads without waiting, both
+// when the tablet is idle and right after writes, and that a scan resumed
+// at a snapshot picked elsewhere reads that same snapshot.
+TEST_F(BoundedStalenessITest, TestFollowerReads) {
+  vector<string> results;
+  uint64_t snap_timestamp;
+
+  // With no writes at all, only the safe time sent with the leader's
+  // heartbeats can keep the followers within the staleness bound.
+  SleepFor(MonoDelta::FromMilliseconds(kMaxStalenessMs * 2));
+  BOOST_FOREACH(TServerDetails* follower, followers_) {
+    NO_FATALS(ScanAtBoundedStalenessOK(follower, kMaxStalenessMs, boost::none,
+                                       &snap_timestamp, &results));
+    ASSERT_EQ(0, results.size());
+  }
+
+  // Right after writes, a follower may read at a snapshot which doesn't have
+  // all of them yet, but it never has to bounce the read. Once its safe time
+  // passes the last write, it sees all of them.
+  NO_FATALS(WriteRowsAndWait());
+  BOOST_FOREACH(TServerDetails* follower, followers_) {
+    MonoTime deadline = MonoTime::Now(MonoTime::FINE);
+    deadline.AddDelta(MonoDelta::FromSeconds(10));
+    while (true) {
+      NO_FATALS(ScanAtBoundedStalenessOK(follower, kMaxStalenessMs, boost::none,
+                                         &snap_timestamp, &results));
+      ASSERT_LE(results.size(), kNumRows);
+      if (results.size() == kNumRows) {
+        break;
+      }
+      ASSERT_TRUE(MonoTime::Now(MonoTime::FINE).ComesBefore(deadline))
+          << "Follower " << follower->ToString() << " only saw "
+          << results.size() << " rows";
+      SleepFor(MonoDelta::FromMilliseconds(10));
+    }
+  }
+
+  // Resuming at the last snapshot reads exactly it on every replica, even
+  // once it's further in the past than the staleness bound.
+  SleepFor(MonoDelta::FromMilliseconds(kMaxStalenessMs * 2));
+  BOOST_FOREACH(TServerDetails* ts, tservers_) {
+    uint64_t resumed_snap_timestamp;
+    NO_FATALS(ScanAtBoundedStalenessOK(ts, kMaxStalenessMs, snap_timestamp,
+                                       &resumed_snap_timestamp, &results));
+    ASSERT_EQ(snap_timestamp, resumed_snap_timestamp);
+    ASSERT_EQ(kNumRows, results.size());
+  }
+}
+
+// Test that followers whose safe time falls behind the staleness bound reject
+// reads, that the leader waits instead, and that the client retries such
+// reads elsewhere.
+TEST_F(BoundedStalenessITest, TestStaleFollowers) {
+  vector<string> results;
+  uint64_t snap_timestamp;
+
+  NO_FATALS(WriteRowsAndWait());
+
+  // Cut the followers off from the leader, so that their safe time stops
+  // advancing, and let it fall behind the bound.
+  BOOST_FOREACH(TServerDetails* follower, followers_) {
+    ASSERT_OK(SetRejectUpdates(follower, true));
+  }
+  SleepFor(MonoDelta::FromMilliseconds(kMaxStalenessMs * 2));
+  BOOST_FOREACH(TServerDetails* follower, followers_) {
+    NO_FATALS(AssertReplicaTooStale(follower, kMaxStalenessMs, boost::none));
+  }
+
+  // The idle leader's clean time is behind the bound too, but it waits for
+  // the bound to be clean rather than rejecting the read.
+  NO_FATALS(ScanAtBoundedStalenessOK(leader_, kMaxStalenessMs, boost::none,
+                                     &snap_timestamp, &results));
+  ASSERT_EQ(kNumRows, results.size());
+
+  // A scan resumed at the leader's snapshot can't be served by the followers
+  // either, since their safe time hasn't reached it.
+  BOOST_FOREACH(TServerDetails* follower, followers_) {
+    NO_FATALS(AssertReplicaTooStale(follower, kMaxStalenessMs, snap_timestamp));
+  }
+
+  // The client blacklists the stale followers and retries at the leader. It
+  // picks a random replica for each scan, so a few scans are bound to start
+  // at a follower.
+  for (int i = 0; i < 10; i++) {
+    KuduScanner scanner(table_.get());
+    ASSERT_OK(scanner.SetSelection(KuduClient::CLOSEST_REPLICA));
+    ASSERT_OK(scanner.SetReadMode(KuduScanner::READ_WITH_BOUNDED_STALENESS));
+    ASSERT_OK(scanner.SetMaxStalenessMillis(kMaxStalenessMs));
+    ASSERT_OK(scanner.SetFaultTolerant());
+    results.clear();
+    NO_FATALS(client::ScanToStrings(&scanner, &results));
+    ASSERT_EQ(kNumRows, results.size());
+  }
+
+  // Once the followers hear from the leader again, they serve reads again.
+  BOOST_FOREACH(TServerDetails* follower, followers_) {
+    ASSERT_OK(SetRejectUpdates(follower, false));
+  }
+  BOOST_FOREACH(TServerDetails* follower, followers_) {
+    MonoTime deadline = MonoTime::Now(MonoTime::FINE);
+    deadline.AddDelta(MonoDelta::FromSeconds(10));
+    while (true) {
+      ScanResponsePB resp;
+      NO_FATALS(ScanAtBoundedStaleness(follower, kMaxStalenessMs, boost::none,
+                                       &resp, &results));
+      if (!resp.has_error()) {
+        ASSERT_EQ(kNumRows, results.size());
+        break;
+      }
+      ASSERT_EQ(TabletServerErrorPB::REPLICA_TOO_STALE, resp.error().code());
+      ASSERT_TRUE(MonoTime::Now(MonoTime::FINE).ComesBefore(deadline))
+          << "Follower " << follower->ToString() << " is still too stale";
+      SleepFor(MonoDelta::FromMilliseconds(10));
+    }
+  }
+}
+
+}  // namespace tserver
+}  // namespace kudu
@@ -83,6 +83,8 @@ Status Master::Init() {
   CHECK_EQ(kStopped, state_);
 
   cfile::BlockCache::GetSingleton()->StartInstrumentation(metric_entity());
+  cfile::BlockCache::GetSingleton(cfile::BlockCache::HIGH_PRIORITY)->StartInstrumentation(
+      metric_entity());
 
   RETURN_NOT_OK(ThreadPoolBuilder("init").set_max_threads(1).Build(&init_pool_));
 
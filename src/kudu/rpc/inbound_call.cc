@@ -57,7 +57,11 @@ InboundCall::~InboundCall() {}
 Status InboundCall::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
   TRACE_EVENT_FLOW_BEGIN0("rpc", "InboundCall", this);
   TRACE_EVENT0("rpc", "InboundCall::ParseFrom");
-  RETURN_NOT_OK(serialization::ParseMessage(transfer->data(), &header_, &serialized_request_));
+  Slice main_message;
+  RETURN_NOT_OK(serialization::ParseMessage(transfer->data(), &header_, &main_message));
+  RETURN_NOT_OK(serialization::ParseSidecars(main_message, header_.sidecar_offsets(),
+                                             OutboundTransfer::kMaxPayloadSlices,
+                                             &serialized_request_, inbound_sidecar_slices_));
 
   // Adopt the service/method info from the header as soon as it's available.
   if (PREDICT_FALSE(!header_.has_remote_method())) {
@@ -174,6 +178,15 @@ Status InboundCall::AddRpcSidecar(gscoped_ptr<RpcSidecar> car, int* idx) {
   return Status::OK();
 }
 
+Status InboundCall::GetInboundSidecar(int idx, Slice* sidecar) const {
+  if (idx < 0 || idx >= header_.sidecar_offsets_size()) {
+    return Status::InvalidArgument(Substitute(
+        "Index $0 does not reference a valid sidecar", idx));
+  }
+  *sidecar = inbound_sidecar_slices_[idx];
+  return Status::OK();
+}
+
 string InboundCall::ToString() const {
   return Substitute("Call $0 from $1 (request call id $2)",
                       remote_method_.ToString(),
@@ -117,6 +117,9 @@ class InboundCall {
   // See RpcContext::AddRpcSidecar()
   Status AddRpcSidecar(gscoped_ptr<RpcSidecar> car, int* idx);
 
+  // See RpcContext::GetInboundSidecar()
+  Status GetInboundSidecar(int idx, Slice* sidecar) const;
+
   std::string ToString() const;
 
   void DumpPB(const DumpRunningRpcsRequestPB& req, RpcCallInProgressPB* resp);
@@ -183,6 +186,10 @@ class InboundCall {
   // This references memory held by 'transfer_'.
   Slice serialized_request_;
 
+  // Slices of data for the sidecars sent along with the request. Set by
+  // ParseFrom(). These reference memory held by 'transfer_'.
+  Slice inbound_sidecar_slices_[OutboundTransfer::kMaxPayloadSlices];
+
   // The transfer that produced the call.
   // This is kept around because it retains the memory referred to
   // by 'serialized_request_' above.
@@ -15,6 +15,7 @@
 #include <algorithm>
 #include <string>
 #include <vector>
+#include <boost/foreach.hpp>
 #include <boost/functional/hash.hpp>
 #include <gflags/gflags.h>
 
@@ -24,6 +25,7 @@
 #include "kudu/rpc/constants.h"
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
+#include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/rpc/serialization.h"
 #include "kudu/rpc/transfer.h"
 #include "kudu/util/flag_tags.h"
@@ -62,7 +64,8 @@ OutboundCall::OutboundCall(const ConnectionId& conn_id,
     conn_id_(conn_id),
     callback_(callback),
     controller_(DCHECK_NOTNULL(controller)),
-    response_(DCHECK_NOTNULL(response_storage)) {
+    response_(DCHECK_NOTNULL(response_storage)),
+    sidecars_deleter_(&sidecars_) {
   DVLOG(4) << "OutboundCall " << this << " constructed with state_: " << StateName(state_)
            << " and RPC timeout: "
            << (controller->timeout().Initialized() ? controller->timeout().ToString() : "none");
@@ -81,6 +84,9 @@ Status OutboundCall::SerializeTo(vector<Slice>* slices) {
   if (PREDICT_FALSE(param_len == 0)) {
     return Status::InvalidArgument("Must call SetRequestParam() before SerializeTo()");
   }
+  BOOST_FOREACH(RpcSidecar* car, sidecars_) {
+    param_len += car->AsSlice().size();
+  }
 
   const MonoDelta &timeout = controller_->timeout();
   if (timeout.Initialized()) {
@@ -92,11 +98,25 @@ Status OutboundCall::SerializeTo(vector<Slice>* slices) {
   // Return the concatenated packet.
   slices->push_back(Slice(header_buf_));
   slices->push_back(Slice(request_buf_));
+  BOOST_FOREACH(RpcSidecar* car, sidecars_) {
+    slices->push_back(car->AsSlice());
+  }
   return Status::OK();
 }
 
 Status OutboundCall::SetRequestParam(const Message& message) {
-  return serialization::SerializeMessage(message, &request_buf_);
+  // Take over the sidecars added to the controller, since they must outlive
+  // the transfer of the call, which may outlive the controller's use.
+  sidecars_.swap(controller_->outbound_sidecars_);
+
+  uint32_t protobuf_msg_size = message.ByteSize();
+  uint32_t absolute_sidecar_offset = protobuf_msg_size;
+  BOOST_FOREACH(RpcSidecar* car, sidecars_) {
+    header_.add_sidecar_offsets(absolute_sidecar_offset);
+    absolute_sidecar_offset += car->AsSlice().size();
+  }
+  int additional_size = absolute_sidecar_offset - protobuf_msg_size;
+  return serialization::SerializeMessage(message, &request_buf_, additional_size, true);
 }
 
 Status OutboundCall::status() const {
@@ -442,40 +462,9 @@ Status CallResponse::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
                                             &entire_message));
 
   // Use information from header to extract the payload slices.
-  int last = header_.sidecar_offsets_size() - 1;
-
-  if (last >= OutboundTransfer::kMaxPayloadSlices) {
-    return Status::Corruption(strings::Substitute(
-        "Received $0 additional payload slices, expected at most %d",
-        last, OutboundTransfer::kMaxPayloadSlices));
-  }
-
-  if (last >= 0) {
-    serialized_response_ = Slice(entire_message.data(),
-                                 header_.sidecar_offsets(0));
-    for (int i = 0; i < last; ++i) {
-      uint32_t next_offset = header_.sidecar_offsets(i);
-      int32_t len = header_.sidecar_offsets(i + 1) - next_offset;
-      if (next_offset + len > entire_message.size() || len < 0) {
-        return Status::Corruption(strings::Substitute(
-            "Invalid sidecar offsets; sidecar $0 apparently starts at $1,"
-            " has length $2, but the entire message has length $3",
-            i, next_offset, len, entire_message.size()));
-      }
-      sidecar_slices_[i] = Slice(entire_message.data() + next_offset, len);
-    }
-    uint32_t next_offset = header_.sidecar_offsets(last);
-    if (next_offset > entire_message.size()) {
-        return Status::Corruption(strings::Substitute(
-            "Invalid sidecar offsets; the last sidecar ($0) apparently starts "
-            "at $1, but the entire message has length $3",
-            last, next_offset, entire_message.size()));
-    }
-    sidecar_slices_[last] = Slice(entire_message.data() + next_offset,
-                                  entire_message.size() - next_offset);
-  } else {
-    serialized_response_ = entire_message;
-  }
+  RETURN_NOT_OK(serialization::ParseSidecars(entire_message, header_.sidecar_offsets(),
+                                             OutboundTransfer::kMaxPayloadSlices,
+                                             &serialized_response_, sidecar_slices_));
 
   transfer_.swap(transfer);
   parsed_ = true;
@@ -22,6 +22,7 @@
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/remote_method.h"
@@ -48,6 +49,7 @@ class DumpRunningRpcsRequestPB;
 class InboundTransfer;
 class RpcCallInProgressPB;
 class RpcController;
+class RpcSidecar;
 
 // Client-side user credentials, such as a user's username & password.
 // In the future, we will add Kerberos credentials.
@@ -294,6 +296,11 @@ class OutboundCall {
   faststring header_buf_;
   faststring request_buf_;
 
+  // Sidecars which are sent along with the request, taken over from the
+  // controller by SetRequestParam().
+  std::vector<RpcSidecar*> sidecars_;
+  ElementDeleter sidecars_deleter_;
+
   // Once a response has been received for this call, contains that response.
   // Otherwise NULL.
   gscoped_ptr<CallResponse> call_response_;
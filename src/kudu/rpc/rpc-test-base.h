@@ -15,6 +15,7 @@
 #define KUDU_RPC_RPC_TEST_BASE_H
 
 #include <algorithm>
+#include <boost/foreach.hpp>
 #include <list>
 #include <string>
 
@@ -69,6 +70,7 @@ class GenericCalculatorService : public ServiceIf {
   static const char *kAddMethodName;
   static const char *kSleepMethodName;
   static const char *kSendTwoStringsMethodName;
+  static const char *kEchoSidecarsMethodName;
 
   static const char* kFirstString;
   static const char* kSecondString;
@@ -88,6 +90,8 @@ class GenericCalculatorService : public ServiceIf {
       DoSleep(incoming);
     } else if (incoming->remote_method().method_name() == kSendTwoStringsMethodName) {
       DoSendTwoStrings(incoming);
+    } else if (incoming->remote_method().method_name() == kEchoSidecarsMethodName) {
+      DoEchoSidecars(incoming);
     } else {
       incoming->RespondFailure(ErrorStatusPB::ERROR_NO_SUCH_METHOD,
                                Status::InvalidArgument("bad method"));
@@ -139,6 +143,26 @@ class GenericCalculatorService : public ServiceIf {
     incoming->RespondSuccess(resp);
   }
 
+  void DoEchoSidecars(InboundCall* incoming) {
+    Slice param(incoming->serialized_request());
+    EchoSidecarsRequestPB req;
+    if (!req.ParseFromArray(param.data(), param.size())) {
+      LOG(FATAL) << "couldn't parse: " << param.ToDebugString();
+    }
+
+    EchoSidecarsResponsePB resp;
+    BOOST_FOREACH(uint32_t req_idx, req.sidecars()) {
+      Slice data;
+      CHECK_OK(incoming->GetInboundSidecar(req_idx, &data));
+      gscoped_ptr<faststring> copy(new faststring);
+      copy->append(data.data(), data.size());
+      int idx;
+      CHECK_OK(incoming->AddRpcSidecar(make_gscoped_ptr(new RpcSidecar(copy.Pass())), &idx));
+      resp.add_sidecars(idx);
+    }
+    incoming->RespondSuccess(resp);
+  }
+
   void DoSleep(InboundCall *incoming) {
     Slice param(incoming->serialized_request());
     SleepRequestPB req;
@@ -249,6 +273,7 @@ const char *GenericCalculatorService::kFullServiceName = "kudu.rpc.GenericCalcul
 const char *GenericCalculatorService::kAddMethodName = "Add";
 const char *GenericCalculatorService::kSleepMethodName = "Sleep";
 const char *GenericCalculatorService::kSendTwoStringsMethodName = "SendTwoStrings";
+const char *GenericCalculatorService::kEchoSidecarsMethodName = "EchoSidecars";
 
 const char *GenericCalculatorService::kFirstString =
     "1111111111111111111111111111111111111111111111111111111111";
@@ -385,6 +410,39 @@ class RpcTestBase : public KuduTest {
 
  private:
 
+  // Sends sidecars of the given sizes along with a request, and checks that
+  // the server received them by having it echo them back.
+  void DoTestRequestSidecars(const Proxy &p, int size1, int size2) {
+    Random rng(12345);
+    gscoped_ptr<faststring> first(new faststring);
+    first->resize(size1);
+    RandomString(first->data(), size1, &rng);
+    gscoped_ptr<faststring> second(new faststring);
+    second->resize(size2);
+    RandomString(second->data(), size2, &rng);
+    faststring expected1, expected2;
+    expected1.append(first->data(), first->size());
+    expected2.append(second->data(), second->size());
+
+    EchoSidecarsRequestPB req;
+    RpcController controller;
+    controller.set_timeout(MonoDelta::FromMilliseconds(10000));
+    int idx;
+    CHECK_OK(controller.AddOutboundSidecar(make_gscoped_ptr(new RpcSidecar(first.Pass())), &idx));
+    req.add_sidecars(idx);
+    CHECK_OK(controller.AddOutboundSidecar(make_gscoped_ptr(new RpcSidecar(second.Pass())), &idx));
+    req.add_sidecars(idx);
+
+    EchoSidecarsResponsePB resp;
+    CHECK_OK(p.SyncRequest(GenericCalculatorService::kEchoSidecarsMethodName,
+                           req, &resp, &controller));
+    CHECK_EQ(2, resp.sidecars_size());
+    CHECK_EQ(0, GetSidecarPointer(controller, resp.sidecars(0), size1).compare(
+        Slice(expected1)));
+    CHECK_EQ(0, GetSidecarPointer(controller, resp.sidecars(1), size2).compare(
+        Slice(expected2)));
+  }
+
   static Slice GetSidecarPointer(const RpcController& controller, int idx,
                                  int expected_size) {
     Slice sidecar;
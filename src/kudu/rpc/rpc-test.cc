@@ -277,6 +277,20 @@ TEST_F(TestRpc, TestRpcSidecar) {
   DoTestSidecar(p, 3000 * 1024, 2000 * 1024);
 }
 
+// Test that sidecars added to requests reach the server.
+TEST_F(TestRpc, TestRequestSidecar) {
+  // Set up server.
+  Sockaddr server_addr;
+  StartTestServer(&server_addr);
+
+  // Set up client.
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client"));
+  Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+
+  DoTestRequestSidecars(p, 123, 456);
+  DoTestRequestSidecars(p, 3000 * 1024, 2000 * 1024);
+}
+
 // Test that timeouts are properly handled.
 TEST_F(TestRpc, TestCallTimeout) {
   Sockaddr server_addr;
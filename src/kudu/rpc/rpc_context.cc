@@ -86,6 +86,10 @@ Status RpcContext::AddRpcSidecar(gscoped_ptr<RpcSidecar> car, int* idx) {
   return call_->AddRpcSidecar(car.Pass(), idx);
 }
 
+Status RpcContext::GetInboundSidecar(int idx, Slice* sidecar) const {
+  return call_->GetInboundSidecar(idx, sidecar);
+}
+
 const UserCredentials& RpcContext::user_credentials() const {
   return call_->user_credentials();
 }
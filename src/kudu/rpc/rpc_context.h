@@ -30,6 +30,7 @@ class MessageLite;
 
 namespace kudu {
 
+class Slice;
 class Sockaddr;
 class Trace;
 
@@ -147,6 +148,13 @@ class RpcContext {
   // by the RPC response.
   Status AddRpcSidecar(gscoped_ptr<RpcSidecar> car, int* idx);
 
+  // Fills 'sidecar' with the data of the sidecar which the client added to
+  // the request (see RpcController::AddOutboundSidecar()) at index 'idx'.
+  // The data is only valid until the call is responded to.
+  //
+  // May fail if the index is invalid.
+  Status GetInboundSidecar(int idx, Slice* sidecar) const;
+
   // Return the credentials of the remote user who made this call.
   const UserCredentials& user_credentials() const;
 
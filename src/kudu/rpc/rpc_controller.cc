@@ -16,10 +16,12 @@
 
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/rpc/outbound_call.h"
+#include "kudu/rpc/rpc_sidecar.h"
 
 namespace kudu { namespace rpc {
 
-RpcController::RpcController() {
+RpcController::RpcController()
+  : outbound_sidecars_deleter_(&outbound_sidecars_) {
   DVLOG(4) << "RpcController " << this << " constructed";
 }
 
@@ -33,6 +35,7 @@ void RpcController::Reset() {
     CHECK(finished());
   }
   call_.reset();
+  STLDeleteElements(&outbound_sidecars_);
 }
 
 bool RpcController::finished() const {
@@ -60,6 +63,18 @@ Status RpcController::GetSidecar(int idx, Slice* sidecar) const {
   return call_->call_response_->GetSidecar(idx, sidecar);
 }
 
+Status RpcController::AddOutboundSidecar(gscoped_ptr<RpcSidecar> car, int* idx) {
+  DCHECK(!call_) << "Sidecars must be added before the request is sent";
+  // Two of the payload slices are used up by the header and the main
+  // message protobufs.
+  if (outbound_sidecars_.size() + 2 >= OutboundTransfer::kMaxPayloadSlices) {
+    return Status::ServiceUnavailable("All available sidecars already used");
+  }
+  outbound_sidecars_.push_back(car.release());
+  *idx = outbound_sidecars_.size() - 1;
+  return Status::OK();
+}
+
 void RpcController::set_timeout(const MonoDelta& timeout) {
   lock_guard<simple_spinlock> l(&lock_);
   DCHECK(!call_ || call_->state() == OutboundCall::READY);
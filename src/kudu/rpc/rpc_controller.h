@@ -16,8 +16,11 @@
 
 #include <glog/logging.h>
 #include <tr1/memory>
+#include <vector>
 
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
@@ -28,6 +31,7 @@ namespace rpc {
 
 class ErrorStatusPB;
 class OutboundCall;
+class RpcSidecar;
 
 // Controller for managing properties of a single RPC call, on the client side.
 //
@@ -107,6 +111,17 @@ class RpcController {
   // May fail if index is invalid.
   Status GetSidecar(int idx, Slice* sidecar) const;
 
+  // Adds a sidecar to the request, to be retrieved by the server through
+  // RpcContext::GetInboundSidecar(). Like RpcContext::AddRpcSidecar(), this
+  // avoids the copies made by serializing large fields of the protobuf.
+  //
+  // Must be called before each request is sent, since Reset() discards the
+  // sidecars. Writes the index of the
+  // sidecar, which must be communicated to the server some other way (e.g.
+  // in the request protobuf), to 'idx'. May fail if all the sidecars have
+  // already been used.
+  Status AddOutboundSidecar(gscoped_ptr<RpcSidecar> car, int* idx);
+
  private:
   friend class OutboundCall;
   friend class Proxy;
@@ -118,6 +133,11 @@ class RpcController {
   // Once the call is sent, it is tracked here.
   std::tr1::shared_ptr<OutboundCall> call_;
 
+  // Sidecars added to the request before it is sent. The call takes them
+  // over when it's created.
+  std::vector<RpcSidecar*> outbound_sidecars_;
+  ElementDeleter outbound_sidecars_deleter_;
+
   DISALLOW_COPY_AND_ASSIGN(RpcController);
 };
 
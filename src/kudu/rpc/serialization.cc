@@ -20,6 +20,7 @@
 
 #include "kudu/gutil/endian.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/slice.h"
@@ -157,6 +158,54 @@ Status ParseMessage(const Slice& buf,
   return Status::OK();
 }
 
+Status ParseSidecars(const Slice& main_message,
+                     const google::protobuf::RepeatedField<uint32_t>& sidecar_offsets,
+                     int max_sidecars,
+                     Slice* parsed_message,
+                     Slice* sidecars) {
+  int last = sidecar_offsets.size() - 1;
+
+  if (last >= max_sidecars) {
+    return Status::Corruption(strings::Substitute(
+        "Received $0 additional payload slices, expected at most $1",
+        last + 1, max_sidecars));
+  }
+
+  if (last < 0) {
+    *parsed_message = main_message;
+    return Status::OK();
+  }
+
+  if (sidecar_offsets.Get(0) > main_message.size()) {
+    return Status::Corruption(strings::Substitute(
+        "Invalid sidecar offsets; the first sidecar apparently starts at $0, "
+        "but the entire message has length $1",
+        sidecar_offsets.Get(0), main_message.size()));
+  }
+  *parsed_message = Slice(main_message.data(), sidecar_offsets.Get(0));
+  for (int i = 0; i < last; ++i) {
+    uint32_t next_offset = sidecar_offsets.Get(i);
+    int32_t len = sidecar_offsets.Get(i + 1) - next_offset;
+    if (next_offset + len > main_message.size() || len < 0) {
+      return Status::Corruption(strings::Substitute(
+          "Invalid sidecar offsets; sidecar $0 apparently starts at $1,"
+          " has length $2, but the entire message has length $3",
+          i, next_offset, len, main_message.size()));
+    }
+    sidecars[i] = Slice(main_message.data() + next_offset, len);
+  }
+  uint32_t next_offset = sidecar_offsets.Get(last);
+  if (next_offset > main_message.size()) {
+    return Status::Corruption(strings::Substitute(
+        "Invalid sidecar offsets; the last sidecar ($0) apparently starts "
+        "at $1, but the entire message has length $2",
+        last, next_offset, main_message.size()));
+  }
+  sidecars[last] = Slice(main_message.data() + next_offset,
+                         main_message.size() - next_offset);
+  return Status::OK();
+}
+
 void SerializeConnHeader(uint8_t* buf) {
   memcpy(reinterpret_cast<char *>(buf), kMagicNumber, kMagicNumberLength);
   buf += kMagicNumberLength;
@@ -15,6 +15,7 @@
 #ifndef KUDU_RPC_SERIALIZATION_H
 #define KUDU_RPC_SERIALIZATION_H
 
+#include <google/protobuf/repeated_field.h>
 #include <inttypes.h>
 #include <string.h>
 
@@ -71,6 +72,20 @@ Status ParseMessage(const Slice& buf,
                     google::protobuf::MessageLite* parsed_header,
                     Slice* parsed_main_message);
 
+// Split the main message of a call or response which was sent with
+// sidecars into the payload slices.
+// In: main_message Slice, as returned by ParseMessage(),
+//     the sidecar offsets from the call or response header,
+//     the maximum number of sidecars to accept.
+// Out: parsed_message pointing to the serialized protobuf,
+//      sidecars pointing to each sidecar, in an array with room for
+//      'max_sidecars' slices.
+Status ParseSidecars(const Slice& main_message,
+                     const google::protobuf::RepeatedField<uint32_t>& sidecar_offsets,
+                     int max_sidecars,
+                     Slice* parsed_message,
+                     Slice* sidecars);
+
 // Serialize the RPC connection header (magic number + flags).
 // buf must have 7 bytes available (kMagicNumberLength + kHeaderFlagsLength).
 void SerializeConnHeader(uint8_t* buf);
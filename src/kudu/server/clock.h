@@ -51,6 +51,10 @@ class Clock : public RefCountedThreadSafe<Clock> {
   // plus the max_error.
   virtual Timestamp NowLatest() = 0;
 
+  // Obtains a timestamp corresponding to the current instant minus the
+  // max_error, i.e. one which the true time is known to be past.
+  virtual Timestamp NowEarliest() = 0;
+
   // Obtain a timestamp which is guaranteed to be later than the current time
   // on any machine in the cluster.
   //
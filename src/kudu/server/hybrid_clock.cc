@@ -188,6 +188,21 @@ Timestamp HybridClock::NowLatest() {
   return TimestampFromMicrosecondsAndLogicalValue(now_latest, now_logical);
 }
 
+Timestamp HybridClock::NowEarliest() {
+  Timestamp now;
+  uint64_t error;
+
+  {
+    boost::lock_guard<simple_spinlock> lock(lock_);
+    NowWithError(&now, &error);
+  }
+
+  uint64_t now_earliest = GetPhysicalValueMicros(now) - error;
+  uint64_t now_logical = GetLogicalValue(now);
+
+  return TimestampFromMicrosecondsAndLogicalValue(now_earliest, now_logical);
+}
+
 Status HybridClock::GetGlobalLatest(Timestamp* t) {
   Timestamp now = Now();
   uint64_t now_latest = GetPhysicalValueMicros(now) + FLAGS_max_clock_sync_error_usec;
@@ -45,6 +45,10 @@ class HybridClock : public Clock {
   // time.
   virtual Timestamp NowLatest() OVERRIDE;
 
+  // Obtains the timestamp corresponding to earliest possible current
+  // time.
+  virtual Timestamp NowEarliest() OVERRIDE;
+
   // Obtain a timestamp which is guaranteed to be later than the current time
   // on any machine in the cluster.
   //
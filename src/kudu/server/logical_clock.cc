@@ -41,6 +41,10 @@ Timestamp LogicalClock::NowLatest() {
   return Now();
 }
 
+Timestamp LogicalClock::NowEarliest() {
+  return Now();
+}
+
 Status LogicalClock::Update(const Timestamp& to_update) {
   DCHECK_NE(to_update.value(), Timestamp::kInvalidTimestamp.value())
       << "Updating the clock with an invalid timestamp";
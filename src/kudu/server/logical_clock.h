@@ -47,6 +47,9 @@ class LogicalClock : public Clock {
   // In the logical clock this call is equivalent to Now();
   virtual Timestamp NowLatest() OVERRIDE;
 
+  // In the logical clock this call is equivalent to Now();
+  virtual Timestamp NowEarliest() OVERRIDE;
+
   virtual Status Update(const Timestamp& to_update) OVERRIDE;
 
   // The Wait*() functions are not available for this clock.
@@ -12,17 +12,20 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <boost/foreach.hpp>
 #include <gtest/gtest.h>
 #include <glog/logging.h>
 #include <tr1/memory>
 
 #include "kudu/common/generic_iterators.h"
+#include "kudu/common/predicate_encoder.h"
 #include "kudu/tablet/cfile_set.h"
 #include "kudu/tablet/diskrowset-test-base.h"
 #include "kudu/tablet/tablet-test-base.h"
 #include "kudu/util/test_util.h"
 
 DECLARE_int32(cfile_default_block_size);
+DECLARE_bool(materializing_iterator_late_materialization);
 
 namespace kudu {
 namespace tablet {
@@ -282,6 +285,58 @@ TEST_F(TestCFileSet, TestRangeScan) {
   EXPECT_EQ(stats[2].data_blocks_read_from_disk, 1);
 }
 
+// Tests that only point lookups read the blocks of every column together,
+// and that the last batch of other scans still skips the blocks of columns
+// whose rows were all eliminated by predicates on other columns.
+TEST_F(TestCFileSet, TestLastBatchLateMaterialization) {
+  const int kNumRows = 10000;
+  WriteTestRowSet(kNumRows);
+
+  shared_ptr<CFileSet> fileset(new CFileSet(rowset_meta_));
+  ASSERT_OK(fileset->Open());
+  Schema key_schema = schema_.CreateKeyProjection();
+
+  // No row has c1 in this range, though it lies within the column's values.
+  uint32_t c1_lower = 10001;
+  uint32_t c1_upper = 10009;
+  ColumnRangePredicate c1_pred(schema_.column(1), &c1_lower, &c1_upper);
+
+  for (int i = 0; i < 2; i++) {
+    bool point_lookup = i == 1;
+    SCOPED_TRACE(point_lookup);
+    shared_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_));
+    gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+    Arena arena(1024, 256 * 1024);
+    RangePredicateEncoder encoder(&key_schema, &arena);
+
+    // The rows of the range fit in a single batch.
+    ScanSpec spec;
+    uint32_t lower = 2000;
+    uint32_t upper = point_lookup ? 2000 : 2008;
+    ColumnRangePredicate key_pred(schema_.column(0), &lower, &upper);
+    spec.AddPredicate(key_pred);
+    spec.AddPredicate(c1_pred);
+    encoder.EncodeRangePredicates(&spec, true);
+    ASSERT_OK(iter->Init(&spec));
+    ASSERT_EQ(point_lookup, cfile_iter->point_lookup_);
+
+    vector<string> results;
+    ASSERT_OK(IterateToStringList(iter.get(), &results));
+    ASSERT_EQ(0, results.size());
+
+    vector<IteratorStats> stats;
+    iter->GetIteratorStats(&stats);
+    EXPECT_EQ(1, stats[1].data_blocks_read_from_disk);
+    if (point_lookup) {
+      EXPECT_EQ(1, stats[0].data_blocks_read_from_disk);
+      EXPECT_EQ(1, stats[2].data_blocks_read_from_disk);
+    } else {
+      EXPECT_EQ(0, stats[0].data_blocks_read_from_disk);
+      EXPECT_EQ(0, stats[2].data_blocks_read_from_disk);
+    }
+  }
+}
+
 // Several other black-box tests for range scans. These are similar to
 // TestRangeScan above, except don't inspect internal state.
 TEST_F(TestCFileSet, TestRangePredicates2) {
@@ -309,6 +364,146 @@ TEST_F(TestCFileSet, TestRangePredicates2) {
   DoTestRangeScan(fileset, kNumRows * 10, kNoBound);
 }
 
+// Test that a predicate on a non-key column uses the zone maps to skip
+// data blocks which cannot contain matching rows.
+TEST_F(TestCFileSet, TestZoneMapPruning) {
+  const int kNumRows = 10000;
+  WriteTestRowSet(kNumRows);
+
+  shared_ptr<CFileSet> fileset(new CFileSet(rowset_meta_));
+  ASSERT_OK(fileset->Open());
+
+  shared_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_));
+  cfile_iter->EnableZoneMapPruning(std::set<int>());
+  gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+
+  // c1 contains the row index * 10, so this selects rows 5000 through 5009.
+  ScanSpec spec;
+  uint32_t lower = 50000;
+  uint32_t upper = 50090;
+  ColumnRangePredicate pred(schema_.column(1), &lower, &upper);
+  spec.AddPredicate(pred);
+  ASSERT_OK(iter->Init(&spec));
+
+  vector<string> results;
+  ASSERT_OK(IterateToStringList(iter.get(), &results));
+  ASSERT_EQ(10, results.size());
+  EXPECT_EQ("(uint32 c0=10000, uint32 c1=50000, uint32 c2=500000)", results[0]);
+  EXPECT_EQ("(uint32 c0=10018, uint32 c1=50090, uint32 c2=500900)", results[9]);
+
+  // Nearly all of the rows should have been skipped without being read.
+  EXPECT_GT(cfile_iter->rows_pruned(), kNumRows * 9 / 10);
+
+  // A predicate which is outside the range of the column skips the whole rowset.
+  shared_ptr<CFileSet::Iterator> cfile_iter2(fileset->NewIterator(&schema_));
+  cfile_iter2->EnableZoneMapPruning(std::set<int>());
+  gscoped_ptr<RowwiseIterator> iter2(new MaterializingIterator(cfile_iter2));
+  ScanSpec spec2;
+  uint32_t lower2 = kNumRows * 10;
+  ColumnRangePredicate pred2(schema_.column(1), &lower2, NULL);
+  spec2.AddPredicate(pred2);
+  ASSERT_OK(iter2->Init(&spec2));
+  ASSERT_FALSE(iter2->HasNext());
+  EXPECT_EQ(kNumRows, cfile_iter2->rows_pruned());
+}
+
+// Test that an IN-list on the key column seeks directly to the listed keys.
+TEST_F(TestCFileSet, TestKeyInListSeeks) {
+  const int kNumRows = 10000;
+  WriteTestRowSet(kNumRows);
+
+  shared_ptr<CFileSet> fileset(new CFileSet(rowset_meta_));
+  ASSERT_OK(fileset->Open());
+
+  shared_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_));
+  gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+
+  // c0 contains the row index * 2, so 7 is not present.
+  ScanSpec spec;
+  uint32_t vals[] = { 10000, 20, 7, 19998 };
+  vector<const void*> in_list;
+  for (int i = 0; i < arraysize(vals); i++) {
+    in_list.push_back(&vals[i]);
+  }
+  spec.AddPredicate(ColumnRangePredicate::InList(schema_.column(0), in_list));
+
+  Arena arena(1024, 1024 * 1024);
+  Schema key_schema = schema_.CreateKeyProjection();
+  RangePredicateEncoder enc(&key_schema, &arena);
+  enc.EncodeRangePredicates(&spec, true);
+  ASSERT_EQ(4, spec.key_ranges().size());
+  ASSERT_OK(iter->Init(&spec));
+
+  vector<string> results;
+  ASSERT_OK(IterateToStringList(iter.get(), &results));
+  ASSERT_EQ(3, results.size());
+  EXPECT_EQ("(uint32 c0=20, uint32 c1=100, uint32 c2=1000)", results[0]);
+  EXPECT_EQ("(uint32 c0=10000, uint32 c1=50000, uint32 c2=500000)", results[1]);
+  EXPECT_EQ("(uint32 c0=19998, uint32 c1=99990, uint32 c2=999900)", results[2]);
+
+  // All of the rows between the listed keys should have been skipped.
+  EXPECT_GT(cfile_iter->rows_pruned(), kNumRows - 10);
+}
+
+// Test that with a selective predicate on one column, the other columns only
+// decode the rows which passed the predicate.
+TEST_F(TestCFileSet, TestLateMaterialization) {
+  const int kNumRows = 10000;
+  const int kSelectEvery = 50;
+  WriteTestRowSet(kNumRows);
+
+  shared_ptr<CFileSet> fileset(new CFileSet(rowset_meta_));
+  ASSERT_OK(fileset->Open());
+
+  // c1 contains the row index * 10. Select every 50th row.
+  vector<uint32_t> vals;
+  for (int i = 0; i < kNumRows; i += kSelectEvery) {
+    vals.push_back(i * 10);
+  }
+  vector<const void*> in_list;
+  BOOST_FOREACH(const uint32_t& val, vals) {
+    in_list.push_back(&val);
+  }
+
+  for (int pass = 0; pass < 2; pass++) {
+    bool late_materialization = (pass == 1);
+    FLAGS_materializing_iterator_late_materialization = late_materialization;
+
+    shared_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_));
+    gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+    ScanSpec spec;
+    spec.AddPredicate(ColumnRangePredicate::InList(schema_.column(1), in_list));
+    ASSERT_OK(iter->Init(&spec));
+
+    Arena arena(1024, 1024);
+    RowBlock block(schema_, 100, &arena);
+    int nrows = 0;
+    while (iter->HasNext()) {
+      ASSERT_OK_FAST(iter->NextBlock(&block));
+      for (size_t i = 0; i < block.nrows(); i++) {
+        if (!block.selection_vector()->IsRowSelected(i)) continue;
+        RowBlockRow row = block.row(i);
+        uint32_t c0 = *schema_.ExtractColumnFromRow<UINT32>(row, 0);
+        uint32_t c2 = *schema_.ExtractColumnFromRow<UINT32>(row, 2);
+        ASSERT_EQ(c0 * 50, c2) << schema_.DebugRow(row);
+        nrows++;
+      }
+    }
+    ASSERT_EQ(kNumRows / kSelectEvery, nrows);
+
+    vector<IteratorStats> stats;
+    cfile_iter->GetIteratorStats(&stats);
+    LOG(INFO) << "late_materialization=" << late_materialization
+              << " c2 stats: " << stats[2].ToString();
+    ASSERT_EQ(0, stats[1].cells_skipped);
+    if (late_materialization) {
+      ASSERT_GT(stats[2].cells_skipped, kNumRows / 2);
+      ASSERT_GT(stats[0].cells_skipped, kNumRows / 2);
+    } else {
+      ASSERT_EQ(0, stats[2].cells_skipped);
+    }
+  }
+}
 
 } // namespace tablet
 } // namespace kudu
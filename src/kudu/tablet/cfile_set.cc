@@ -21,7 +21,11 @@
 #include "kudu/cfile/bloomfile.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/cfile/index_btree.h"
+#include "kudu/cfile/zone_map.h"
+#include "kudu/common/encoded_key.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/algorithm.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
@@ -29,16 +33,32 @@
 #include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/cfile_set.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/memory/arena.h"
 
 DEFINE_bool(consult_bloom_filters, true, "Whether to consult bloom filters on row presence checks");
 TAG_FLAG(consult_bloom_filters, hidden);
 
+DEFINE_bool(consult_zone_maps, true,
+            "Whether to consult cfile zone maps to skip data blocks which cannot match "
+            "scan predicates");
+TAG_FLAG(consult_zone_maps, hidden);
+
+DEFINE_bool(evaluate_predicates_on_dictionary, true,
+            "Whether to evaluate scan predicates on dictionary-encoded columns once per "
+            "dictionary entry, rather than once per row");
+TAG_FLAG(evaluate_predicates_on_dictionary, hidden);
+
 namespace kudu {
 namespace tablet {
 
+using cfile::DataBlockZoneMapPB;
+using cfile::DataBlockZoneMapsPB;
 using cfile::ReaderOptions;
 using cfile::DefaultColumnValueIterator;
+using cfile::IndexTreeIterator;
+using cfile::ZoneMapMayMatch;
 using fs::ReadableBlock;
+using std::pair;
 using std::tr1::shared_ptr;
 using strings::Substitute;
 
@@ -194,6 +214,41 @@ uint64_t CFileSet::EstimateOnDiskSize() const {
   return ret;
 }
 
+Status CFileSet::SampleKeys(uint64_t rowset_size,
+                            vector<RowSetKeySample>* samples) const {
+  CFileReader* key_reader = key_index_reader();
+  if (!key_reader->has_validx()) {
+    // Without a value index, the only key known up front is the minimum.
+    RowSetKeySample sample;
+    sample.encoded_key = min_encoded_key_;
+    sample.size_bytes = rowset_size;
+    samples->push_back(sample);
+    return Status::OK();
+  }
+
+  gscoped_ptr<IndexTreeIterator> iter(
+    IndexTreeIterator::Create(key_reader, key_reader->validx_root()));
+  RETURN_NOT_OK(iter->SeekToFirst());
+
+  size_t first_sample = samples->size();
+  uint64_t index_size = 0;
+  while (true) {
+    RowSetKeySample sample;
+    sample.encoded_key = iter->GetCurrentKey().ToString();
+    sample.size_bytes = iter->GetCurrentBlockPointer().size();
+    index_size += sample.size_bytes;
+    samples->push_back(sample);
+    if (!iter->HasNext()) break;
+    RETURN_NOT_OK(iter->Next());
+  }
+
+  for (size_t i = first_sample; i < samples->size(); i++) {
+    RowSetKeySample* sample = &(*samples)[i];
+    sample->size_bytes = index_size == 0 ? 0 : sample->size_bytes * rowset_size / index_size;
+  }
+  return Status::OK();
+}
+
 Status CFileSet::FindRow(const RowSetKeyProbe &probe, rowid_t *idx,
                          ProbeStats* stats) const {
   if (bloom_reader_ != NULL && FLAGS_consult_bloom_filters) {
@@ -262,6 +317,8 @@ Status CFileSet::Iterator::CreateColumnIterators(const ScanSpec* spec) {
   vector<ColumnIterator*> ret_iters;
   ElementDeleter del(&ret_iters);
   ret_iters.reserve(projection_->num_columns());
+  vector<CFileIterator*> cfile_iters;
+  cfile_iters.reserve(projection_->num_columns());
 
   CFileReader::CacheControl cache_blocks = CFileReader::CACHE_BLOCK;
   if (spec && !spec->cache_blocks()) {
@@ -284,6 +341,7 @@ Status CFileSet::Iterator::CreateColumnIterators(const ScanSpec* spec) {
       }
       ret_iters.push_back(new DefaultColumnValueIterator(col_schema.type_info(),
                                                          col_schema.read_default_value()));
+      cfile_iters.push_back(NULL);
       continue;
     }
     CFileIterator *iter;
@@ -291,9 +349,11 @@ Status CFileSet::Iterator::CreateColumnIterators(const ScanSpec* spec) {
                           Substitute("could not create iterator for column $0",
                                      projection_->column(proj_col_idx).ToString()));
     ret_iters.push_back(iter);
+    cfile_iters.push_back(iter);
   }
 
   col_iters_.swap(ret_iters);
+  cfile_col_iters_.swap(cfile_iters);
   return Status::OK();
 }
 
@@ -312,20 +372,46 @@ Status CFileSet::Iterator::Init(ScanSpec *spec) {
   // ordinal range.
   RETURN_NOT_OK(PushdownRangeScanPredicate(spec));
 
+  // Skip the rows between the key ranges of the scan, and use zone maps to
+  // find ranges of rows which can't match the predicates.
+  excluded_ranges_.clear();
+  next_excluded_range_ = 0;
+  RETURN_NOT_OK(PushdownKeyRanges(spec));
+  RETURN_NOT_OK(PushdownZoneMapPredicates(spec));
+  MergeExcludedRanges();
+
   initted_ = true;
 
   // Don't actually seek -- we'll seek when we first actually read the
   // data.
   cur_idx_ = lower_bound_idx_;
+  SkipExcludedRows();
   Unprepare(); // Reset state.
   return Status::OK();
 }
 
+// Return true if the key range of 'spec' contains exactly one key, i.e. its
+// exclusive upper bound is the successor of its lower bound.
+static bool IsSingleKeyRange(const Schema& tablet_schema, const ScanSpec& spec) {
+  if (spec.lower_bound_key() == NULL || spec.exclusive_upper_bound_key() == NULL) {
+    return false;
+  }
+  Arena arena(1024, 1024 * 1024);
+  gscoped_ptr<EncodedKey> key;
+  if (!EncodedKey::DecodeEncodedString(tablet_schema, &arena,
+                                       spec.lower_bound_key()->encoded_key(), &key).ok() ||
+      !EncodedKey::IncrementEncodedKey(tablet_schema, &key, &arena).ok()) {
+    return false;
+  }
+  return key->encoded_key() == spec.exclusive_upper_bound_key()->encoded_key();
+}
+
 Status CFileSet::Iterator::PushdownRangeScanPredicate(ScanSpec *spec) {
   CHECK_GT(row_count_, 0);
 
   lower_bound_idx_ = 0;
   upper_bound_idx_ = row_count_;
+  point_lookup_ = false;
 
   if (spec == NULL) {
     // No predicate.
@@ -378,9 +464,148 @@ Status CFileSet::Iterator::PushdownRangeScanPredicate(ScanSpec *spec) {
               << " as row_idx < " << upper_bound_idx_;
     }
   }
+
+  // Keys are unique within a rowset, so a point lookup covers at most one row.
+  point_lookup_ = upper_bound_idx_ <= lower_bound_idx_ + 1 &&
+      IsSingleKeyRange(base_data_->tablet_schema(), *spec);
+  return Status::OK();
+}
+
+void CFileSet::Iterator::EnableZoneMapPruning(const std::set<int>& col_ids_with_updates) {
+  DCHECK(!initted_);
+  zone_map_pruning_enabled_ = true;
+  col_ids_with_updates_ = col_ids_with_updates;
+}
+
+void CFileSet::Iterator::EnableDictionaryPredicateEvaluation(
+    const std::set<int>& col_ids_with_updates) {
+  DCHECK(!initted_);
+  dictionary_predicates_enabled_ = true;
+  col_ids_with_updates_ = col_ids_with_updates;
+}
+
+Status CFileSet::Iterator::PushdownKeyRanges(const ScanSpec *spec) {
+  if (spec == NULL || spec->key_ranges().empty() ||
+      lower_bound_idx_ >= upper_bound_idx_) {
+    return Status::OK();
+  }
+
+  rowid_t gap_start = lower_bound_idx_;
+  BOOST_FOREACH(const ScanSpec::KeyRange& range, spec->key_ranges()) {
+    rowid_t range_start = lower_bound_idx_;
+    if (range.lower != NULL) {
+      bool exact;
+      Status s = key_iter_->SeekAtOrAfter(*range.lower, &exact);
+      if (s.IsNotFound()) {
+        // This range, and all that follow it, are past the end of the rowset.
+        break;
+      }
+      RETURN_NOT_OK(s);
+      range_start = std::max(range_start, key_iter_->GetCurrentOrdinal());
+    }
+    if (range_start > gap_start) {
+      excluded_ranges_.push_back(std::make_pair(gap_start, range_start));
+    }
+
+    rowid_t range_end = upper_bound_idx_;
+    if (range.exclusive_upper != NULL) {
+      bool exact;
+      Status s = key_iter_->SeekAtOrAfter(*range.exclusive_upper, &exact);
+      if (!s.IsNotFound()) {
+        RETURN_NOT_OK(s);
+        range_end = std::min(range_end, key_iter_->GetCurrentOrdinal());
+      }
+    }
+    gap_start = std::max(gap_start, range_end);
+  }
+  if (gap_start < upper_bound_idx_) {
+    excluded_ranges_.push_back(std::make_pair(gap_start, upper_bound_idx_));
+  }
+  VLOG(1) << "Key ranges excluded " << excluded_ranges_.size() << " row ranges from "
+          << base_data_->ToString();
+  return Status::OK();
+}
+
+Status CFileSet::Iterator::PushdownZoneMapPredicates(const ScanSpec *spec) {
+  if (!zone_map_pruning_enabled_ || !FLAGS_consult_zone_maps ||
+      spec == NULL || lower_bound_idx_ >= upper_bound_idx_) {
+    return Status::OK();
+  }
+
+  size_t num_key_excluded = excluded_ranges_.size();
+  BOOST_FOREACH(const ColumnRangePredicate& pred, spec->predicates()) {
+    int proj_col_idx = projection_->find_column(pred.column().name());
+    if (proj_col_idx == -1) {
+      continue;
+    }
+    int col_id = projection_->column_id(proj_col_idx);
+    if (!base_data_->has_data_for_column_id(col_id) ||
+        ContainsKey(col_ids_with_updates_, col_id)) {
+      continue;
+    }
+
+    CFileReader* reader = FindOrDie(base_data_->readers_by_col_id_, col_id).get();
+    RETURN_NOT_OK(reader->Init());
+    if (!reader->has_zone_maps()) {
+      continue;
+    }
+    DCHECK_EQ(reader->type_info()->type(), pred.column().type_info()->type());
+
+    if (!ZoneMapMayMatch(reader->type_info(), reader->file_zone_map(), pred)) {
+      // No row in this rowset can match the predicate.
+      VLOG(1) << "Zone map of " << base_data_->ToString() << " excludes "
+              << pred.ToString() << ": skipping rowset";
+      rows_pruned_ += upper_bound_idx_ - lower_bound_idx_;
+      upper_bound_idx_ = lower_bound_idx_;
+      return Status::OK();
+    }
+
+    const DataBlockZoneMapsPB* zone_maps;
+    RETURN_NOT_OK(reader->GetBlockZoneMaps(&zone_maps));
+    BOOST_FOREACH(const DataBlockZoneMapPB& block, zone_maps->blocks()) {
+      if (!ZoneMapMayMatch(reader->type_info(), block.zone_map(), pred)) {
+        excluded_ranges_.push_back(std::make_pair(block.first_ordinal(),
+                                          block.first_ordinal() + block.num_values()));
+      }
+    }
+  }
+
+  VLOG(1) << "Zone maps excluded " << (excluded_ranges_.size() - num_key_excluded)
+          << " row ranges from " << base_data_->ToString();
   return Status::OK();
 }
 
+void CFileSet::Iterator::MergeExcludedRanges() {
+  typedef pair<rowid_t, rowid_t> RowRange;
+  vector<RowRange> excluded;
+  excluded.swap(excluded_ranges_);
+
+  // Merge the ranges from all sources into a sorted, non-overlapping list.
+  std::sort(excluded.begin(), excluded.end());
+  BOOST_FOREACH(const RowRange& range, excluded) {
+    if (!excluded_ranges_.empty() && range.first <= excluded_ranges_.back().second) {
+      excluded_ranges_.back().second = std::max(excluded_ranges_.back().second, range.second);
+    } else {
+      excluded_ranges_.push_back(range);
+    }
+  }
+}
+
+void CFileSet::Iterator::SkipExcludedRows() {
+  while (next_excluded_range_ < excluded_ranges_.size()) {
+    const pair<rowid_t, rowid_t>& range = excluded_ranges_[next_excluded_range_];
+    if (cur_idx_ < range.first) {
+      break;
+    }
+    if (cur_idx_ < range.second) {
+      rowid_t new_idx = std::min<rowid_t>(range.second, upper_bound_idx_);
+      rows_pruned_ += new_idx - cur_idx_;
+      cur_idx_ = new_idx;
+    }
+    next_excluded_range_++;
+  }
+}
+
 void CFileSet::Iterator::Unprepare() {
   prepared_count_ = 0;
   cols_prepared_.assign(col_iters_.size(), false);
@@ -390,6 +615,11 @@ Status CFileSet::Iterator::PrepareBatch(size_t *n) {
   DCHECK_EQ(prepared_count_, 0) << "Already prepared";
 
   size_t remaining = upper_bound_idx_ - cur_idx_;
+  // Don't prepare rows which the zone maps have excluded.
+  if (next_excluded_range_ < excluded_ranges_.size()) {
+    remaining = std::min<size_t>(remaining,
+                                 excluded_ranges_[next_excluded_range_].first - cur_idx_);
+  }
   if (*n > remaining) {
     *n = remaining;
   }
@@ -416,7 +646,16 @@ Status CFileSet::Iterator::PrepareColumn(size_t idx) {
     // columns completely eliminated the block).
     //
     // Either way, we need to seek it to the correct offset.
-    RETURN_NOT_OK(col_iter->SeekToOrdinal(cur_idx_));
+    if (point_lookup_) {
+      // A point lookup's row will most likely be materialized in every
+      // column. Seek them all now so that their data blocks are read
+      // together rather than one column at a time. Other scans seek each
+      // column only once it is materialized, so that late materialization
+      // can skip the blocks of the rows which the predicates eliminate.
+      RETURN_NOT_OK(SeekUnpreparedColumns());
+    } else {
+      RETURN_NOT_OK(col_iter->SeekToOrdinal(cur_idx_));
+    }
   }
 
   Status s = col_iter->PrepareBatch(&n);
@@ -437,6 +676,37 @@ Status CFileSet::Iterator::PrepareColumn(size_t idx) {
   return Status::OK();
 }
 
+Status CFileSet::Iterator::SeekUnpreparedColumns() {
+  vector<CFileIterator*> seeking;
+  vector<fs::BlockReadRequest*> reads;
+  for (size_t i = 0; i < col_iters_.size(); i++) {
+    CFileIterator* iter = cfile_col_iters_[i];
+    if (cols_prepared_[i] || iter == NULL ||
+        (iter->seeked() && iter->GetCurrentOrdinal() == cur_idx_)) {
+      continue;
+    }
+    RETURN_NOT_OK(iter->PrepareSeekToOrdinal(cur_idx_, &reads));
+    seeking.push_back(iter);
+  }
+
+  if (!reads.empty()) {
+    vector<fs::BlockReadRequest> batch;
+    batch.reserve(reads.size());
+    BOOST_FOREACH(const fs::BlockReadRequest* req, reads) {
+      batch.push_back(*req);
+    }
+    RETURN_NOT_OK(base_data_->rowset_metadata_->fs_manager()->ReadBatch(&batch));
+    for (int i = 0; i < reads.size(); i++) {
+      reads[i]->read.result = batch[i].read.result;
+    }
+  }
+
+  BOOST_FOREACH(CFileIterator* iter, seeking) {
+    RETURN_NOT_OK(iter->FinishSeekToOrdinal());
+  }
+  return Status::OK();
+}
+
 Status CFileSet::Iterator::InitializeSelectionVector(SelectionVector *sel_vec) {
   sel_vec->SetAllTrue();
   return Status::OK();
@@ -451,6 +721,38 @@ Status CFileSet::Iterator::MaterializeColumn(size_t col_idx, ColumnBlock *dst) {
   return iter->Scan(dst);
 }
 
+Status CFileSet::Iterator::MaterializeColumnSelected(size_t col_idx, ColumnBlock *dst,
+                                                     const SelectionVector& sel) {
+  CHECK_EQ(prepared_count_, dst->nrows());
+  DCHECK_LT(col_idx, col_iters_.size());
+
+  RETURN_NOT_OK(PrepareColumn(col_idx));
+  ColumnIterator* iter = col_iters_[col_idx];
+  return iter->ScanSelected(dst, sel);
+}
+
+Status CFileSet::Iterator::MaterializeColumnAndEvaluate(size_t col_idx,
+                                                        const ColumnRangePredicate& pred,
+                                                        ColumnBlock *dst,
+                                                        SelectionVector *sel,
+                                                        bool *evaluated) {
+  // The dictionary describes the base data only, so predicates on columns
+  // which may have been updated are left to be evaluated after the deltas
+  // are applied.
+  if (!dictionary_predicates_enabled_ || !FLAGS_evaluate_predicates_on_dictionary ||
+      ContainsKey(col_ids_with_updates_, projection_->column_id(col_idx))) {
+    *evaluated = false;
+    return MaterializeColumnSelected(col_idx, dst, *sel);
+  }
+
+  CHECK_EQ(prepared_count_, dst->nrows());
+  DCHECK_LT(col_idx, col_iters_.size());
+
+  RETURN_NOT_OK(PrepareColumn(col_idx));
+  ColumnIterator* iter = col_iters_[col_idx];
+  return iter->ScanSelectedAndEvaluate(pred, dst, sel, evaluated);
+}
+
 Status CFileSet::Iterator::FinishBatch() {
   CHECK_GT(prepared_count_, 0);
 
@@ -465,6 +767,7 @@ Status CFileSet::Iterator::FinishBatch() {
   }
 
   cur_idx_ += prepared_count_;
+  SkipExcludedRows();
   Unprepare();
 
   return Status::OK();
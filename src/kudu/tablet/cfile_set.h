@@ -17,7 +17,9 @@
 #include <gtest/gtest_prod.h>
 #include <tr1/memory>
 #include <tr1/unordered_map>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "kudu/cfile/bloomfile.h"
@@ -71,6 +73,12 @@ class CFileSet : public std::tr1::enable_shared_from_this<CFileSet> {
 
   uint64_t EstimateOnDiskSize() const;
 
+  // Append to 'samples' the encoded key at the start of each data block of
+  // the key index. The key index blocks each cover a similar number of rows,
+  // so 'rowset_size' is spread across the samples in proportion to the size
+  // of their blocks.
+  Status SampleKeys(uint64_t rowset_size, vector<RowSetKeySample>* samples) const;
+
   // Determine the index of the given row key.
   Status FindRow(const RowSetKeyProbe &probe, rowid_t *idx, ProbeStats* stats) const;
 
@@ -144,6 +152,15 @@ class CFileSet::Iterator : public ColumnwiseIterator {
 
   virtual Status MaterializeColumn(size_t col_idx, ColumnBlock *dst) OVERRIDE;
 
+  virtual Status MaterializeColumnSelected(size_t col_idx, ColumnBlock *dst,
+                                           const SelectionVector& sel) OVERRIDE;
+
+  virtual Status MaterializeColumnAndEvaluate(size_t col_idx,
+                                              const ColumnRangePredicate& pred,
+                                              ColumnBlock *dst,
+                                              SelectionVector *sel,
+                                              bool *evaluated) OVERRIDE;
+
   virtual Status FinishBatch() OVERRIDE;
 
   virtual bool HasNext() const OVERRIDE {
@@ -168,10 +185,36 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // Collect the IO statistics for each of the underlying columns.
   virtual void GetIteratorStats(vector<IteratorStats> *stats) const OVERRIDE;
 
+  // Allow this iterator to skip ranges of rows which the zone maps of the
+  // underlying cfiles show cannot match the scan predicates. The base data
+  // of columns in 'col_ids_with_updates' may be stale with respect to
+  // deltas, so predicates on those columns are not used for pruning.
+  //
+  // Pruning only narrows the rows returned; the predicates remain in the
+  // scan spec and must still be evaluated by a higher layer.
+  //
+  // Must be called before Init().
+  void EnableZoneMapPruning(const std::set<int>& col_ids_with_updates);
+
+  // Allow this iterator to evaluate predicates on dictionary-encoded columns
+  // against the dictionary as the columns are materialized (see
+  // MaterializeColumnAndEvaluate()). As with zone maps, this is only done
+  // for columns which are not in 'col_ids_with_updates'.
+  //
+  // Must be called before Init().
+  void EnableDictionaryPredicateEvaluation(const std::set<int>& col_ids_with_updates);
+
+  // Return the number of rows skipped so far due to the scan's key ranges
+  // or zone map pruning.
+  rowid_t rows_pruned() const {
+    return rows_pruned_;
+  }
+
   virtual ~Iterator();
  private:
   DISALLOW_COPY_AND_ASSIGN(Iterator);
   FRIEND_TEST(TestCFileSet, TestRangeScan);
+  FRIEND_TEST(TestCFileSet, TestLastBatchLateMaterialization);
   friend class CFileSet;
 
   // 'projection' must remain valid for the lifetime of this object.
@@ -180,8 +223,13 @@ class CFileSet::Iterator : public ColumnwiseIterator {
     : base_data_(base_data),
       projection_(projection),
       initted_(false),
+      zone_map_pruning_enabled_(false),
+      dictionary_predicates_enabled_(false),
       cur_idx_(0),
-      prepared_count_(0) {
+      prepared_count_(0),
+      point_lookup_(false),
+      next_excluded_range_(0),
+      rows_pruned_(0) {
     CHECK_OK(base_data_->CountRows(&row_count_));
   }
 
@@ -193,11 +241,30 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // store it in member fields.
   Status PushdownRangeScanPredicate(ScanSpec *spec);
 
+  // Convert the key ranges of 'spec' (e.g. from an IN-list on a key column)
+  // into excluded ordinal ranges covering the gaps between them.
+  Status PushdownKeyRanges(const ScanSpec *spec);
+
+  // Use the zone maps of the columns referenced by the predicates in 'spec'
+  // to compute the ordinal ranges which cannot contain any matching row.
+  // If no row in the rowset can match, the iterator's range is emptied.
+  Status PushdownZoneMapPredicates(const ScanSpec *spec);
+
+  // Sort and merge excluded_ranges_ into a non-overlapping list.
+  void MergeExcludedRanges();
+
+  // Advance cur_idx_ past any excluded ranges it falls within.
+  void SkipExcludedRows();
+
   void Unprepare();
 
   // Prepare the given column if not already prepared.
   Status PrepareColumn(size_t col_idx);
 
+  // Seek each of the columns which haven't been prepared in this batch to
+  // cur_idx_, reading the data blocks of all of them together.
+  Status SeekUnpreparedColumns();
+
   const shared_ptr<CFileSet const> base_data_;
   const Schema* projection_;
 
@@ -205,8 +272,16 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   gscoped_ptr<CFileIterator> key_iter_;
   std::vector<ColumnIterator*> col_iters_;
 
+  // The iterators of col_iters_ which read from CFiles, or NULL for those
+  // which return the columns' default values.
+  std::vector<CFileIterator*> cfile_col_iters_;
+
   bool initted_;
 
+  bool zone_map_pruning_enabled_;
+  bool dictionary_predicates_enabled_;
+  std::set<int> col_ids_with_updates_;
+
   size_t cur_idx_;
   size_t prepared_count_;
 
@@ -220,6 +295,18 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   rowid_t lower_bound_idx_;
   rowid_t upper_bound_idx_;
 
+  // True if the scan's key range is a single key, as for point lookups.
+  bool point_lookup_;
+
+  // Ordinal ranges [first, second) which the key ranges or zone maps show
+  // cannot contain any row matching the scan predicates. Sorted and
+  // non-overlapping once Init() has returned.
+  std::vector<std::pair<rowid_t, rowid_t> > excluded_ranges_;
+
+  // Index of the first range in excluded_ranges_ not yet passed by cur_idx_.
+  size_t next_excluded_range_;
+
+  rowid_t rows_pruned_;
 
   // The underlying columns are prepared lazily, so that if a column is never
   // materialized, it doesn't need to be read off disk.
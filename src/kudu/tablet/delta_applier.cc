@@ -31,7 +31,8 @@ DeltaApplier::DeltaApplier(const shared_ptr<CFileSet::Iterator>& base_iter,
                            const shared_ptr<DeltaIterator>& delta_iter)
   : base_iter_(base_iter),
     delta_iter_(delta_iter),
-    first_prepare_(true) {
+    first_prepare_(true),
+    next_delta_idx_(0) {
 }
 
 DeltaApplier::~DeltaApplier() {
@@ -70,12 +71,16 @@ Status DeltaApplier::PrepareBatch(size_t *nrows) {
   // The initial seek is deferred from Init() into the first PrepareBatch()
   // because it requires a loaded delta file, and we don't want to require
   // that at Init() time.
-  if (first_prepare_) {
+  //
+  // We also need to seek if the base iterator skipped past some rows since
+  // the previous batch.
+  if (first_prepare_ || base_iter_->cur_ordinal_idx() != next_delta_idx_) {
     RETURN_NOT_OK(delta_iter_->SeekToOrdinal(base_iter_->cur_ordinal_idx()));
     first_prepare_ = false;
   }
   RETURN_NOT_OK(base_iter_->PrepareBatch(nrows));
   RETURN_NOT_OK(delta_iter_->PrepareBatch(*nrows, DeltaIterator::PREPARE_FOR_APPLY));
+  next_delta_idx_ = base_iter_->cur_ordinal_idx() + *nrows;
   return Status::OK();
 }
 
@@ -100,5 +105,31 @@ Status DeltaApplier::MaterializeColumn(size_t col_idx, ColumnBlock *dst) {
   return Status::OK();
 }
 
+Status DeltaApplier::MaterializeColumnSelected(size_t col_idx, ColumnBlock *dst,
+                                               const SelectionVector& sel) {
+  DCHECK(!first_prepare_) << "PrepareBatch() must be called at least once";
+
+  // Copy the base data for the selected rows only. Updates are still applied
+  // to every row: an update to an unselected row just overwrites a cell whose
+  // contents are undefined anyway.
+  RETURN_NOT_OK(base_iter_->MaterializeColumnSelected(col_idx, dst, sel));
+  RETURN_NOT_OK(delta_iter_->ApplyUpdates(col_idx, dst));
+  return Status::OK();
+}
+
+Status DeltaApplier::MaterializeColumnAndEvaluate(size_t col_idx,
+                                                  const ColumnRangePredicate& pred,
+                                                  ColumnBlock *dst,
+                                                  SelectionVector *sel,
+                                                  bool *evaluated) {
+  DCHECK(!first_prepare_) << "PrepareBatch() must be called at least once";
+
+  // The base iterator only evaluates predicates on columns without any
+  // updates, so applying the updates can't invalidate its result.
+  RETURN_NOT_OK(base_iter_->MaterializeColumnAndEvaluate(col_idx, pred, dst, sel, evaluated));
+  RETURN_NOT_OK(delta_iter_->ApplyUpdates(col_idx, dst));
+  return Status::OK();
+}
+
 } // namespace tablet
 } // namespace kudu
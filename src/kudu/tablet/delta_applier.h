@@ -59,6 +59,13 @@ class DeltaApplier : public ColumnwiseIterator {
   virtual Status InitializeSelectionVector(SelectionVector *sel_vec) OVERRIDE;
 
   Status MaterializeColumn(size_t col_idx, ColumnBlock *dst) OVERRIDE;
+
+  Status MaterializeColumnSelected(size_t col_idx, ColumnBlock *dst,
+                                   const SelectionVector& sel) OVERRIDE;
+
+  Status MaterializeColumnAndEvaluate(size_t col_idx, const ColumnRangePredicate& pred,
+                                      ColumnBlock *dst, SelectionVector *sel,
+                                      bool *evaluated) OVERRIDE;
  private:
   friend class DeltaTracker;
 
@@ -75,6 +82,11 @@ class DeltaApplier : public ColumnwiseIterator {
   std::tr1::shared_ptr<DeltaIterator> delta_iter_;
 
   bool first_prepare_;
+
+  // The ordinal index at which the next delta batch will be prepared.
+  // The base iterator may skip rows between batches (e.g. due to zone map
+  // pruning), in which case the delta iterator must be re-seeked.
+  rowid_t next_delta_idx_;
 };
 
 } // namespace tablet
@@ -47,7 +47,8 @@ DeltaTracker::DeltaTracker(const shared_ptr<RowSetMetadata>& rowset_metadata,
   num_rows_(num_rows),
   open_(false),
   log_anchor_registry_(log_anchor_registry),
-  parent_tracker_(parent_tracker) {
+  parent_tracker_(parent_tracker),
+  dms_flush_in_progress_(false) {
 }
 
 Status DeltaTracker::OpenDeltaReaders(const vector<BlockId>& blocks,
@@ -341,6 +342,14 @@ Status DeltaTracker::WrapIterator(const shared_ptr<CFileSet::Iterator> &base,
   shared_ptr<DeltaIterator> iter;
   RETURN_NOT_OK(NewDeltaIterator(&base->schema(), mvcc_snap, &iter));
 
+  // Zone maps and dictionaries describe the base data only, so they can
+  // only be used for columns whose values haven't been changed by any delta.
+  set<int> col_ids_with_updates;
+  if (GetColumnIdsWithPossibleUpdates(&col_ids_with_updates)) {
+    base->EnableZoneMapPruning(col_ids_with_updates);
+    base->EnableDictionaryPredicateEvaluation(col_ids_with_updates);
+  }
+
   out->reset(new DeltaApplier(base, iter));
   return Status::OK();
 }
@@ -424,6 +433,36 @@ Status DeltaTracker::FlushDMS(DeltaMemStore* dms,
   return Status::OK();
 }
 
+size_t DeltaTracker::SwapInNewDMS(shared_ptr<DeltaMemStore>* old_dms) {
+  // Lock the component_lock_ in exclusive mode.
+  // This shuts out any concurrent readers or writers.
+  lock_guard<rw_spinlock> lock(&component_lock_);
+
+  size_t count = dms_->Count();
+
+  // Swap the DeltaMemStore to use the new schema
+  *old_dms = dms_;
+  dms_.reset(new DeltaMemStore((*old_dms)->id() + 1, rowset_metadata_->id(),
+                               log_anchor_registry_, parent_tracker_));
+
+  if (count > 0) {
+    redo_delta_stores_.push_back(*old_dms);
+    dms_flush_in_progress_ = true;
+  }
+  return count;
+}
+
+void DeltaTracker::SwapInFlushedDMS(const shared_ptr<DeltaMemStore>& old_dms,
+                                    const shared_ptr<DeltaFileReader>& dfr) {
+  lock_guard<rw_spinlock> lock(&component_lock_);
+  size_t idx = redo_delta_stores_.size() - 1;
+
+  CHECK_EQ(redo_delta_stores_[idx], old_dms)
+    << "Another thread modified the delta store list during flush";
+  redo_delta_stores_[idx] = dfr;
+  dms_flush_in_progress_ = false;
+}
+
 Status DeltaTracker::Flush(MetadataFlushType flush_type) {
   lock_guard<Mutex> l(&compact_flush_lock_);
 
@@ -431,26 +470,11 @@ Status DeltaTracker::Flush(MetadataFlushType flush_type) {
   // and add it to the list of delta stores to be reflected
   // in reads.
   shared_ptr<DeltaMemStore> old_dms;
-  size_t count;
-  {
-    // Lock the component_lock_ in exclusive mode.
-    // This shuts out any concurrent readers or writers.
-    lock_guard<rw_spinlock> lock(&component_lock_);
-
-    count = dms_->Count();
-
-    // Swap the DeltaMemStore to use the new schema
-    old_dms = dms_;
-    dms_.reset(new DeltaMemStore(old_dms->id() + 1, rowset_metadata_->id(),
-                                 log_anchor_registry_, parent_tracker_));
-
-    if (count == 0) {
-      // No need to flush if there are no deltas.
-      // Ensure that the DeltaMemStore is using the latest schema.
-      return Status::OK();
-    }
-
-    redo_delta_stores_.push_back(old_dms);
+  size_t count = SwapInNewDMS(&old_dms);
+  if (count == 0) {
+    // No need to flush if there are no deltas.
+    // Ensure that the DeltaMemStore is using the latest schema.
+    return Status::OK();
   }
 
   LOG(INFO) << "Flushing " << count << " deltas from DMS " << old_dms->id() << "...";
@@ -469,14 +493,7 @@ Status DeltaTracker::Flush(MetadataFlushType flush_type) {
 
   // Now, re-take the lock and swap in the DeltaFileReader in place of
   // of the DeltaMemStore
-  {
-    lock_guard<rw_spinlock> lock(&component_lock_);
-    size_t idx = redo_delta_stores_.size() - 1;
-
-    CHECK_EQ(redo_delta_stores_[idx], old_dms)
-      << "Another thread modified the delta store list during flush";
-    redo_delta_stores_[idx] = dfr;
-  }
+  SwapInFlushedDMS(old_dms, dfr);
 
   return Status::OK();
 
@@ -528,5 +545,30 @@ void DeltaTracker::GetColumnIdsWithUpdates(std::vector<int>* col_ids) const {
   col_ids->assign(column_ids_with_updates.begin(), column_ids_with_updates.end());
 }
 
+bool DeltaTracker::GetColumnIdsWithPossibleUpdates(set<int>* col_ids) const {
+  shared_lock<rw_spinlock> lock(&component_lock_);
+
+  // While a DeltaMemStore is being flushed, it sits among the REDO stores
+  // without any statistics, so its updates can't be accounted for.
+  if (!dms_->Empty() || dms_flush_in_progress_) {
+    return false;
+  }
+
+  col_ids->clear();
+  BOOST_FOREACH(const shared_ptr<DeltaStore>& ds, undo_delta_stores_) {
+    if (!ds->Initted()) {
+      return false;
+    }
+    ds->delta_stats().AddColumnIdsWithUpdates(col_ids);
+  }
+  BOOST_FOREACH(const shared_ptr<DeltaStore>& ds, redo_delta_stores_) {
+    if (!ds->Initted()) {
+      return false;
+    }
+    ds->delta_stats().AddColumnIdsWithUpdates(col_ids);
+  }
+  return true;
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -15,6 +15,7 @@
 #define KUDU_TABLET_DELTATRACKER_H
 
 #include <gtest/gtest_prod.h>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -170,6 +171,14 @@ class DeltaTracker {
   // Retrieves the list of column indexes that currently have updates.
   void GetColumnIdsWithUpdates(std::vector<int>* col_ids) const;
 
+  // Collects the IDs of all columns which may have been updated by any
+  // delta store (UNDO, REDO or the DeltaMemStore).
+  //
+  // Returns false if this cannot be determined without reading delta files
+  // which have not yet been initialized, or if the DeltaMemStore is non-empty
+  // or being flushed (it does not keep per-column statistics).
+  bool GetColumnIdsWithPossibleUpdates(std::set<int>* col_ids) const;
+
   Mutex* compact_flush_lock() {
     return &compact_flush_lock_;
   }
@@ -181,6 +190,8 @@ class DeltaTracker {
 
   FRIEND_TEST(TestRowSet, TestRowSetUpdate);
   FRIEND_TEST(TestRowSet, TestDMSFlush);
+  FRIEND_TEST(TestRowSet, TestZoneMapsDuringDMSFlush);
+  FRIEND_TEST(TestRowSetStringValues, TestDictionaryPredicatesDuringDMSFlush);
   FRIEND_TEST(TestRowSet, TestMakeDeltaIteratorMergerUnlocked);
   FRIEND_TEST(TestRowSet, TestCompactStores);
   FRIEND_TEST(TestMajorDeltaCompaction, TestCompact);
@@ -193,6 +204,17 @@ class DeltaTracker {
                   shared_ptr<DeltaFileReader>* dfr,
                   MetadataFlushType flush_type);
 
+  // Replaces the DeltaMemStore by a new, empty one, and sets 'old_dms' to the
+  // old one. Unless it was empty, the old one is added to the REDO stores so
+  // that reads keep seeing its deltas while it's flushed. Returns the number
+  // of deltas in the old DeltaMemStore.
+  size_t SwapInNewDMS(shared_ptr<DeltaMemStore>* old_dms);
+
+  // Replaces the flushed 'old_dms' in the REDO stores by 'dfr', the delta
+  // file it was flushed to.
+  void SwapInFlushedDMS(const shared_ptr<DeltaMemStore>& old_dms,
+                        const shared_ptr<DeltaFileReader>& dfr);
+
   // This collects all undo and redo stores.
   void CollectStores(vector<shared_ptr<DeltaStore> > *stores) const;
 
@@ -252,6 +274,10 @@ class DeltaTracker {
   // contention between threads.
   mutable rw_spinlock component_lock_;
 
+  // Whether a DeltaMemStore has been moved to the REDO stores and is being
+  // flushed. Protected by 'component_lock_'.
+  bool dms_flush_in_progress_;
+
   // Exclusive lock that ensures that only one flush or compaction can run
   // at a time. Protects delta_stores_. NOTE: this lock cannot be acquired
   // while component_lock is held: otherwise, Flush and Compaction threads
@@ -294,6 +294,52 @@ TEST_F(TestRowSet, TestDMSFlush) {
   }
 }
 
+// Test that scans don't use the zone maps of updated columns while the
+// DeltaMemStore is being flushed, when its updates aren't reflected in any
+// delta store's statistics.
+TEST_F(TestRowSet, TestZoneMapsDuringDMSFlush) {
+  WriteTestRowSet();
+  shared_ptr<DiskRowSet> rs;
+  ASSERT_OK(OpenTestRowSet(&rs));
+
+  // Move the first row outside of the range of the base data.
+  const uint32_t new_val = n_rows_ * 10;
+  OperationResultPB result;
+  ASSERT_OK(UpdateRow(rs.get(), 0, new_val, &result));
+
+  ScanSpec spec;
+  ColumnRangePredicate pred(schema_.column(1), &new_val, &new_val);
+  spec.AddPredicate(pred);
+  MvccSnapshot snap = MvccSnapshot::CreateSnapshotIncludingAllTransactions();
+  vector<string> rows;
+
+  // Start the flush, stopping before the DeltaMemStore is written out.
+  DeltaTracker* dt = rs->delta_tracker_.get();
+  shared_ptr<DeltaMemStore> old_dms;
+  ASSERT_EQ(1, dt->SwapInNewDMS(&old_dms));
+  set<int> col_ids;
+  ASSERT_FALSE(dt->GetColumnIdsWithPossibleUpdates(&col_ids));
+  {
+    gscoped_ptr<RowwiseIterator> row_iter;
+    ASSERT_OK(rs->NewRowIterator(&schema_, snap, &row_iter));
+    ASSERT_OK(row_iter->Init(&spec));
+    ASSERT_OK(IterateToStringList(row_iter.get(), &rows));
+    ASSERT_EQ(1, rows.size());
+  }
+
+  // Finish the flush.
+  shared_ptr<DeltaFileReader> dfr;
+  ASSERT_OK(dt->FlushDMS(old_dms.get(), &dfr, DeltaTracker::FLUSH_METADATA));
+  dt->SwapInFlushedDMS(old_dms, dfr);
+  {
+    gscoped_ptr<RowwiseIterator> row_iter;
+    ASSERT_OK(rs->NewRowIterator(&schema_, snap, &row_iter));
+    ASSERT_OK(row_iter->Init(&spec));
+    ASSERT_OK(IterateToStringList(row_iter.get(), &rows));
+    ASSERT_EQ(1, rows.size());
+  }
+}
+
 // Test that when a single row is updated multiple times, we can query the
 // historical values using MVCC, even after it is flushed.
 TEST_F(TestRowSet, TestFlushedUpdatesRespectMVCC) {
@@ -533,5 +579,111 @@ TEST_F(TestRowSet, TestCompactStores) {
   ASSERT_TRUE(is_sorted(results.begin(), results.end()));
 }
 
+class TestRowSetStringValues : public KuduRowSetTest {
+ public:
+  TestRowSetStringValues()
+    : KuduRowSetTest(CreateTestSchema()),
+      op_id_(consensus::MaximumOpId()),
+      mvcc_(scoped_refptr<server::Clock>(
+          server::LogicalClock::CreateStartingAt(Timestamp::kInitialTimestamp))) {
+  }
+
+ protected:
+  static const int kNumRows = 1000;
+
+  static Schema CreateTestSchema() {
+    ColumnStorageAttributes dict_attrs;
+    dict_attrs.encoding = DICT_ENCODING;
+    SchemaBuilder builder;
+    CHECK_OK(builder.AddKeyColumn("key", INT32));
+    CHECK_OK(builder.AddColumn(ColumnSchema("val", STRING, false, NULL, NULL, dict_attrs),
+                               false));
+    return builder.BuildWithoutIds();
+  }
+
+  // Writes a rowset whose rows look like (<n>, "val <n % 10>").
+  void WriteTestRowSet() {
+    DiskRowSetWriter drsw(rowset_meta_.get(), &schema_,
+                          BloomFilterSizing::BySizeAndFPRate(32*1024, 0.01f));
+    ASSERT_OK(drsw.Open());
+    RowBuilder rb(schema_);
+    for (int i = 0; i < kNumRows; i++) {
+      rb.Reset();
+      rb.AddInt32(i);
+      rb.AddString(StringPrintf("val %d", i % 10));
+      ASSERT_OK(WriteRow(rb.data(), &drsw));
+    }
+    ASSERT_OK(drsw.Finish());
+  }
+
+  Status UpdateRow(DiskRowSet* rs, int32_t key, const Slice& new_val) {
+    faststring update_buf;
+    RowChangeListEncoder update(&update_buf);
+    update.AddColumnUpdate(schema_.column(1), schema_.column_id(1), &new_val);
+
+    RowBuilder rb(schema_.CreateKeyProjection());
+    rb.AddInt32(key);
+    RowSetKeyProbe probe(rb.row());
+    ProbeStats stats;
+    OperationResultPB result;
+    ScopedTransaction tx(&mvcc_);
+    tx.StartApplying();
+    Status s = rs->MutateRow(tx.timestamp(), probe, RowChangeList(update_buf), op_id_,
+                             &stats, &result);
+    tx.Commit();
+    return s;
+  }
+
+  // Returns the number of rows whose value equals 'val'.
+  int CountRowsWithValue(const DiskRowSet& rs, const Slice& val) {
+    ScanSpec spec;
+    spec.AddPredicate(ColumnRangePredicate(schema_.column(1), &val, &val));
+    MvccSnapshot snap = MvccSnapshot::CreateSnapshotIncludingAllTransactions();
+    gscoped_ptr<RowwiseIterator> row_iter;
+    CHECK_OK(rs.NewRowIterator(&schema_, snap, &row_iter));
+    CHECK_OK(row_iter->Init(&spec));
+    vector<string> rows;
+    CHECK_OK(IterateToStringList(row_iter.get(), &rows));
+    return rows.size();
+  }
+
+  consensus::OpId op_id_;
+  MvccManager mvcc_;
+};
+
+// Test that predicates aren't evaluated against the dictionary of a column
+// whose values were updated, whether the updates are being flushed or were
+// already flushed.
+TEST_F(TestRowSetStringValues, TestDictionaryPredicatesDuringDMSFlush) {
+  WriteTestRowSet();
+  shared_ptr<DiskRowSet> rs;
+  ASSERT_OK(DiskRowSet::Open(rowset_meta_, new log::LogAnchorRegistry(), &rs));
+
+  // Change one row to a value which isn't in the dictionary, and another
+  // from one value in the dictionary to another.
+  ASSERT_OK(UpdateRow(rs.get(), 3, "updated"));
+  ASSERT_OK(UpdateRow(rs.get(), 5, "val 6"));
+  const int kRowsPerValue = kNumRows / 10;
+
+  // Start the flush, stopping before the DeltaMemStore is written out.
+  DeltaTracker* dt = rs->delta_tracker_.get();
+  shared_ptr<DeltaMemStore> old_dms;
+  ASSERT_EQ(2, dt->SwapInNewDMS(&old_dms));
+  ASSERT_EQ(1, CountRowsWithValue(*rs, "updated"));
+  ASSERT_EQ(kRowsPerValue - 1, CountRowsWithValue(*rs, "val 3"));
+  ASSERT_EQ(kRowsPerValue + 1, CountRowsWithValue(*rs, "val 6"));
+
+  // Finish the flush. The delta file's statistics are only consulted once
+  // it has been initialized by the first scan.
+  shared_ptr<DeltaFileReader> dfr;
+  ASSERT_OK(dt->FlushDMS(old_dms.get(), &dfr, DeltaTracker::FLUSH_METADATA));
+  dt->SwapInFlushedDMS(old_dms, dfr);
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(1, CountRowsWithValue(*rs, "updated"));
+    ASSERT_EQ(kRowsPerValue - 1, CountRowsWithValue(*rs, "val 3"));
+    ASSERT_EQ(kRowsPerValue + 1, CountRowsWithValue(*rs, "val 6"));
+  }
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -647,6 +647,13 @@ uint64_t DiskRowSet::EstimateOnDiskSize() const {
   return EstimateBaseDataDiskSize() + EstimateDeltaDiskSize();
 }
 
+Status DiskRowSet::SampleKeys(vector<RowSetKeySample>* samples) const {
+  DCHECK(open_);
+  uint64_t size = EstimateOnDiskSize();
+  boost::shared_lock<rw_spinlock> lock(component_lock_.get_lock());
+  return base_data_->SampleKeys(size, samples);
+}
+
 size_t DiskRowSet::DeltaMemStoreSize() const {
   DCHECK(open_);
   return delta_tracker_->DeltaMemStoreSize();
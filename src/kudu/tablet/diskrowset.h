@@ -328,6 +328,10 @@ class DiskRowSet : public RowSet {
   // TODO Offer a version that has the real total disk space usage.
   uint64_t EstimateOnDiskSize() const OVERRIDE;
 
+  // Samples the keys at the start of each block of the key index, spreading
+  // the size of the rowset (including its deltas) across the samples.
+  Status SampleKeys(vector<RowSetKeySample>* samples) const OVERRIDE;
+
   size_t DeltaMemStoreSize() const OVERRIDE;
 
   bool DeltaMemStoreEmpty() const OVERRIDE;
@@ -362,6 +366,8 @@ class DiskRowSet : public RowSet {
  private:
   FRIEND_TEST(TestRowSet, TestRowSetUpdate);
   FRIEND_TEST(TestRowSet, TestDMSFlush);
+  FRIEND_TEST(TestRowSet, TestZoneMapsDuringDMSFlush);
+  FRIEND_TEST(TestRowSetStringValues, TestDictionaryPredicatesDuringDMSFlush);
   FRIEND_TEST(TestCompaction, TestOneToOne);
 
   friend class CompactionInput;
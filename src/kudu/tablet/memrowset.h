@@ -224,6 +224,11 @@ class MemRowSet : public RowSet,
     return 0;
   }
 
+  // MemRowSets have nothing on disk, so they contribute no samples.
+  Status SampleKeys(vector<RowSetKeySample>* samples) const OVERRIDE {
+    return Status::OK();
+  }
+
   boost::mutex *compact_flush_lock() OVERRIDE {
     return &compact_flush_lock_;
   }
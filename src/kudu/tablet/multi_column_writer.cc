@@ -59,6 +59,9 @@ Status MultiColumnWriter::Open() {
     /// Set the column storage attributes.
     opts.storage_attributes = col.attributes();
 
+    // Write min/max statistics so that scans may skip blocks.
+    opts.write_zone_maps = true;
+
     // If the schema has a single PK and this is the PK col
     if (i == 0 && schema_->num_key_columns() == 1) {
       opts.write_validx = true;
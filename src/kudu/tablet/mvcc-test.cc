@@ -534,6 +534,76 @@ TEST_F(MvccTest, TestCleanTimeCoalescingOnOfflineTransactions) {
   ASSERT_EQ(mgr.cur_snap_.ToString(), "MvccSnapshot[committed={T|T < 15 or (T in {15})}]");
 }
 
+// Tests that the safe time sent to followers never passes an in-flight
+// transaction, and that later transactions start after it.
+TEST_F(MvccTest, TestSafeTimeForFollowers) {
+  MvccManager mgr(clock_.get());
+
+  Timestamp tx1 = mgr.StartTransaction();
+  ASSERT_EQ(mgr.GetSafeTimeForFollowers().CompareTo(tx1), 0);
+
+  mgr.StartApplyingTransaction(tx1);
+  mgr.CommitTransaction(tx1);
+  Timestamp safe_time = mgr.GetSafeTimeForFollowers();
+  ASSERT_GT(safe_time.CompareTo(tx1), 0);
+
+  // Advancing the safe time doesn't affect the clean time.
+  ASSERT_EQ(mgr.GetCleanTimestamp().CompareTo(safe_time), -1);
+
+  Timestamp tx2 = mgr.StartTransaction();
+  ASSERT_GT(tx2.CompareTo(safe_time), 0);
+  ASSERT_EQ(mgr.GetSafeTimeForFollowers().CompareTo(tx2), 0);
+  mgr.AbortTransaction(tx2);
+
+  Timestamp tx3 = mgr.StartTransactionAtLatest();
+  ASSERT_GT(tx3.CompareTo(safe_time), 0);
+  mgr.AbortTransaction(tx3);
+}
+
+// Tests a leader change while a follower has a safe time from the old leader:
+// the follower must still be able to start transactions replicated by the new
+// leader below that safe time, and the new leader must only assign timestamps
+// after it.
+TEST_F(MvccTest, TestFollowerSafeTimeAcrossLeaderChange) {
+  scoped_refptr<Clock> hybrid_clock(new HybridClock());
+  ASSERT_OK(hybrid_clock->Init());
+  MvccManager old_leader(hybrid_clock);
+  MvccManager follower(hybrid_clock);
+  MvccManager new_leader(hybrid_clock);
+
+  // The safe time is capped at the earliest possible current time.
+  Timestamp safe_time = old_leader.GetSafeTimeForFollowers();
+  ASSERT_LE(safe_time.CompareTo(hybrid_clock->NowEarliest()), 0);
+
+  follower.AdvanceFollowerSafeTime(safe_time);
+  ASSERT_EQ(0, follower.GetSafeTimestampForReads().CompareTo(safe_time));
+  // The clean time isn't affected.
+  ASSERT_LT(follower.GetCleanTimestamp().CompareTo(safe_time), 0);
+
+  // A write replicated by a leader which never saw the safe time may have a
+  // lower timestamp. The follower must start it, and can't read past it
+  // without waiting until it commits.
+  Timestamp replicated(safe_time.value() - 1);
+  ASSERT_OK(follower.StartTransactionAtTimestamp(replicated));
+  ASSERT_EQ(0, follower.GetSafeTimestampForReads().CompareTo(replicated));
+  follower.StartApplyingTransaction(replicated);
+  follower.CommitTransaction(replicated);
+  ASSERT_GE(follower.GetSafeTimestampForReads().CompareTo(safe_time), 0);
+
+  // Once it has become leader, a replica only assigns timestamps after the
+  // latest time its clock could have been at.
+  Timestamp now_latest = hybrid_clock->NowLatest();
+  new_leader.AdvanceTimestampsForNewLeader();
+  Timestamp tx1 = new_leader.StartTransaction();
+  ASSERT_GT(tx1.CompareTo(now_latest), 0);
+  ASSERT_GT(tx1.CompareTo(safe_time), 0);
+  new_leader.AbortTransaction(tx1);
+
+  Timestamp tx2 = new_leader.StartTransactionAtLatest();
+  ASSERT_GT(tx2.CompareTo(now_latest), 0);
+  new_leader.AbortTransaction(tx2);
+}
+
 // Various death tests which ensure that we can only transition in one of the following
 // valid ways:
 //
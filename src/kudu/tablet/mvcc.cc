@@ -34,6 +34,9 @@ namespace kudu { namespace tablet {
 
 MvccManager::MvccManager(const scoped_refptr<server::Clock>& clock)
   : no_new_transactions_at_or_before_(Timestamp::kMin),
+    safe_time_for_followers_(Timestamp::kMin),
+    new_leader_timestamps_after_(Timestamp::kMin),
+    follower_safe_time_(Timestamp::kMin),
     earliest_in_flight_(Timestamp::kMax),
     clock_(clock) {
   cur_snap_.all_committed_before_ = Timestamp::kInitialTimestamp;
@@ -43,10 +46,22 @@ MvccManager::MvccManager(const scoped_refptr<server::Clock>& clock)
 Timestamp MvccManager::StartTransaction() {
   while (true) {
     Timestamp now = clock_->Now();
-    boost::lock_guard<LockType> l(lock_);
-    if (PREDICT_TRUE(InitTransactionUnlocked(now))) {
-      return now;
+    Timestamp wait_until;
+    {
+      boost::lock_guard<LockType> l(lock_);
+      if (PREDICT_TRUE(now.CompareTo(new_leader_timestamps_after_) > 0)) {
+        if (PREDICT_TRUE(now.CompareTo(safe_time_for_followers_) > 0 &&
+                         InitTransactionUnlocked(now))) {
+          return now;
+        }
+        continue;
+      }
+      wait_until = new_leader_timestamps_after_;
     }
+    // This replica just became leader; wait out the clock error rather than
+    // spinning.
+    WARN_NOT_OK(clock_->WaitUntilAfterLocally(wait_until, MonoTime::Max()),
+                "Unable to wait for the clock after becoming leader");
   }
   // dummy return to avoid compiler warnings
   LOG(FATAL) << "Unreachable, added to avoid compiler warning.";
@@ -56,7 +71,9 @@ Timestamp MvccManager::StartTransaction() {
 Timestamp MvccManager::StartTransactionAtLatest() {
   boost::lock_guard<LockType> l(lock_);
   Timestamp now_latest = clock_->NowLatest();
-  while (PREDICT_FALSE(!InitTransactionUnlocked(now_latest))) {
+  while (PREDICT_FALSE(now_latest.CompareTo(safe_time_for_followers_) <= 0 ||
+                       now_latest.CompareTo(new_leader_timestamps_after_) <= 0 ||
+                       !InitTransactionUnlocked(now_latest))) {
     now_latest = clock_->NowLatest();
   }
 
@@ -235,6 +252,49 @@ void MvccManager::OfflineAdjustSafeTime(Timestamp safe_time) {
   AdjustCleanTime();
 }
 
+Timestamp MvccManager::GetSafeTimeForFollowers() {
+  boost::lock_guard<LockType> l(lock_);
+  // Another thread may have taken a timestamp from the clock before this and
+  // not yet started its transaction; it will have to take a new one.
+  Timestamp now_earliest = clock_->NowEarliest();
+  if (safe_time_for_followers_.CompareTo(now_earliest) < 0) {
+    safe_time_for_followers_ = now_earliest;
+  }
+  if (earliest_in_flight_.CompareTo(safe_time_for_followers_) < 0) {
+    return earliest_in_flight_;
+  }
+  return safe_time_for_followers_;
+}
+
+void MvccManager::AdvanceTimestampsForNewLeader() {
+  // The safe times sent by previous leaders were below the true time when
+  // they were sent, so they're below the latest time this clock could be at.
+  Timestamp now_latest = clock_->NowLatest();
+  boost::lock_guard<LockType> l(lock_);
+  if (new_leader_timestamps_after_.CompareTo(now_latest) < 0) {
+    new_leader_timestamps_after_ = now_latest;
+  }
+}
+
+void MvccManager::AdvanceFollowerSafeTime(Timestamp safe_time) {
+  boost::lock_guard<LockType> l(lock_);
+  if (follower_safe_time_.CompareTo(safe_time) < 0) {
+    follower_safe_time_ = safe_time;
+  }
+}
+
+Timestamp MvccManager::GetSafeTimestampForReads() const {
+  boost::lock_guard<LockType> l(lock_);
+  Timestamp safe_time = follower_safe_time_;
+  if (earliest_in_flight_.CompareTo(safe_time) < 0) {
+    safe_time = earliest_in_flight_;
+  }
+  if (cur_snap_.all_committed_before_.CompareTo(safe_time) > 0) {
+    return cur_snap_.all_committed_before_;
+  }
+  return safe_time;
+}
+
 // Remove any elements from 'v' which are < the given watermark.
 static void FilterTimestamps(std::vector<Timestamp::val_type>* v,
                              Timestamp::val_type watermark) {
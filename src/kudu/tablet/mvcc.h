@@ -240,6 +240,40 @@ class MvccManager {
   // manager can trim state.
   void OfflineAdjustSafeTime(Timestamp safe_time);
 
+  // Used on the leader to get the safe time to send to followers: a timestamp
+  // such that every transaction with a lower timestamp has committed or
+  // aborted, and no transaction will later be started at it or below.
+  //
+  // Transactions which take their timestamps from the clock after this call
+  // are given later ones. Unlike CommitTransaction(), this doesn't advance
+  // the clean time, so transactions which are replicated with pre-assigned
+  // timestamps but haven't started yet are unaffected.
+  //
+  // The safe time is at most the clock's NowEarliest(), so that it's below
+  // any timestamp a later leader assigns. See AdvanceTimestampsForNewLeader().
+  Timestamp GetSafeTimeForFollowers();
+
+  // Used when this replica becomes leader. Transactions which take their
+  // timestamps from the clock are made to start after the clock's current
+  // NowLatest(), waiting out its error bound if needed, so that they can't
+  // be assigned timestamps below a safe time sent by a previous leader.
+  void AdvanceTimestampsForNewLeader();
+
+  // Used on followers to advance the safe time to 'safe_time' sent by the
+  // leader, once every transaction below it has been started.
+  //
+  // Unlike OfflineAdjustSafeTime(), this neither advances the clean time nor
+  // keeps transactions from starting below 'safe_time', so that a
+  // transaction replicated by a new leader can always be started. It only
+  // bounds the timestamp returned by GetSafeTimestampForReads().
+  void AdvanceFollowerSafeTime(Timestamp safe_time);
+
+  // Returns a timestamp below which every transaction has committed, so that
+  // a snapshot at it can be read without waiting. This is the clean
+  // timestamp or, on a follower, the safe time sent by the leader if there
+  // are no transactions in flight below it.
+  Timestamp GetSafeTimestampForReads() const;
+
   // Take a snapshot of the current MVCC state, which indicates which
   // transactions have been committed at the time of this call.
   void TakeSnapshot(MvccSnapshot *snapshot) const;
@@ -382,6 +416,18 @@ class MvccManager {
   // to or lower than this one.
   Timestamp no_new_transactions_at_or_before_;
 
+  // The latest safe time returned by GetSafeTimeForFollowers(). Transactions
+  // which take their timestamps from the clock must start after it.
+  Timestamp safe_time_for_followers_;
+
+  // The clock's NowLatest() when this replica last became leader.
+  // Transactions which take their timestamps from the clock must start
+  // after it.
+  Timestamp new_leader_timestamps_after_;
+
+  // The latest safe time passed to AdvanceFollowerSafeTime().
+  Timestamp follower_safe_time_;
+
   // The minimum timestamp in timestamps_in_flight_, or Timestamp::kMax
   // if that set is empty. This is cached in order to avoid having to iterate
   // over timestamps_in_flight_ on every commit.
@@ -14,6 +14,7 @@
 
 #include "kudu/tablet/rowset.h"
 
+#include <algorithm>
 #include <limits>
 #include <string>
 #include <vector>
@@ -205,6 +206,16 @@ uint64_t DuplicatingRowSet::EstimateOnDiskSize() const {
   return size;
 }
 
+Status DuplicatingRowSet::SampleKeys(vector<RowSetKeySample>* samples) const {
+  // Like reads, sample the input rowsets, since the output may be partial.
+  // The inputs may overlap, so sort the combined samples.
+  BOOST_FOREACH(const shared_ptr<RowSet> &rs, old_rowsets_) {
+    RETURN_NOT_OK(rs->SampleKeys(samples));
+  }
+  std::sort(samples->begin(), samples->end(), RowSetKeySampleLessThan);
+  return Status::OK();
+}
+
 shared_ptr<RowSetMetadata> DuplicatingRowSet::metadata() {
   return shared_ptr<RowSetMetadata>(reinterpret_cast<RowSetMetadata *>(NULL));
 }
@@ -46,6 +46,19 @@ class RowSetKeyProbe;
 class RowSetMetadata;
 struct ProbeStats;
 
+// An encoded key sampled from a rowset, along with the estimated number of
+// bytes on disk taken up by the rows from that key up to the next sample.
+// See RowSet::SampleKeys().
+struct RowSetKeySample {
+  std::string encoded_key;
+  uint64_t size_bytes;
+};
+
+// Orders samples by key. Encoded keys compare bytewise.
+inline bool RowSetKeySampleLessThan(const RowSetKeySample& a, const RowSetKeySample& b) {
+  return a.encoded_key < b.encoded_key;
+}
+
 class RowSet {
  public:
   enum DeltaCompactionType {
@@ -114,6 +127,14 @@ class RowSet {
   // Estimate the number of bytes on-disk
   virtual uint64_t EstimateOnDiskSize() const = 0;
 
+  // Append to 'samples' a sample of the encoded keys in this rowset, in
+  // ascending order, which splits it into roughly evenly sized pieces.
+  // The sizes of the samples add up to about EstimateOnDiskSize().
+  //
+  // Rowsets which don't have an index over their keys (eg MemRowSet) may
+  // append no samples.
+  virtual Status SampleKeys(vector<RowSetKeySample>* samples) const = 0;
+
   // Return the lock used for including this DiskRowSet in a compaction.
   // This prevents multiple compactions and flushes from trying to include
   // the same rowset.
@@ -275,6 +296,8 @@ class DuplicatingRowSet : public RowSet {
 
   uint64_t EstimateOnDiskSize() const OVERRIDE;
 
+  Status SampleKeys(vector<RowSetKeySample>* samples) const OVERRIDE;
+
   string ToString() const OVERRIDE;
 
   virtual Status DebugDump(vector<string> *lines = NULL) OVERRIDE;
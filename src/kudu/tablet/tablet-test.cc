@@ -27,6 +27,9 @@
 #include "kudu/tablet/tablet-test-base.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/test_macros.h"
+#include "kudu/util/threadpool.h"
+
+DECLARE_int32(tablet_scan_parallelism);
 
 namespace kudu {
 namespace tablet {
@@ -444,6 +447,95 @@ TYPED_TEST(TestTablet, TestRowIteratorOrdered) {
 }
 
 
+// Test that scans which decode the rowsets in parallel on a thread pool
+// return the same rows, in the same order, as serial scans.
+TYPED_TEST(TestTablet, TestParallelScan) {
+  const int kNumRows = 1000;
+  const int kNumRowSets = 5;
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  for (int i = 0; i < kNumRowSets; i++) {
+    for (int j = 0; j < kNumRows; j++) {
+      if (j % (kNumRowSets + 1) == i) {
+        CHECK_OK(this->InsertTestRow(&writer, j, j));
+      }
+    }
+    ASSERT_OK(this->tablet()->Flush());
+  }
+  // Leave some rows in the MemRowSet.
+  for (int j = kNumRowSets; j < kNumRows; j += kNumRowSets + 1) {
+    CHECK_OK(this->InsertTestRow(&writer, j, j));
+  }
+
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("scan").set_max_threads(4).Build(&pool));
+
+  MvccSnapshot snap(*this->tablet()->mvcc_manager());
+  for (int order = Tablet::UNORDERED; order <= Tablet::ORDERED; order++) {
+    vector<string> serial_rows;
+    {
+      gscoped_ptr<RowwiseIterator> iter;
+      ASSERT_OK(this->tablet()->NewRowIterator(this->client_schema_, snap,
+                                               static_cast<Tablet::OrderMode>(order), &iter));
+      ASSERT_OK(iter->Init(NULL));
+      ASSERT_OK(IterateToStringList(iter.get(), &serial_rows));
+    }
+    ASSERT_EQ(kNumRows, serial_rows.size());
+
+    for (int parallelism = 1; parallelism <= kNumRowSets + 1; parallelism *= 2) {
+      FLAGS_tablet_scan_parallelism = parallelism;
+      gscoped_ptr<RowwiseIterator> iter;
+      ASSERT_OK(this->tablet()->NewRowIterator(this->client_schema_, snap,
+                                               static_cast<Tablet::OrderMode>(order),
+                                               pool.get(), &iter));
+      ASSERT_OK(iter->Init(NULL));
+      vector<string> rows;
+      ASSERT_OK(IterateToStringList(iter.get(), &rows));
+      ASSERT_EQ(JoinStrings(serial_rows, "\n"), JoinStrings(rows, "\n"))
+        << "order " << order << ", parallelism " << parallelism;
+    }
+  }
+}
+
+// Test that SplitKeyRange() splits the tablet at the keys sampled from its
+// rowsets, honoring the target size and the key bounds.
+TYPED_TEST(TestTablet, TestSplitKeyRange) {
+  const int kNumRowSets = 5;
+  const int kRowsPerRowSet = 100;
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  for (int i = 0; i < kNumRowSets; i++) {
+    for (int j = 0; j < kRowsPerRowSet; j++) {
+      int row = i * kRowsPerRowSet + j;
+      CHECK_OK(this->InsertTestRow(&writer, row, row));
+    }
+    ASSERT_OK(this->tablet()->Flush());
+  }
+
+  // A tiny target splits the tablet at the start of every rowset but the first.
+  vector<string> split_keys;
+  ASSERT_OK(this->tablet()->SplitKeyRange(Slice(), Slice(), 1, &split_keys));
+  ASSERT_EQ(kNumRowSets - 1, split_keys.size());
+  for (int i = 1; i < split_keys.size(); i++) {
+    ASSERT_LT(Slice(split_keys[i - 1]).compare(split_keys[i]), 0);
+  }
+
+  // Bounding the range drops the split keys outside of it.
+  vector<string> bounded_split_keys;
+  ASSERT_OK(this->tablet()->SplitKeyRange(split_keys[0], split_keys[2], 1,
+                                          &bounded_split_keys));
+  ASSERT_EQ(1, bounded_split_keys.size());
+  ASSERT_EQ(split_keys[1], bounded_split_keys[0]);
+
+  // A target larger than the tablet doesn't split it at all.
+  split_keys.clear();
+  ASSERT_OK(this->tablet()->SplitKeyRange(Slice(), Slice(),
+                                          this->tablet()->EstimateOnDiskSize() + 1,
+                                          &split_keys));
+  ASSERT_EQ(0, split_keys.size());
+
+  ASSERT_TRUE(this->tablet()->SplitKeyRange(Slice(), Slice(), 0, &split_keys)
+              .IsInvalidArgument());
+}
+
 template<class SETUP>
 bool TestSetupExpectsNulls(int32_t key_idx) {
   return false;
@@ -26,6 +26,7 @@
 #include <vector>
 
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/row_changelist.h"
 #include "kudu/common/row_operations.h"
@@ -69,6 +70,14 @@ DEFINE_bool(tablet_do_dup_key_checks, true,
             "Use at your own risk!");
 TAG_FLAG(tablet_do_dup_key_checks, unsafe);
 
+DEFINE_int32(tablet_scan_parallelism, 4,
+             "Maximum number of rowsets of a tablet which an unordered scan decodes in "
+             "parallel on the tablet server's scan thread pool. Ordered scans decode all "
+             "of their rowsets in parallel, but buffer no more decoded blocks in total "
+             "than an unordered scan does, or one per rowset if that is more. Set to 1 "
+             "to disable parallel scans.");
+TAG_FLAG(tablet_scan_parallelism, advanced);
+
 DEFINE_int32(tablet_compaction_budget_mb, 128,
              "Budget for a single compaction");
 TAG_FLAG(tablet_compaction_budget_mb, experimental);
@@ -249,12 +258,20 @@ Status Tablet::NewRowIterator(const Schema &projection,
                               const MvccSnapshot &snap,
                               const OrderMode order,
                               gscoped_ptr<RowwiseIterator> *iter) const {
+  return NewRowIterator(projection, snap, order, NULL, iter);
+}
+
+Status Tablet::NewRowIterator(const Schema &projection,
+                              const MvccSnapshot &snap,
+                              const OrderMode order,
+                              ThreadPool* scan_pool,
+                              gscoped_ptr<RowwiseIterator> *iter) const {
   CHECK_EQ(state_, kOpen);
   if (metrics_) {
     metrics_->scans_started->Increment();
   }
   VLOG(2) << "Created new Iterator under snap: " << snap.ToString();
-  iter->reset(new Iterator(this, projection, snap, order));
+  iter->reset(new Iterator(this, projection, snap, order, scan_pool));
   return Status::OK();
 }
 
@@ -1494,6 +1511,53 @@ size_t Tablet::EstimateOnDiskSize() const {
   return ret;
 }
 
+Status Tablet::SplitKeyRange(const Slice& start_key,
+                             const Slice& stop_key,
+                             uint64_t target_chunk_size,
+                             vector<string>* split_keys) const {
+  if (target_chunk_size == 0) {
+    return Status::InvalidArgument("Target chunk size must be positive");
+  }
+
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  // Sample the rowsets which overlap the range.
+  vector<RowSetKeySample> samples;
+  BOOST_FOREACH(const shared_ptr<RowSet> &rowset, comps->rowsets->all_rowsets()) {
+    Slice min_key, max_key;
+    RETURN_NOT_OK(rowset->GetBounds(&min_key, &max_key));
+    if ((!start_key.empty() && max_key.compare(start_key) < 0) ||
+        (!stop_key.empty() && min_key.compare(stop_key) >= 0)) {
+      continue;
+    }
+    RETURN_NOT_OK(rowset->SampleKeys(&samples));
+  }
+  std::sort(samples.begin(), samples.end(), RowSetKeySampleLessThan);
+
+  // Walk the samples in key order, starting a new chunk whenever the current
+  // one has reached the target size.
+  uint64_t chunk_size = 0;
+  BOOST_FOREACH(const RowSetKeySample& sample, samples) {
+    Slice key(sample.encoded_key);
+    if (!start_key.empty() && key.compare(start_key) <= 0) {
+      // The rows of the last sample before the range may extend into it.
+      chunk_size = sample.size_bytes;
+      continue;
+    }
+    if (!stop_key.empty() && key.compare(stop_key) >= 0) {
+      break;
+    }
+    if (chunk_size >= target_chunk_size &&
+        (split_keys->empty() || split_keys->back() != sample.encoded_key)) {
+      split_keys->push_back(sample.encoded_key);
+      chunk_size = 0;
+    }
+    chunk_size += sample.size_bytes;
+  }
+  return Status::OK();
+}
+
 size_t Tablet::DeltaMemStoresSize() const {
   scoped_refptr<TabletComponents> comps;
   GetComponents(&comps);
@@ -1711,11 +1775,13 @@ void Tablet::PrintRSLayout(ostream* o) {
 Tablet::Iterator::Iterator(const Tablet *tablet,
                            const Schema &projection,
                            const MvccSnapshot &snap,
-                           const OrderMode order)
+                           const OrderMode order,
+                           ThreadPool* scan_pool)
     : tablet_(tablet),
       projection_(projection),
       snap_(snap),
       order_(order),
+      scan_pool_(scan_pool),
       arena_(256, 4096),
       encoder_(&tablet_->key_schema(), &arena_) {
 }
@@ -1737,6 +1803,22 @@ Status Tablet::Iterator::Init(ScanSpec *spec) {
   RETURN_NOT_OK(tablet_->CaptureConsistentIterators(
       &projection_, snap_, spec, &iters));
 
+  // Decode the rowsets in parallel on the scan pool. A union reads them one
+  // after another, so only a window of them needs to be decoded ahead. A
+  // merge reads from all of them at once, so they are all decoded ahead, but
+  // they share the buffer space of the union's window so that the memory
+  // used doesn't grow with the number of rowsets.
+  if (scan_pool_ != NULL && FLAGS_tablet_scan_parallelism > 1 && iters.size() > 1) {
+    int parallelism = FLAGS_tablet_scan_parallelism;
+    int max_buffered_blocks = PrefetchingIterator::kDefaultMaxBufferedBlocks;
+    if (order_ == ORDERED) {
+      max_buffered_blocks = std::max<int>(1, parallelism * max_buffered_blocks / iters.size());
+      parallelism = iters.size();
+    }
+    PrefetchingIterator::WrapForParallelScan(scan_pool_, parallelism, max_buffered_blocks,
+                                             &iters);
+  }
+
   switch (order_) {
     case ORDERED:
       iter_.reset(new MergeIterator(projection_, iters));
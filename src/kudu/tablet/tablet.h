@@ -43,6 +43,7 @@ namespace kudu {
 class MemTracker;
 class MetricEntity;
 class RowChangeList;
+class ThreadPool;
 class UnionIterator;
 
 namespace log {
@@ -201,6 +202,16 @@ class Tablet {
                         const OrderMode order,
                         gscoped_ptr<RowwiseIterator> *iter) const;
 
+  // Like the above, but if 'scan_pool' is non-NULL, the iterator decodes up
+  // to --tablet_scan_parallelism of the tablet's rowsets in parallel on it.
+  // The rows are returned in the same order either way. 'scan_pool' must
+  // outlive the iterator.
+  Status NewRowIterator(const Schema &projection,
+                        const MvccSnapshot &snap,
+                        const OrderMode order,
+                        ThreadPool* scan_pool,
+                        gscoped_ptr<RowwiseIterator> *iter) const;
+
   // Flush the current MemRowSet for this tablet to disk. This swaps
   // in a new (initially empty) MemRowSet in its place.
   //
@@ -264,6 +275,18 @@ class Tablet {
   // Estimate the total on-disk size of this tablet, in bytes.
   size_t EstimateOnDiskSize() const;
 
+  // Split the encoded primary key range ['start_key', 'stop_key') into chunks
+  // of roughly 'target_chunk_size' bytes on disk, appending the keys at which
+  // the chunks begin (other than the first) to 'split_keys', in ascending
+  // order. An empty 'start_key' or 'stop_key' leaves that end unbounded.
+  //
+  // The split keys are sampled from the key indexes of the rowsets, so the
+  // chunk sizes are approximate. Rows in the MemRowSet aren't accounted for.
+  Status SplitKeyRange(const Slice& start_key,
+                       const Slice& stop_key,
+                       uint64_t target_chunk_size,
+                       vector<string>* split_keys) const;
+
   // Get the total size of all the DMS
   size_t DeltaMemStoresSize() const;
 
@@ -599,12 +622,14 @@ class Tablet::Iterator : public RowwiseIterator {
   Iterator(const Tablet *tablet,
            const Schema &projection,
            const MvccSnapshot &snap,
-           const OrderMode order);
+           const OrderMode order,
+           ThreadPool* scan_pool);
 
   const Tablet *tablet_;
   Schema projection_;
   const MvccSnapshot snap_;
   const OrderMode order_;
+  ThreadPool* const scan_pool_;
   gscoped_ptr<RowwiseIterator> iter_;
 
   // TODO: we could probably share an arena with the Scanner object inside the
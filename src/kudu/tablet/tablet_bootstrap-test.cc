@@ -27,6 +27,9 @@
 #include "kudu/tablet/tablet_bootstrap.h"
 #include "kudu/tablet/tablet-test-util.h"
 #include "kudu/tablet/tablet_metadata.h"
+#include "kudu/util/path_util.h"
+
+DECLARE_bool(tablet_bootstrap_pipeline_log_reads);
 
 namespace kudu {
 
@@ -171,6 +174,68 @@ TEST_F(BootstrapTest, TestBootstrap) {
   ASSERT_EQ(1, results.size());
 }
 
+// Tests a bootstrap which replays many segments, with each operation's commit
+// in the segment after its replicate, so that the replay of each segment
+// overlaps with the read of the next one.
+TEST_F(BootstrapTest, TestBootstrapManySegments) {
+  const int kNumSegments = 10;
+  BuildLog();
+
+  for (int i = 0; i < kNumSegments; i++) {
+    AppendReplicateBatch(MakeOpId(1, current_index_));
+    ASSERT_OK(RollLog());
+    AppendCommit(MakeOpId(1, current_index_));
+    current_index_++;
+  }
+
+  shared_ptr<Tablet> tablet;
+  ConsensusBootstrapInfo boot_info;
+  ASSERT_OK(BootstrapTestTablet(-1, -1, &tablet, &boot_info));
+
+  vector<string> results;
+  IterateTabletRows(tablet.get(), &results);
+  ASSERT_EQ(kNumSegments, results.size());
+  ASSERT_EQ(current_index_ - 1, boot_info.last_committed_id.index());
+}
+
+// Tests that a bootstrap which fails to read a segment replays the segments
+// before it and then fails, whether the segments are read ahead of their
+// replay or inline.
+TEST_F(BootstrapTest, TestFailedSegmentRead) {
+  const int kNumSegments = 4;
+  BuildLog();
+
+  for (int i = 0; i < kNumSegments; i++) {
+    AppendReplicateBatch(MakeOpId(1, current_index_));
+    ASSERT_OK(RollLog());
+    AppendCommit(MakeOpId(1, current_index_));
+    current_index_++;
+  }
+
+  // Corrupt the first entry of the second segment. The segment has a footer,
+  // so the corruption isn't mistaken for a partially written entry.
+  log::SegmentSequence segments;
+  ASSERT_OK(log_->GetLogReader()->GetSegmentsSnapshot(&segments));
+  ASSERT_GT(segments.size(), 2);
+  const scoped_refptr<ReadableLogSegment>& segment = segments[1];
+  ASSERT_TRUE(segment->HasFooter());
+  ASSERT_OK(log::CorruptLogFile(env_.get(), segment->path(), log::FLIP_BYTE,
+                                segment->first_entry_offset() + log::kEntryHeaderSize + 1));
+
+  // The failed bootstrap leaves the segments in the recovery directory, so
+  // the second attempt reads the same ones.
+  for (int i = 0; i < 2; i++) {
+    FLAGS_tablet_bootstrap_pipeline_log_reads = i == 0;
+    SCOPED_TRACE(FLAGS_tablet_bootstrap_pipeline_log_reads);
+    shared_ptr<Tablet> tablet;
+    ConsensusBootstrapInfo boot_info;
+    Status s = BootstrapTestTablet(-1, -1, &tablet, &boot_info);
+    ASSERT_TRUE(s.IsCorruption()) << "Expected corruption: " << s.ToString();
+    ASSERT_STR_CONTAINS(s.ToString(), "Error reading Log Segment");
+    ASSERT_STR_CONTAINS(s.ToString(), BaseName(segment->path()));
+  }
+}
+
 // Tests attempting a local bootstrap of a tablet that was in the middle of a
 // remote bootstrap before "crashing".
 TEST_F(BootstrapTest, TestIncompleteRemoteBootstrap) {
@@ -14,6 +14,7 @@
 
 #include "kudu/tablet/tablet_bootstrap.h"
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <gflags/gflags.h>
 #include <map>
@@ -46,6 +47,7 @@
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
 #include "kudu/tablet/transactions/write_transaction.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
@@ -53,6 +55,7 @@
 #include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_bool(skip_remove_old_recovery_dir, false,
             "Skip removing WAL recovery dir after startup. (useful for debugging)");
@@ -64,6 +67,11 @@ DEFINE_double(fault_crash_during_log_replay, 0.0,
               "(For testing only!)");
 TAG_FLAG(fault_crash_during_log_replay, unsafe);
 
+DEFINE_bool(tablet_bootstrap_pipeline_log_reads, true,
+            "Whether to read and decode the next WAL segment on a separate thread "
+            "while the entries of the current one are replayed during tablet bootstrap.");
+TAG_FLAG(tablet_bootstrap_pipeline_log_reads, advanced);
+
 DECLARE_int32(max_clock_sync_error_usec);
 
 namespace kudu {
@@ -1000,6 +1008,38 @@ void TabletBootstrap::DumpReplayStateToLog(const ReplayState& state) {
   }
 }
 
+// The entries of a log segment, decoded ahead of their replay.
+struct SegmentEntries {
+  explicit SegmentEntries(const scoped_refptr<ReadableLogSegment>& seg)
+    : segment(seg),
+      done(1) {
+  }
+
+  ~SegmentEntries() {
+    STLDeleteElements(&entries);
+  }
+
+  scoped_refptr<ReadableLogSegment> segment;
+  vector<LogEntryPB*> entries;
+  Status read_status;
+
+  // Counted down once 'entries' and 'read_status' have been filled in.
+  CountDownLatch done;
+};
+
+static void ReadSegmentEntries(SegmentEntries* seg) {
+  seg->read_status = seg->segment->ReadEntries(&seg->entries);
+  seg->done.CountDown();
+}
+
+// Decode the entries of 'seg' on 'pool', or inline if there's no pool or it
+// won't take the task.
+static void SubmitReadSegmentEntries(ThreadPool* pool, SegmentEntries* seg) {
+  if (pool == NULL || !pool->SubmitFunc(boost::bind(&ReadSegmentEntries, seg)).ok()) {
+    ReadSegmentEntries(seg);
+  }
+}
+
 Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
   ReplayState state;
   log::SegmentSequence segments;
@@ -1024,12 +1064,36 @@ Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
   // writing.
   RETURN_NOT_OK_PREPEND(OpenNewLog(), "Failed to open new log");
 
-  int segment_count = 0;
-  BOOST_FOREACH(const scoped_refptr<ReadableLogSegment>& segment, segments) {
-    vector<LogEntryPB*> entries;
-    ElementDeleter deleter(&entries);
-    // TODO: Optimize this to not read the whole thing into memory?
-    Status read_status = segment->ReadEntries(&entries);
+  // Decode the entries of the next segment on a separate thread while the
+  // current one is being applied, so that replay isn't stalled on reading
+  // and parsing the log. At most two segments are held in memory at once.
+  //
+  // The pool is declared after the decoded segments so that it's shut down,
+  // and any read in progress finished, before they're freed.
+  gscoped_ptr<SegmentEntries> current;
+  gscoped_ptr<SegmentEntries> next;
+  gscoped_ptr<ThreadPool> read_pool;
+  if (FLAGS_tablet_bootstrap_pipeline_log_reads) {
+    WARN_NOT_OK(ThreadPoolBuilder("log-replay-read")
+                .set_max_threads(1)
+                .Build(&read_pool),
+                "Couldn't start log read thread, reading log segments inline");
+  }
+  if (!segments.empty()) {
+    next.reset(new SegmentEntries(segments[0]));
+    SubmitReadSegmentEntries(read_pool.get(), next.get());
+  }
+
+  for (int segment_count = 0; segment_count < segments.size(); segment_count++) {
+    current.reset(next.release());
+    if (segment_count + 1 < segments.size()) {
+      next.reset(new SegmentEntries(segments[segment_count + 1]));
+      SubmitReadSegmentEntries(read_pool.get(), next.get());
+    }
+    current->done.Wait();
+
+    const scoped_refptr<ReadableLogSegment>& segment = current->segment;
+    vector<LogEntryPB*>& entries = current->entries;
     for (int entry_idx = 0; entry_idx < entries.size(); ++entry_idx) {
       LogEntryPB* entry = entries[entry_idx];
       Status s = HandleEntry(&state, entry);
@@ -1044,7 +1108,7 @@ Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
 
       // If HandleEntry returns OK, then it has taken ownership of the entry.
       // So, we have to remove it from the entries vector to avoid it getting
-      // freed by ElementDeleter.
+      // freed when the decoded segment is destroyed.
       entries[entry_idx] = NULL;
     }
 
@@ -1053,11 +1117,11 @@ Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
     // TODO: this is sort of scary -- why doesn't LogReader expose an
     // entry-by-entry iterator-like API instead? Seems better to avoid
     // exposing the idea of segments to callers.
-    if (PREDICT_FALSE(!read_status.ok())) {
+    if (PREDICT_FALSE(!current->read_status.ok())) {
       return Status::Corruption(Substitute("Error reading Log Segment of tablet $0: $1 "
                                            "(Read up to entry $2 of segment $3, in path $4)",
                                            tablet_->tablet_id(),
-                                           read_status.ToString(),
+                                           current->read_status.ToString(),
                                            entries.size(),
                                            segment->header().sequence_number(),
                                            segment->path()));
@@ -1071,7 +1135,6 @@ Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
                                         segment_count + 1, log_reader_->num_segments(),
                                         stats_.ToString(),
                                         state.pending_replicates.size()));
-    segment_count++;
   }
 
   // If we have non-applied commits they all must belong to pending operations and
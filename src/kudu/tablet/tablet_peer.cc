@@ -506,6 +506,40 @@ Status TabletPeer::StartReplicaTransaction(const scoped_refptr<ConsensusRound>&
   return Status::OK();
 }
 
+Timestamp TabletPeer::GetSafeTimestampForFollowers() {
+  shared_ptr<Tablet> tablet = shared_tablet();
+  if (!tablet) {
+    return Timestamp::kInvalidTimestamp;
+  }
+  return tablet->mvcc_manager()->GetSafeTimeForFollowers();
+}
+
+void TabletPeer::AdvanceSafeTimestamp(const Timestamp& safe_time) {
+  // Replica transactions start their MVCC transactions as part of their
+  // prepare, which runs on the prepare pool in the order the transactions
+  // were submitted, so queueing behind them guarantees that every write below
+  // 'safe_time' has started.
+  WARN_NOT_OK(prepare_pool_->SubmitClosure(
+                  Bind(&TabletPeer::AdvanceSafeTimestampTask, Unretained(this), safe_time)),
+              "Unable to advance the safe time");
+}
+
+void TabletPeer::AdvanceSafeTimestampTask(Timestamp safe_time) {
+  shared_ptr<Tablet> tablet = shared_tablet();
+  if (!tablet) {
+    return;
+  }
+  tablet->mvcc_manager()->AdvanceFollowerSafeTime(safe_time);
+}
+
+void TabletPeer::BecomingLeader() {
+  shared_ptr<Tablet> tablet = shared_tablet();
+  if (!tablet) {
+    return;
+  }
+  tablet->mvcc_manager()->AdvanceTimestampsForNewLeader();
+}
+
 Status TabletPeer::NewLeaderTransactionDriver(gscoped_ptr<Transaction> transaction,
                                               scoped_refptr<TransactionDriver>* driver) {
   scoped_refptr<TransactionDriver> tx_driver = new TransactionDriver(
@@ -118,6 +118,17 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   virtual Status StartReplicaTransaction(
       const scoped_refptr<consensus::ConsensusRound>& round) OVERRIDE;
 
+  // Used by consensus on the leader to get the safe time to send to followers.
+  virtual Timestamp GetSafeTimestampForFollowers() OVERRIDE;
+
+  // Used by consensus on followers to advance the tablet's safe time to that
+  // sent by the leader.
+  virtual void AdvanceSafeTimestamp(const Timestamp& safe_time) OVERRIDE;
+
+  // Used by consensus when this replica becomes leader, so that the tablet
+  // doesn't assign timestamps below a safe time sent by a previous leader.
+  virtual void BecomingLeader() OVERRIDE;
+
   consensus::Consensus* consensus() {
     boost::lock_guard<simple_spinlock> lock(lock_);
     return consensus_.get();
@@ -248,6 +259,10 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   // Wait until the TabletPeer is fully in SHUTDOWN state.
   void WaitUntilShutdown();
 
+  // Runs on 'prepare_pool_' to advance the tablet's safe time after the
+  // replica transactions submitted before it have started.
+  void AdvanceSafeTimestampTask(Timestamp safe_time);
+
   // After bootstrap is complete and consensus is setup this initiates the transactions
   // that were not complete on bootstrap.
   // Not implemented yet. See .cc file.
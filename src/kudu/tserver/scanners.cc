@@ -19,11 +19,13 @@
 #include <tr1/memory>
 
 #include "kudu/common/iterator.h"
+#include "kudu/common/scan_aggregator.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/tserver/scanner_metrics.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/thread.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/metrics.h"
 
 DEFINE_int32(scanner_ttl_ms, 60000,
@@ -33,6 +35,10 @@ TAG_FLAG(scanner_ttl_ms, advanced);
 DEFINE_int32(scanner_gc_check_interval_us, 5 * 1000L *1000L, // 5 seconds
              "Number of microseconds in the interval at which we remove expired scanners");
 TAG_FLAG(scanner_ttl_ms, hidden);
+DEFINE_int32(scan_pool_max_threads, 0,
+             "Maximum number of threads used to decode the rowsets of tablets in parallel "
+             "during scans. 0 means the number of CPUs on the machine.");
+TAG_FLAG(scan_pool_max_threads, advanced);
 
 // TODO: would be better to scope this at a tablet level instead of
 // server level.
@@ -49,6 +55,11 @@ namespace tserver {
 
 ScannerManager::ScannerManager(const scoped_refptr<MetricEntity>& metric_entity)
   : shutdown_(false) {
+  ThreadPoolBuilder builder("scan");
+  if (FLAGS_scan_pool_max_threads > 0) {
+    builder.set_max_threads(FLAGS_scan_pool_max_threads);
+  }
+  CHECK_OK(builder.Build(&scan_pool_));
   if (metric_entity) {
     metrics_.reset(new ScannerMetrics(metric_entity));
     METRIC_active_scanners.InstantiateFunctionGauge(
@@ -189,6 +200,10 @@ void Scanner::Init(gscoped_ptr<RowwiseIterator> iter,
   spec_.reset(spec.release());
 }
 
+void Scanner::set_aggregator(gscoped_ptr<ScanAggregator> aggregator) {
+  aggregator_.swap(aggregator);
+}
+
 const ScanSpec& Scanner::spec() const {
   return *spec_;
 }
@@ -37,10 +37,12 @@ namespace kudu {
 
 class MetricEntity;
 class RowwiseIterator;
+class ScanAggregator;
 class ScanSpec;
 class Schema;
 class Status;
 class Thread;
+class ThreadPool;
 
 struct IteratorStats;
 
@@ -88,6 +90,9 @@ class ScannerManager {
   // Iterate through scanners and remove any which are past their TTL.
   void RemoveExpiredScanners();
 
+  // The pool on which scans decode the rowsets of a tablet in parallel.
+  ThreadPool* scan_pool() { return scan_pool_.get(); }
+
  private:
   FRIEND_TEST(ScannerTest, TestExpire);
 
@@ -105,6 +110,10 @@ class ScannerManager {
   mutable boost::mutex shutdown_lock_;
   boost::condition_variable shutdown_cv_;
 
+  // Declared before the scanner map so that the scanners' iterators, which
+  // may have tasks on the pool, are destroyed first.
+  gscoped_ptr<ThreadPool> scan_pool_;
+
   // Lock protecting the scanner map.
   mutable boost::shared_mutex lock_;
 
@@ -247,6 +256,13 @@ class Scanner {
   // See the note about 'set_client_projection_schema' above.
   const Schema* client_projection_schema() const { return client_projection_schema_.get(); }
 
+  // Associate an aggregator with the Scanner, which then accumulates the
+  // scanned rows rather than returning them. Takes ownership of 'aggregator'.
+  void set_aggregator(gscoped_ptr<ScanAggregator> aggregator);
+
+  // Returns the scan's aggregator, or NULL if the scan returns rows.
+  ScanAggregator* aggregator() { return aggregator_.get(); }
+
   // Get per-column stats for each iterator.
   void GetIteratorStats(std::vector<IteratorStats>* stats) const;
 
@@ -299,6 +315,10 @@ class Scanner {
 
   gscoped_ptr<RowwiseIterator> iter_;
 
+  // Accumulates the partial aggregates of an aggregating scan. Refers to the
+  // schema of 'iter_'.
+  gscoped_ptr<ScanAggregator> aggregator_;
+
   AutoReleasePool autorelease_pool_;
 
   // Arena used for allocations which must last as long as the scanner
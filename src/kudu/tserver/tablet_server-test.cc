@@ -1575,6 +1575,28 @@ TEST_F(TabletServerTest, TestInvalidScanRequest_WithIds) {
                            "User requests should not have Column IDs");
 }
 
+// Test that aggregates can only be grouped by a prefix of the primary key.
+TEST_F(TabletServerTest, TestInvalidScanRequest_GroupByNotKeyPrefix) {
+  ScanRequestPB req;
+  ScanResponsePB resp;
+  RpcController rpc;
+
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+  scan->add_group_by_columns("int_val");
+  scan->add_aggregates()->set_function(AggregatePB::COUNT);
+  req.set_call_seq_id(0);
+
+  SCOPED_TRACE(req.DebugString());
+  ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+  SCOPED_TRACE(resp.DebugString());
+  ASSERT_TRUE(resp.has_error());
+  ASSERT_EQ(TabletServerErrorPB::INVALID_SCAN_SPEC, resp.error().code());
+  ASSERT_STR_CONTAINS(resp.error().status().message(),
+                      "Group-by columns must be a prefix of the primary key");
+}
+
 // Test scanning a tablet that has no entries.
 TEST_F(TabletServerTest, TestScan_NoResults) {
   ScanRequestPB req;
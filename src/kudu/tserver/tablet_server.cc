@@ -78,6 +78,8 @@ Status TabletServer::Init() {
   CHECK(!initted_);
 
   cfile::BlockCache::GetSingleton()->StartInstrumentation(metric_entity());
+  cfile::BlockCache::GetSingleton(cfile::BlockCache::HIGH_PRIORITY)->StartInstrumentation(
+      metric_entity());
 
   // Validate that the passed master address actually resolves.
   // We don't validate that we can connect at this point -- it should
@@ -21,14 +21,17 @@
 #include <vector>
 
 #include "kudu/common/iterator.h"
+#include "kudu/common/scan_aggregator.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/consensus.h"
+#include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/escaping.h"
+#include "kudu/gutil/strings/join.h"
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/server/hybrid_clock.h"
@@ -292,8 +295,10 @@ class RpcTransactionCompletionCallback : public TransactionCompletionCallback {
 // Generic interface to handle scan results.
 class ScanResultCollector {
  public:
-  virtual void HandleRowBlock(const Schema* client_projection_schema,
-                              const RowBlock& row_block) = 0;
+  // Handles the selected rows of 'row_block'. On failure, the collector must
+  // not be used further, and the scan request fails with the returned status.
+  virtual Status HandleRowBlock(const Schema* client_projection_schema,
+                                const RowBlock& row_block) = 0;
 
   // Returns number of times HandleRowBlock() was called.
   virtual int BlocksProcessed() const = 0;
@@ -327,6 +332,31 @@ void SetLastRow(const RowBlock& row_block, faststring* last_primary_key) {
   }
 }
 
+// Hands the results of 'aggregator' to 'collector' as a single row block.
+Status CollectAggregates(const ScanAggregator& aggregator, ScanResultCollector* collector) {
+  if (aggregator.num_groups() == 0) {
+    return Status::OK();
+  }
+  Arena arena(32 * 1024, 1 * 1024 * 1024);
+  RowBlock block(aggregator.result_schema(), aggregator.num_groups(), &arena);
+  aggregator.ExportResults(&block);
+  return collector->HandleRowBlock(NULL, block);
+}
+
+// Hands the groups of 'aggregator' which are finished to 'collector', and
+// removes them, so that only a bounded number of groups is held while
+// scanning. The client merges partial results of the same group.
+Status CollectFinishedAggregates(ScanAggregator* aggregator, ScanResultCollector* collector) {
+  size_t num_finished = aggregator->num_finished_groups();
+  if (num_finished == 0) {
+    return Status::OK();
+  }
+  Arena arena(32 * 1024, 1 * 1024 * 1024);
+  RowBlock block(aggregator->result_schema(), num_finished, &arena);
+  aggregator->ExportFinishedGroups(&block);
+  return collector->HandleRowBlock(NULL, block);
+}
+
 }  // namespace
 
 // Copies the scan result to the given row block PB and data buffers.
@@ -347,13 +377,14 @@ class ScanResultCopier : public ScanResultCollector {
         num_rows_returned_(0) {
   }
 
-  virtual void HandleRowBlock(const Schema* client_projection_schema,
-                              const RowBlock& row_block) OVERRIDE {
+  virtual Status HandleRowBlock(const Schema* client_projection_schema,
+                                const RowBlock& row_block) OVERRIDE {
     blocks_processed_++;
     num_rows_returned_ += row_block.selection_vector()->CountSelected();
     SerializeRowBlock(row_block, rowblock_pb_, client_projection_schema,
                       rows_data_, indirect_data_);
     SetLastRow(row_block, &last_primary_key_);
+    return Status::OK();
   }
 
   virtual int BlocksProcessed() const OVERRIDE { return blocks_processed_; }
@@ -382,6 +413,49 @@ class ScanResultCopier : public ScanResultCollector {
   DISALLOW_COPY_AND_ASSIGN(ScanResultCopier);
 };
 
+// Copies the scan result into a ColumnarRowBlockEncoder.
+//
+// This is used in place of ScanResultCopier when the client asked for the
+// columnar layout.
+class ColumnarScanResultCopier : public ScanResultCollector {
+ public:
+  ColumnarScanResultCopier()
+      : blocks_processed_(0) {
+  }
+
+  virtual Status HandleRowBlock(const Schema* client_projection_schema,
+                                const RowBlock& row_block) OVERRIDE {
+    blocks_processed_++;
+    RETURN_NOT_OK(encoder_.AppendRowBlock(row_block, client_projection_schema));
+    SetLastRow(row_block, &last_primary_key_);
+    return Status::OK();
+  }
+
+  virtual int BlocksProcessed() const OVERRIDE { return blocks_processed_; }
+
+  // Returns number of bytes buffered to return.
+  virtual int64_t ResponseSize() const OVERRIDE {
+    return encoder_.buffered_size();
+  }
+
+  virtual const faststring& last_primary_key() const OVERRIDE {
+    return last_primary_key_;
+  }
+
+  virtual int64_t NumRowsReturned() const OVERRIDE {
+    return encoder_.num_rows();
+  }
+
+  const ColumnarRowBlockEncoder& encoder() const { return encoder_; }
+
+ private:
+  ColumnarRowBlockEncoder encoder_;
+  int blocks_processed_;
+  faststring last_primary_key_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnarScanResultCopier);
+};
+
 // Checksums the scan result.
 class ScanResultChecksummer : public ScanResultCollector {
  public:
@@ -391,8 +465,8 @@ class ScanResultChecksummer : public ScanResultCollector {
         blocks_processed_(0) {
   }
 
-  virtual void HandleRowBlock(const Schema* client_projection_schema,
-                              const RowBlock& row_block) OVERRIDE {
+  virtual Status HandleRowBlock(const Schema* client_projection_schema,
+                                const RowBlock& row_block) OVERRIDE {
     blocks_processed_++;
     if (!client_projection_schema) {
       client_projection_schema = &row_block.schema();
@@ -406,6 +480,7 @@ class ScanResultChecksummer : public ScanResultCollector {
     }
     // Find the last selected row and save its encoded key.
     SetLastRow(row_block, &encoded_last_row_);
+    return Status::OK();
   }
 
   virtual int BlocksProcessed() const OVERRIDE { return blocks_processed_; }
@@ -758,6 +833,27 @@ void ConsensusServiceImpl::UpdateConsensus(const ConsensusRequestPB* req,
   // Submit the update directly to the TabletPeer's Consensus instance.
   scoped_refptr<Consensus> consensus;
   if (!GetConsensusOrRespond(tablet_peer, resp, context, &consensus)) return;
+
+  // If the leader sent the ops in a sidecar, parse them into a copy of the
+  // request so that consensus handles them as usual. The copy is cheap, since
+  // the request itself carries no ops in that case.
+  ConsensusRequestPB req_with_ops;
+  if (req->has_ops_sidecar_idx()) {
+    Slice ops;
+    Status s = context->GetInboundSidecar(req->ops_sidecar_idx(), &ops);
+    if (s.ok()) {
+      req_with_ops.CopyFrom(*req);
+      s = consensus::ParseOpsSidecar(ops, &req_with_ops);
+    }
+    if (PREDICT_FALSE(!s.ok())) {
+      SetupErrorAndRespond(resp->mutable_error(), s,
+                           TabletServerErrorPB::UNKNOWN_ERROR,
+                           context);
+      return;
+    }
+    req = &req_with_ops;
+  }
+
   Status s = consensus->Update(req, resp);
   if (PREDICT_FALSE(!s.ok())) {
     // Clear the response first, since a partially-filled response could
@@ -981,10 +1077,17 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
   }
 
   size_t batch_size_bytes = GetMaxBatchSizeBytesHint(req);
-  gscoped_ptr<faststring> rows_data(new faststring(batch_size_bytes * 11 / 10));
-  gscoped_ptr<faststring> indirect_data(new faststring(batch_size_bytes * 11 / 10));
+  // The columnar layout buffers each column separately, and only copies
+  // them into the sidecars once the batch is complete.
+  size_t initial_capacity = req->columnar_layout() ? 0 : batch_size_bytes * 11 / 10;
+  gscoped_ptr<faststring> rows_data(new faststring(initial_capacity));
+  gscoped_ptr<faststring> indirect_data(new faststring(initial_capacity));
   RowwiseRowBlockPB data;
-  ScanResultCopier collector(&data, rows_data.get(), indirect_data.get());
+  ScanResultCopier rowwise_collector(&data, rows_data.get(), indirect_data.get());
+  ColumnarScanResultCopier columnar_collector;
+  ScanResultCollector& collector = req->columnar_layout()
+      ? static_cast<ScanResultCollector&>(columnar_collector)
+      : static_cast<ScanResultCollector&>(rowwise_collector);
 
   bool has_more_results = false;
   TabletServerErrorPB::Code error_code;
@@ -1027,20 +1130,35 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
 
   DVLOG(2) << "Blocks processed: " << collector.BlocksProcessed();
   if (collector.BlocksProcessed() > 0) {
-    resp->mutable_data()->CopyFrom(data);
+    if (req->columnar_layout()) {
+      ColumnarRowBlockPB* columnar_data = resp->mutable_columnar_data();
+      columnar_collector.encoder().Finish(columnar_data, rows_data.get(), indirect_data.get());
 
-    // Add sidecar data to context and record the returned indices.
-    int rows_idx;
-    CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
-        new rpc::RpcSidecar(rows_data.Pass())), &rows_idx));
-    resp->mutable_data()->set_rows_sidecar(rows_idx);
+      int data_idx;
+      CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+          new rpc::RpcSidecar(rows_data.Pass())), &data_idx));
+      columnar_data->set_data_sidecar(data_idx);
 
-    // Add indirect data as a sidecar, if applicable.
-    if (indirect_data->size() > 0) {
-      int indirect_idx;
+      int varlen_idx;
       CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
-          new rpc::RpcSidecar(indirect_data.Pass())), &indirect_idx));
-      resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+          new rpc::RpcSidecar(indirect_data.Pass())), &varlen_idx));
+      columnar_data->set_varlen_data_sidecar(varlen_idx);
+    } else {
+      resp->mutable_data()->CopyFrom(data);
+
+      // Add sidecar data to context and record the returned indices.
+      int rows_idx;
+      CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+          new rpc::RpcSidecar(rows_data.Pass())), &rows_idx));
+      resp->mutable_data()->set_rows_sidecar(rows_idx);
+
+      // Add indirect data as a sidecar, if applicable.
+      if (indirect_data->size() > 0) {
+        int indirect_idx;
+        CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+            new rpc::RpcSidecar(indirect_data.Pass())), &indirect_idx));
+        resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+      }
     }
 
     // Set the last row found by the collector.
@@ -1071,6 +1189,37 @@ void TabletServiceImpl::ListTablets(const ListTabletsRequestPB* req,
   context->RespondSuccess();
 }
 
+void TabletServiceImpl::SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                                      SplitKeyRangeResponsePB* resp,
+                                      rpc::RpcContext* context) {
+  scoped_refptr<TabletPeer> tablet_peer;
+  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
+                                 &tablet_peer)) {
+    return;
+  }
+
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  vector<string> split_keys;
+  s = tablet->SplitKeyRange(req->start_primary_key(), req->stop_primary_key(),
+                            req->target_chunk_size_bytes(), &split_keys);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s,
+                         TabletServerErrorPB::UNKNOWN_ERROR, context);
+    return;
+  }
+  BOOST_FOREACH(const string& key, split_keys) {
+    resp->add_split_keys(key);
+  }
+  context->RespondSuccess();
+}
+
 void TabletServiceImpl::Checksum(const ChecksumRequestPB* req,
                                  ChecksumResponsePB* resp,
                                  rpc::RpcContext* context) {
@@ -1229,11 +1378,18 @@ static Status SetupScanSpec(const NewScanRequestPB& scan_pb,
 
   // First the column range predicates.
   BOOST_FOREACH(const ColumnRangePredicatePB& pred_pb, scan_pb.range_predicates()) {
-    if (!pred_pb.has_lower_bound() && !pred_pb.has_upper_bound()) {
+    if (pred_pb.type() == ColumnRangePredicatePB::RANGE &&
+        !pred_pb.has_lower_bound() && !pred_pb.has_upper_bound()) {
       return Status::InvalidArgument(
         string("Invalid predicate ") + pred_pb.ShortDebugString() +
         ": has no lower or upper bound.");
     }
+    if (pred_pb.type() == ColumnRangePredicatePB::IN_LIST &&
+        pred_pb.in_list_values_size() == 0) {
+      return Status::InvalidArgument(
+        string("Invalid predicate ") + pred_pb.ShortDebugString() +
+        ": IN-list has no values.");
+    }
     ColumnSchema col(ColumnSchemaFromPB(pred_pb.column()));
     if (projection.find_column(col.name()) == -1 &&
         !ContainsKey(missing_col_names, col.name())) {
@@ -1241,32 +1397,52 @@ static Status SetupScanSpec(const NewScanRequestPB& scan_pb,
       InsertOrDie(&missing_col_names, col.name());
     }
 
-    const void* lower_bound = NULL;
-    const void* upper_bound = NULL;
-    if (pred_pb.has_lower_bound()) {
-      const void* val;
-      RETURN_NOT_OK(ExtractPredicateValue(col, pred_pb.lower_bound(),
-                                          scanner->arena(),
-                                          &val));
-      lower_bound = val;
-    } else {
-      lower_bound = NULL;
-    }
-    if (pred_pb.has_upper_bound()) {
-      const void* val;
-      RETURN_NOT_OK(ExtractPredicateValue(col, pred_pb.upper_bound(),
-                                          scanner->arena(),
-                                          &val));
-      upper_bound = val;
-    } else {
-      upper_bound = NULL;
+    gscoped_ptr<ColumnRangePredicate> pred;
+    switch (pred_pb.type()) {
+      case ColumnRangePredicatePB::RANGE: {
+        const void* lower_bound = NULL;
+        const void* upper_bound = NULL;
+        if (pred_pb.has_lower_bound()) {
+          RETURN_NOT_OK(ExtractPredicateValue(col, pred_pb.lower_bound(),
+                                              scanner->arena(),
+                                              &lower_bound));
+        }
+        if (pred_pb.has_upper_bound()) {
+          RETURN_NOT_OK(ExtractPredicateValue(col, pred_pb.upper_bound(),
+                                              scanner->arena(),
+                                              &upper_bound));
+        }
+        pred.reset(new ColumnRangePredicate(col, lower_bound, upper_bound));
+        break;
+      }
+      case ColumnRangePredicatePB::IN_LIST: {
+        vector<const void*> values;
+        values.reserve(pred_pb.in_list_values_size());
+        BOOST_FOREACH(const string& pb_value, pred_pb.in_list_values()) {
+          const void* val;
+          RETURN_NOT_OK(ExtractPredicateValue(col, pb_value, scanner->arena(), &val));
+          values.push_back(val);
+        }
+        pred.reset(new ColumnRangePredicate(ColumnRangePredicate::InList(col, values)));
+        break;
+      }
+      case ColumnRangePredicatePB::IS_NULL:
+        pred.reset(new ColumnRangePredicate(ColumnRangePredicate::IsNull(col)));
+        break;
+      case ColumnRangePredicatePB::IS_NOT_NULL:
+        pred.reset(new ColumnRangePredicate(ColumnRangePredicate::IsNotNull(col)));
+        break;
+      default:
+        return Status::InvalidArgument(
+          string("Invalid predicate ") + pred_pb.ShortDebugString() +
+          ": unknown predicate type.");
     }
 
-    ColumnRangePredicate pred(col, lower_bound, upper_bound);
     if (VLOG_IS_ON(3)) {
-      VLOG(3) << "Parsed predicate " << pred.ToString() << " from " << scan_pb.ShortDebugString();
+      VLOG(3) << "Parsed predicate " << pred->ToString() << " from "
+              << scan_pb.ShortDebugString();
     }
-    ret->AddPredicate(pred);
+    ret->AddPredicate(*pred);
   }
 
   // When doing an ordered scan, we need to include the key columns to be able to encode
@@ -1333,10 +1509,17 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
   if (scan_pb.order_mode() == ORDERED) {
     // Ordered scans must be at a snapshot so that we perform a serializable read (which can be
     // resumed). Otherwise, this would be read committed isolation, which is not resumable.
-    if (scan_pb.read_mode() != READ_AT_SNAPSHOT) {
+    if (scan_pb.read_mode() != READ_AT_SNAPSHOT &&
+        scan_pb.read_mode() != READ_WITH_BOUNDED_STALENESS) {
       *error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
           return Status::InvalidArgument("Cannot do an ordered scan that is not a snapshot read");
     }
+    if (scan_pb.aggregates_size() > 0) {
+      // An ordered scan may be resumed partway through the tablet, which
+      // would count some rows twice.
+      *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+      return Status::InvalidArgument("Cannot compute aggregates in an ordered scan");
+    }
   }
 
   gscoped_ptr<ScanSpec> spec(new ScanSpec);
@@ -1384,7 +1567,9 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
         return s;
       }
       case READ_LATEST: {
-        s = tablet->NewRowIterator(projection, &iter);
+        tablet::MvccSnapshot snap(*tablet->mvcc_manager());
+        s = tablet->NewRowIterator(projection, snap, Tablet::UNORDERED,
+                                   server_->scanner_manager()->scan_pool(), &iter);
         break;
       }
       case READ_AT_SNAPSHOT: {
@@ -1392,9 +1577,23 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
         if (!s.ok()) {
           tmp_error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
         }
+        break;
+      }
+      case READ_WITH_BOUNDED_STALENESS: {
+        tablet::MvccSnapshot snap;
+        s = PickBoundedStalenessSnapshot(scan_pb, rpc_context, tablet_peer, tablet,
+                                         &snap, snap_timestamp, error_code);
+        if (!s.ok()) {
+          return s;
+        }
+        s = NewSnapshotIterator(scan_pb, projection, tablet, snap, &iter);
+        if (!s.ok()) {
+          tmp_error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
+        }
+        break;
       }
-      TRACE("Iterator created");
     }
+    TRACE("Iterator created");
   }
 
   if (PREDICT_TRUE(s.ok())) {
@@ -1416,15 +1615,46 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     return s;
   }
 
+  gscoped_ptr<ScanAggregator> aggregator;
+  if (scan_pb.aggregates_size() > 0) {
+    vector<AggregatePB> aggregates(scan_pb.aggregates().begin(), scan_pb.aggregates().end());
+    vector<string> group_by_columns(scan_pb.group_by_columns().begin(),
+                                    scan_pb.group_by_columns().end());
+    // Grouping by a key prefix means that rows come in group order, at least
+    // within each rowset, so that groups can be returned as they finish.
+    for (int i = 0; i < group_by_columns.size(); i++) {
+      if (i >= tablet_schema.num_key_columns() ||
+          group_by_columns[i] != tablet_schema.column(i).name()) {
+        *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+        return Status::InvalidArgument("Group-by columns must be a prefix of the primary key",
+                                       JoinStrings(group_by_columns, ", "));
+      }
+    }
+    aggregator.reset(new ScanAggregator);
+    s = aggregator->Init(iter->schema(), group_by_columns, aggregates);
+    if (PREDICT_FALSE(!s.ok())) {
+      *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+      return s;
+    }
+  }
+
   *has_more_results = iter->HasNext();
   TRACE("has_more: $0", *has_more_results);
   if (!*has_more_results) {
     // If there are no more rows, we can short circuit some work and respond immediately.
     VLOG(1) << "No more rows, short-circuiting out without creating a server-side scanner.";
+    if (aggregator) {
+      s = CollectAggregates(*aggregator, result_collector);
+      if (PREDICT_FALSE(!s.ok())) {
+        *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+        return s;
+      }
+    }
     return Status::OK();
   }
 
   scanner->Init(iter.Pass(), spec.Pass());
+  scanner->set_aggregator(aggregator.Pass());
   unreg_scanner.Cancel();
   *scanner_id = scanner->id();
 
@@ -1492,6 +1722,7 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
   scanner->UpdateAccessTime();
 
   RowwiseIterator* iter = scanner->iter();
+  ScanAggregator* aggregator = scanner->aggregator();
 
   // TODO: could size the RowBlock based on the user's requested batch size?
   // If people had really large indirect objects, we would currently overshoot
@@ -1524,7 +1755,18 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
       // The collector will separately count the number of rows actually returned to
       // the client.
       rows_scanned += block.nrows();
-      result_collector->HandleRowBlock(scanner->client_projection_schema(), block);
+      if (aggregator != NULL) {
+        aggregator->AddRowBlock(block);
+        s = CollectFinishedAggregates(aggregator, result_collector);
+      } else {
+        s = result_collector->HandleRowBlock(scanner->client_projection_schema(), block);
+      }
+      if (PREDICT_FALSE(!s.ok())) {
+        LOG(WARNING) << "Couldn't collect the results of scan request "
+                     << req->ShortDebugString() << ": " << s.ToString();
+        *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+        return s;
+      }
     }
 
     int64_t response_size = result_collector->ResponseSize();
@@ -1546,6 +1788,15 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
     }
   }
 
+  if (aggregator != NULL && !iter->HasNext()) {
+    // The whole tablet has been scanned: return its partial aggregates.
+    Status s = CollectAggregates(*aggregator, result_collector);
+    if (PREDICT_FALSE(!s.ok())) {
+      *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+      return s;
+    }
+  }
+
   // Update metrics based on this scan request.
   scoped_refptr<TabletPeer> tablet_peer = scanner->tablet_peer();
   shared_ptr<Tablet> tablet;
@@ -1636,7 +1887,91 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   }
 
   tablet::MvccSnapshot snap;
+  RETURN_NOT_OK(WaitForCleanSnapshot(rpc_context, tablet, tmp_snap_timestamp, &snap));
+  RETURN_NOT_OK(NewSnapshotIterator(scan_pb, projection, tablet, snap, iter));
+  *snap_timestamp = tmp_snap_timestamp;
+  return Status::OK();
+}
+
+Status TabletServiceImpl::PickBoundedStalenessSnapshot(const NewScanRequestPB& scan_pb,
+                                                       const RpcContext* rpc_context,
+                                                       TabletPeer* tablet_peer,
+                                                       const shared_ptr<Tablet>& tablet,
+                                                       tablet::MvccSnapshot* snap,
+                                                       Timestamp* snap_timestamp,
+                                                       TabletServerErrorPB::Code* error_code) {
+  if (scan_pb.has_propagated_timestamp()) {
+    Status s = server_->clock()->Update(Timestamp(scan_pb.propagated_timestamp()));
+    if (!s.ok()) {
+      *error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
+      return s;
+    }
+  }
+
+  // The staleness bound is expressed in physical time, which only the
+  // hybrid clock can provide. It's measured back from the latest time the
+  // clock could currently be at, so that the clock's error can only make the
+  // snapshot fresher than requested, never staler.
+  Timestamp now_latest;
+  Status s = server_->clock()->GetGlobalLatest(&now_latest);
+  if (!s.ok()) {
+    *error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
+    return Status::NotSupported("Reads with bounded staleness not supported on this server",
+                                s.ToString());
+  }
+  Timestamp min_timestamp = server::HybridClock::AddPhysicalTimeToTimestamp(
+      now_latest,
+      MonoDelta::FromMilliseconds(-static_cast<int64_t>(scan_pb.max_staleness_ms())));
+
+  // A snapshot timestamp is set when a fault tolerant scan resumes on another
+  // replica: the scan must keep reading at the snapshot it started at, which
+  // was within the staleness bound when it was picked.
+  if (scan_pb.has_snap_timestamp()) {
+    min_timestamp.FromUint64(scan_pb.snap_timestamp());
+    if (min_timestamp.CompareTo(now_latest) > 0) {
+      *error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
+      return Status::InvalidArgument(
+          Substitute("Snapshot time $0 in the future. Max allowed timestamp is $1",
+                     server_->clock()->Stringify(min_timestamp),
+                     server_->clock()->Stringify(now_latest)));
+    }
+  }
+
+  // Every transaction below the safe timestamp has committed, so a snapshot
+  // there can be read right away. On a follower, it trails the leader's safe
+  // time, which is how followers serve reads without coordinating with the
+  // leader.
+  Timestamp safe_timestamp = tablet->mvcc_manager()->GetSafeTimestampForReads();
+  Timestamp tmp_snap_timestamp = scan_pb.has_snap_timestamp() ? min_timestamp : safe_timestamp;
+  if (safe_timestamp.CompareTo(min_timestamp) >= 0) {
+    TRACE("Safe timestamp within staleness bound, reading without waiting");
+    *snap = tablet::MvccSnapshot(tmp_snap_timestamp);
+  } else if (tablet_peer->consensus()->role() == consensus::RaftPeerPB::LEADER) {
+    // The leader assigns timestamps itself, so the bound can only be missed
+    // because of writes which are still in flight. Wait for them rather than
+    // bouncing the client to another replica.
+    tmp_snap_timestamp = min_timestamp;
+    s = WaitForCleanSnapshot(rpc_context, tablet, tmp_snap_timestamp, snap);
+    if (!s.ok()) {
+      *error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
+      return s;
+    }
+  } else {
+    *error_code = TabletServerErrorPB::REPLICA_TOO_STALE;
+    return Status::ServiceUnavailable(
+        Substitute("Replica safe time $0 is behind the requested staleness bound $1",
+                   server_->clock()->Stringify(safe_timestamp),
+                   server_->clock()->Stringify(min_timestamp)));
+  }
 
+  *snap_timestamp = tmp_snap_timestamp;
+  return Status::OK();
+}
+
+Status TabletServiceImpl::WaitForCleanSnapshot(const RpcContext* rpc_context,
+                                               const shared_ptr<Tablet>& tablet,
+                                               const Timestamp& timestamp,
+                                               tablet::MvccSnapshot* snap) {
   // Wait for the in-flights in the snapshot to be finished.
   // We'll use the client-provided deadline, but not if it's more than 5 seconds from
   // now -- it's better to make the client retry than hold RPC threads busy.
@@ -1659,23 +1994,28 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   TRACE("Waiting for operations in snapshot to commit");
   MonoTime before = MonoTime::Now(MonoTime::FINE);
   RETURN_NOT_OK_PREPEND(
-      tablet->mvcc_manager()->WaitForCleanSnapshotAtTimestamp(
-          tmp_snap_timestamp, &snap, deadline),
+      tablet->mvcc_manager()->WaitForCleanSnapshotAtTimestamp(timestamp, snap, deadline),
       "could not wait for desired snapshot timestamp to be consistent");
 
   uint64_t duration_usec = MonoTime::Now(MonoTime::FINE).GetDeltaSince(before).ToMicroseconds();
   tablet->metrics()->snapshot_read_inflight_wait_duration->Increment(duration_usec);
   TRACE("All operations in snapshot committed. Waited for $0 microseconds", duration_usec);
+  return Status::OK();
+}
 
+Status TabletServiceImpl::NewSnapshotIterator(const NewScanRequestPB& scan_pb,
+                                              const Schema& projection,
+                                              const shared_ptr<Tablet>& tablet,
+                                              const tablet::MvccSnapshot& snap,
+                                              gscoped_ptr<RowwiseIterator>* iter) {
   tablet::Tablet::OrderMode order;
   switch (scan_pb.order_mode()) {
     case UNORDERED: order = tablet::Tablet::UNORDERED; break;
     case ORDERED: order = tablet::Tablet::ORDERED; break;
     default: LOG(FATAL) << "Unexpected order mode.";
   }
-  RETURN_NOT_OK(tablet->NewRowIterator(projection, snap, order, iter));
-  *snap_timestamp = tmp_snap_timestamp;
-  return Status::OK();
+  return tablet->NewRowIterator(projection, snap, order,
+                                server_->scanner_manager()->scan_pool(), iter);
 }
 
 } // namespace tserver
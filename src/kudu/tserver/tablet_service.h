@@ -30,6 +30,7 @@ class Status;
 class Timestamp;
 
 namespace tablet {
+class MvccSnapshot;
 class Tablet;
 class TabletPeer;
 class TransactionState;
@@ -64,6 +65,10 @@ class TabletServiceImpl : public TabletServerServiceIf {
                            ListTabletsResponsePB* resp,
                            rpc::RpcContext* context) OVERRIDE;
 
+  virtual void SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                             SplitKeyRangeResponsePB* resp,
+                             rpc::RpcContext* context) OVERRIDE;
+
   virtual void Checksum(const ChecksumRequestPB* req,
                         ChecksumResponsePB* resp,
                         rpc::RpcContext* context) OVERRIDE;
@@ -92,6 +97,33 @@ class TabletServiceImpl : public TabletServerServiceIf {
                               gscoped_ptr<RowwiseIterator>* iter,
                               Timestamp* snap_timestamp);
 
+  // Picks the snapshot for a READ_WITH_BOUNDED_STALENESS scan. Reads at the
+  // replica's clean timestamp if it's within the requested staleness bound.
+  // Otherwise, a leader waits for the in-flight writes below the bound, and a
+  // follower fails with REPLICA_TOO_STALE. If the request carries a snapshot
+  // timestamp, that snapshot is read instead, under the same rules.
+  // On failure, sets 'error_code'.
+  Status PickBoundedStalenessSnapshot(const NewScanRequestPB& scan_pb,
+                                      const rpc::RpcContext* rpc_context,
+                                      tablet::TabletPeer* tablet_peer,
+                                      const std::tr1::shared_ptr<tablet::Tablet>& tablet,
+                                      tablet::MvccSnapshot* snap,
+                                      Timestamp* snap_timestamp,
+                                      TabletServerErrorPB::Code* error_code);
+
+  // Waits, up to a deadline derived from the client's, for all transactions
+  // before 'timestamp' to commit, and sets 'snap' to a snapshot at 'timestamp'.
+  Status WaitForCleanSnapshot(const rpc::RpcContext* rpc_context,
+                              const std::tr1::shared_ptr<tablet::Tablet>& tablet,
+                              const Timestamp& timestamp,
+                              tablet::MvccSnapshot* snap);
+
+  Status NewSnapshotIterator(const NewScanRequestPB& scan_pb,
+                             const Schema& projection,
+                             const std::tr1::shared_ptr<tablet::Tablet>& tablet,
+                             const tablet::MvccSnapshot& snap,
+                             gscoped_ptr<RowwiseIterator>* iter);
+
   TabletServer* server_;
 };
 
@@ -18,16 +18,21 @@
 #include <gtest/gtest.h>
 #include <string>
 #include <tr1/memory>
+#include <vector>
 
 #include "kudu/common/partition.h"
 #include "kudu/common/schema.h"
+#include "kudu/consensus/consensus_meta.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/strings/util.h"
 #include "kudu/master/master.pb.h"
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tablet/tablet-test-util.h"
 #include "kudu/tserver/mini_tablet_server.h"
 #include "kudu/tserver/tablet_server.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/test_util.h"
 
 #define ASSERT_REPORT_HAS_UPDATED_TABLET(report, tablet_id) \
@@ -39,11 +44,16 @@
 namespace kudu {
 namespace tserver {
 
+using consensus::ConsensusMetadata;
 using consensus::kInvalidOpIdIndex;
 using consensus::RaftConfigPB;
+using consensus::RaftPeerPB;
 using master::ReportedTabletPB;
 using master::TabletReportPB;
 using std::tr1::shared_ptr;
+using std::vector;
+using strings::Substitute;
+using tablet::TabletMetadata;
 using tablet::TabletPeer;
 
 static const char* const kTabletId = "my-tablet-id";
@@ -121,6 +131,91 @@ TEST_F(TsTabletManagerTest, TestCreateTablet) {
   ASSERT_EQ(kTabletId, peer->tablet()->tablet_id());
 }
 
+// Test that tablets which this server likely led are bootstrapped first,
+// followed by the others in decreasing order of WAL size.
+TEST_F(TsTabletManagerTest, TestPrioritizeTabletsForBootstrap) {
+  const char* const kTabletIds[] = { "follower-small", "follower-big", "leader-small",
+                                     "leader-big" };
+  vector<scoped_refptr<TabletMetadata> > metas;
+  BOOST_FOREACH(const char* tablet_id, kTabletIds) {
+    scoped_refptr<TabletPeer> peer;
+    ASSERT_OK(CreateNewTablet(tablet_id, schema_, &peer));
+    metas.push_back(peer->tablet_metadata());
+  }
+
+  // Make the "follower" tablets look like followers of a three-voter config,
+  // and pad the WALs of the "big" tablets with extra segments.
+  BOOST_FOREACH(const char* tablet_id, kTabletIds) {
+    if (HasPrefixString(tablet_id, "follower")) {
+      gscoped_ptr<ConsensusMetadata> cmeta;
+      ASSERT_OK(ConsensusMetadata::Load(fs_manager_, tablet_id, fs_manager_->uuid(), &cmeta));
+      RaftConfigPB config = cmeta->committed_config();
+      config.set_local(false);
+      for (int i = 1; i < 3; i++) {
+        *config.add_peers() = config.peers(0);
+        config.mutable_peers(i)->set_permanent_uuid(Substitute("other-peer-$0", i));
+      }
+      for (int i = 0; i < 3; i++) {
+        config.mutable_peers(i)->mutable_last_known_addr()->set_host("127.0.0.1");
+        config.mutable_peers(i)->mutable_last_known_addr()->set_port(i + 1);
+      }
+      cmeta->set_committed_config(config);
+      cmeta->clear_voted_for();
+      ASSERT_OK(cmeta->Flush());
+    }
+    if (HasSuffixString(tablet_id, "big")) {
+      string padding(10 * 1024 * 1024, 'x');
+      ASSERT_OK(WriteStringToFile(env_.get(), padding,
+                                  JoinPathSegments(fs_manager_->GetTabletWalDir(tablet_id),
+                                                   "wal-000000999")));
+    }
+  }
+
+  tablet_manager_->PrioritizeTabletsForBootstrap(&metas);
+  ASSERT_EQ(4, metas.size());
+  ASSERT_EQ("leader-big", metas[0]->tablet_id());
+  ASSERT_EQ("leader-small", metas[1]->tablet_id());
+  ASSERT_EQ("follower-big", metas[2]->tablet_id());
+  ASSERT_EQ("follower-small", metas[3]->tablet_id());
+
+  // Remove the padding, which isn't a valid segment.
+  BOOST_FOREACH(const char* tablet_id, kTabletIds) {
+    if (HasSuffixString(tablet_id, "big")) {
+      ASSERT_OK(env_->DeleteFile(JoinPathSegments(fs_manager_->GetTabletWalDir(tablet_id),
+                                                  "wal-000000999")));
+    }
+  }
+}
+
+// Test that the bootstrap progress counts the tablets opened at startup.
+TEST_F(TsTabletManagerTest, TestBootstrapProgress) {
+  int num_bootstrapped;
+  int num_total;
+  tablet_manager_->GetBootstrapProgress(&num_bootstrapped, &num_total);
+  ASSERT_EQ(0, num_bootstrapped);
+  ASSERT_EQ(0, num_total);
+
+  // Tablets created after startup don't count.
+  ASSERT_OK(CreateNewTablet("tablet-1", schema_, NULL));
+  ASSERT_OK(CreateNewTablet("tablet-2", schema_, NULL));
+  tablet_manager_->GetBootstrapProgress(&num_bootstrapped, &num_total);
+  ASSERT_EQ(0, num_total);
+
+  mini_server_->Shutdown();
+  mini_server_.reset(
+      new MiniTabletServer(GetTestPath("TsTabletManagerTest-fsroot"), 0));
+  ASSERT_OK(mini_server_->Start());
+  tablet_manager_ = mini_server_->server()->tablet_manager();
+  tablet_manager_->GetBootstrapProgress(&num_bootstrapped, &num_total);
+  ASSERT_EQ(2, num_total);
+  ASSERT_LE(num_bootstrapped, num_total);
+
+  ASSERT_OK(mini_server_->WaitStarted());
+  tablet_manager_->GetBootstrapProgress(&num_bootstrapped, &num_total);
+  ASSERT_EQ(2, num_bootstrapped);
+  ASSERT_EQ(2, num_total);
+}
+
 static void AssertMonotonicReportSeqno(int64_t* report_seqno,
                                        const TabletReportPB &report) {
   ASSERT_LT(*report_seqno, report.sequence_number());
@@ -27,6 +27,7 @@
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/consensus_meta.h"
 #include "kudu/consensus/log.h"
+#include "kudu/consensus/log_util.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/quorum_util.h"
@@ -49,6 +50,7 @@
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/trace.h"
@@ -66,6 +68,13 @@ DEFINE_int32(tablet_start_warn_threshold_ms, 500,
              "a warning with a trace.");
 TAG_FLAG(tablet_start_warn_threshold_ms, hidden);
 
+DEFINE_bool(prioritize_tablet_bootstrap, true,
+            "Whether to order the tablets opened at startup so that those which "
+            "this server most likely led, followed by those with the most WAL "
+            "data to replay, are bootstrapped first. Otherwise tablets are "
+            "bootstrapped in directory listing order.");
+TAG_FLAG(prioritize_tablet_bootstrap, advanced);
+
 DEFINE_double(fault_crash_after_blocks_deleted, 0.0,
               "Fraction of the time when the tablet will crash immediately "
               "after deleting the data blocks during tablet deletion. "
@@ -146,6 +155,8 @@ TSTabletManager::TSTabletManager(FsManager* fs_manager,
   : fs_manager_(fs_manager),
     server_(server),
     next_report_seq_(0),
+    num_tablets_to_bootstrap_(0),
+    num_tablets_bootstrapped_(0),
     metric_registry_(metric_registry),
     state_(MANAGER_INITIALIZING) {
 
@@ -198,7 +209,13 @@ Status TSTabletManager::Init() {
     metas.push_back(meta);
   }
 
-  // Now submit the "Open" task for each.
+  if (FLAGS_prioritize_tablet_bootstrap) {
+    PrioritizeTabletsForBootstrap(&metas);
+  }
+  num_tablets_to_bootstrap_.Store(metas.size());
+
+  // Now submit the "Open" task for each. The bootstrap pool runs them in
+  // submission order.
   BOOST_FOREACH(const scoped_refptr<TabletMetadata>& meta, metas) {
     scoped_refptr<TransitionInProgressDeleter> deleter;
     {
@@ -207,8 +224,8 @@ Status TSTabletManager::Init() {
     }
 
     scoped_refptr<TabletPeer> tablet_peer = CreateAndRegisterTabletPeer(meta, NEW_PEER);
-    RETURN_NOT_OK(open_tablet_pool_->SubmitFunc(boost::bind(&TSTabletManager::OpenTablet,
-                                                this, meta, deleter)));
+    RETURN_NOT_OK(open_tablet_pool_->SubmitFunc(
+        boost::bind(&TSTabletManager::OpenTabletOnStartup, this, meta, deleter)));
   }
 
   {
@@ -219,6 +236,117 @@ Status TSTabletManager::Init() {
   return Status::OK();
 }
 
+namespace {
+
+// A tablet to open at startup, along with the hints used to decide how soon
+// to bootstrap it.
+struct BootstrapCandidate {
+  scoped_refptr<TabletMetadata> meta;
+
+  // Whether this server voted for itself in the latest term it knows of, or
+  // is the only voter of the tablet: either way, it was most likely the
+  // leader when it went down.
+  bool likely_leader;
+
+  // The size of the tablet's WAL, which approximates how much write traffic
+  // the tablet has taken since it last flushed.
+  uint64_t wal_bytes;
+};
+
+bool CompareByBootstrapPriority(const BootstrapCandidate& a, const BootstrapCandidate& b) {
+  if (a.likely_leader != b.likely_leader) {
+    return a.likely_leader;
+  }
+  return a.wal_bytes > b.wal_bytes;
+}
+
+// Fill in the hints of 'c' from its tablet's consensus metadata and WAL
+// directory. Any errors reading them are left for the bootstrap itself to
+// report; the tablet is just not prioritized.
+void LoadBootstrapHints(FsManager* fs_manager, BootstrapCandidate* c) {
+  const string& local_uuid = fs_manager->uuid();
+  const string& tablet_id = c->meta->tablet_id();
+  Env* env = fs_manager->env();
+
+  gscoped_ptr<ConsensusMetadata> cmeta;
+  Status s = ConsensusMetadata::Load(fs_manager, tablet_id, local_uuid, &cmeta);
+  if (s.ok()) {
+    const RaftConfigPB& config = cmeta->committed_config();
+    c->likely_leader = (cmeta->has_voted_for() && cmeta->voted_for() == local_uuid) ||
+        (consensus::CountVoters(config) == 1 &&
+         consensus::IsRaftConfigVoter(local_uuid, config));
+  }
+
+  // A recovery directory left over from an interrupted bootstrap holds the
+  // segments which still have to be replayed.
+  string wal_dir = fs_manager->GetTabletWalRecoveryDir(tablet_id);
+  if (!env->FileExists(wal_dir)) {
+    wal_dir = fs_manager->GetTabletWalDir(tablet_id);
+  }
+  vector<string> children;
+  if (env->GetChildren(wal_dir, &children).ok()) {
+    BOOST_FOREACH(const string& child, children) {
+      if (!log::IsLogFileName(child)) {
+        continue;
+      }
+      uint64_t size;
+      if (env->GetFileSize(JoinPathSegments(wal_dir, child), &size).ok()) {
+        c->wal_bytes += size;
+      }
+    }
+  }
+}
+
+} // anonymous namespace
+
+void TSTabletManager::PrioritizeTabletsForBootstrap(
+    vector<scoped_refptr<TabletMetadata> >* metas) {
+  vector<BootstrapCandidate> candidates(metas->size());
+  for (int i = 0; i < metas->size(); i++) {
+    BootstrapCandidate* c = &candidates[i];
+    c->meta = (*metas)[i];
+    c->likely_leader = false;
+    c->wal_bytes = 0;
+  }
+
+  // Reading the hints takes a few small reads per tablet, so spread them
+  // over the bootstrap pool, which isn't running any bootstraps yet. If a
+  // task can't be submitted, its hints are read inline.
+  BOOST_FOREACH(BootstrapCandidate& c, candidates) {
+    Status s = open_tablet_pool_->SubmitFunc(
+        boost::bind(&LoadBootstrapHints, fs_manager_, &c));
+    if (PREDICT_FALSE(!s.ok())) {
+      LoadBootstrapHints(fs_manager_, &c);
+    }
+  }
+  open_tablet_pool_->Wait();
+
+  std::stable_sort(candidates.begin(), candidates.end(), CompareByBootstrapPriority);
+
+  int num_likely_leaders = 0;
+  metas->clear();
+  BOOST_FOREACH(const BootstrapCandidate& c, candidates) {
+    if (c.likely_leader) {
+      num_likely_leaders++;
+    }
+    metas->push_back(c.meta);
+  }
+  LOG(INFO) << "Bootstrapping " << metas->size() << " tablets, starting with "
+            << num_likely_leaders << " which this server likely led";
+}
+
+void TSTabletManager::OpenTabletOnStartup(
+    const scoped_refptr<TabletMetadata>& meta,
+    const scoped_refptr<TransitionInProgressDeleter>& deleter) {
+  OpenTablet(meta, deleter);
+  num_tablets_bootstrapped_.Increment();
+}
+
+void TSTabletManager::GetBootstrapProgress(int* num_bootstrapped, int* num_total) const {
+  *num_bootstrapped = num_tablets_bootstrapped_.Load();
+  *num_total = num_tablets_to_bootstrap_.Load();
+}
+
 Status TSTabletManager::WaitForAllBootstrapsToFinish() {
   CHECK_EQ(state(), MANAGER_RUNNING);
 
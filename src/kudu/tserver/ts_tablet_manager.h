@@ -28,6 +28,7 @@
 #include "kudu/tserver/tablet_peer_lookup.h"
 #include "kudu/tserver/tserver_admin.pb.h"
 #include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/status.h"
@@ -91,6 +92,10 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
   // the first tablet whose bootstrap failed.
   Status WaitForAllBootstrapsToFinish();
 
+  // Returns how many of the tablets found by Init() have finished
+  // bootstrapping, successfully or not, and how many there are in total.
+  void GetBootstrapProgress(int* num_bootstrapped, int* num_total) const;
+
   // Shut down all of the tablets, gracefully flushing before shutdown.
   void Shutdown();
 
@@ -179,6 +184,7 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
 
  private:
   FRIEND_TEST(TsTabletManagerTest, TestPersistBlocks);
+  FRIEND_TEST(TsTabletManagerTest, TestPrioritizeTabletsForBootstrap);
 
   // Flag specified when registering a TabletPeer.
   enum RegisterTabletPeerMode {
@@ -231,6 +237,18 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
   void OpenTablet(const scoped_refptr<tablet::TabletMetadata>& meta,
                   const scoped_refptr<TransitionInProgressDeleter>& deleter);
 
+  // Open a tablet found by Init(), and count it towards the bootstrap progress.
+  void OpenTabletOnStartup(const scoped_refptr<tablet::TabletMetadata>& meta,
+                           const scoped_refptr<TransitionInProgressDeleter>& deleter);
+
+  // Reorder the tablets found by Init() so that the ones most in need of
+  // serving come first: those which this server most likely led before it
+  // went down, then those with the most WAL data, as a proxy for the write
+  // traffic they take. The hints are read from the consensus metadata and
+  // WAL directories, in parallel on open_tablet_pool_. A tablet whose hints
+  // can't be read is treated as a follower with an empty WAL.
+  void PrioritizeTabletsForBootstrap(std::vector<scoped_refptr<tablet::TabletMetadata> >* metas);
+
   // Open a tablet whose metadata has already been loaded.
   void BootstrapAndInitTablet(const scoped_refptr<tablet::TabletMetadata>& meta,
                               scoped_refptr<tablet::TabletPeer>* peer);
@@ -330,6 +348,11 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
 
   TSTabletManagerStatePB state_;
 
+  // The number of tablets found by Init(), and how many of them have
+  // finished bootstrapping.
+  AtomicInt<int32_t> num_tablets_to_bootstrap_;
+  AtomicInt<int32_t> num_tablets_bootstrapped_;
+
   // Thread pool used to open the tablets async, whether bootstrap is required or not.
   gscoped_ptr<ThreadPool> open_tablet_pool_;
 
@@ -176,6 +176,15 @@ void TabletServerPathHandlers::HandleTabletsPage(const Webserver::WebRequest& re
   tserver_->tablet_manager()->GetTabletPeers(&peers);
 
   *output << "<h1>Tablets</h1>\n";
+
+  int num_bootstrapped;
+  int num_to_bootstrap;
+  tserver_->tablet_manager()->GetBootstrapProgress(&num_bootstrapped, &num_to_bootstrap);
+  if (num_bootstrapped < num_to_bootstrap) {
+    *output << Substitute("<p>Bootstrapping tablets: $0 of $1 done.</p>\n",
+                          num_bootstrapped, num_to_bootstrap);
+  }
+
   *output << "<table class='table table-striped'>\n";
   *output << "  <tr><th>Table name</th><th>Tablet ID</th>"
       "<th>Partition</th>"
@@ -458,6 +467,8 @@ string TabletServerPathHandlers::IteratorStatsToHtml(const Schema& projection,
        << "<th>Blocks read from disk</th>"
        << "<th>Bytes read from disk</th>"
        << "<th>Cells read from disk</th>"
+       << "<th>Blocks from decoded cache</th>"
+       << "<th>Cells skipped</th>"
        << "</tr>\n";
   for (size_t idx = 0; idx < stats.size(); idx++) {
     // We use 'title' attributes so that if the user hovers over the value, they get a
@@ -466,8 +477,7 @@ string TabletServerPathHandlers::IteratorStatsToHtml(const Schema& projection,
                        "<td>$0</td>"
                        "<td title=\"$1\">$2</td>"
                        "<td title=\"$3\">$4</td>"
-                       "<td title=\"$5\">$6</td>"
-                       "</tr>\n",
+                       "<td title=\"$5\">$6</td>",
                        EscapeForHtmlToString(projection.column(idx).name()), // $0
                        HumanReadableInt::ToString(stats[idx].data_blocks_read_from_disk), // $1
                        stats[idx].data_blocks_read_from_disk, // $2
@@ -475,6 +485,13 @@ string TabletServerPathHandlers::IteratorStatsToHtml(const Schema& projection,
                        stats[idx].bytes_read_from_disk, // $4
                        HumanReadableInt::ToString(stats[idx].cells_read_from_disk), // $5
                        stats[idx].cells_read_from_disk); // $6
+    html << Substitute("<td title=\"$0\">$1</td>"
+                       "<td title=\"$2\">$3</td>"
+                       "</tr>\n",
+                       HumanReadableInt::ToString(stats[idx].data_blocks_from_decoded_cache), // $0
+                       stats[idx].data_blocks_from_decoded_cache, // $1
+                       HumanReadableInt::ToString(stats[idx].cells_skipped), // $2
+                       stats[idx].cells_skipped); // $3
   }
   html << "</table>\n";
   return html.str();
@@ -0,0 +1,139 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Multi-threaded benchmark for the DRAM cache implementations. Each thread
+// looks up random keys, inserting any key which misses, so that the ratio
+// of key space to cache capacity determines the hit rate.
+
+#include <string>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/atomicops.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/cache.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/random.h"
+#include "kudu/util/test_util.h"
+#include "kudu/util/thread.h"
+
+DEFINE_int32(cache_bench_num_threads, 16,
+             "Number of threads concurrently looking up and inserting entries");
+DEFINE_double(cache_bench_seconds, 1,
+              "Number of seconds to run each cache type for");
+DEFINE_double(cache_bench_key_space_ratio, 1.1,
+              "Ratio of the number of distinct keys to the number of entries "
+              "which fit in the cache. Values above 1 cause a steady stream of "
+              "misses and evictions; values at or below 1 only exercise hits "
+              "once the cache is warm");
+
+namespace kudu {
+
+using std::vector;
+
+// Each entry is charged as a typical cfile block.
+static const int kEntryCharge = 16 * 1024;
+static const int kCacheCapacity = 256 * 1024 * 1024;
+
+class NoopDeleter : public CacheDeleter {
+ public:
+  virtual void Delete(const Slice& key, void* value) OVERRIDE {}
+};
+
+class CacheBench : public KuduTest,
+                   public ::testing::WithParamInterface<CacheType> {
+ public:
+  CacheBench()
+    : stop_(false),
+      total_lookups_(0),
+      total_hits_(0) {
+  }
+
+  virtual void SetUp() OVERRIDE {
+    KuduTest::SetUp();
+    cache_.reset(NewLRUCache(GetParam(), kCacheCapacity, "cache_bench"));
+  }
+
+  // Look up and insert random keys until told to stop.
+  void BenchThread(uint32_t seed) {
+    Random r(seed);
+    const uint32_t key_space = static_cast<uint32_t>(
+        FLAGS_cache_bench_key_space_ratio * kCacheCapacity / kEntryCharge);
+    faststring key;
+    int64_t lookups = 0;
+    int64_t hits = 0;
+    while (!stop_.Load()) {
+      // Check the flag every few operations rather than on each one.
+      for (int i = 0; i < 100; i++) {
+        key.clear();
+        PutFixed32(&key, r.Uniform(key_space));
+        Cache::Handle* h = cache_->Lookup(Slice(key), Cache::EXPECT_IN_CACHE);
+        lookups++;
+        if (h != NULL) {
+          hits++;
+        } else {
+          h = cache_->Insert(Slice(key), NULL, kEntryCharge, &deleter_);
+        }
+        cache_->Release(h);
+      }
+    }
+    base::subtle::NoBarrier_AtomicIncrement(&total_lookups_, lookups);
+    base::subtle::NoBarrier_AtomicIncrement(&total_hits_, hits);
+  }
+
+ protected:
+  NoopDeleter deleter_;
+  gscoped_ptr<Cache> cache_;
+  AtomicBool stop_;
+  Atomic64 total_lookups_;
+  Atomic64 total_hits_;
+};
+
+INSTANTIATE_TEST_CASE_P(CacheTypes, CacheBench,
+                        ::testing::Values(DRAM_CACHE, DRAM_SLRU_CACHE, DRAM_CLOCK_CACHE));
+
+TEST_P(CacheBench, RunBench) {
+  vector<scoped_refptr<Thread> > threads;
+  for (int i = 0; i < FLAGS_cache_bench_num_threads; i++) {
+    scoped_refptr<Thread> t;
+    ASSERT_OK(Thread::Create("test", strings::Substitute("cache-bench-$0", i),
+                             &CacheBench::BenchThread, this, SeedRandom() + i, &t));
+    threads.push_back(t);
+  }
+  MonoTime start = MonoTime::Now(MonoTime::FINE);
+  SleepFor(MonoDelta::FromSeconds(FLAGS_cache_bench_seconds));
+  stop_.Store(true);
+  BOOST_FOREACH(const scoped_refptr<Thread>& t, threads) {
+    t->Join();
+  }
+  double elapsed = MonoTime::Now(MonoTime::FINE).GetDeltaSince(start).ToSeconds();
+
+  int64_t lookups = base::subtle::NoBarrier_Load(&total_lookups_);
+  int64_t hits = base::subtle::NoBarrier_Load(&total_hits_);
+  ASSERT_GT(lookups, 0);
+  LOG(INFO) << strings::Substitute(
+      "Cache type $0 with $1 threads: $2 lookups/sec, $3% hits",
+      GetParam(), FLAGS_cache_bench_num_threads,
+      static_cast<int64_t>(lookups / elapsed), hits * 100 / lookups);
+}
+
+} // namespace kudu
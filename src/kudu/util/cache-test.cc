@@ -22,6 +22,7 @@
 
 #include <vector>
 #include "kudu/util/cache.h"
+#include "kudu/util/cache_metrics.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
@@ -29,6 +30,9 @@
 
 DECLARE_string(nvm_cache_path);
 
+METRIC_DECLARE_counter(block_cache_probationary_segment_hits);
+METRIC_DECLARE_counter(block_cache_protected_segment_hits);
+
 namespace kudu {
 
 // Conversions between numeric keys/values and the types expected by Cache.
@@ -59,6 +63,7 @@ class CacheTest : public KuduTest,
   std::tr1::shared_ptr<MemTracker> mem_tracker_;
   gscoped_ptr<Cache> cache_;
   MetricRegistry metric_registry_;
+  scoped_refptr<MetricEntity> metric_entity_;
 
   static const int kCacheSize = 14*1024*1024;
 
@@ -73,13 +78,12 @@ class CacheTest : public KuduTest,
     MemTracker::FindTracker("cache_test-sharded_lru_cache", &mem_tracker_);
     // Since nvm cache does not have memtracker due to the use of
     // tcmalloc for this we only check for it in the DRAM case.
-    if (GetParam() == DRAM_CACHE) {
+    if (GetParam() != NVM_CACHE) {
       ASSERT_TRUE(mem_tracker_);
     }
 
-    scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(
-        &metric_registry_, "test");
-    cache_->SetMetrics(entity);
+    metric_entity_ = METRIC_ENTITY_server.Instantiate(&metric_registry_, "test");
+    cache_->SetMetrics(gscoped_ptr<CacheMetrics>(new CacheMetrics(metric_entity_)));
   }
 
   int Lookup(int key) {
@@ -100,7 +104,9 @@ class CacheTest : public KuduTest,
     cache_->Erase(EncodeKey(key));
   }
 };
-INSTANTIATE_TEST_CASE_P(CacheTypes, CacheTest, ::testing::Values(DRAM_CACHE, NVM_CACHE));
+INSTANTIATE_TEST_CASE_P(CacheTypes, CacheTest,
+                        ::testing::Values(DRAM_CACHE, NVM_CACHE, DRAM_SLRU_CACHE,
+                                          DRAM_CLOCK_CACHE));
 
 TEST_P(CacheTest, TrackMemory) {
   if (mem_tracker_) {
@@ -196,6 +202,53 @@ TEST_P(CacheTest, EvictionPolicy) {
   ASSERT_EQ(-1, Lookup(200));
 }
 
+// A single pass over more data than the cache can hold must not evict
+// entries which have been hit since they were inserted.
+TEST_P(CacheTest, ScanResistance) {
+  if (GetParam() != DRAM_SLRU_CACHE) {
+    LOG(INFO) << "Only the segmented LRU cache is scan-resistant";
+    return;
+  }
+  const int kNumHot = 100;
+  const int kSizePerElem = kCacheSize / 1000;
+
+  for (int i = 0; i < kNumHot; i++) {
+    Insert(i, 1000 + i, kSizePerElem);
+    ASSERT_EQ(1000 + i, Lookup(i));
+  }
+
+  // Scan through twice the cache capacity, touching each entry once.
+  for (int i = 0; i < 2000; i++) {
+    Insert(10000 + i, 20000 + i, kSizePerElem);
+  }
+
+  for (int i = 0; i < kNumHot; i++) {
+    ASSERT_EQ(1000 + i, Lookup(i));
+  }
+  ASSERT_EQ(-1, Lookup(10000));
+}
+
+TEST_P(CacheTest, SegmentHitMetrics) {
+  if (GetParam() != DRAM_SLRU_CACHE) {
+    LOG(INFO) << "Only the segmented LRU cache has segments";
+    return;
+  }
+  scoped_refptr<Counter> probationary_hits =
+      METRIC_block_cache_probationary_segment_hits.Instantiate(metric_entity_);
+  scoped_refptr<Counter> protected_hits =
+      METRIC_block_cache_protected_segment_hits.Instantiate(metric_entity_);
+
+  Insert(100, 101);
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(1, probationary_hits->value());
+  ASSERT_EQ(0, protected_hits->value());
+
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(1, probationary_hits->value());
+  ASSERT_EQ(2, protected_hits->value());
+}
+
 TEST_P(CacheTest, HeavyEntries) {
   // Add a bunch of light and heavy entries and then count the combined
   // size of items still in the cache, which must be approximately the
@@ -16,7 +16,9 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
+#include <algorithm>
 #include <boost/foreach.hpp>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <stdlib.h>
 #include <string>
@@ -24,17 +26,29 @@
 #include <vector>
 
 #include "kudu/gutil/atomic_refcount.h"
+#include "kudu/gutil/atomicops.h"
+#include "kudu/gutil/bits.h"
 #include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/cache.h"
 #include "kudu/util/cache_metrics.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/nvm_cache.h"
 
+DEFINE_double(cache_slru_protected_ratio, 0.8,
+              "For segmented LRU caches, the fraction of the capacity reserved "
+              "for the protected segment, which holds entries that were hit at "
+              "least once after being inserted. The remainder holds newly "
+              "inserted entries, which are evicted first.");
+TAG_FLAG(cache_slru_protected_ratio, advanced);
+TAG_FLAG(cache_slru_protected_ratio, experimental);
+
 namespace kudu {
 
 class MetricEntity;
@@ -63,6 +77,8 @@ struct LRUHandle {
   size_t key_length;
   Atomic32 refs;
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  bool in_protected;  // Only used by SLRUCache
+  Atomic32 clock_referenced;  // Only used by ClockCache
   uint8_t key_data[1];   // Beginning of key
 
   Slice key() const {
@@ -376,14 +392,543 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
   }
 }
 
+// A single shard of a segmented LRU (SLRU) cache.
+//
+// Entries are inserted into a probationary segment, and are moved to a
+// protected segment the first time they are hit. When the protected segment
+// outgrows its share of the capacity, its least recently used entries are
+// demoted back to the probationary segment. Eviction always starts with the
+// probationary segment, so a burst of entries which are only accessed once
+// (e.g. a large scan) cannot push the frequently used working set out of the
+// cache.
+class SLRUCache {
+ public:
+  explicit SLRUCache(MemTracker* tracker);
+  ~SLRUCache();
+
+  // Separate from constructor so caller can easily make an array of SLRUCache
+  void SetCapacity(size_t capacity);
+
+  void SetMetrics(CacheMetrics* metrics) { metrics_ = metrics; }
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  Cache::Handle* Insert(const Slice& key, uint32_t hash,
+                        void* value, size_t charge,
+                        CacheDeleter* deleter);
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
+
+ private:
+  // Remove 'e' from whichever segment it belongs to.
+  void Segment_Remove(LRUHandle* e);
+  // Make 'e' the newest entry of the probationary or protected segment.
+  void Segment_Append(LRUHandle* e, bool is_protected);
+  // Just reduce the reference count by 1.
+  // Return true if last reference
+  bool Unref(LRUHandle* e);
+  // Call deleter and free
+  void FreeEntry(LRUHandle* e);
+
+  // Initialized before use.
+  size_t capacity_;
+  size_t protected_capacity_;
+
+  // mutex_ protects the following state.
+  MutexType mutex_;
+  size_t probationary_usage_;
+  size_t protected_usage_;
+
+  // Dummy heads of the segments' LRU lists.
+  // prev is the newest entry, next is the oldest entry.
+  LRUHandle probationary_;
+  LRUHandle protected_;
+
+  HandleTable table_;
+
+  MemTracker* mem_tracker_;
+
+  CacheMetrics* metrics_;
+};
+
+SLRUCache::SLRUCache(MemTracker* tracker)
+ : probationary_usage_(0),
+   protected_usage_(0),
+   mem_tracker_(tracker),
+   metrics_(NULL) {
+  // Make empty circular linked lists
+  probationary_.next = &probationary_;
+  probationary_.prev = &probationary_;
+  protected_.next = &protected_;
+  protected_.prev = &protected_;
+}
+
+SLRUCache::~SLRUCache() {
+  LRUHandle* heads[] = { &probationary_, &protected_ };
+  BOOST_FOREACH(LRUHandle* head, heads) {
+    for (LRUHandle* e = head->next; e != head; ) {
+      LRUHandle* next = e->next;
+      DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
+      if (Unref(e)) {
+        FreeEntry(e);
+      }
+      e = next;
+    }
+  }
+}
+
+void SLRUCache::SetCapacity(size_t capacity) {
+  double ratio = std::min(1.0, std::max(0.0, FLAGS_cache_slru_protected_ratio));
+  capacity_ = capacity;
+  protected_capacity_ = static_cast<size_t>(capacity * ratio);
+}
+
+bool SLRUCache::Unref(LRUHandle* e) {
+  DCHECK_GT(ANNOTATE_UNPROTECTED_READ(e->refs), 0);
+  return !base::RefCountDec(&e->refs);
+}
+
+void SLRUCache::FreeEntry(LRUHandle* e) {
+  DCHECK_EQ(ANNOTATE_UNPROTECTED_READ(e->refs), 0);
+  e->deleter->Delete(e->key(), e->value);
+  mem_tracker_->Release(e->charge);
+  if (PREDICT_TRUE(metrics_)) {
+    metrics_->cache_usage->DecrementBy(e->charge);
+    metrics_->evictions->Increment();
+  }
+  free(e);
+}
+
+void SLRUCache::Segment_Remove(LRUHandle* e) {
+  e->next->prev = e->prev;
+  e->prev->next = e->next;
+  if (e->in_protected) {
+    protected_usage_ -= e->charge;
+  } else {
+    probationary_usage_ -= e->charge;
+  }
+}
+
+void SLRUCache::Segment_Append(LRUHandle* e, bool is_protected) {
+  LRUHandle* head = is_protected ? &protected_ : &probationary_;
+  e->in_protected = is_protected;
+  e->next = head;
+  e->prev = head->prev;
+  e->prev->next = e;
+  e->next->prev = e;
+  if (is_protected) {
+    protected_usage_ += e->charge;
+  } else {
+    probationary_usage_ += e->charge;
+  }
+}
+
+Cache::Handle* SLRUCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
+  LRUHandle* e;
+  bool was_protected = false;
+  {
+    lock_guard<MutexType> l(&mutex_);
+    e = table_.Lookup(key, hash);
+    if (e != NULL) {
+      base::RefCountInc(&e->refs);
+      was_protected = e->in_protected;
+      Segment_Remove(e);
+      Segment_Append(e, true);
+
+      // Demote the oldest protected entries to make room. This doesn't change
+      // the total usage, so nothing needs to be evicted.
+      while (protected_usage_ > protected_capacity_ && protected_.next != &protected_) {
+        LRUHandle* old = protected_.next;
+        Segment_Remove(old);
+        Segment_Append(old, false);
+      }
+    }
+  }
+
+  // Do the metrics outside of the lock.
+  if (metrics_) {
+    metrics_->lookups->Increment();
+    bool was_hit = (e != NULL);
+    if (was_hit) {
+      if (caching) {
+        metrics_->cache_hits_caching->Increment();
+      } else {
+        metrics_->cache_hits->Increment();
+      }
+      if (was_protected) {
+        metrics_->protected_segment_hits->Increment();
+      } else {
+        metrics_->probationary_segment_hits->Increment();
+      }
+    } else {
+      if (caching) {
+        metrics_->cache_misses_caching->Increment();
+      } else {
+        metrics_->cache_misses->Increment();
+      }
+    }
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void SLRUCache::Release(Cache::Handle* handle) {
+  LRUHandle* e = reinterpret_cast<LRUHandle*>(handle);
+  bool last_reference = Unref(e);
+  if (last_reference) {
+    FreeEntry(e);
+  }
+}
+
+Cache::Handle* SLRUCache::Insert(
+    const Slice& key, uint32_t hash, void* value, size_t charge,
+    CacheDeleter *deleter) {
+
+  LRUHandle* e = reinterpret_cast<LRUHandle*>(
+      malloc(sizeof(LRUHandle)-1 + key.size()));
+  LRUHandle* to_remove_head = NULL;
+
+  e->value = value;
+  e->deleter = deleter;
+  e->charge = charge;
+  e->key_length = key.size();
+  e->hash = hash;
+  e->refs = 2;  // One from SLRUCache, one for the returned handle
+  e->in_protected = false;
+  memcpy(e->key_data, key.data(), key.size());
+  mem_tracker_->Consume(charge);
+  if (PREDICT_TRUE(metrics_)) {
+    metrics_->cache_usage->IncrementBy(charge);
+    metrics_->inserts->Increment();
+  }
+
+  {
+    lock_guard<MutexType> l(&mutex_);
+
+    Segment_Append(e, false);
+
+    LRUHandle* old = table_.Insert(e);
+    if (old != NULL) {
+      Segment_Remove(old);
+      if (Unref(old)) {
+        old->next = to_remove_head;
+        to_remove_head = old;
+      }
+    }
+
+    // Evict from the probationary segment first, and only fall back to the
+    // protected segment once the probationary segment is empty.
+    while (probationary_usage_ + protected_usage_ > capacity_) {
+      LRUHandle* old;
+      if (probationary_.next != &probationary_) {
+        old = probationary_.next;
+      } else if (protected_.next != &protected_) {
+        old = protected_.next;
+      } else {
+        break;
+      }
+      Segment_Remove(old);
+      table_.Remove(old->key(), old->hash);
+      if (Unref(old)) {
+        old->next = to_remove_head;
+        to_remove_head = old;
+      }
+    }
+  }
+
+  // we free the entries here outside of mutex for
+  // performance reasons
+  while (to_remove_head != NULL) {
+    LRUHandle* next = to_remove_head->next;
+    FreeEntry(to_remove_head);
+    to_remove_head = next;
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void SLRUCache::Erase(const Slice& key, uint32_t hash) {
+  LRUHandle* e;
+  bool last_reference = false;
+  {
+    lock_guard<MutexType> l(&mutex_);
+    e = table_.Remove(key, hash);
+    if (e != NULL) {
+      Segment_Remove(e);
+      last_reference = Unref(e);
+    }
+  }
+  // mutex not held here
+  // last_reference will only be true if e != NULL
+  if (last_reference) {
+    FreeEntry(e);
+  }
+}
+
+// A single shard of a CLOCK cache.
+//
+// Rather than moving entries to the head of a list on every hit, which needs
+// the shard's lock in exclusive mode, a hit only sets the entry's reference
+// bit. Lookups therefore only take the shard's lock in shared mode, and since
+// that lock is a percpu_rwlock, concurrent lookups on different CPUs don't
+// contend on the same cache line. Entries are kept in a ring, and eviction
+// advances a "clock hand" around it: entries which have been referenced since
+// the hand last passed get their bit cleared and a second chance, while the
+// others are evicted.
+class ClockCache {
+ public:
+  explicit ClockCache(MemTracker* tracker);
+  ~ClockCache();
+
+  // Separate from constructor so caller can easily make an array of ClockCache
+  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+
+  void SetMetrics(CacheMetrics* metrics) { metrics_ = metrics; }
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  Cache::Handle* Insert(const Slice& key, uint32_t hash,
+                        void* value, size_t charge,
+                        CacheDeleter* deleter);
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
+
+ private:
+  // Insert 'e' just behind the clock hand, so that it is the last entry the
+  // hand reaches.
+  void Ring_Insert(LRUHandle* e);
+  void Ring_Remove(LRUHandle* e);
+  // Just reduce the reference count by 1.
+  // Return true if last reference
+  bool Unref(LRUHandle* e);
+  // Call deleter and free
+  void FreeEntry(LRUHandle* e);
+
+  // Initialized before use.
+  size_t capacity_;
+
+  // Taken in shared mode by Lookup(), and in exclusive mode by anything
+  // which modifies the following state.
+  percpu_rwlock mutex_;
+  size_t usage_;
+
+  // Dummy head of the ring of entries.
+  LRUHandle ring_;
+  // The next entry to consider for eviction. May point at ring_.
+  LRUHandle* hand_;
+
+  HandleTable table_;
+
+  MemTracker* mem_tracker_;
+
+  CacheMetrics* metrics_;
+};
+
+ClockCache::ClockCache(MemTracker* tracker)
+ : usage_(0),
+   hand_(&ring_),
+   mem_tracker_(tracker),
+   metrics_(NULL) {
+  // Make empty circular linked list
+  ring_.next = &ring_;
+  ring_.prev = &ring_;
+}
+
+ClockCache::~ClockCache() {
+  for (LRUHandle* e = ring_.next; e != &ring_; ) {
+    LRUHandle* next = e->next;
+    DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
+    if (Unref(e)) {
+      FreeEntry(e);
+    }
+    e = next;
+  }
+}
+
+bool ClockCache::Unref(LRUHandle* e) {
+  DCHECK_GT(ANNOTATE_UNPROTECTED_READ(e->refs), 0);
+  return !base::RefCountDec(&e->refs);
+}
+
+void ClockCache::FreeEntry(LRUHandle* e) {
+  DCHECK_EQ(ANNOTATE_UNPROTECTED_READ(e->refs), 0);
+  e->deleter->Delete(e->key(), e->value);
+  mem_tracker_->Release(e->charge);
+  if (PREDICT_TRUE(metrics_)) {
+    metrics_->cache_usage->DecrementBy(e->charge);
+    metrics_->evictions->Increment();
+  }
+  free(e);
+}
+
+void ClockCache::Ring_Insert(LRUHandle* e) {
+  e->next = hand_;
+  e->prev = hand_->prev;
+  e->prev->next = e;
+  e->next->prev = e;
+  usage_ += e->charge;
+}
+
+void ClockCache::Ring_Remove(LRUHandle* e) {
+  if (hand_ == e) {
+    hand_ = e->next;
+  }
+  e->next->prev = e->prev;
+  e->prev->next = e->next;
+  usage_ -= e->charge;
+}
+
+Cache::Handle* ClockCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
+  LRUHandle* e;
+  {
+    shared_lock<rw_spinlock> l(&mutex_.get_lock());
+    e = table_.Lookup(key, hash);
+    if (e != NULL) {
+      base::RefCountInc(&e->refs);
+      // Avoid dirtying the cache line if the bit is already set.
+      if (!base::subtle::NoBarrier_Load(&e->clock_referenced)) {
+        base::subtle::NoBarrier_Store(&e->clock_referenced, 1);
+      }
+    }
+  }
+
+  // Do the metrics outside of the lock.
+  if (metrics_) {
+    metrics_->lookups->Increment();
+    bool was_hit = (e != NULL);
+    if (was_hit) {
+      if (caching) {
+        metrics_->cache_hits_caching->Increment();
+      } else {
+        metrics_->cache_hits->Increment();
+      }
+    } else {
+      if (caching) {
+        metrics_->cache_misses_caching->Increment();
+      } else {
+        metrics_->cache_misses->Increment();
+      }
+    }
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void ClockCache::Release(Cache::Handle* handle) {
+  LRUHandle* e = reinterpret_cast<LRUHandle*>(handle);
+  bool last_reference = Unref(e);
+  if (last_reference) {
+    FreeEntry(e);
+  }
+}
+
+Cache::Handle* ClockCache::Insert(
+    const Slice& key, uint32_t hash, void* value, size_t charge,
+    CacheDeleter *deleter) {
+
+  LRUHandle* e = reinterpret_cast<LRUHandle*>(
+      malloc(sizeof(LRUHandle)-1 + key.size()));
+  LRUHandle* to_remove_head = NULL;
+
+  e->value = value;
+  e->deleter = deleter;
+  e->charge = charge;
+  e->key_length = key.size();
+  e->hash = hash;
+  e->refs = 2;  // One from ClockCache, one for the returned handle
+  // Count the insert as a reference, as LRUCache treats it as a use.
+  // Otherwise, if every other entry has been referenced, the hand would
+  // reach and evict the new entry first.
+  e->clock_referenced = 1;
+  memcpy(e->key_data, key.data(), key.size());
+  mem_tracker_->Consume(charge);
+  if (PREDICT_TRUE(metrics_)) {
+    metrics_->cache_usage->IncrementBy(charge);
+    metrics_->inserts->Increment();
+  }
+
+  {
+    lock_guard<percpu_rwlock> l(&mutex_);
+
+    Ring_Insert(e);
+
+    LRUHandle* old = table_.Insert(e);
+    if (old != NULL) {
+      Ring_Remove(old);
+      if (Unref(old)) {
+        old->next = to_remove_head;
+        to_remove_head = old;
+      }
+    }
+
+    // Lookups can't set reference bits while we hold the lock exclusively,
+    // so this terminates within two turns of the hand.
+    while (usage_ > capacity_ && ring_.next != &ring_) {
+      if (hand_ == &ring_) {
+        hand_ = ring_.next;
+      }
+      LRUHandle* old = hand_;
+      if (old->clock_referenced) {
+        old->clock_referenced = 0;
+        hand_ = old->next;
+        continue;
+      }
+      Ring_Remove(old);
+      table_.Remove(old->key(), old->hash);
+      if (Unref(old)) {
+        old->next = to_remove_head;
+        to_remove_head = old;
+      }
+    }
+  }
+
+  // we free the entries here outside of mutex for
+  // performance reasons
+  while (to_remove_head != NULL) {
+    LRUHandle* next = to_remove_head->next;
+    FreeEntry(to_remove_head);
+    to_remove_head = next;
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void ClockCache::Erase(const Slice& key, uint32_t hash) {
+  LRUHandle* e;
+  bool last_reference = false;
+  {
+    lock_guard<percpu_rwlock> l(&mutex_);
+    e = table_.Remove(key, hash);
+    if (e != NULL) {
+      Ring_Remove(e);
+      last_reference = Unref(e);
+    }
+  }
+  // mutex not held here
+  // last_reference will only be true if e != NULL
+  if (last_reference) {
+    FreeEntry(e);
+  }
+}
+
 static const int kNumShardBits = 4;
-static const int kNumShards = 1 << kNumShardBits;
 
-class ShardedLRUCache : public Cache {
+// Returns the number of shard bits to use for a cache whose lookups should
+// scale with the number of cores: at least 2^kNumShardBits shards, and at
+// least one per CPU.
+static int PerCpuShardBits() {
+  return std::max(kNumShardBits, Bits::Log2Ceiling(base::NumCPUs()));
+}
+
+// A cache split into 2^num_shard_bits independently locked shards, each of
+// which is a LRUCache, SLRUCache or ClockCache.
+template<class CacheShard>
+class ShardedCache : public Cache {
  private:
   shared_ptr<MemTracker> mem_tracker_;
   gscoped_ptr<CacheMetrics> metrics_;
-  vector<LRUCache*> shards_;
+  vector<CacheShard*> shards_;
+  const int num_shard_bits_;
   MutexType id_mutex_;
   uint64_t last_id_;
 
@@ -392,28 +937,32 @@ class ShardedLRUCache : public Cache {
       reinterpret_cast<const char *>(s.data()), s.size());
   }
 
-  static uint32_t Shard(uint32_t hash) {
-    return hash >> (32 - kNumShardBits);
+  uint32_t Shard(uint32_t hash) const {
+    return hash >> (32 - num_shard_bits_);
   }
 
  public:
-  explicit ShardedLRUCache(size_t capacity, const string& id)
-      : last_id_(0) {
+  ShardedCache(size_t capacity, const string& id, int num_shard_bits = kNumShardBits)
+      : num_shard_bits_(num_shard_bits),
+        last_id_(0) {
+    DCHECK_GT(num_shard_bits_, 0);
+    DCHECK_LT(num_shard_bits_, 32);
     // A cache is often a singleton, so:
     // 1. We reuse its MemTracker if one already exists, and
     // 2. It is directly parented to the root MemTracker.
     mem_tracker_ = MemTracker::FindOrCreateTracker(
         -1, strings::Substitute("$0-sharded_lru_cache", id));
 
-    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
-    for (int s = 0; s < kNumShards; s++) {
-      gscoped_ptr<LRUCache> shard(new LRUCache(mem_tracker_.get()));
+    const int num_shards = 1 << num_shard_bits_;
+    const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
+    for (int s = 0; s < num_shards; s++) {
+      gscoped_ptr<CacheShard> shard(new CacheShard(mem_tracker_.get()));
       shard->SetCapacity(per_shard);
       shards_.push_back(shard.release());
     }
   }
 
-  virtual ~ShardedLRUCache() {
+  virtual ~ShardedCache() {
     STLDeleteElements(&shards_);
   }
 
@@ -442,9 +991,9 @@ class ShardedLRUCache : public Cache {
     return ++(last_id_);
   }
 
-  virtual void SetMetrics(const scoped_refptr<MetricEntity>& entity) OVERRIDE {
-    metrics_.reset(new CacheMetrics(entity));
-    BOOST_FOREACH(LRUCache* cache, shards_) {
+  virtual void SetMetrics(gscoped_ptr<CacheMetrics> metrics) OVERRIDE {
+    metrics_.reset(metrics.release());
+    BOOST_FOREACH(CacheShard* cache, shards_) {
       cache->SetMetrics(metrics_.get());
     }
   }
@@ -470,7 +1019,11 @@ class ShardedLRUCache : public Cache {
 Cache* NewLRUCache(CacheType type, size_t capacity, const string& id) {
   switch (type) {
     case DRAM_CACHE:
-      return new ShardedLRUCache(capacity, id);
+      return new ShardedCache<LRUCache>(capacity, id);
+    case DRAM_SLRU_CACHE:
+      return new ShardedCache<SLRUCache>(capacity, id);
+    case DRAM_CLOCK_CACHE:
+      return new ShardedCache<ClockCache>(capacity, id, PerCpuShardBits());
     case NVM_CACHE:
       return NewLRUNvmCache(capacity, id);
   }
@@ -21,6 +21,7 @@
 #include <stdint.h>
 #include <string>
 
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/slice.h"
@@ -33,11 +34,27 @@ class MetricEntity;
 
 enum CacheType {
   DRAM_CACHE,
-  NVM_CACHE
+  NVM_CACHE,
+  // Like DRAM_CACHE, but evicts with a segmented LRU (SLRU) policy. Each
+  // shard keeps two LRU lists: a probationary segment, which new entries are
+  // inserted into, and a protected segment, which may hold up to
+  // --cache_slru_protected_ratio of the shard's capacity. A hit moves an
+  // entry to the most recently used end of the protected segment. When the
+  // protected segment exceeds its share, its least recently used entries are
+  // moved to the most recently used end of the probationary segment. To make
+  // room for an insert, the least recently used probationary entries are
+  // evicted first, and protected entries only once the probationary segment
+  // is empty. Entries which are never hit after insertion, such as those of
+  // a large scan, thus only evict other such entries while there are any.
+  DRAM_SLRU_CACHE,
+  // Like DRAM_CACHE, but approximates LRU with the CLOCK algorithm so that
+  // lookups never take a lock exclusively. Suited to many concurrent readers.
+  DRAM_CLOCK_CACHE
 };
 
-// Create a new cache with a fixed size capacity.  This implementation
-// of Cache uses a least-recently-used eviction policy.
+// Create a new cache with a fixed size capacity. DRAM_CACHE and NVM_CACHE
+// evict the least recently used entries; DRAM_SLRU_CACHE and
+// DRAM_CLOCK_CACHE evict as described above.
 Cache* NewLRUCache(CacheType type, size_t capacity, const std::string& id);
 
 // Callback interface for deleting a value stored in the cache.
@@ -118,8 +135,9 @@ class Cache {
   // its cache keys.
   virtual uint64_t NewId() = 0;
 
-  // Pass a metric entity in order to start recoding metrics.
-  virtual void SetMetrics(const scoped_refptr<MetricEntity>& metric_entity) = 0;
+  // Start recording metrics in 'metrics', which the cache takes ownership
+  // of. Replaces any metrics which were previously set.
+  virtual void SetMetrics(gscoped_ptr<CacheMetrics> metrics) = 0;
 
   // Allocate 'bytes' bytes from the cache's memory pool.
   //
@@ -26,8 +26,12 @@ class AtomicGauge;
 class Counter;
 class MetricEntity;
 
+// The metrics recorded by a Cache. By default these are the block cache
+// metrics; caches which record their own set of metrics instantiate them in
+// a subclass.
 struct CacheMetrics {
   explicit CacheMetrics(const scoped_refptr<MetricEntity>& metric_entity);
+  virtual ~CacheMetrics() {}
 
   scoped_refptr<Counter> inserts;
   scoped_refptr<Counter> lookups;
@@ -37,7 +41,17 @@ struct CacheMetrics {
   scoped_refptr<Counter> cache_misses;
   scoped_refptr<Counter> cache_misses_caching;
 
+  // Only updated by segmented LRU caches.
+  scoped_refptr<Counter> probationary_segment_hits;
+  scoped_refptr<Counter> protected_segment_hits;
+
   scoped_refptr<AtomicGauge<uint64_t> > cache_usage;
+
+ protected:
+  CacheMetrics() {}
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CacheMetrics);
 };
 
 } // namespace kudu
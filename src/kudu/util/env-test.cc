@@ -24,6 +24,7 @@
 #include <boost/foreach.hpp>
 
 #include "kudu/gutil/bind.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/path_util.h"
@@ -34,6 +35,8 @@
 #include "kudu/util/env_util.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/memenv/memenv.h"
+#include "kudu/util/random.h"
+#include "kudu/util/test_macros.h"
 
 // Copied from falloc.h. Useful for older kernels that lack support for
 // hole punching; fallocate(2) will return EOPNOTSUPP.
@@ -44,6 +47,8 @@
 #define FALLOC_FL_PUNCH_HOLE  0x02 /* de-allocates range */
 #endif
 
+DECLARE_bool(env_use_io_uring);
+
 namespace kudu {
 
 using std::string;
@@ -417,6 +422,10 @@ class ShortReadRandomAccessFile : public RandomAccessFile {
     return wrapped_->Read(offset, short_n, result, scratch);
   }
 
+  virtual Status ReadAhead(uint64_t offset, size_t n) const OVERRIDE {
+    return wrapped_->ReadAhead(offset, n);
+  }
+
   virtual Status Size(uint64_t *size) const OVERRIDE {
     return wrapped_->Size(size);
   }
@@ -486,6 +495,8 @@ TEST_F(TestEnv, TestAppendVector) {
   ASSERT_NO_FATAL_FAILURE(DoTestAppendVector(opts));
   opts.mmap_file = false;
   ASSERT_NO_FATAL_FAILURE(DoTestAppendVector(opts));
+  opts.direct_io = true;
+  ASSERT_NO_FATAL_FAILURE(DoTestAppendVector(opts));
 }
 
 TEST_F(TestEnv, TestGetExecutablePath) {
@@ -505,6 +516,111 @@ TEST_F(TestEnv, TestOpenEmptyRandomAccessFile) {
   ASSERT_EQ(0, size);
 }
 
+TEST_F(TestEnv, TestReadAhead) {
+  const int kFileSize = 64 * 1024;
+  string test_file = GetTestPath("test_file");
+  ASSERT_NO_FATAL_FAILURE(WriteTestFile(env_.get(), test_file, kFileSize));
+
+  // Read-ahead is only a hint, so all we can check is that it's accepted,
+  // including for ranges which run past the end of the file.
+  gscoped_ptr<RandomAccessFile> raf;
+  ASSERT_OK(env_->NewRandomAccessFile(test_file, &raf));
+  ASSERT_OK(raf->ReadAhead(0, kFileSize));
+  ASSERT_OK(raf->ReadAhead(kFileSize / 2, kFileSize));
+
+  RWFileOptions opts;
+  opts.mode = Env::OPEN_EXISTING;
+  gscoped_ptr<RWFile> rwf;
+  ASSERT_OK(env_->NewRWFile(opts, test_file, &rwf));
+  ASSERT_OK(rwf->ReadAhead(0, kFileSize));
+
+  // The data is unaffected.
+  Slice s;
+  gscoped_ptr<uint8_t[]> scratch(new uint8_t[kFileSize]);
+  ASSERT_OK(env_util::ReadFully(raf.get(), 0, kFileSize, &s, scratch.get()));
+  ASSERT_EQ(kFileSize, s.size());
+}
+
+// Reads a batch of random ranges of a file, through both io_uring (where
+// supported) and threads, and checks the data.
+TEST_F(TestEnv, TestReadBatch) {
+  const int kFileSize = 1024 * 1024;
+  const int kNumReads = 300;
+  string test_file = GetTestPath("test_file");
+  ASSERT_NO_FATAL_FAILURE(WriteTestFile(env_.get(), test_file, kFileSize));
+  gscoped_ptr<RandomAccessFile> raf;
+  ASSERT_OK(env_->NewRandomAccessFile(test_file, &raf));
+  RWFileOptions opts;
+  opts.mode = Env::OPEN_EXISTING;
+  gscoped_ptr<RWFile> rwf;
+  ASSERT_OK(env_->NewRWFile(opts, test_file, &rwf));
+
+  Random r(SeedRandom());
+  gscoped_ptr<uint8_t[]> scratch(new uint8_t[kNumReads * 4096]);
+  BOOST_FOREACH(bool use_io_uring, boost::assign::list_of(true)(false)) {
+    FLAGS_env_use_io_uring = use_io_uring;
+    vector<ReadRequest> requests;
+    for (int i = 0; i < kNumReads; i++) {
+      size_t length = r.Uniform(4096);
+      requests.push_back(ReadRequest(r.Uniform(kFileSize - length), length,
+                                     scratch.get() + i * 4096));
+    }
+    ASSERT_OK(raf->ReadBatch(&requests));
+    BOOST_FOREACH(const ReadRequest& req, requests) {
+      ASSERT_EQ(req.length, req.result.size());
+      ASSERT_NO_FATAL_FAILURE(VerifyTestData(req.result, req.offset));
+    }
+    ASSERT_OK(rwf->ReadBatch(&requests));
+
+    // Reads which extend past the end of the file fail.
+    requests.push_back(ReadRequest(kFileSize - 10, 20, scratch.get()));
+    Status s = raf->ReadBatch(&requests);
+    ASSERT_TRUE(s.IsIOError()) << s.ToString();
+    ASSERT_STR_CONTAINS(s.ToString(), "EOF");
+  }
+}
+
+TEST_F(TestEnv, TestReadBatchAcrossFiles) {
+  const int kFileSize = 64 * 1024;
+  const int kNumFiles = 4;
+  const int kNumReads = 100;
+  vector<RWFile*> files;
+  ElementDeleter deleter(&files);
+  for (int i = 0; i < kNumFiles; i++) {
+    string test_file = GetTestPath(strings::Substitute("test_file_$0", i));
+    ASSERT_NO_FATAL_FAILURE(WriteTestFile(env_.get(), test_file, kFileSize));
+    RWFileOptions opts;
+    opts.mode = Env::OPEN_EXISTING;
+    gscoped_ptr<RWFile> rwf;
+    ASSERT_OK(env_->NewRWFile(opts, test_file, &rwf));
+    files.push_back(rwf.release());
+  }
+
+  Random r(SeedRandom());
+  gscoped_ptr<uint8_t[]> scratch(new uint8_t[kNumReads * 1024]);
+  BOOST_FOREACH(bool use_io_uring, boost::assign::list_of(true)(false)) {
+    FLAGS_env_use_io_uring = use_io_uring;
+    vector<FileReadRequest> requests;
+    for (int i = 0; i < kNumReads; i++) {
+      size_t length = r.Uniform(1024);
+      requests.push_back(FileReadRequest(files[r.Uniform(kNumFiles)],
+                                         r.Uniform(kFileSize - length), length,
+                                         scratch.get() + i * 1024));
+    }
+    ASSERT_OK(env_->ReadBatch(&requests));
+    BOOST_FOREACH(const FileReadRequest& req, requests) {
+      ASSERT_EQ(req.read.length, req.read.result.size());
+      ASSERT_NO_FATAL_FAILURE(VerifyTestData(req.read.result, req.read.offset));
+    }
+
+    // A read past the end of any of the files fails the batch.
+    requests.push_back(FileReadRequest(files[1], kFileSize - 10, 20, scratch.get()));
+    Status s = env_->ReadBatch(&requests);
+    ASSERT_TRUE(s.IsIOError()) << s.ToString();
+    ASSERT_STR_CONTAINS(s.ToString(), "EOF");
+  }
+}
+
 TEST_F(TestEnv, TestOverwrite) {
   string test_path = GetTestPath("test_env_wf");
 
@@ -529,6 +645,47 @@ TEST_F(TestEnv, TestReopen) {
   ASSERT_NO_FATAL_FAILURE(DoTestReopen(opts));
   opts.mmap_file = false;
   ASSERT_NO_FATAL_FAILURE(DoTestReopen(opts));
+  opts.direct_io = true;
+  ASSERT_NO_FATAL_FAILURE(DoTestReopen(opts));
+}
+
+// Test that direct I/O writes of unaligned lengths leave the file at its
+// logical size whenever it's synced, and can be appended to afterwards.
+TEST_F(TestEnv, TestDirectIOWrites) {
+  string test_path = GetTestPath("test_env_direct");
+  WritableFileOptions opts;
+  opts.direct_io = true;
+  shared_ptr<WritableFile> writer;
+  ASSERT_OK(env_util::OpenFileForWrite(opts, env_.get(), test_path, &writer));
+
+  // A mix of lengths smaller than, not a multiple of, and larger than both
+  // the alignment and the buffer.
+  const size_t kLengths[] = { 1, 4095, 4097, 100000, 300000, 513 };
+  string expected;
+  for (int i = 0; i < arraysize(kLengths); i++) {
+    string data(kLengths[i], 'a' + i);
+    ASSERT_OK(writer->Append(data));
+    expected += data;
+    ASSERT_EQ(expected.size(), writer->Size());
+
+    if (i % 2 == 0) {
+      ASSERT_OK(writer->Sync());
+      uint64_t size;
+      ASSERT_OK(env_->GetFileSize(test_path, &size));
+      ASSERT_EQ(expected.size(), size);
+    }
+  }
+  ASSERT_OK(writer->Close());
+
+  shared_ptr<RandomAccessFile> reader;
+  ASSERT_OK(env_util::OpenFileForRandom(env_.get(), test_path, &reader));
+  uint64_t size;
+  ASSERT_OK(reader->Size(&size));
+  ASSERT_EQ(expected.size(), size);
+  gscoped_ptr<uint8_t[]> scratch(new uint8_t[size]);
+  Slice s;
+  ASSERT_OK(env_util::ReadFully(reader.get(), 0, size, &s, scratch.get()));
+  ASSERT_EQ(expected, s.ToString());
 }
 
 TEST_F(TestEnv, TestIsDirectory) {
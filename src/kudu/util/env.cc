@@ -3,6 +3,10 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "kudu/util/env.h"
+
+#include <boost/foreach.hpp>
+
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/faststring.h"
 
 namespace kudu {
@@ -10,18 +14,51 @@ namespace kudu {
 Env::~Env() {
 }
 
+Status Env::ReadBatch(std::vector<FileReadRequest>* requests) {
+  BOOST_FOREACH(FileReadRequest& req, *requests) {
+    ReadRequest* r = &req.read;
+    RETURN_NOT_OK(req.file->Read(r->offset, r->length, &r->result, r->scratch));
+  }
+  return Status::OK();
+}
+
 SequentialFile::~SequentialFile() {
 }
 
 RandomAccessFile::~RandomAccessFile() {
 }
 
+Status RandomAccessFile::ReadBatch(std::vector<ReadRequest>* requests) const {
+  BOOST_FOREACH(ReadRequest& req, *requests) {
+    size_t done = 0;
+    while (done < req.length) {
+      Slice s;
+      RETURN_NOT_OK(Read(req.offset + done, req.length - done, &s, req.scratch + done));
+      if (s.empty()) {
+        return Status::IOError(strings::Substitute(
+            "EOF trying to read $0 bytes at offset $1", req.length, req.offset));
+      }
+      s.relocate(req.scratch + done);
+      done += s.size();
+    }
+    req.result = Slice(req.scratch, req.length);
+  }
+  return Status::OK();
+}
+
 WritableFile::~WritableFile() {
 }
 
 RWFile::~RWFile() {
 }
 
+Status RWFile::ReadBatch(std::vector<ReadRequest>* requests) const {
+  BOOST_FOREACH(ReadRequest& req, *requests) {
+    RETURN_NOT_OK(Read(req.offset, req.length, &req.result, req.scratch));
+  }
+  return Status::OK();
+}
+
 FileLock::~FileLock() {
 }
 
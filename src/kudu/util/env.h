@@ -31,7 +31,9 @@ class SequentialFile;
 class Slice;
 class WritableFile;
 
+struct FileReadRequest;
 struct RandomAccessFileOptions;
+struct ReadRequest;
 struct RWFileOptions;
 struct WritableFileOptions;
 
@@ -127,6 +129,15 @@ class Env {
                            const std::string& fname,
                            gscoped_ptr<RWFile>* result) = 0;
 
+  // Issue the reads of 'requests' together, keeping as many of them in
+  // flight at once as possible. The reads may span several files, each of
+  // which must have been opened through this Env.
+  //
+  // Fails if any of the reads fails or extends past the end of its file.
+  //
+  // The default implementation reads the requests one at a time.
+  virtual Status ReadBatch(std::vector<FileReadRequest>* requests);
+
   // Returns true iff the named file exists.
   virtual bool FileExists(const std::string& fname) = 0;
 
@@ -148,6 +159,11 @@ class Env {
   // Synchronize the entry for a specific directory.
   virtual Status SyncDir(const std::string& dirname) = 0;
 
+  // Synchronize the contents of the given file, which may be concurrently
+  // appended to through a WritableFile. Writes which completed before the
+  // call are durable once it returns.
+  virtual Status SyncFile(const std::string& fname) = 0;
+
   // Recursively delete the specified directory.
   // This should operate safely, not following any symlinks, etc.
   virtual Status DeleteRecursively(const std::string &dirname) = 0;
@@ -308,6 +324,22 @@ class RandomAccessFile {
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       uint8_t *scratch) const = 0;
 
+  // Hint that "n" bytes starting at "offset" will be read soon, so that
+  // they may be read into the OS page cache in the background. Does not
+  // wait for the data to be read.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual Status ReadAhead(uint64_t offset, size_t n) const = 0;
+
+  // Read each of 'requests' in full, returning an IOError if any of them
+  // extends past the end of the file. The reads may be issued concurrently;
+  // the call returns once all of them have completed.
+  //
+  // The default implementation reads them one after the other.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual Status ReadBatch(std::vector<ReadRequest>* requests) const;
+
   // Returns the size of the file
   virtual Status Size(uint64_t *size) const = 0;
 
@@ -319,6 +351,13 @@ class RandomAccessFile {
   virtual size_t memory_footprint() const = 0;
 };
 
+// The alignment required of the offsets, lengths and memory buffers of
+// writes to files opened with 'direct_io'.
+const size_t kDirectIOAlignment = 4096;
+
+// The size of the buffers in which writes with direct I/O are staged.
+const size_t kDirectIOBufferSize = 256 * 1024;
+
 // Creation-time options for WritableFile
 struct WritableFileOptions {
   // Use memory-mapped I/O if supported.
@@ -327,15 +366,62 @@ struct WritableFileOptions {
   // Call Sync() during Close().
   bool sync_on_close;
 
+  // Write to the file with direct I/O (bypassing the page cache) if the
+  // filesystem supports it. Appends are staged in an aligned buffer and
+  // written out in whole aligned chunks. Takes precedence over 'mmap_file'.
+  bool direct_io;
+
   // See CreateMode for details.
   Env::CreateMode mode;
 
   WritableFileOptions()
     : mmap_file(true),
       sync_on_close(false),
+      direct_io(false),
       mode(Env::CREATE_IF_NON_EXISTING_TRUNCATE) { }
 };
 
+// One of the reads of a RandomAccessFile::ReadBatch() call.
+struct ReadRequest {
+  ReadRequest()
+    : offset(0),
+      length(0),
+      scratch(NULL) {
+  }
+
+  ReadRequest(uint64_t offset, size_t length, uint8_t* scratch)
+    : offset(offset),
+      length(length),
+      scratch(scratch) {
+  }
+
+  // The range of the file to read.
+  uint64_t offset;
+  size_t length;
+
+  // At least 'length' bytes which may be used to hold the data. Must be
+  // live while 'result' is used.
+  uint8_t* scratch;
+
+  // Set to the 'length' bytes read. May point at 'scratch'.
+  Slice result;
+};
+
+// One of the reads of an Env::ReadBatch() call.
+struct FileReadRequest {
+  FileReadRequest()
+    : file(NULL) {
+  }
+
+  FileReadRequest(const RWFile* file, uint64_t offset, size_t length, uint8_t* scratch)
+    : file(file),
+      read(offset, length, scratch) {
+  }
+
+  const RWFile* file;
+  ReadRequest read;
+};
+
 // Options specified when a file is opened for random access.
 struct RandomAccessFileOptions {
   // Use memory-mapped I/O if supported.
@@ -399,11 +485,18 @@ struct RWFileOptions {
   // Call Sync() during Close().
   bool sync_on_close;
 
+  // Access the file with direct I/O (bypassing the page cache) if the
+  // filesystem supports it. If so, every read and write must be aligned to
+  // kDirectIOAlignment in offset, length and memory; the file does no
+  // buffering of its own.
+  bool direct_io;
+
   // See CreateMode for details.
   Env::CreateMode mode;
 
   RWFileOptions()
     : sync_on_close(false),
+      direct_io(false),
       mode(Env::CREATE_IF_NON_EXISTING_TRUNCATE) { }
 };
 
@@ -438,6 +531,13 @@ class RWFile {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const = 0;
 
+  // Hint that 'length' bytes starting at 'offset' will be read soon. See
+  // RandomAccessFile::ReadAhead().
+  virtual Status ReadAhead(uint64_t offset, size_t length) const = 0;
+
+  // Read each of 'requests'. See RandomAccessFile::ReadBatch().
+  virtual Status ReadBatch(std::vector<ReadRequest>* requests) const;
+
   // Writes 'data' to the file position given by 'offset'.
   virtual Status Write(uint64_t offset, const Slice& data) = 0;
 
@@ -547,6 +647,9 @@ class EnvWrapper : public Env {
                    gscoped_ptr<RWFile>* r) OVERRIDE {
     return target_->NewRWFile(o, f, r);
   }
+  Status ReadBatch(std::vector<FileReadRequest>* r) OVERRIDE {
+    return target_->ReadBatch(r);
+  }
   bool FileExists(const std::string& f) OVERRIDE { return target_->FileExists(f); }
   Status GetChildren(const std::string& dir, std::vector<std::string>* r) OVERRIDE {
     return target_->GetChildren(dir, r);
@@ -554,6 +657,7 @@ class EnvWrapper : public Env {
   Status DeleteFile(const std::string& f) OVERRIDE { return target_->DeleteFile(f); }
   Status CreateDir(const std::string& d) OVERRIDE { return target_->CreateDir(d); }
   Status SyncDir(const std::string& d) OVERRIDE { return target_->SyncDir(d); }
+  Status SyncFile(const std::string& f) OVERRIDE { return target_->SyncFile(f); }
   Status DeleteDir(const std::string& d) OVERRIDE { return target_->DeleteDir(d); }
   Status DeleteRecursively(const std::string& d) OVERRIDE { return target_->DeleteRecursively(d); }
   Status GetFileSize(const std::string& f, uint64_t* s) OVERRIDE {
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <dirent.h>
 #include <errno.h>
@@ -30,12 +31,20 @@
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/callback.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/singleton.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/alignment.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env.h"
 #include "kudu/util/errno.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/io_uring.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/monotime.h"
@@ -43,6 +52,7 @@
 #include "kudu/util/slice.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/thread_restrictions.h"
+#include "kudu/util/threadpool.h"
 
 // Copied from falloc.h. Useful for older kernels that lack support for
 // hole punching; fallocate(2) will return EOPNOTSUPP.
@@ -69,6 +79,18 @@ DEFINE_bool(never_fsync, false,
 TAG_FLAG(never_fsync, advanced);
 TAG_FLAG(never_fsync, unsafe);
 
+DEFINE_bool(env_use_io_uring, true,
+            "Issue batches of reads through io_uring, if the kernel supports it. "
+            "Otherwise they're spread across a pool of threads.");
+TAG_FLAG(env_use_io_uring, advanced);
+TAG_FLAG(env_use_io_uring, experimental);
+
+DEFINE_int32(env_read_batch_threads, 16,
+             "Maximum number of threads used to issue batches of reads "
+             "concurrently when io_uring isn't used.");
+TAG_FLAG(env_read_batch_threads, advanced);
+TAG_FLAG(env_read_batch_threads, experimental);
+
 using base::subtle::Atomic64;
 using base::subtle::Barrier_AtomicIncrement;
 using std::tr1::unordered_set;
@@ -135,7 +157,21 @@ static Status DoSync(int fd, const string& filename) {
   return Status::OK();
 }
 
-static Status DoOpen(const string& filename, Env::CreateMode mode, int* fd) {
+// Switch 'fd' to direct I/O if its filesystem supports it. O_DIRECT is set
+// after opening rather than passed to open(), since some filesystems create
+// the file before rejecting the flag.
+static void EnableDirectIO(const string& filename, int fd) {
+  int flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_DIRECT) < 0) {
+    int err = errno;
+    KLOG_FIRST_N(WARNING, 1) << "Direct I/O is not supported for " << filename
+                             << ": " << ErrnoToString(err)
+                             << "; writing through the page cache instead";
+  }
+}
+
+static Status DoOpen(const string& filename, Env::CreateMode mode, bool direct_io,
+                     int* fd) {
   ThreadRestrictions::AssertIOAllowed();
   int flags = O_RDWR;
   switch (mode) {
@@ -154,10 +190,199 @@ static Status DoOpen(const string& filename, Env::CreateMode mode, int* fd) {
   if (f < 0) {
     return IOError(filename, errno);
   }
+  if (direct_io) {
+    EnableDirectIO(filename, f);
+  }
   *fd = f;
   return Status::OK();
 }
 
+static Status DoReadAhead(const string& filename, int fd, uint64_t offset, size_t n) {
+  // posix_fadvise() only queues the reads, so there's no need to assert
+  // that IO is allowed here.
+  int err = posix_fadvise(fd, offset, n, POSIX_FADV_WILLNEED);
+  if (PREDICT_FALSE(err != 0)) {
+    return IOError(filename, err);
+  }
+  return Status::OK();
+}
+
+static Status DoReadFully(const string& filename, int fd, uint64_t offset, size_t length,
+                          Slice* result, uint8_t* scratch) {
+  ThreadRestrictions::AssertIOAllowed();
+  int rem = length;
+  uint8_t* dst = scratch;
+  uint64_t cur_offset = offset;
+  while (rem > 0) {
+    ssize_t r = pread(fd, dst, rem, cur_offset);
+    if (r < 0) {
+      // An error: return a non-ok status.
+      return IOError(filename, errno);
+    }
+    Slice this_result(dst, r);
+    DCHECK_LE(this_result.size(), rem);
+    if (this_result.size() == 0) {
+      // EOF
+      return Status::IOError(Substitute("EOF trying to read $0 bytes at offset $1",
+                                        length, offset));
+    }
+    dst += this_result.size();
+    rem -= this_result.size();
+    cur_offset += this_result.size();
+  }
+  DCHECK_EQ(0, rem);
+  *result = Slice(scratch, length);
+  return Status::OK();
+}
+
+// Issues the reads of a batch concurrently, either by submitting them all to
+// io_uring, or by spreading them across a pool of threads.
+class BatchReader {
+ public:
+  static BatchReader* GetSingleton() {
+    return Singleton<BatchReader>::get();
+  }
+
+  // Read each of 'requests' from the file at the same index of 'filenames'
+  // and 'fds'.
+  Status Read(const vector<const string*>& filenames, const vector<int>& fds,
+              vector<ReadRequest>* requests);
+
+ private:
+  friend class Singleton<BatchReader>;
+
+  BatchReader();
+
+  // Return an idle ring, setting up a new one if there aren't any.
+  // Returns NULL if io_uring can't be used.
+  IoUring* AcquireRing();
+
+  void ReleaseRing(IoUring* ring);
+
+  Status ReadWithThreads(const vector<const string*>& filenames, const vector<int>& fds,
+                         vector<ReadRequest>* requests);
+
+  static void ReadTask(const string* filename, int fd, ReadRequest* req,
+                       Status* status, CountDownLatch* latch);
+
+  // Setting up a ring takes several system calls, so idle ones are kept
+  // for reuse. There are at most as many as there were concurrent batches.
+  simple_spinlock lock_;
+  vector<IoUring*> idle_rings_;
+  ElementDeleter idle_rings_deleter_;
+
+  // Set once setting up a ring has failed, after which batches are always
+  // read with threads.
+  AtomicBool io_uring_failed_;
+
+  gscoped_ptr<ThreadPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(BatchReader);
+};
+
+// The number of reads each ring may have in flight.
+static const uint32_t kIoUringQueueDepth = 64;
+
+BatchReader::BatchReader()
+  : idle_rings_deleter_(&idle_rings_),
+    io_uring_failed_(false) {
+  CHECK_OK(ThreadPoolBuilder("batch-read")
+           .set_max_threads(FLAGS_env_read_batch_threads)
+           .Build(&pool_));
+}
+
+IoUring* BatchReader::AcquireRing() {
+  if (!FLAGS_env_use_io_uring || io_uring_failed_.Load()) {
+    return NULL;
+  }
+  {
+    lock_guard<simple_spinlock> l(&lock_);
+    if (!idle_rings_.empty()) {
+      IoUring* ring = idle_rings_.back();
+      idle_rings_.pop_back();
+      return ring;
+    }
+  }
+  gscoped_ptr<IoUring> ring;
+  Status s = IoUring::Create(kIoUringQueueDepth, &ring);
+  if (!s.ok()) {
+    if (!io_uring_failed_.Exchange(true)) {
+      LOG(WARNING) << "Unable to use io_uring, reading batches with threads instead: "
+                   << s.ToString();
+    }
+    return NULL;
+  }
+  return ring.release();
+}
+
+void BatchReader::ReleaseRing(IoUring* ring) {
+  lock_guard<simple_spinlock> l(&lock_);
+  idle_rings_.push_back(ring);
+}
+
+Status BatchReader::Read(const vector<const string*>& filenames, const vector<int>& fds,
+                         vector<ReadRequest>* requests) {
+  ThreadRestrictions::AssertIOAllowed();
+  IoUring* ring = AcquireRing();
+  if (!ring) {
+    return ReadWithThreads(filenames, fds, requests);
+  }
+  size_t failed = 0;
+  Status s = ring->Read(fds, requests, &failed);
+  ReleaseRing(ring);
+  if (!s.ok() && s.posix_code() > 0) {
+    // Go through IOError() so that errors are handled like those of
+    // blocking reads.
+    return IOError(*filenames[failed], s.posix_code());
+  }
+  RETURN_NOT_OK_PREPEND(s, *filenames[failed]);
+  return Status::OK();
+}
+
+void BatchReader::ReadTask(const string* filename, int fd, ReadRequest* req,
+                           Status* status, CountDownLatch* latch) {
+  *status = DoReadFully(*filename, fd, req->offset, req->length, &req->result, req->scratch);
+  latch->CountDown();
+}
+
+Status BatchReader::ReadWithThreads(const vector<const string*>& filenames,
+                                    const vector<int>& fds,
+                                    vector<ReadRequest>* requests) {
+  // The calling thread reads the first request itself.
+  vector<Status> statuses(requests->size());
+  CountDownLatch latch(requests->size() - 1);
+  for (int i = 1; i < requests->size(); i++) {
+    ReadRequest* req = &(*requests)[i];
+    Status s = pool_->SubmitFunc(boost::bind(&BatchReader::ReadTask, filenames[i], fds[i],
+                                             req, &statuses[i], &latch));
+    if (PREDICT_FALSE(!s.ok())) {
+      ReadTask(filenames[i], fds[i], req, &statuses[i], &latch);
+    }
+  }
+  ReadRequest* first = &(*requests)[0];
+  statuses[0] = DoReadFully(*filenames[0], fds[0], first->offset, first->length,
+                            &first->result, first->scratch);
+  latch.Wait();
+
+  BOOST_FOREACH(const Status& s, statuses) {
+    RETURN_NOT_OK(s);
+  }
+  return Status::OK();
+}
+
+static Status DoReadBatch(const string& filename, int fd, vector<ReadRequest>* requests) {
+  if (requests->empty()) {
+    return Status::OK();
+  }
+  if (requests->size() == 1) {
+    ReadRequest* req = &(*requests)[0];
+    return DoReadFully(filename, fd, req->offset, req->length, &req->result, req->scratch);
+  }
+  vector<const string*> filenames(requests->size(), &filename);
+  vector<int> fds(requests->size(), fd);
+  return BatchReader::GetSingleton()->Read(filenames, fds, requests);
+}
+
 class PosixSequentialFile: public SequentialFile {
  private:
   std::string filename_;
@@ -220,6 +445,14 @@ class PosixRandomAccessFile: public RandomAccessFile {
     return s;
   }
 
+  virtual Status ReadAhead(uint64_t offset, size_t n) const OVERRIDE {
+    return DoReadAhead(filename_, fd_, offset, n);
+  }
+
+  virtual Status ReadBatch(vector<ReadRequest>* requests) const OVERRIDE {
+    return DoReadBatch(filename_, fd_, requests);
+  }
+
   virtual Status Size(uint64_t *size) const OVERRIDE {
     TRACE_EVENT1("io", "PosixRandomAccessFile::Size", "path", filename_);
     ThreadRestrictions::AssertIOAllowed();
@@ -266,6 +499,12 @@ class PosixMmapReadableFile: public RandomAccessFile {
     return s;
   }
 
+  virtual Status ReadAhead(uint64_t offset, size_t n) const OVERRIDE {
+    // Reads of a mapped file fault the pages in on access anyway, and the
+    // kernel already reads ahead around faults.
+    return Status::OK();
+  }
+
   virtual Status Size(uint64_t *size) const OVERRIDE {
     *size = length_;
     return Status::OK();
@@ -542,6 +781,12 @@ class PosixMmapFile : public WritableFile {
 
 // Use non-memory mapped POSIX files to write data to a file.
 //
+// With direct I/O, appends are staged in an aligned buffer, and only whole
+// aligned chunks of it are written out, except when syncing or closing the
+// file. Then the partial chunk at the end is written out too, padded with
+// zeroes which are truncated away afterwards. That chunk stays buffered, so
+// that it can be rewritten whole once more data is appended to it.
+//
 // TODO (perf) investigate zeroing a pre-allocated allocated area in
 // order to further improve Sync() performance.
 class PosixWritableFile : public WritableFile {
@@ -555,7 +800,38 @@ class PosixWritableFile : public WritableFile {
         sync_on_close_(sync_on_close),
         filesize_(file_size),
         pre_allocated_size_(0),
-        pending_sync_(false) {
+        pending_sync_(false),
+        direct_buf_offset_(0),
+        direct_buf_len_(0),
+        tail_written_(false),
+        padded_(false) {
+  }
+
+  // Stage appends for direct I/O. If the file doesn't end on an aligned
+  // boundary, reads its last partial chunk back into the buffer.
+  Status InitDirectIO() {
+    void* buf;
+    int err = posix_memalign(&buf, kDirectIOAlignment, kDirectIOBufferSize);
+    if (err != 0) {
+      return IOError(filename_, err);
+    }
+    direct_buf_.reset(static_cast<uint8_t*>(buf));
+    direct_buf_offset_ = KUDU_ALIGN_DOWN(filesize_, kDirectIOAlignment);
+    direct_buf_len_ = filesize_ - direct_buf_offset_;
+    tail_written_ = true;
+    if (direct_buf_len_ > 0) {
+      ThreadRestrictions::AssertIOAllowed();
+      ssize_t r = pread(fd_, direct_buf_.get(), kDirectIOAlignment, direct_buf_offset_);
+      if (r < 0) {
+        return IOError(filename_, errno);
+      }
+      if (r < direct_buf_len_) {
+        return Status::IOError(
+            Substitute("$0: EOF trying to read $1 bytes at offset $2",
+                       filename_, direct_buf_len_, direct_buf_offset_));
+      }
+    }
+    return Status::OK();
   }
 
   ~PosixWritableFile() {
@@ -575,6 +851,13 @@ class PosixWritableFile : public WritableFile {
     static const size_t kIovMaxElements = IOV_MAX;
 
     Status s;
+    if (direct_buf_) {
+      for (size_t i = 0; i < data_vector.size() && s.ok(); i++) {
+        s = DoAppendDirect(data_vector[i]);
+      }
+      pending_sync_ = true;
+      return s;
+    }
     for (size_t i = 0; i < data_vector.size() && s.ok(); i += kIovMaxElements) {
       size_t n = std::min(data_vector.size() - i, kIovMaxElements);
       s = DoWritev(data_vector, i, n);
@@ -607,13 +890,20 @@ class PosixWritableFile : public WritableFile {
     ThreadRestrictions::AssertIOAllowed();
     Status s;
 
-    // If we've allocated more space than we used, truncate to the
-    // actual size of the file and perform Sync().
-    if (filesize_ < pre_allocated_size_) {
+    if (direct_buf_) {
+      s = DoWriteDirect(true);
+    }
+
+    // If we've allocated (or written padding to) more space than we used,
+    // truncate to the actual size of the file and perform Sync().
+    if (filesize_ < pre_allocated_size_ || padded_) {
       if (ftruncate(fd_, filesize_) < 0) {
-        s = IOError(filename_, errno);
-        pending_sync_ = true;
+        if (s.ok()) {
+          s = IOError(filename_, errno);
+        }
       }
+      padded_ = false;
+      pending_sync_ = true;
     }
 
     if (sync_on_close_) {
@@ -639,6 +929,11 @@ class PosixWritableFile : public WritableFile {
   virtual Status Flush(FlushMode mode) OVERRIDE {
     TRACE_EVENT1("io", "PosixWritableFile::Flush", "path", filename_);
     ThreadRestrictions::AssertIOAllowed();
+    if (direct_buf_) {
+      // The written chunks bypassed the page cache, so there's nothing
+      // left to flush.
+      return DoWriteDirect(false);
+    }
     int flags = SYNC_FILE_RANGE_WRITE;
     if (mode == FLUSH_SYNC) {
       flags |= SYNC_FILE_RANGE_WAIT_AFTER;
@@ -652,6 +947,15 @@ class PosixWritableFile : public WritableFile {
   virtual Status Sync() OVERRIDE {
     TRACE_EVENT1("io", "PosixWritableFile::Sync", "path", filename_);
     ThreadRestrictions::AssertIOAllowed();
+    if (direct_buf_) {
+      RETURN_NOT_OK(DoWriteDirect(true));
+      if (padded_) {
+        if (ftruncate(fd_, filesize_) < 0) {
+          return IOError(filename_, errno);
+        }
+        padded_ = false;
+      }
+    }
     LOG_SLOW_EXECUTION(WARNING, 1000, Substitute("sync call for $0", filename_)) {
       if (pending_sync_) {
         pending_sync_ = false;
@@ -704,6 +1008,65 @@ class PosixWritableFile : public WritableFile {
     return Status::OK();
   }
 
+  // Copy 'data' into the direct I/O buffer, writing it out whenever it
+  // fills up.
+  Status DoAppendDirect(const Slice& data) {
+    const uint8_t* src = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+      size_t n = std::min(left, kDirectIOBufferSize - direct_buf_len_);
+      memcpy(direct_buf_.get() + direct_buf_len_, src, n);
+      direct_buf_len_ += n;
+      filesize_ += n;
+      tail_written_ = false;
+      src += n;
+      left -= n;
+      if (direct_buf_len_ == kDirectIOBufferSize) {
+        RETURN_NOT_OK(DoWriteDirect(false));
+      }
+    }
+    return Status::OK();
+  }
+
+  // Write out the whole aligned chunks of the direct I/O buffer and drop
+  // them from it. If 'include_tail' is true, the partial chunk at the end is
+  // written out too (unless it already has been), padded with zeroes, but
+  // is kept in the buffer.
+  Status DoWriteDirect(bool include_tail) {
+    ThreadRestrictions::AssertIOAllowed();
+    size_t whole_len = KUDU_ALIGN_DOWN(direct_buf_len_, kDirectIOAlignment);
+    size_t write_len = whole_len;
+    if (include_tail && !tail_written_ && whole_len < direct_buf_len_) {
+      write_len = KUDU_ALIGN_UP(direct_buf_len_, kDirectIOAlignment);
+      memset(direct_buf_.get() + direct_buf_len_, 0, write_len - direct_buf_len_);
+    }
+    if (write_len == 0) {
+      return Status::OK();
+    }
+
+    ssize_t written = pwrite(fd_, direct_buf_.get(), write_len, direct_buf_offset_);
+    if (PREDICT_FALSE(written == -1)) {
+      int err = errno;
+      return IOError(filename_, err);
+    }
+    if (PREDICT_FALSE(written != write_len)) {
+      return Status::IOError(
+          Substitute("pwrite error: expected to write $0 bytes, wrote $1 bytes instead",
+                     write_len, written));
+    }
+    if (write_len > whole_len) {
+      tail_written_ = true;
+      padded_ = true;
+    }
+
+    if (whole_len > 0) {
+      memmove(direct_buf_.get(), direct_buf_.get() + whole_len, direct_buf_len_ - whole_len);
+      direct_buf_offset_ += whole_len;
+      direct_buf_len_ -= whole_len;
+    }
+    return Status::OK();
+  }
+
   const std::string filename_;
   int fd_;
   bool sync_on_close_;
@@ -711,6 +1074,19 @@ class PosixWritableFile : public WritableFile {
   uint64_t pre_allocated_size_;
 
   bool pending_sync_;
+
+  // The direct I/O buffer, or NULL if not using direct I/O. Always holds
+  // the end of the file, starting at the aligned 'direct_buf_offset_'.
+  gscoped_ptr<uint8_t[], FreeDeleter> direct_buf_;
+  uint64_t direct_buf_offset_;
+  size_t direct_buf_len_;
+
+  // Whether the partial chunk at the end of the buffer is on disk already.
+  bool tail_written_;
+
+  // Whether zeroes past the end of the file were written along with its
+  // last partial chunk, and have yet to be truncated away.
+  bool padded_;
 };
 
 class PosixRWFile : public RWFile {
@@ -733,29 +1109,15 @@ class PosixRWFile : public RWFile {
 
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const OVERRIDE {
-    ThreadRestrictions::AssertIOAllowed();
-    int rem = length;
-    uint8_t* dst = scratch;
-    while (rem > 0) {
-      ssize_t r = pread(fd_, dst, rem, offset);
-      if (r < 0) {
-        // An error: return a non-ok status.
-        return IOError(filename_, errno);
-      }
-      Slice this_result(dst, r);
-      DCHECK_LE(this_result.size(), rem);
-      if (this_result.size() == 0) {
-        // EOF
-        return Status::IOError(Substitute("EOF trying to read $0 bytes at offset $1",
-                                          length, offset));
-      }
-      dst += this_result.size();
-      rem -= this_result.size();
-      offset += this_result.size();
-    }
-    DCHECK_EQ(0, rem);
-    *result = Slice(scratch, length);
-    return Status::OK();
+    return DoReadFully(filename_, fd_, offset, length, result, scratch);
+  }
+
+  virtual Status ReadAhead(uint64_t offset, size_t length) const OVERRIDE {
+    return DoReadAhead(filename_, fd_, offset, length);
+  }
+
+  virtual Status ReadBatch(vector<ReadRequest>* requests) const OVERRIDE {
+    return DoReadBatch(filename_, fd_, requests);
   }
 
   virtual Status Write(uint64_t offset, const Slice& data) OVERRIDE {
@@ -863,6 +1225,8 @@ class PosixRWFile : public RWFile {
     return filename_;
   }
 
+  int fd() const { return fd_; }
+
  private:
   const std::string filename_;
   int fd_;
@@ -956,7 +1320,7 @@ class PosixEnv : public Env {
                                  gscoped_ptr<WritableFile>* result) OVERRIDE {
     TRACE_EVENT1("io", "PosixEnv::NewWritableFile", "path", fname);
     int fd;
-    RETURN_NOT_OK(DoOpen(fname, opts.mode, &fd));
+    RETURN_NOT_OK(DoOpen(fname, opts.mode, opts.direct_io, &fd));
     return InstantiateNewWritableFile(fname, fd, opts, result);
   }
 
@@ -974,6 +1338,9 @@ class PosixEnv : public Env {
                      errno);
     }
     *created_filename = fname.get();
+    if (opts.direct_io) {
+      EnableDirectIO(*created_filename, fd);
+    }
     return InstantiateNewWritableFile(*created_filename, fd, opts, result);
   }
 
@@ -987,11 +1354,40 @@ class PosixEnv : public Env {
                            gscoped_ptr<RWFile>* result) OVERRIDE {
     TRACE_EVENT1("io", "PosixEnv::NewRWFile", "path", fname);
     int fd;
-    RETURN_NOT_OK(DoOpen(fname, opts.mode, &fd));
+    RETURN_NOT_OK(DoOpen(fname, opts.mode, opts.direct_io, &fd));
     result->reset(new PosixRWFile(fname, fd, opts.sync_on_close));
     return Status::OK();
   }
 
+  virtual Status ReadBatch(vector<FileReadRequest>* requests) OVERRIDE {
+    if (requests->empty()) {
+      return Status::OK();
+    }
+    vector<const string*> filenames;
+    vector<int> fds;
+    vector<ReadRequest> reads;
+    filenames.reserve(requests->size());
+    fds.reserve(requests->size());
+    reads.reserve(requests->size());
+    BOOST_FOREACH(const FileReadRequest& req, *requests) {
+      const PosixRWFile* file = down_cast<const PosixRWFile*>(req.file);
+      filenames.push_back(&file->filename());
+      fds.push_back(file->fd());
+      reads.push_back(req.read);
+    }
+    if (reads.size() == 1) {
+      ReadRequest* r = &reads[0];
+      RETURN_NOT_OK(DoReadFully(*filenames[0], fds[0], r->offset, r->length,
+                                &r->result, r->scratch));
+    } else {
+      RETURN_NOT_OK(BatchReader::GetSingleton()->Read(filenames, fds, &reads));
+    }
+    for (int i = 0; i < reads.size(); i++) {
+      (*requests)[i].read.result = reads[i].result;
+    }
+    return Status::OK();
+  }
+
   virtual bool FileExists(const std::string& fname) OVERRIDE {
     TRACE_EVENT1("io", "PosixEnv::FileExists", "path", fname);
     ThreadRestrictions::AssertIOAllowed();
@@ -1061,6 +1457,18 @@ class PosixEnv : public Env {
     return Status::OK();
   }
 
+  virtual Status SyncFile(const std::string& fname) OVERRIDE {
+    TRACE_EVENT1("io", "SyncFile", "path", fname);
+    ThreadRestrictions::AssertIOAllowed();
+    if (FLAGS_never_fsync) return Status::OK();
+    int fd;
+    if ((fd = open(fname.c_str(), O_RDONLY)) == -1) {
+      return IOError(fname, errno);
+    }
+    ScopedFdCloser fd_closer(fd);
+    return DoSync(fd, fname);
+  }
+
   virtual Status DeleteRecursively(const std::string &name) OVERRIDE {
     return Walk(name, POST_ORDER, Bind(&PosixEnv::DeleteRecursivelyCb,
                                        Unretained(this)));
@@ -1324,7 +1732,12 @@ class PosixEnv : public Env {
     if (opts.mode == OPEN_EXISTING) {
       RETURN_NOT_OK(GetFileSize(fname, &file_size));
     }
-    if (opts.mmap_file) {
+    if (opts.direct_io) {
+      gscoped_ptr<PosixWritableFile> file(
+          new PosixWritableFile(fname, fd, file_size, opts.sync_on_close));
+      RETURN_NOT_OK(file->InitDirectIO());
+      result->reset(file.release());
+    } else if (opts.mmap_file) {
       result->reset(new PosixMmapFile(fname, fd, file_size, page_size_, opts.sync_on_close));
     } else {
       result->reset(new PosixWritableFile(fname, fd, file_size, opts.sync_on_close));
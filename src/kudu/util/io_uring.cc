@@ -0,0 +1,312 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kudu/util/io_uring.h"
+
+#include <errno.h>
+#include <glog/logging.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#endif
+
+#include "kudu/gutil/atomicops.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/env.h"
+#include "kudu/util/errno.h"
+#include "kudu/util/monotime.h"
+
+// Older C libraries may not know the system call numbers even if the kernel
+// headers define the interface.
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup)
+#define KUDU_IO_URING_SUPPORTED 1
+#endif
+
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+#ifdef KUDU_IO_URING_SUPPORTED
+
+static int IoUringSetup(uint32_t entries, io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int IoUringEnter(int ring_fd, uint32_t to_submit, uint32_t min_complete,
+                        uint32_t flags) {
+  return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+// The ring heads and tails are updated concurrently by the kernel.
+static uint32_t LoadShared(const uint32_t* p) {
+  return base::subtle::Acquire_Load(reinterpret_cast<const volatile Atomic32*>(p));
+}
+
+static void StoreShared(uint32_t* p, uint32_t val) {
+  base::subtle::Release_Store(reinterpret_cast<volatile Atomic32*>(p), val);
+}
+
+static void* MapRing(int ring_fd, size_t size, off_t offset) {
+  void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ring_fd, offset);
+  return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+IoUring::IoUring()
+  : ring_fd_(-1),
+    sq_ring_(NULL),
+    sq_ring_size_(0),
+    cq_ring_(NULL),
+    cq_ring_size_(0),
+    sqes_(NULL),
+    sqes_size_(0),
+    sq_head_(NULL),
+    sq_tail_(NULL),
+    sq_mask_(0),
+    sq_entries_(0),
+    sq_array_(NULL),
+    cq_head_(NULL),
+    cq_tail_(NULL),
+    cq_mask_(0),
+    cqes_(NULL) {
+}
+
+IoUring::~IoUring() {
+  if (sqes_) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  if (ring_fd_ >= 0) {
+    close(ring_fd_);
+  }
+}
+
+Status IoUring::Create(uint32_t queue_depth, gscoped_ptr<IoUring>* ring) {
+  gscoped_ptr<IoUring> r(new IoUring());
+  RETURN_NOT_OK(r->Init(queue_depth));
+  *ring = r.Pass();
+  return Status::OK();
+}
+
+Status IoUring::Init(uint32_t queue_depth) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring_fd_ = IoUringSetup(queue_depth, &params);
+  if (ring_fd_ < 0) {
+    int err = errno;
+    return Status::NotSupported("Could not set up io_uring", ErrnoToString(err), err);
+  }
+
+  // Map the rings separately rather than relying on newer kernels' ability
+  // to share a single mapping for both.
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  sq_ring_ = MapRing(ring_fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  cq_ring_ = MapRing(ring_fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = static_cast<io_uring_sqe*>(MapRing(ring_fd_, sqes_size_, IORING_OFF_SQES));
+  if (!sq_ring_ || !cq_ring_ || !sqes_) {
+    int err = errno;
+    return Status::IOError("Could not map io_uring", ErrnoToString(err), err);
+  }
+
+  uint8_t* sq = static_cast<uint8_t*>(sq_ring_);
+  sq_head_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sq_array_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+
+  uint8_t* cq = static_cast<uint8_t*>(cq_ring_);
+  cq_head_ = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+  // The completion queue is at least as large as the submission queue, and
+  // we never have more reads in flight than fit in the submission queue, so
+  // completions can't overflow.
+  DCHECK_GE(params.cq_entries, params.sq_entries);
+  return Status::OK();
+}
+
+Status IoUring::Read(const vector<int>& fds, vector<ReadRequest>* requests,
+                     size_t* failed_request) {
+  const size_t num_requests = requests->size();
+  DCHECK_EQ(fds.size(), num_requests);
+
+  // The number of bytes read so far for each request, and the buffer
+  // descriptor of its current read, which must stay live until the read
+  // completes.
+  vector<size_t> bytes_read(num_requests, 0);
+  vector<iovec> iovs(num_requests);
+
+  // Requests whose reads came back short or were interrupted.
+  vector<size_t> resubmit;
+
+  // The next request which hasn't been submitted yet.
+  size_t next = 0;
+
+  // The number of reads queued or submitted which haven't completed.
+  uint32_t in_flight = 0;
+
+  Status s;
+  size_t failed_idx = 0;
+  while (in_flight > 0 || (s.ok() && (next < num_requests || !resubmit.empty()))) {
+    // Queue up reads while there's room in the submission queue. Only this
+    // thread writes the tail.
+    uint32_t sq_tail = *sq_tail_;
+    while (s.ok() && in_flight < sq_entries_ &&
+           (next < num_requests || !resubmit.empty())) {
+      size_t idx;
+      if (!resubmit.empty()) {
+        idx = resubmit.back();
+        resubmit.pop_back();
+      } else {
+        idx = next++;
+      }
+      ReadRequest& req = (*requests)[idx];
+      if (req.length == 0) {
+        req.result = Slice(req.scratch, 0);
+        continue;
+      }
+      iovec* iov = &iovs[idx];
+      iov->iov_base = req.scratch + bytes_read[idx];
+      iov->iov_len = req.length - bytes_read[idx];
+
+      uint32_t slot = sq_tail & sq_mask_;
+      io_uring_sqe* sqe = &sqes_[slot];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_READV;
+      sqe->fd = fds[idx];
+      sqe->off = req.offset + bytes_read[idx];
+      sqe->addr = reinterpret_cast<uint64_t>(iov);
+      sqe->len = 1;
+      sqe->user_data = idx;
+      sq_array_[slot] = slot;
+      sq_tail++;
+      in_flight++;
+    }
+    StoreShared(sq_tail_, sq_tail);
+    if (in_flight == 0) {
+      // Only zero-length requests were left.
+      break;
+    }
+
+    // Submit whatever the kernel hasn't consumed yet, and wait for at least
+    // one of the reads to complete.
+    uint32_t to_submit = sq_tail - LoadShared(sq_head_);
+    if (IoUringEnter(ring_fd_, to_submit, 1, IORING_ENTER_GETEVENTS) < 0) {
+      int err = errno;
+      if (err == EINTR) {
+        continue;
+      }
+      // Take back the reads which the kernel didn't consume, and fail the
+      // batch. Reads it already consumed may still write into the requests'
+      // buffers, so keep waiting for them before returning.
+      uint32_t sq_head = LoadShared(sq_head_);
+      uint32_t unsubmitted = sq_tail - sq_head;
+      if (unsubmitted > 0) {
+        StoreShared(sq_tail_, sq_head);
+        in_flight -= unsubmitted;
+        if (s.ok()) {
+          failed_idx = sqes_[sq_head & sq_mask_].user_data;
+        }
+      }
+      if (s.ok()) {
+        s = Status::IOError("io_uring_enter failed", ErrnoToString(err), err);
+      }
+      if (unsubmitted == 0) {
+        // Nothing was taken back, so the wait itself failed: back off
+        // rather than spin until the reads in flight complete.
+        SleepFor(MonoDelta::FromMilliseconds(1));
+      }
+    }
+
+    uint32_t cq_head = *cq_head_;
+    uint32_t cq_tail = LoadShared(cq_tail_);
+    for (; cq_head != cq_tail; cq_head++) {
+      const io_uring_cqe& cqe = cqes_[cq_head & cq_mask_];
+      size_t idx = cqe.user_data;
+      int res = cqe.res;
+      in_flight--;
+
+      ReadRequest& req = (*requests)[idx];
+      if (res == -EINTR || res == -EAGAIN) {
+        resubmit.push_back(idx);
+      } else if (res < 0) {
+        if (s.ok()) {
+          s = Status::IOError(Substitute("Read of $0 bytes at offset $1 failed",
+                                         req.length, req.offset),
+                              ErrnoToString(-res), -res);
+          failed_idx = idx;
+        }
+      } else if (res == 0) {
+        if (s.ok()) {
+          s = Status::IOError(Substitute("EOF trying to read $0 bytes at offset $1",
+                                         req.length, req.offset));
+          failed_idx = idx;
+        }
+      } else {
+        bytes_read[idx] += res;
+        if (bytes_read[idx] < req.length) {
+          resubmit.push_back(idx);
+        } else {
+          req.result = Slice(req.scratch, req.length);
+        }
+      }
+    }
+    StoreShared(cq_head_, cq_head);
+  }
+  if (!s.ok() && failed_request) {
+    *failed_request = failed_idx;
+  }
+  return s;
+}
+
+#else
+
+IoUring::IoUring() {
+}
+
+IoUring::~IoUring() {
+}
+
+Status IoUring::Create(uint32_t queue_depth, gscoped_ptr<IoUring>* ring) {
+  return Status::NotSupported("Built without io_uring support");
+}
+
+Status IoUring::Init(uint32_t queue_depth) {
+  return Status::NotSupported("Built without io_uring support");
+}
+
+Status IoUring::Read(const vector<int>& fds, vector<ReadRequest>* requests,
+                     size_t* failed_request) {
+  return Status::NotSupported("Built without io_uring support");
+}
+
+#endif // KUDU_IO_URING_SUPPORTED
+
+} // namespace kudu
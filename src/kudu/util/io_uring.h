@@ -0,0 +1,93 @@
+// Copyright 2015 Cloudera, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef KUDU_UTIL_IO_URING_H
+#define KUDU_UTIL_IO_URING_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/status.h"
+
+struct io_uring_cqe;
+struct io_uring_sqe;
+
+namespace kudu {
+
+struct ReadRequest;
+
+// A Linux io_uring submission/completion queue pair, used to keep many
+// reads in flight from a single thread.
+//
+// This drives the kernel interface through the raw system calls rather
+// than through liburing. If the build host lacked the io_uring headers,
+// or the running kernel doesn't support it, Create() returns
+// NotSupported, and callers should fall back to blocking reads.
+//
+// Not thread-safe: each instance may only be used by one thread at a time.
+class IoUring {
+ public:
+  // Set up a ring which allows up to 'queue_depth' reads in flight.
+  static Status Create(uint32_t queue_depth, gscoped_ptr<IoUring>* ring);
+
+  ~IoUring();
+
+  // Read each of 'requests' in full from the file descriptor at the same
+  // index of 'fds', keeping as many of the reads in flight at once as the
+  // queue allows. Reads which come back short are resubmitted for the
+  // remainder.
+  //
+  // Returns once none of the reads are in flight anymore, even if one of
+  // them failed, since the kernel may otherwise still write to the
+  // requests' scratch buffers. On failure, returns the first error, and
+  // sets *failed_request (if not NULL) to the index of the request which
+  // caused it.
+  Status Read(const std::vector<int>& fds, std::vector<ReadRequest>* requests,
+              size_t* failed_request = NULL);
+
+ private:
+  IoUring();
+
+  // Map the rings of the io_uring instance 'ring_fd_'.
+  Status Init(uint32_t queue_depth);
+
+  int ring_fd_;
+
+  // The mapped submission queue ring, completion queue ring and array of
+  // submission queue entries.
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  void* cq_ring_;
+  size_t cq_ring_size_;
+  io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  // Pointers into the rings. The heads and tails are shared with the kernel.
+  uint32_t* sq_head_;
+  uint32_t* sq_tail_;
+  uint32_t sq_mask_;
+  uint32_t sq_entries_;
+  uint32_t* sq_array_;
+  uint32_t* cq_head_;
+  uint32_t* cq_tail_;
+  uint32_t cq_mask_;
+  io_uring_cqe* cqes_;
+
+  DISALLOW_COPY_AND_ASSIGN(IoUring);
+};
+
+} // namespace kudu
+
+#endif
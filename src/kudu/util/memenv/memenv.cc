@@ -243,6 +243,10 @@ class RandomAccessFileImpl : public RandomAccessFile {
     return file_->Read(offset, n, result, scratch);
   }
 
+  virtual Status ReadAhead(uint64_t offset, size_t n) const OVERRIDE {
+    return Status::OK();
+  }
+
   virtual Status Size(uint64_t *size) const OVERRIDE {
     *size = file_->Size();
     return Status::OK();
@@ -320,6 +324,10 @@ class RWFileImpl : public RWFile {
     return file_->Read(offset, length, result, scratch);
   }
 
+  virtual Status ReadAhead(uint64_t offset, size_t length) const OVERRIDE {
+    return Status::OK();
+  }
+
   virtual Status Write(uint64_t offset, const Slice& data) OVERRIDE {
     uint64_t file_size = file_->Size();
     // TODO: Modify FileState to allow rewriting.
@@ -436,6 +444,11 @@ class InMemoryEnv : public EnvWrapper {
     return NewRWFile(RWFileOptions(), fname, result);
   }
 
+  virtual Status ReadBatch(vector<FileReadRequest>* requests) OVERRIDE {
+    // The files aren't those of the wrapped Env.
+    return Env::ReadBatch(requests);
+  }
+
   virtual Status NewTempWritableFile(const WritableFileOptions& opts,
                                      const std::string& name_template,
                                      std::string* created_filename,
@@ -506,6 +519,10 @@ class InMemoryEnv : public EnvWrapper {
     return Status::OK();
   }
 
+  virtual Status SyncFile(const std::string& fname) OVERRIDE {
+    return Status::OK();
+  }
+
   virtual Status DeleteRecursively(const std::string& dirname) OVERRIDE {
     CHECK(!dirname.empty());
     string dir(dirname);
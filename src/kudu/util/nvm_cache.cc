@@ -541,8 +541,8 @@ class ShardedLRUCache : public Cache {
     lock_guard<MutexType> l(&id_mutex_);
     return ++(last_id_);
   }
-  virtual void SetMetrics(const scoped_refptr<MetricEntity>& entity) OVERRIDE {
-    metrics_.reset(new CacheMetrics(entity));
+  virtual void SetMetrics(gscoped_ptr<CacheMetrics> metrics) OVERRIDE {
+    metrics_.reset(metrics.release());
     BOOST_FOREACH(NvmLRUCache* cache, shards_) {
       cache->SetMetrics(metrics_.get());
     }